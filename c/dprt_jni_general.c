@@ -29,7 +29,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
 #include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 #include <jni.h>
 #include "dprt_jni_general.h"
 
@@ -40,6 +55,244 @@
  * Property file name. This default value copied from the DpRtStatus.java source.
  */
 #define PROPERTY_FILE_NAME "./dprt.properties"
+/**
+ * The minimum number of seconds between checks of the property file's modification time/inode,
+ * to see whether the property index needs re-loading.
+ * @see #DpRt_JNI_Property_Index_Check
+ */
+#define PROPERTY_FILE_CHECK_INTERVAL	(1)
+/**
+ * The minimum number of buckets in the property index hash table. Must be a power of two.
+ * @see #DpRt_JNI_Property_Snapshot_Struct
+ */
+#define PROPERTY_INDEX_MIN_BUCKET_COUNT	(64)
+/**
+ * The number of buckets in the DpRtStatus property cache hash table. Must be a power of two.
+ * @see #DpRt_JNI_Context_Struct
+ */
+#define STATUS_PROPERTY_CACHE_BUCKET_COUNT	(256)
+/**
+ * The number of buckets in the missing property cache hash table. Must be a power of two.
+ * @see #DpRt_JNI_Context_Struct
+ */
+#define MISSING_PROPERTY_CACHE_BUCKET_COUNT	(256)
+/**
+ * The maximum length of a log message held in the asynchronous log queue, including the terminating NULL.
+ * Longer messages are truncated.
+ * @see #Log_Record_Struct
+ */
+#define LOG_QUEUE_MESSAGE_LENGTH	(1024)
+/**
+ * The maximum number of log records the log queue thread delivers to the Java layer per batch 
+ * (per local reference frame).
+ * @see #DpRt_JNI_Log_Queue_Thread
+ */
+#define LOG_QUEUE_BATCH_LENGTH		(64)
+/**
+ * How long (in milliseconds) the log queue thread, or a producer blocked on a full log queue, waits before 
+ * re-checking the queue when it has not been signalled.
+ * @see #DpRt_JNI_Log_Queue_Thread
+ * @see #DpRt_JNI_Log_Queue_Put
+ */
+#define LOG_QUEUE_WAIT_MS		(100)
+/**
+ * The maximum length of a deadline's stage name, including the terminating NULL.
+ * @see #DpRt_JNI_Deadline_Struct
+ */
+#define DEADLINE_STAGE_LENGTH		(64)
+/**
+ * Deadline state: the reduction is running within it's budget.
+ * @see #DpRt_JNI_Deadline_Struct
+ */
+#define DEADLINE_STATE_ACTIVE		(0)
+/**
+ * Deadline state: the reduction finished within it's budget.
+ * @see #DpRt_JNI_Deadline_Struct
+ */
+#define DEADLINE_STATE_FINISHED		(1)
+/**
+ * Deadline state: the budget has elapsed, and the watchdog is aborting the reduction and reporting the overrun.
+ * @see #DpRt_JNI_Deadline_Struct
+ */
+#define DEADLINE_STATE_EXPIRED		(2)
+/**
+ * Deadline state: the watchdog has aborted the reduction and reported the overrun.
+ * @see #DpRt_JNI_Deadline_Struct
+ */
+#define DEADLINE_STATE_REPORTED		(3)
+/**
+ * The default initial capacity of each scheduler worker's job deque, if the property is not set.
+ * Deques grow as needed. Must be a power of two.
+ * @see #DpRt_JNI_Scheduler_Start
+ */
+#define SCHEDULER_DEQUE_DEFAULT_LENGTH	(64)
+/**
+ * The maximum number of futures the completion thread completes inside one JNI local reference frame.
+ * @see #DpRt_JNI_Completion_Queue_Thread
+ */
+#define COMPLETION_QUEUE_BATCH_LENGTH	(64)
+/**
+ * The maximum number of distinct strings (sub-systems, source filenames, functions and categories) 
+ * that can be interned for structured logging. Strings beyond this are sent as ID 0 (none).
+ * @see #Log_String_List
+ */
+#define LOG_STRING_MAX_COUNT		(4096)
+/**
+ * The number of hash buckets in the interned log string table.
+ * @see #Log_String_Bucket_List
+ */
+#define LOG_STRING_BUCKET_COUNT		(256)
+/**
+ * Log string registration state: the string has not been sent to the current log record handler.
+ * @see #Log_String_Struct
+ */
+#define LOG_STRING_UNREGISTERED		(0)
+/**
+ * Log string registration state: a thread is sending the string to the log record handler.
+ * @see #Log_String_Struct
+ */
+#define LOG_STRING_REGISTERING		(1)
+/**
+ * Log string registration state: the string has been sent to the current log record handler.
+ * @see #Log_String_Struct
+ */
+#define LOG_STRING_REGISTERED		(2)
+/**
+ * The number of entries in the lock-free pointer cache in front of the interned log string table.
+ * Must be a power of two.
+ * @see #Log_String_Cache
+ */
+#define LOG_STRING_CACHE_LENGTH		(1024)
+/**
+ * How many consecutive pointer cache entries are probed when looking up or adding a pointer.
+ * @see #Log_String_Cache
+ */
+#define LOG_STRING_CACHE_PROBE_COUNT	(8)
+/**
+ * Index into Done_Method_List/Method_Id_List of the setSuccessful(boolean) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_SUCCESSFUL		(0)
+/**
+ * Index of the setErrorNum(int) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_ERROR_NUM		(1)
+/**
+ * Index of the setErrorString(String) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_ERROR_STRING		(2)
+/**
+ * Index of the setFilename(String) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_FILENAME		(3)
+/**
+ * Index of the setMeanCounts(float) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_MEAN_COUNTS		(4)
+/**
+ * Index of the setPeakCounts(float) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_PEAK_COUNTS		(5)
+/**
+ * Index of the setSeeing(float) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_SEEING			(6)
+/**
+ * Index of the setCounts(float) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_COUNTS			(7)
+/**
+ * Index of the setXpix(float) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_XPIX			(8)
+/**
+ * Index of the setYpix(float) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_YPIX			(9)
+/**
+ * Index of the setPhotometricity(float) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_PHOTOMETRICITY		(10)
+/**
+ * Index of the setSkyBrightness(float) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_SKY_BRIGHTNESS		(11)
+/**
+ * Index of the setSaturation(boolean) method.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_SET_SATURATION		(12)
+/**
+ * Index of the optional setReduceResults(double[] results,int resultSetMask) method.
+ * @see #Done_Method_List
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DONE_METHOD_SET_REDUCE_RESULTS		(13)
+/**
+ * Index of the optional setSourceCatalogue(int,ByteBuffer) method.
+ * @see #Done_Method_List
+ * @see #DpRt_JNI_Set_Source_Catalogue
+ */
+#define DONE_METHOD_SET_SOURCE_CATALOGUE	(14)
+/**
+ * Index of the optional setFrame(int,ByteBuffer) method.
+ * @see #Done_Method_List
+ * @see #DpRt_JNI_Set_Reduce_Frame
+ */
+#define DONE_METHOD_SET_FRAME			(15)
+/**
+ * The number of done setter methods in Done_Method_List.
+ * @see #Done_Method_List
+ */
+#define DONE_METHOD_COUNT			(16)
+/**
+ * The number of bits of a frame handle used for the index into Frame_List. The rest of the handle is the
+ * slot's generation, so stale handles to a re-used slot are detected.
+ * @see #Frame_List
+ */
+#define FRAME_HANDLE_INDEX_BITS			(8)
+/**
+ * The maximum number of frames that can exist at one time.
+ * @see #Frame_List
+ */
+#define FRAME_MAX_COUNT				(1<<FRAME_HANDLE_INDEX_BITS)
+/**
+ * The maximum number of size classes in the frame buffer pool.
+ * @see #Frame_Pool_Size_Class_List
+ */
+#define FRAME_POOL_SIZE_CLASS_MAX_COUNT		(16)
+/**
+ * The length of an explicit huge page. Pool buffers are rounded up to a multiple of this when huge pages
+ * are requested, so each buffer starts on a huge page boundary.
+ * @see #DpRt_JNI_Frame_Pool_Initialise
+ */
+#define FRAME_POOL_HUGE_PAGE_LENGTH		(2*1024*1024)
+/**
+ * The maximum length of a frame pool property keyword.
+ * @see #DpRt_JNI_Frame_Pool_Initialise
+ */
+#define FRAME_POOL_KEYWORD_LENGTH		(256)
+/**
+ * The maximum number of arguments an error message format can have, and still be formatted lazily.
+ * @see #Error_Struct
+ */
+#define ERROR_ARGUMENT_MAX_COUNT		(8)
+/**
+ * The maximum length of a printf conversion specification in an error message format.
+ * @see #DpRt_JNI_Error_Format_Spec
+ */
+#define ERROR_FORMAT_SPEC_LENGTH		(32)
 
 /* ------------------------------------------------------- */
 /* structure definitions */
@@ -51,7 +304,8 @@
  * 	The reduction
  * 	routines should check this at regular intervals, and if it is TRUE
  * 	should abort processing and set the <a href="#DpRt_JNI_Error_Number">DpRt_JNI_Error_Number</a> and
- * 	<a href="#DpRt_JNI_Error_String">DpRt_JNI_Error_String</a> accordingly and return FALSE.</dd>
+ * 	<a href="#DpRt_JNI_Error_String">DpRt_JNI_Error_String</a> accordingly and return FALSE.
+ * 	Accessed atomically.</dd>
  * <dt>DpRt_Get_Property_Function_Pointer</dt><dd>Function pointer to actual routine that 
  * 	retrieves a keyword's string value from a Java property list Hashtable.</dd>
  * <dt>DpRt_Get_Property_Integer_Function_Pointer</dt><dd>Function pointer to actual routine that 
@@ -60,6 +314,8 @@
  * 	retrieves a keyword's double value from a Java property list Hashtable.</dd>
  * <dt>DpRt_Get_Property_Boolean_Function_Pointer</dt><dd>Function pointer to actual routine that retrieves 
  * 	a keyword's boolean value from a Java property list Hashtable.</dd>
+ * <dt>DpRt_Get_Property_List_Function_Pointer</dt><dd>Function pointer to actual routine that retrieves 
+ * 	a list of keywords' values from a Java property list Hashtable.</dd>
  * <dt></dt><dd></dd>
  * </dl>
  * @see #DpRt_JNI_Error_Number
@@ -69,1272 +325,8602 @@
  * @see #DpRt_JNI_Get_Property_Integer
  * @see #DpRt_JNI_Get_Property_Double
  * @see #DpRt_JNI_Get_Property_Boolean
+ * @see #DpRt_JNI_Get_Property_List
  */
 struct DpRt_Struct
 {
-	volatile int DpRt_Abort;/* volatile as thread dependant */
+	int DpRt_Abort;/* accessed with __atomic builtins, as thread dependant */
 	int (*DpRt_Get_Property_Function_Pointer)(char *keyword,char **value_string);
 	int (*DpRt_Get_Property_Integer_Function_Pointer)(char *keyword,int *value);
 	int (*DpRt_Get_Property_Double_Function_Pointer)(char *keyword,double *value);
 	int (*DpRt_Get_Property_Boolean_Function_Pointer)(char *keyword,int *value);
+	int (*DpRt_Get_Property_List_Function_Pointer)(struct DpRt_JNI_Property_Request_Struct *request_list,
+						       int request_count);
 };
 
-/* ------------------------------------------------------- */
-/* external variables */
-/* ------------------------------------------------------- */
 /**
- * Error Number - set this to a unique value for each location an error occurs.
+ * Data type holding one keyword/value pair loaded from the property file. The keyword and value are
+ * copied into the index's arena, so the index does not refer to the property file (or snapshot) buffer.
+ * This consists of the following:
+ * <dl>
+ * <dt>Keyword_String_Offset</dt><dd>The offset in the index's Value_Arena of a NULL terminated copy of the 
+ *     keyword, the part of the line before the '='.</dd>
+ * <dt>Keyword_Length</dt><dd>The length of the keyword, with trailing whitespace removed.</dd>
+ * <dt>Value_Length</dt><dd>The length of the value, not including the terminating newline.</dd>
+ * <dt>Value_String_Offset</dt><dd>The offset in the index's Value_Arena of a NULL terminated copy of the value,
+ *     the part of the line after the '='.</dd>
+ * <dt>Valid_List</dt><dd>For each DPRT_JNI_PROPERTY_TYPE_*, whether the value could be converted to that type
+ *     when the index was built.</dd>
+ * <dt>Integer_Value</dt><dd>The value converted to an integer, if valid.</dd>
+ * <dt>Double_Value</dt><dd>The value converted to a double, if valid.</dd>
+ * <dt>Boolean_Value</dt><dd>The value converted to a boolean, if valid.</dd>
+ * <dt>Hash</dt><dd>The hash of the keyword, as computed by DpRt_JNI_Property_Hash.</dd>
+ * <dt>Next</dt><dd>The index in the entry list of the next entry in the same hash table bucket, or -1.</dd>
+ * </dl>
+ * @see #DpRt_JNI_Property_Snapshot_Struct
+ * @see #DpRt_JNI_Property_Hash
  */
-int DpRt_JNI_Error_Number = 0;
+struct Property_Entry_Struct
+{
+	size_t Keyword_String_Offset;
+	size_t Keyword_Length;
+	size_t Value_Length;
+	size_t Value_String_Offset;
+	int Valid_List[DPRT_JNI_PROPERTY_TYPE_COUNT];
+	int Integer_Value;
+	double Double_Value;
+	int Boolean_Value;
+	unsigned int Hash;
+	int Next;
+};
+
 /**
- * Error String - set this to a descriptive string each place an error occurs.
- * Ensure the string is not longer than <a href="#DPRT_ERROR_STRING_LENGTH">DPRT_ERROR_STRING_LENGTH</a> long.
- * @see #DpRt_JNI_Error_Number
- * @see #DPRT_ERROR_STRING_LENGTH
+ * Data type holding an immutable keyword to value hash index of the property file (or a DpRtStatus snapshot). 
+ * The index is built once, and only re-built (into a new index) if the property file changes.
+ * The index, bucket list, entry list and arena (holding the keywords and values) are a single allocation.
+ * The index is reference counted, so callers of DpRt_JNI_Property_Snapshot_Acquire can borrow values from
+ * it after it has been replaced by a re-loaded index. This consists of the following:
+ * <dl>
+ * <dt>Bucket_List</dt><dd>An array of Bucket_Count hash table bucket list heads. Each is an index into 
+ *     Entry_List, or -1 if the bucket is empty.</dd>
+ * <dt>Bucket_Count</dt><dd>The number of buckets in the hash table, always a power of two.</dd>
+ * <dt>Entry_List</dt><dd>An array of Entry_Count keyword/value entries, in file order.</dd>
+ * <dt>Entry_Count</dt><dd>The number of keyword/value pairs in the index.</dd>
+ * <dt>Value_Arena</dt><dd>NULL terminated copies of the keywords and values, packed end to end.</dd>
+ * <dt>Reference_Count</dt><dd>The number of references to the index (modified atomically). The owner 
+ *     (Property_Index or a context's Status_Snapshot_Index) holds one, each acquired snapshot another.
+ *     The index is freed when the count reaches zero.</dd>
+ * <dt>Device</dt><dd>The device of the property file the index was loaded from.</dd>
+ * <dt>Inode</dt><dd>The inode of the property file the index was loaded from.</dd>
+ * <dt>Size</dt><dd>The size in bytes of the property file the index was loaded from.</dd>
+ * <dt>Modification_Time</dt><dd>The modification time of the property file the index was loaded from.</dd>
+ * </dl>
+ * @see #Property_Entry_Struct
+ * @see #PROPERTY_INDEX_MIN_BUCKET_COUNT
  */
-char DpRt_JNI_Error_String[DPRT_ERROR_STRING_LENGTH] = "";
+struct DpRt_JNI_Property_Snapshot_Struct
+{
+	int *Bucket_List;
+	unsigned int Bucket_Count;
+	struct Property_Entry_Struct *Entry_List;
+	int Entry_Count;
+	char *Value_Arena;
+	int Reference_Count;
+	dev_t Device;
+	ino_t Inode;
+	off_t Size;
+	time_t Modification_Time;
+};
 
-/* ------------------------------------------------------- */
-/* internal variables */
-/* ------------------------------------------------------- */
 /**
- * Revision Control System identifier.
+ * Data type holding the values of one keyword retrieved from the DpRtStatus object, so the next retrieval
+ * of the keyword need not call up into the JVM. A keyword's value is retrieved separately for each type,
+ * as the DpRtStatus typed getters do their own conversion. This consists of the following:
+ * <dl>
+ * <dt>Keyword</dt><dd>The keyword, stored after the entry in the same allocation.</dd>
+ * <dt>Hash</dt><dd>The hash of the keyword, as computed by DpRt_JNI_Property_Hash.</dd>
+ * <dt>Generation</dt><dd>The value of Status_Property_Cache_Generation when the values were cached.
+ *     If this differs from the current generation, none of the values are valid.</dd>
+ * <dt>Valid_List</dt><dd>Indexed by DPRT_JNI_PROPERTY_TYPE_STRING, DPRT_JNI_PROPERTY_TYPE_INTEGER, 
+ *     DPRT_JNI_PROPERTY_TYPE_DOUBLE and DPRT_JNI_PROPERTY_TYPE_BOOLEAN, whether the corresponding value has
+ *     been cached.</dd>
+ * <dt>String_Value</dt><dd>An allocated copy of the string value, or NULL (getProperty returned null).</dd>
+ * <dt>Integer_Value</dt><dd>The integer value.</dd>
+ * <dt>Double_Value</dt><dd>The double value.</dd>
+ * <dt>Boolean_Value</dt><dd>The boolean value.</dd>
+ * <dt>Next</dt><dd>The next entry in the same hash table bucket, or NULL.</dd>
+ * </dl>
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DPRT_JNI_PROPERTY_TYPE_COUNT
  */
-static char rcsid[] = "$Id: dprt_jni_general.c,v 1.4 2011-04-19 13:54:43 cjm Exp $";
+struct Status_Property_Cache_Entry_Struct
+{
+	char *Keyword;
+	unsigned int Hash;
+	unsigned int Generation;
+	int Valid_List[DPRT_JNI_PROPERTY_TYPE_COUNT];
+	char *String_Value;
+	int Integer_Value;
+	double Double_Value;
+	int Boolean_Value;
+	struct Status_Property_Cache_Entry_Struct *Next;
+};
 
 /**
- * The single instance of struct DpRt_Struct, that holds local data to this source file.
- * Initialised to NULL/FALSE.
- * @see #DpRt_Struct
+ * Data type holding one entry in a context's missing property cache, recording that a keyword 
+ * could not be retrieved (as some types) from the property source. This consists of the following:
+ * <dl>
+ * <dt>Keyword</dt><dd>An allocated copy of the keyword.</dd>
+ * <dt>Hash</dt><dd>The hash of the keyword, as computed by DpRt_JNI_Property_Hash.</dd>
+ * <dt>Generation</dt><dd>The property generation the entry was recorded in. If the property source has
+ *     changed since, the entry is stale.</dd>
+ * <dt>Missing_List</dt><dd>For each DPRT_JNI_PROPERTY_TYPE_*, whether the keyword could not be retrieved
+ *     as that type.</dd>
+ * <dt>Next</dt><dd>The next entry in the same hash table bucket.</dd>
+ * </dl>
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Property_Generation_Get
  */
-static struct DpRt_Struct DpRt_Data = 
+struct Missing_Property_Entry_Struct
 {
-	FALSE,NULL,NULL,NULL,NULL
+	char *Keyword;
+	unsigned int Hash;
+	unsigned int Generation;
+	int Missing_List[DPRT_JNI_PROPERTY_TYPE_COUNT];
+	struct Missing_Property_Entry_Struct *Next;
 };
 
 /**
- * Copy of the java virtual machine pointer, used for calling back up to the Java layer from C.
+ * Data type holding one log record in the asynchronous log queue. This consists of the following:
+ * <dl>
+ * <dt>Sequence</dt><dd>The record's sequence number, used to synchronise producers and consumers 
+ *     without locks. See DpRt_JNI_Log_Queue_Put and DpRt_JNI_Log_Queue_Get.</dd>
+ * <dt>Level</dt><dd>The log level of the message.</dd>
+ * <dt>Sub_System_Id</dt><dd>The interned ID of the sub-system, or 0.</dd>
+ * <dt>Source_Filename_Id</dt><dd>The interned ID of the source filename, or 0.</dd>
+ * <dt>Function_Id</dt><dd>The interned ID of the function, or 0.</dd>
+ * <dt>Category_Id</dt><dd>The interned ID of the category, or 0.</dd>
+ * <dt>Logger</dt><dd>The global reference to the logger of the context the message was logged in.</dd>
+ * <dt>Message</dt><dd>A copy of the message, truncated if necessary.</dd>
+ * </dl>
+ * @see #Log_Queue_Struct
+ * @see #LOG_QUEUE_MESSAGE_LENGTH
  */
-static JavaVM *Java_VM = NULL;
+struct Log_Record_Struct
+{
+	unsigned long Sequence;
+	int Level;
+	int Sub_System_Id;
+	int Source_Filename_Id;
+	int Function_Id;
+	int Category_Id;
+	jobject Logger;
+	char Message[LOG_QUEUE_MESSAGE_LENGTH];
+};
+
 /**
- * Cached global reference to the "DpRtLibrary" logger, used to log back to the Java layer from
- * C routines.
+ * Data type holding the asynchronous log queue. This is a bounded multi-producer queue of log records,
+ * from which a single thread (attached to the JVM) delivers records to the Java logger.
+ * This consists of the following:
+ * <dl>
+ * <dt>Record_List</dt><dd>An allocated ring buffer of Capacity records.</dd>
+ * <dt>Capacity</dt><dd>The number of records in the ring buffer, a power of two.</dd>
+ * <dt>Enqueue_Position</dt><dd>The position the next record will be added at (modulo Capacity).</dd>
+ * <dt>Dequeue_Position</dt><dd>The position the next record will be removed from (modulo Capacity).</dd>
+ * <dt>Overflow_Policy</dt><dd>What to do when the queue is full, one of DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_OLDEST,
+ *     DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_NEWEST, DPRT_JNI_LOG_QUEUE_OVERFLOW_BLOCK.</dd>
+ * <dt>Running</dt><dd>TRUE whilst the queue is accepting records.</dd>
+ * <dt>Active_Producer_Count</dt><dd>The number of threads currently inside DpRt_JNI_Log_Queue_Put.</dd>
+ * <dt>Thread</dt><dd>The log queue thread.</dd>
+ * <dt>Lock</dt><dd>Mutex used with the condition variables. It is only taken when the queue thread is idle,
+ *     or a producer is blocked on a full queue.</dd>
+ * <dt>Not_Empty_Condition</dt><dd>Signalled when a record is added whilst the queue thread is waiting.</dd>
+ * <dt>Not_Full_Condition</dt><dd>Signalled when records are removed whilst producers are blocked.</dd>
+ * <dt>Consumer_Waiting</dt><dd>TRUE whilst the queue thread is waiting on Not_Empty_Condition.</dd>
+ * <dt>Producer_Waiting_Count</dt><dd>The number of producers waiting on Not_Full_Condition.</dd>
+ * <dt>Record_Count</dt><dd>The number of records added to the queue.</dd>
+ * <dt>Dropped_Count</dt><dd>The number of records dropped because the queue was full.</dd>
+ * <dt>Blocked_Count</dt><dd>The number of times a producer blocked because the queue was full.</dd>
+ * <dt>Flushed_Position</dt><dd>Every record before this position has been delivered (or dropped), 
+ *     so it's logger reference is no longer in use. Updated by the queue thread after each batch.</dd>
+ * <dt>Flushed_Condition</dt><dd>Broadcast when Flushed_Position is updated whilst a thread is waiting in
+ *     DpRt_JNI_Log_Queue_Flush.</dd>
+ * <dt>Flush_Waiting_Count</dt><dd>The number of threads waiting on Flushed_Condition.</dd>
+ * </dl>
+ * @see #Log_Record_Struct
+ * @see #Log_Queue
  */
-static jobject Logger = NULL;
+struct Log_Queue_Struct
+{
+	struct Log_Record_Struct *Record_List;
+	unsigned long Capacity;
+	unsigned long Enqueue_Position;
+	unsigned long Dequeue_Position;
+	int Overflow_Policy;
+	int Running;
+	int Active_Producer_Count;
+	pthread_t Thread;
+	pthread_mutex_t Lock;
+	pthread_cond_t Not_Empty_Condition;
+	pthread_cond_t Not_Full_Condition;
+	int Consumer_Waiting;
+	int Producer_Waiting_Count;
+	unsigned long Record_Count;
+	unsigned long Dropped_Count;
+	unsigned long Blocked_Count;
+	unsigned long Flushed_Position;
+	pthread_cond_t Flushed_Condition;
+	int Flush_Waiting_Count;
+};
+
 /**
- * Cached reference to the "ngat.util.logging.Logger" class's log(int level,String message) method.
- * Used to log C layer log messages, in conjunction with the logger's object reference logger.
- * @see #logger
+ * Data type holding one interned log string. This consists of the following:
+ * <dl>
+ * <dt>String</dt><dd>An allocated copy of the string.</dd>
+ * <dt>Hash</dt><dd>The hash of the string.</dd>
+ * <dt>Next</dt><dd>The ID of the next string in the same hash bucket, or 0.</dd>
+ * <dt>Registered</dt><dd>Whether the ID/string pair has been sent to the Java log record handler, one of
+ *     LOG_STRING_UNREGISTERED, LOG_STRING_REGISTERING, LOG_STRING_REGISTERED.</dd>
+ * </dl>
+ * @see #Log_String_List
  */
-static jmethodID Log_Method_Id = NULL;
+struct Log_String_Struct
+{
+	char *String;
+	unsigned int Hash;
+	int Next;
+	int Registered;
+};
+
 /**
- * Cached global reference to the "ngat.dprt.DpRtStatus" instance, so that C routines can access Java methods.
+ * Data type holding one entry of the lock-free pointer cache in front of the interned log string table.
+ * <dl>
+ * <dt>Pointer</dt><dd>The address of a string passed to the log handler.</dd>
+ * <dt>Id</dt><dd>The interned ID of the string's contents.</dd>
+ * </dl>
+ * @see #Log_String_Cache
  */
-static jobject DpRt_Status = NULL;
+struct Log_String_Cache_Entry_Struct
+{
+	char *Pointer;
+	int Id;
+};
+
 /**
- * Cached reference to the "ngat.dprt.DpRtStatus" class's getProperty(String keyword) method.
- * Used to retrieve configuration from the Java property file from the C layer.
- * @see #DpRt_Status
+ * Data type holding one stored error message argument.
+ * <dl>
+ * <dt>Integer_Value</dt><dd>The value of a signed integer (%d, %i, %c) argument.</dd>
+ * <dt>Unsigned_Value</dt><dd>The value of an unsigned integer (%u, %x, %X, %o) argument.</dd>
+ * <dt>Double_Value</dt><dd>The value of a floating point (%f, %e, %g) argument.</dd>
+ * <dt>Pointer_Value</dt><dd>The value of a pointer (%p) argument.</dd>
+ * <dt>String_Offset</dt><dd>For a string (%s) argument, the offset of the copy of the string in the
+ *     error's String_Argument_Buffer.</dd>
+ * </dl>
+ * @see #Error_Struct
  */
-static jmethodID DpRt_Status_Get_Property_Method_Id = NULL;
+union Error_Argument_Union
+{
+	long long Integer_Value;
+	unsigned long long Unsigned_Value;
+	double Double_Value;
+	void *Pointer_Value;
+	size_t String_Offset;
+};
+
 /**
- * Cached reference to the "ngat.dprt.DpRtStatus" class's getPropertyInteger(String keyword) method.
- * Used to retrieve configuration from the Java property file from the C layer.
- * @see #DpRt_Status
+ * Data type holding a thread's error state. The error message is not formatted when the error occurs,
+ * the format and arguments are stored, and only formatted into String when the string is retrieved.
+ * <dl>
+ * <dt>Number</dt><dd>The error number, 0 if no error has occured.</dd>
+ * <dt>Format</dt><dd>The printf format of an error message not yet formatted into String (pointing to 
+ *     Format_Buffer), or NULL if String is up to date.</dd>
+ * <dt>Format_Buffer</dt><dd>A copy of the format, as the caller's format may not exist by the time
+ *     the message is formatted.</dd>
+ * <dt>Argument_Count</dt><dd>The number of arguments in Argument_List.</dd>
+ * <dt>Argument_List</dt><dd>The format's arguments.</dd>
+ * <dt>String_Argument_Buffer</dt><dd>Copies of the format's string arguments, which may not exist
+ *     by the time the message is formatted.</dd>
+ * <dt>String_Argument_Length</dt><dd>The number of bytes of String_Argument_Buffer in use.</dd>
+ * <dt>String</dt><dd>The formatted error message.</dd>
+ * </dl>
+ * @see #DpRt_JNI_Error_Set
+ * @see #DpRt_JNI_Error_Format
  */
-static jmethodID DpRt_Status_Get_Property_Integer_Method_Id = NULL;
+struct Error_Struct
+{
+	int Number;
+	char *Format;
+	char Format_Buffer[DPRT_ERROR_STRING_LENGTH];
+	int Argument_Count;
+	union Error_Argument_Union Argument_List[ERROR_ARGUMENT_MAX_COUNT];
+	char String_Argument_Buffer[DPRT_ERROR_STRING_LENGTH];
+	size_t String_Argument_Length;
+	char String[DPRT_ERROR_STRING_LENGTH];
+};
+
 /**
- * Cached reference to the "ngat.dprt.DpRtStatus" class's getPropertyDouble(String keyword) method.
- * Used to retrieve configuration from the Java property file from the C layer.
- * @see #DpRt_Status
+ * Data type holding one thread's latency histograms, one per probe. Only the owning thread updates it 
+ * (using relaxed atomic stores, so it needs no locks), other threads read it when merging.
+ * This consists of the following:
+ * <dl>
+ * <dt>Probe_List</dt><dd>The histograms, indexed by the DPRT_JNI_LATENCY_PROBE_ defines.</dd>
+ * <dt>Previous</dt><dd>The previous thread's histograms in Latency_Histogram_List, or NULL.</dd>
+ * <dt>Next</dt><dd>The next thread's histograms in Latency_Histogram_List, or NULL.</dd>
+ * </dl>
+ * @see #Latency_Histogram_List
+ * @see #DpRt_JNI_Latency_Record
  */
-static jmethodID DpRt_Status_Get_Property_Double_Method_Id = NULL;
+struct Latency_Thread_Histogram_Struct
+{
+	struct DpRt_JNI_Latency_Histogram_Struct Probe_List[DPRT_JNI_LATENCY_PROBE_COUNT];
+	struct Latency_Thread_Histogram_Struct *Previous;
+	struct Latency_Thread_Histogram_Struct *Next;
+};
+
 /**
- * Cached reference to the "ngat.dprt.DpRtStatus" class's getPropertyBoolean(String keyword) method.
- * Used to retrieve configuration from the Java property file from the C layer.
- * @see #DpRt_Status
+ * Data type holding per-thread state, stored against Thread_Data_Key. This consists of the following:
+ * <dl>
+ * <dt>Env</dt><dd>The JNI environment pointer for this thread, or NULL if not yet retrieved.</dd>
+ * <dt>Attached</dt><dd>TRUE if this library attached the thread to the JVM (and so must detach it 
+ *     when the thread exits), FALSE if the thread was already attached (e.g. it is a Java thread).</dd>
+ * <dt>Local_Reference_Count</dt><dd>When Local_Reference_Debug is TRUE, the number of JNI local references
+ *     created by this library's upcalls on this thread that have not yet been deleted.</dd>
+ * <dt>Local_Reference_High_Water</dt><dd>When Local_Reference_Debug is TRUE, the maximum value 
+ *     Local_Reference_Count has reached.</dd>
+ * <dt>Context</dt><dd>The context bound to this thread by DpRt_JNI_Context_Set_Current, or NULL to use
+ *     Default_Context.</dd>
+ * <dt>Error</dt><dd>This thread's error state.</dd>
+ * <dt>Cancel_Token</dt><dd>The cancellation token of the reduction running on this thread, bound by 
+ *     DpRt_JNI_Cancel_Token_Set_Current, or NULL.</dd>
+ * <dt>Scheduler_Worker</dt><dd>If this thread is a scheduler worker, it's worker, otherwise NULL. 
+ *     Jobs submitted by a worker are queued on it's own deque.</dd>
+ * <dt>Latency_Histogram</dt><dd>This thread's latency histograms, allocated the first time the thread
+ *     records a latency, or NULL.</dd>
+ * </dl>
+ * @see #Thread_Data_Key
+ * @see #DpRt_JNI_Get_Env
  */
-static jmethodID DpRt_Status_Get_Property_Boolean_Method_Id = NULL;
+struct Thread_Data_Struct
+{
+	JNIEnv *Env;
+	int Attached;
+	int Local_Reference_Count;
+	int Local_Reference_High_Water;
+	struct DpRt_JNI_Context_Struct *Context;
+	struct Error_Struct Error;
+	struct DpRt_JNI_Cancel_Token_Struct *Cancel_Token;
+	struct Scheduler_Worker_Struct *Scheduler_Worker;
+	struct Latency_Thread_Histogram_Struct *Latency_Histogram;
+};
 
-/* ------------------------------------------------------- */
-/* internal function declarations */
-/* ------------------------------------------------------- */
-static int DpRt_JNI_Get_Property_From_C_File(char *keyword,char **value_string);
-static int DpRt_JNI_Get_Property_Integer_From_C_File(char *keyword,int *value);
-static int DpRt_JNI_Get_Property_Double_From_C_File(char *keyword,double *value);
-static int DpRt_JNI_Get_Property_Boolean_From_C_File(char *keyword,int *value);
+/**
+ * Data type holding the name and signature of one done setter method.
+ * <dl>
+ * <dt>Name</dt><dd>The method name.</dd>
+ * <dt>Signature</dt><dd>The JNI method signature.</dd>
+ * </dl>
+ * @see #Done_Method_List
+ */
+struct Done_Method_Struct
+{
+	char *Name;
+	char *Signature;
+};
 
-/* ------------------------------------------------------- */
-/* external functions */
-/* ------------------------------------------------------- */
-/* initialisation */
 /**
- * This routine gets called when the native library is loaded. We use this routine
- * to get a copy of the JavaVM pointer of the JVM we are running in. This is used to
- * get the correct per-thread JNIEnv context pointer when C calls back into Java.
- * @see #Java_VM
+ * Data type holding the resolved done setter method IDs of one done class. This consists of the following:
+ * <dl>
+ * <dt>Class</dt><dd>A global reference to the class.</dd>
+ * <dt>Method_Id_List</dt><dd>The method ID of each method in Done_Method_List, or NULL if the class does
+ *     not have that method.</dd>
+ * <dt>Next</dt><dd>The next class in the registry.</dd>
+ * </dl>
+ * @see #Done_Class_List
+ * @see #DpRt_JNI_Done_Class_Get
  */
-void DpRt_JNI_Set_Java_VM(JavaVM *vm)
+struct Done_Class_Struct
 {
-	Java_VM = vm;
-}
+	jclass Class;
+	jmethodID Method_Id_List[DONE_METHOD_COUNT];
+	struct Done_Class_Struct *Next;
+};
 
 /**
- * This takes the supplied ngat.dprt.DpRtStatus object reference and stores it in the 
- * DpRt_Status variable as a global reference.
- * Some method ID's from this class are also retrieved and stored.
- * @param env The JNI environment pointer.
- * @param object The instance of ngat.dprt.DpRtLibraryInterface this method was called with.
- * @param status The DpRt's instance of ngat.dprt.DpRtStatus.
- * @see #DpRt_Status
- * @see #DpRt_Status_Get_Property_Method_Id
- * @see #DpRt_Status_Get_Property_Integer_Method_Id
- * @see #DpRt_Status_Get_Property_Double_Method_Id
- * @see #DpRt_Status_Get_Property_Boolean_Method_Id
+ * Data type holding one frame of native memory shared between C pipelines and Java. This consists of:
+ * <dl>
+ * <dt>In_Use</dt><dd>TRUE if this slot holds a frame.</dd>
+ * <dt>Generation</dt><dd>Incremented each time the slot is re-used, and part of the frame's handle.</dd>
+ * <dt>Reference_Count</dt><dd>The number of owners of the frame. The frame is freed when this reaches 0.</dd>
+ * <dt>Data</dt><dd>The frame's memory.</dd>
+ * <dt>Length</dt><dd>The length of Data in bytes.</dd>
+ * <dt>Free_Function</dt><dd>If non-NULL, called with Data and Free_User_Data to free wrapped memory.
+ *     If NULL (and Buffer is NULL), Data was allocated by this library and is freed with free().</dd>
+ * <dt>Free_User_Data</dt><dd>Passed to Free_Function.</dd>
+ * <dt>Buffer</dt><dd>If the frame's memory belongs to a Java direct ByteBuffer, a global reference
+ *     to it, keeping it alive until the frame is freed. NULL otherwise.</dd>
+ * </dl>
+ * @see #Frame_List
  */
-void DpRt_JNI_Set_Status(JNIEnv *env,jobject object,jobject status)
+struct Frame_Struct
 {
-	jclass cls = NULL;
+	int In_Use;
+	unsigned int Generation;
+	int Reference_Count;
+	void *Data;
+	size_t Length;
+	void (*Free_Function)(void *data,void *user_data);
+	void *Free_User_Data;
+	jobject Buffer;
+};
 
-/* save DpRtStatus instance */
-	DpRt_Status = (*env)->NewGlobalRef(env,status);
-/* get the DpRtStatus class */
-	cls = (*env)->FindClass(env,"ngat/dprt/DpRtStatus");
-	/* if the class is null, one of the following exceptions occured:
-	** ClassFormatError,ClassCircularityError,NoClassDefFoundError,OutOfMemoryError */
-	if(cls == NULL)
-		return;
-/* get relevant method id's to call */
-/* String getProperty(java/lang/String keyword) */
-	DpRt_Status_Get_Property_Method_Id = (*env)->GetMethodID(env,cls,"getProperty",
-								 "(Ljava/lang/String;)Ljava/lang/String;");
-	if(DpRt_Status_Get_Property_Method_Id == NULL)
-	{
-		/* One of the following exceptions has been thrown:
-		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
-		return;
-	}
-/* int getPropertyInteger(java/lang/String keyword) */
-	DpRt_Status_Get_Property_Integer_Method_Id = (*env)->GetMethodID(env,cls,"getPropertyInteger",
-								 "(Ljava/lang/String;)I");
-	if(DpRt_Status_Get_Property_Integer_Method_Id == NULL)
-	{
-		/* One of the following exceptions has been thrown:
-		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
-		return;
-	}
-/* double getPropertyDouble(java/lang/String keyword) */
-	DpRt_Status_Get_Property_Double_Method_Id = (*env)->GetMethodID(env,cls,"getPropertyDouble",
-								 "(Ljava/lang/String;)D");
-	if(DpRt_Status_Get_Property_Double_Method_Id == NULL)
-	{
-		/* One of the following exceptions has been thrown:
-		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
-		return;
-	}
-/* boolean getPropertyBoolean(java/lang/String keyword) */
-	DpRt_Status_Get_Property_Boolean_Method_Id = (*env)->GetMethodID(env,cls,"getPropertyBoolean",
-								 "(Ljava/lang/String;)Z");
-	if(DpRt_Status_Get_Property_Boolean_Method_Id == NULL)
-	{
-		/* One of the following exceptions has been thrown:
-		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
-		return;
-	}
-}
+/**
+ * Data type holding one size class of the frame buffer pool. This consists of:
+ * <dl>
+ * <dt>Buffer_Length</dt><dd>The length of each buffer in bytes, rounded up to a whole number of pages.</dd>
+ * <dt>Buffer_Count</dt><dd>The number of buffers in this size class.</dd>
+ * <dt>Region</dt><dd>One mapping holding all the buffers, contiguously.</dd>
+ * <dt>Region_Length</dt><dd>The length of Region in bytes.</dd>
+ * <dt>Huge_Pages</dt><dd>TRUE if Region is backed by explicit huge pages.</dd>
+ * <dt>Locked</dt><dd>TRUE if Region was successfully locked into RAM with mlock.</dd>
+ * <dt>Next_List</dt><dd>For each free buffer, the index of the next free buffer, or -1.</dd>
+ * <dt>Free_Head</dt><dd>The head of the free buffer stack. The low 32 bits are the index of the top buffer 
+ *     plus one (0 when empty), the high 32 bits a tag incremented on every change, so a compare and swap
+ *     cannot succeed against a head that has been popped and pushed back in the meantime.</dd>
+ * <dt>Free_Count</dt><dd>The number of buffers currently on the free stack.</dd>
+ * </dl>
+ * @see #Frame_Pool_Size_Class_List
+ */
+struct Frame_Pool_Size_Class_Struct
+{
+	size_t Buffer_Length;
+	int Buffer_Count;
+	char *Region;
+	size_t Region_Length;
+	int Huge_Pages;
+	int Locked;
+	int *Next_List;
+	uint64_t Free_Head;
+	int Free_Count;
+};
 
 /**
- * This takes the supplied logger object reference and stores it in the logger variable as a global reference.
- * The log method ID is also retrieved and stored.
- * @param l The DpRtLibrary's specific (instrument specific) logger.
- * @see #Logger
- * @see #Log_Method_Id
+ * Data type holding a cancellation token, used to abort one reduction without affecting others.
+ * This consists of the following:
+ * <dl>
+ * <dt>Cancelled</dt><dd>Whether the token has been cancelled (accessed atomically). Once set, it is never cleared.</dd>
+ * <dt>Lock</dt><dd>Mutex protecting Event_Fd, and used with Condition.</dd>
+ * <dt>Condition</dt><dd>Condition variable broadcast when the token is cancelled, used by 
+ *     DpRt_JNI_Cancel_Token_Wait. Uses CLOCK_MONOTONIC for timed waits.</dd>
+ * <dt>Event_Fd</dt><dd>An eventfd signalled when the token is cancelled, created on demand by 
+ *     DpRt_JNI_Cancel_Token_Get_Event_Fd, or -1.</dd>
+ * <dt>Context</dt><dd>The context the token was created in, or NULL if the context has been destroyed.
+ *     Protected by Cancel_Token_Context_Lock once the token is created.</dd>
+ * <dt>Next</dt><dd>The next token in the context's Cancel_Token_List.</dd>
+ * </dl>
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Cancel_Token_Create
  */
-void DpRt_JNI_Initialise_Logger_Reference(JNIEnv *env,jobject obj,jobject l)
+struct DpRt_JNI_Cancel_Token_Struct
 {
-	jclass cls = NULL;
+	int Cancelled;
+	pthread_mutex_t Lock;
+	pthread_cond_t Condition;
+	int Event_Fd;
+	struct DpRt_JNI_Context_Struct *Context;
+	struct DpRt_JNI_Cancel_Token_Struct *Next;
+};
 
-/* save logger instance */
-	Logger = (*env)->NewGlobalRef(env,l);
-/* get the ngat.util.logging.Logger class */
-	cls = (*env)->FindClass(env,"ngat/util/logging/Logger");
-	/* if the class is null, one of the following exceptions occured:
-	** ClassFormatError,ClassCircularityError,NoClassDefFoundError,OutOfMemoryError */
-	if(cls == NULL)
-		return;
-/* get relevant method id to call */
-/* log(int level,java/lang/String message) */
+/**
+ * Data type holding the deadline of one reduction, watched by the deadline watchdog thread.
+ * This consists of the following:
+ * <dl>
+ * <dt>Budget</dt><dd>The reduction's latency budget, in seconds.</dd>
+ * <dt>Start_Time</dt><dd>When the deadline was started (CLOCK_MONOTONIC).</dd>
+ * <dt>Expiry_Time</dt><dd>When the budget elapses (CLOCK_MONOTONIC).</dd>
+ * <dt>State</dt><dd>One of DEADLINE_STATE_ACTIVE, DEADLINE_STATE_FINISHED, DEADLINE_STATE_EXPIRED, 
+ *     DEADLINE_STATE_REPORTED.</dd>
+ * <dt>Stage</dt><dd>The name of the pipeline stage currently running, set by DpRt_JNI_Deadline_Stage_Set.</dd>
+ * <dt>Cancel_Token</dt><dd>The token to cancel if the budget elapses, or NULL if the budget is zero or less.</dd>
+ * <dt>Cancel_Token_Owned</dt><dd>TRUE if Cancel_Token was created (and bound to the starting thread) by 
+ *     DpRt_JNI_Deadline_Start, and is destroyed by DpRt_JNI_Deadline_Finish.</dd>
+ * <dt>Done_Class</dt><dd>A global reference to the class of Done, or NULL.</dd>
+ * <dt>Done</dt><dd>A global reference to the COMMAND_DONE object the overrun is reported to, or NULL.</dd>
+ * <dt>Next</dt><dd>The next deadline in the watchdog's Deadline_List.</dd>
+ * </dl>
+ * All fields after Stage are only modified whilst holding the Deadline_Watchdog lock.
+ * @see #Deadline_Watchdog
+ * @see #DpRt_JNI_Deadline_Start
+ */
+struct DpRt_JNI_Deadline_Struct
+{
+	double Budget;
+	struct timespec Start_Time;
+	struct timespec Expiry_Time;
+	int State;
+	char Stage[DEADLINE_STAGE_LENGTH];
+	struct DpRt_JNI_Cancel_Token_Struct *Cancel_Token;
+	int Cancel_Token_Owned;
+	jclass Done_Class;
+	jobject Done;
+	struct DpRt_JNI_Deadline_Struct *Next;
+};
+
+/**
+ * Data type holding one reduction job submitted to the scheduler. This consists of the following:
+ * <dl>
+ * <dt>Reduce_Function</dt><dd>The function that does the reduction, and sets the done object's reduce 
+ *     specific results.</dd>
+ * <dt>User_Data</dt><dd>Passed to Reduce_Function.</dd>
+ * <dt>Done_Class</dt><dd>A global reference to the class of Done.</dd>
+ * <dt>Done</dt><dd>A global reference to the done object completion is reported to.</dd>
+ * <dt>Future</dt><dd>A global reference to a CompletableFuture to complete with Done once completion has
+ *     been reported, or NULL. See DpRt_JNI_Reduce_Async_Submit.</dd>
+ * <dt>Context</dt><dd>The context the job was submitted in, bound to the worker whilst the job runs.</dd>
+ * <dt>Cancel_Token</dt><dd>The job's cancellation token, created in Context (so DpRt_JNI_Set_Abort in that
+ *     context cancels it), and bound to the worker whilst the job runs.</dd>
+ * </dl>
+ * @see #DpRt_JNI_Scheduler_Submit
+ */
+struct Scheduler_Job_Struct
+{
+	int (*Reduce_Function)(JNIEnv *env,jclass cls,jobject done,void *user_data);
+	void *User_Data;
+	jclass Done_Class;
+	jobject Done;
+	jobject Future;
+	struct DpRt_JNI_Context_Struct *Context;
+	struct DpRt_JNI_Cancel_Token_Struct *Cancel_Token;
+};
+
+/**
+ * Data type holding one scheduler worker and it's job deque. The owning worker pushes and pops jobs at the 
+ * bottom of the deque (so recently submitted, cache-warm jobs run first), other workers steal from the top.
+ * The deque is a ring buffer, protected by a mutex. This consists of the following:
+ * <dl>
+ * <dt>Thread</dt><dd>The worker thread.</dd>
+ * <dt>Index</dt><dd>The worker's index in the scheduler's Worker_List.</dd>
+ * <dt>Lock</dt><dd>Mutex protecting the deque.</dd>
+ * <dt>Job_List</dt><dd>The ring buffer of Capacity jobs.</dd>
+ * <dt>Capacity</dt><dd>The size of Job_List, always a power of two. Doubled when the deque is full.</dd>
+ * <dt>Top</dt><dd>The position of the oldest job, where thieves steal from.</dd>
+ * <dt>Bottom</dt><dd>The position after the newest job, where the owner pushes and pops.</dd>
+ * </dl>
+ * @see #Scheduler
+ * @see #DpRt_JNI_Scheduler_Worker_Thread
+ */
+struct Scheduler_Worker_Struct
+{
+	pthread_t Thread;
+	int Index;
+	pthread_mutex_t Lock;
+	struct Scheduler_Job_Struct **Job_List;
+	unsigned long Capacity;
+	unsigned long Top;
+	unsigned long Bottom;
+};
+
+/**
+ * Data type holding the state of the work-stealing reduction scheduler. This consists of the following:
+ * <dl>
+ * <dt>Running</dt><dd>Whether the scheduler is accepting jobs.</dd>
+ * <dt>Worker_List</dt><dd>The list of Worker_Count workers.</dd>
+ * <dt>Worker_Count</dt><dd>The number of workers.</dd>
+ * <dt>Submit_Lock</dt><dd>Read-write lock. Submitters hold it for reading whilst they check Running and queue
+ *     a job on Worker_List, starting and stopping the scheduler hold it for writing whilst they change Running,
+ *     so the scheduler cannot be stopped (and Worker_List freed) in the middle of a submit.</dd>
+ * <dt>Lock</dt><dd>Mutex used with Work_Condition.</dd>
+ * <dt>Work_Condition</dt><dd>Signalled when a job is submitted whilst workers are sleeping.</dd>
+ * <dt>Started_Condition</dt><dd>Broadcast (with Lock) when a worker has tried to attach to the JVM, 
+ *     and when DpRt_JNI_Scheduler_Start has finished starting the workers.</dd>
+ * <dt>Starting</dt><dd>TRUE whilst DpRt_JNI_Scheduler_Start waits for the workers to attach to the JVM.
+ *     The workers do not take jobs until it is cleared.</dd>
+ * <dt>Started_Count</dt><dd>The number of workers that have tried to attach to the JVM.</dd>
+ * <dt>Attach_Failed_Count</dt><dd>The number of workers that failed to attach to the JVM.</dd>
+ * <dt>Sleeping_Count</dt><dd>The number of workers waiting on Work_Condition.</dd>
+ * <dt>Pending_Count</dt><dd>The number of jobs in all the deques (modified atomically).</dd>
+ * <dt>Submit_Position</dt><dd>Used to distribute jobs submitted from outside the scheduler round-robin 
+ *     across the workers (modified atomically).</dd>
+ * <dt>Submitted_Count</dt><dd>The number of jobs submitted (modified atomically).</dd>
+ * <dt>Completed_Count</dt><dd>The number of jobs completed (modified atomically).</dd>
+ * <dt>Stolen_Count</dt><dd>The number of jobs run by a worker other than the one they were queued on 
+ *     (modified atomically).</dd>
+ * </dl>
+ * @see #Scheduler
+ */
+struct Scheduler_Struct
+{
+	int Running;
+	struct Scheduler_Worker_Struct *Worker_List;
+	int Worker_Count;
+	pthread_rwlock_t Submit_Lock;
+	pthread_mutex_t Lock;
+	pthread_cond_t Work_Condition;
+	pthread_cond_t Started_Condition;
+	int Starting;
+	int Started_Count;
+	int Attach_Failed_Count;
+	int Sleeping_Count;
+	unsigned long Pending_Count;
+	unsigned long Submit_Position;
+	unsigned long Submitted_Count;
+	unsigned long Completed_Count;
+	unsigned long Stolen_Count;
+};
+
+/**
+ * Data type holding one completion in the completion queue. This consists of the following:
+ * <dl>
+ * <dt>Future</dt><dd>A global reference to the CompletableFuture to complete.</dd>
+ * <dt>Done</dt><dd>A global reference to the (filled in) done object to complete it with.</dd>
+ * <dt>Next</dt><dd>The next completion in the queue, or NULL.</dd>
+ * </dl>
+ * @see #Completion_Queue_Struct
+ */
+struct Completion_Struct
+{
+	jobject Future;
+	jobject Done;
+	struct Completion_Struct *Next;
+};
+
+/**
+ * Data type holding the completion queue. Scheduler workers add completions of asynchronous reductions to 
+ * the queue, and a single thread (attached to the JVM) removes all the queued completions at once and
+ * completes their futures. CompletableFuture.complete runs the future's dependent actions on the completing 
+ * thread, so this keeps Java callbacks off the reduction workers. This consists of the following:
+ * <dl>
+ * <dt>Running</dt><dd>TRUE whilst the queue is accepting completions. Only set once the completion thread
+ *     has attached to the JVM.</dd>
+ * <dt>Starting</dt><dd>TRUE whilst DpRt_JNI_Completion_Queue_Start waits for the completion thread to 
+ *     attach to the JVM.</dd>
+ * <dt>Thread</dt><dd>The completion thread.</dd>
+ * <dt>Lock</dt><dd>Mutex protecting the queue.</dd>
+ * <dt>Not_Empty_Condition</dt><dd>Signalled when a completion is added to an empty queue.</dd>
+ * <dt>Started_Condition</dt><dd>Signalled when the completion thread has tried to attach to the JVM.</dd>
+ * <dt>Head</dt><dd>The oldest completion in the queue, or NULL if the queue is empty.</dd>
+ * <dt>Tail</dt><dd>The newest completion in the queue, or NULL if the queue is empty.</dd>
+ * <dt>Complete_Method_Id</dt><dd>The method ID of CompletableFuture.complete(Object).</dd>
+ * <dt>Completion_Count</dt><dd>The number of futures completed.</dd>
+ * <dt>Batch_Count</dt><dd>The number of batches the futures were completed in.</dd>
+ * </dl>
+ * @see #Completion_Struct
+ * @see #Completion_Queue
+ */
+struct Completion_Queue_Struct
+{
+	int Running;
+	int Starting;
+	pthread_t Thread;
+	pthread_mutex_t Lock;
+	pthread_cond_t Not_Empty_Condition;
+	pthread_cond_t Started_Condition;
+	struct Completion_Struct *Head;
+	struct Completion_Struct *Tail;
+	jmethodID Complete_Method_Id;
+	unsigned long Completion_Count;
+	unsigned long Batch_Count;
+};
+
+/**
+ * Data type holding the state of the deadline watchdog thread. This consists of the following:
+ * <dl>
+ * <dt>Lock</dt><dd>Mutex protecting the watchdog and it's deadlines.</dd>
+ * <dt>Condition</dt><dd>Condition variable (using CLOCK_MONOTONIC) broadcast when a deadline is added,
+ *     an overrun has been reported, or the watchdog is stopped.</dd>
+ * <dt>Thread</dt><dd>The watchdog thread.</dd>
+ * <dt>Running</dt><dd>Whether the watchdog thread is running.</dd>
+ * <dt>Deadline_List</dt><dd>The list of active deadlines.</dd>
+ * <dt>Overrun_Count</dt><dd>The number of deadlines that have overrun.</dd>
+ * </dl>
+ * @see #Deadline_Watchdog
+ * @see #DpRt_JNI_Deadline_Watchdog_Thread
+ */
+struct Deadline_Watchdog_Struct
+{
+	pthread_mutex_t Lock;
+	pthread_cond_t Condition;
+	pthread_t Thread;
+	int Running;
+	struct DpRt_JNI_Deadline_Struct *Deadline_List;
+	unsigned long Overrun_Count;
+};
+
+/**
+ * Data type holding one independent pipeline context: it's property backend, logger, status object 
+ * and abort flag. The public routines operate on the calling thread's current context
+ * (see DpRt_JNI_Context_Set_Current), which is Default_Context unless another has been bound.
+ * This consists of the following:
+ * <dl>
+ * <dt>DpRt_Data</dt><dd>The property retrieval function pointers and abort flag.</dd>
+ * <dt>Logger</dt><dd>Cached global reference to the "DpRtLibrary" logger, used to log back to the 
+ *     Java layer from C routines.</dd>
+ * <dt>Log_Filter_Function</dt><dd>The log filter function. If non-NULL, DpRt_JNI_Log_Handler and 
+ *     DpRt_JNI_Log_Format call this before formatting or marshalling a message logged in this context, and 
+ *     discard the message if it returns FALSE. Initially NULL (no filtering), unless the logger's level can be 
+ *     retrieved by DpRt_JNI_Initialise_Logger_Reference.</dd>
+ * <dt>Log_Filter_Level</dt><dd>A native copy of the context's Java logger's level threshold, 
+ *     used by the log filter functions.</dd>
+ * <dt>DpRt_Status</dt><dd>Cached global reference to the "ngat.dprt.DpRtStatus" instance, so that 
+ *     C routines can access Java methods.</dd>
+ * <dt>DpRt_Status_Get_Property_Method_Id</dt><dd>Cached reference to the DpRtStatus class's 
+ *     getProperty(String keyword) method.</dd>
+ * <dt>DpRt_Status_Get_Property_Integer_Method_Id</dt><dd>Cached reference to the DpRtStatus class's 
+ *     getPropertyInteger(String keyword) method.</dd>
+ * <dt>DpRt_Status_Get_Property_Double_Method_Id</dt><dd>Cached reference to the DpRtStatus class's 
+ *     getPropertyDouble(String keyword) method.</dd>
+ * <dt>DpRt_Status_Get_Property_Boolean_Method_Id</dt><dd>Cached reference to the DpRtStatus class's 
+ *     getPropertyBoolean(String keyword) method.</dd>
+ * <dt>DpRt_Status_Get_Property_List_Method_Id</dt><dd>Cached reference to the DpRtStatus class's 
+ *     getPropertyList(String keywords[]) method. This method is optional, if the DpRtStatus class does not 
+ *     have it this is NULL, and DpRt_JNI_DpRtStatus_Get_Property_List retrieves each value in turn.</dd>
+ * <dt>DpRt_Status_Get_Property_Snapshot_Method_Id</dt><dd>Cached reference to the DpRtStatus class's 
+ *     getPropertySnapshot(String prefix) method. This method is optional, if the DpRtStatus class does not 
+ *     have it this is NULL and snapshots cannot be taken.</dd>
+ * <dt>Status_Property_Cache</dt><dd>Hash table of values retrieved from the DpRtStatus object, keyed by keyword.</dd>
+ * <dt>Status_Property_Cache_Lock</dt><dd>Mutex protecting Status_Property_Cache.</dd>
+ * <dt>Status_Property_Cache_Generation</dt><dd>The current DpRtStatus property cache generation. Cache entries 
+ *     with a different generation are stale. Incremented (atomically) by 
+ *     DpRt_JNI_DpRtStatus_Property_Cache_Invalidate.</dd>
+ * <dt>Status_Snapshot_Enable</dt><dd>Whether DpRt_JNI_Set_Status should take a snapshot of the 
+ *     DpRtStatus properties.</dd>
+ * <dt>Status_Snapshot_Prefix</dt><dd>An allocated copy of the keyword prefix of properties to snapshot, 
+ *     or NULL to snapshot all properties.</dd>
+ * <dt>Status_Snapshot_Index</dt><dd>Index of the snapshot of the DpRtStatus properties, or NULL if no 
+ *     snapshot has been taken. Keywords starting with Status_Snapshot_Prefix are retrieved from here rather
+ *     than calling up into the JVM.</dd>
+ * <dt>Status_Snapshot_Lock</dt><dd>Read/write lock protecting Status_Snapshot_Index and 
+ *     Status_Snapshot_Prefix.</dd>
+ * <dt>Property_Generation</dt><dd>Incremented (atomically) whenever the context's property source changes,
+ *     so entries in Missing_Property_Cache become stale.</dd>
+ * <dt>Missing_Property_Cache</dt><dd>Hash table of keywords the optional property getters 
+ *     (DpRt_JNI_Get_Property_*_Default) failed to retrieve.</dd>
+ * <dt>Missing_Property_Cache_Lock</dt><dd>Mutex protecting Missing_Property_Cache.</dd>
+ * <dt>Cancel_Token_List</dt><dd>List of the cancellation tokens created in this context, 
+ *     all cancelled by DpRt_JNI_Set_Abort.</dd>
+ * <dt>Cancel_Token_Lock</dt><dd>Mutex protecting Cancel_Token_List.</dd>
+ * </dl>
+ * @see #DpRt_Struct
+ * @see #Default_Context
+ * @see #DpRt_JNI_Context_Get_Current
+ * @see #DpRt_JNI_Status_Property_Cache_Get
+ * @see #DpRt_JNI_Status_Snapshot_Refresh
+ */
+struct DpRt_JNI_Context_Struct
+{
+	struct DpRt_Struct DpRt_Data;
+	jobject Logger;
+	int (*Log_Filter_Function)(char *sub_system,char *source_filename,char *function,int level,
+				   char *category,char *string);
+	int Log_Filter_Level;
+	jobject DpRt_Status;
+	jmethodID DpRt_Status_Get_Property_Method_Id;
+	jmethodID DpRt_Status_Get_Property_Integer_Method_Id;
+	jmethodID DpRt_Status_Get_Property_Double_Method_Id;
+	jmethodID DpRt_Status_Get_Property_Boolean_Method_Id;
+	jmethodID DpRt_Status_Get_Property_List_Method_Id;
+	jmethodID DpRt_Status_Get_Property_Snapshot_Method_Id;
+	struct Status_Property_Cache_Entry_Struct *Status_Property_Cache[STATUS_PROPERTY_CACHE_BUCKET_COUNT];
+	pthread_mutex_t Status_Property_Cache_Lock;
+	unsigned int Status_Property_Cache_Generation;
+	int Status_Snapshot_Enable;
+	char *Status_Snapshot_Prefix;
+	struct DpRt_JNI_Property_Snapshot_Struct *Status_Snapshot_Index;
+	pthread_rwlock_t Status_Snapshot_Lock;
+	unsigned int Property_Generation;
+	struct Missing_Property_Entry_Struct *Missing_Property_Cache[MISSING_PROPERTY_CACHE_BUCKET_COUNT];
+	pthread_mutex_t Missing_Property_Cache_Lock;
+	struct DpRt_JNI_Cancel_Token_Struct *Cancel_Token_List;
+	pthread_mutex_t Cancel_Token_Lock;
+};
+
+/* ------------------------------------------------------- */
+/* internal variables */
+/* ------------------------------------------------------- */
+/**
+ * Revision Control System identifier.
+ */
+static char rcsid[] = "$Id: dprt_jni_general.c,v 1.4 2011-04-19 13:54:43 cjm Exp $";
+
+/**
+ * Error state used by a thread whose Thread_Data_Struct could not be allocated.
+ * @see #DpRt_JNI_Error_Get
+ */
+static struct Error_Struct Fallback_Error;
+/**
+ * The default context, used by threads that have not bound another context with DpRt_JNI_Context_Set_Current.
+ * Initialised to NULL/FALSE.
+ * @see #DpRt_JNI_Context_Struct
+ */
+static struct DpRt_JNI_Context_Struct Default_Context = 
+{
+	{FALSE,NULL,NULL,NULL,NULL,NULL},NULL,NULL,0,NULL,NULL,NULL,NULL,NULL,NULL,NULL,
+	{NULL},PTHREAD_MUTEX_INITIALIZER,0,FALSE,NULL,NULL,PTHREAD_RWLOCK_INITIALIZER,0,{NULL},PTHREAD_MUTEX_INITIALIZER,
+	NULL,PTHREAD_MUTEX_INITIALIZER
+};
+
+/**
+ * Copy of the java virtual machine pointer, used for calling back up to the Java layer from C.
+ */
+static JavaVM *Java_VM = NULL;
+/**
+ * Cached reference to the "ngat.util.logging.Logger" class's log(int level,String message) method.
+ * Used to log C layer log messages, in conjunction with the logger's object reference logger.
+ * @see #logger
+ */
+static jmethodID Log_Method_Id = NULL;
+/**
+ * An optional Java object to send structured log records to. 
+ * It has registerLogString(int id,String string) and log(int level,int subSystemId,int sourceFilenameId,
+ * int functionId,int categoryId,String message) methods.
+ * @see #DpRt_JNI_Initialise_Log_Record_Handler_Reference
+ */
+static jobject Log_Record_Handler = NULL;
+/**
+ * Method ID of the log record handler's registerLogString(int id,String string) method.
+ * @see #Log_Record_Handler
+ */
+static jmethodID Log_Record_Handler_Register_Method_Id = NULL;
+/**
+ * Method ID of the log record handler's log(int level,int subSystemId,int sourceFilenameId,
+ * int functionId,int categoryId,String message) method.
+ * @see #Log_Record_Handler
+ */
+static jmethodID Log_Record_Handler_Log_Method_Id = NULL;
+/**
+ * The number of threads currently using Log_Record_Handler (modified atomically). A handler's global
+ * reference is only deleted once it has been replaced and no thread is using it.
+ * @see #DpRt_JNI_Log_Deliver
+ * @see #DpRt_JNI_Log_Record_Handler_Replace
+ */
+static int Log_Record_Handler_User_Count = 0;
+/**
+ * Incremented (under Log_String_Lock) whenever Log_Record_Handler changes, so a registration with a replaced
+ * handler that completes late is not counted as a registration with the new one.
+ * @see #DpRt_JNI_Log_Register_String
+ */
+static unsigned int Log_Record_Handler_Generation = 0;
+/**
+ * The interned log string table, indexed by ID-1. Entries are only ever added, so an ID remains valid
+ * (and it's String pointer constant) for the lifetime of the library.
+ * @see #Log_String_Struct
+ * @see #DpRt_JNI_Log_Intern
+ */
+static struct Log_String_Struct Log_String_List[LOG_STRING_MAX_COUNT];
+/**
+ * The number of strings in Log_String_List.
+ * @see #Log_String_List
+ */
+static int Log_String_Count = 0;
+/**
+ * Hash buckets for the interned log string table. Each holds the ID of the first string in the bucket, or 0.
+ * @see #Log_String_List
+ */
+static int Log_String_Bucket_List[LOG_STRING_BUCKET_COUNT];
+/**
+ * Lock protecting additions to Log_String_List, Log_String_Bucket_List and Log_String_Cache, and 
+ * registering strings with the Java log record handler.
+ * @see #Log_String_List
+ */
+static pthread_mutex_t Log_String_Lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * Lock-free cache mapping string addresses to interned IDs. The sub-system, source filename, function and
+ * category passed to the log handler are nearly always string literals, so most lookups are a pointer 
+ * comparison and a short string comparison, without hashing or locking.
+ * @see #Log_String_Cache_Entry_Struct
+ * @see #DpRt_JNI_Log_Intern
+ */
+static struct Log_String_Cache_Entry_Struct Log_String_Cache[LOG_STRING_CACHE_LENGTH];
+/**
+ * The pthread key per-thread data (a pointer to a Thread_Data_Struct) is stored against. The key's
+ * destructor detaches the thread from the JVM when it exits.
+ * @see #Thread_Data_Struct
+ * @see #DpRt_JNI_Thread_Data_Destroy
+ */
+static pthread_key_t Thread_Data_Key;
+/**
+ * Used to create Thread_Data_Key once.
+ * @see #Thread_Data_Key
+ * @see #DpRt_JNI_Thread_Data_Key_Create
+ */
+static pthread_once_t Thread_Data_Key_Once = PTHREAD_ONCE_INIT;
+/**
+ * The number of times a native thread has been attached to the JVM by DpRt_JNI_Get_Env.
+ * @see #DpRt_JNI_Get_Thread_Attach_Statistics
+ */
+static unsigned long Thread_Attach_Count = 0;
+/**
+ * The number of times a native thread has been detached from the JVM on thread exit.
+ * @see #DpRt_JNI_Get_Thread_Attach_Statistics
+ */
+static unsigned long Thread_Detach_Count = 0;
+/**
+ * The done setter methods, indexed by the DONE_METHOD_ defines.
+ * @see #Done_Method_Struct
+ * @see #DONE_METHOD_COUNT
+ */
+static struct Done_Method_Struct Done_Method_List[DONE_METHOD_COUNT] = 
+{
+	{"setSuccessful","(Z)V"},
+	{"setErrorNum","(I)V"},
+	{"setErrorString","(Ljava/lang/String;)V"},
+	{"setFilename","(Ljava/lang/String;)V"},
+	{"setMeanCounts","(F)V"},
+	{"setPeakCounts","(F)V"},
+	{"setSeeing","(F)V"},
+	{"setCounts","(F)V"},
+	{"setXpix","(F)V"},
+	{"setYpix","(F)V"},
+	{"setPhotometricity","(F)V"},
+	{"setSkyBrightness","(F)V"},
+	{"setSaturation","(Z)V"},
+	{"setReduceResults","([DI)V"},
+	{"setSourceCatalogue","(ILjava/nio/ByteBuffer;)V"},
+	{"setFrame","(ILjava/nio/ByteBuffer;)V"}
+};
+/**
+ * The per-field done setter (a DONE_METHOD_ index) used for each reduce result (indexed by the
+ * DPRT_JNI_REDUCE_RESULT_ defines), when the done class has no setReduceResults method.
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+static int Reduce_Result_Method_List[DPRT_JNI_REDUCE_RESULT_COUNT] = 
+{
+	DONE_METHOD_SET_MEAN_COUNTS,DONE_METHOD_SET_PEAK_COUNTS,DONE_METHOD_SET_SEEING,DONE_METHOD_SET_COUNTS,
+	DONE_METHOD_SET_XPIX,DONE_METHOD_SET_YPIX,DONE_METHOD_SET_PHOTOMETRICITY,DONE_METHOD_SET_SKY_BRIGHTNESS,
+	DONE_METHOD_SET_SATURATION
+};
+/**
+ * Registry of done classes whose setter method IDs have been resolved. Entries are added at the head
+ * (under Done_Class_Lock) and only removed by DpRt_JNI_Finalise_Done_Class_References, so the list
+ * can be searched without locking.
+ * @see #Done_Class_Struct
+ * @see #DpRt_JNI_Done_Class_Get
+ */
+static struct Done_Class_Struct *Done_Class_List = NULL;
+/**
+ * Lock used when adding classes to Done_Class_List.
+ * @see #Done_Class_List
+ */
+static pthread_mutex_t Done_Class_Lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * The table of frames, indexed by the low FRAME_HANDLE_INDEX_BITS of a frame handle.
+ * @see #Frame_Struct
+ * @see #Frame_Lock
+ */
+static struct Frame_Struct Frame_List[FRAME_MAX_COUNT];
+/**
+ * Lock protecting Frame_List.
+ * @see #Frame_List
+ */
+static pthread_mutex_t Frame_Lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * The frame buffer pool's size classes, in ascending order of Buffer_Length.
+ * @see #Frame_Pool_Size_Class_Struct
+ * @see #Frame_Pool_Size_Class_Count
+ */
+static struct Frame_Pool_Size_Class_Struct Frame_Pool_Size_Class_List[FRAME_POOL_SIZE_CLASS_MAX_COUNT];
+/**
+ * The number of size classes in Frame_Pool_Size_Class_List, 0 if the pool is not initialised.
+ * @see #Frame_Pool_Size_Class_List
+ */
+static int Frame_Pool_Size_Class_Count = 0;
+/**
+ * The number of frames handed out by DpRt_JNI_Frame_Pool_Get from the pool.
+ * @see #DpRt_JNI_Frame_Pool_Get_Statistics
+ */
+static unsigned long Frame_Pool_Get_Count = 0;
+/**
+ * The number of frames DpRt_JNI_Frame_Pool_Get had to allocate with malloc, as no pool buffer was free.
+ * @see #DpRt_JNI_Frame_Pool_Get_Statistics
+ */
+static unsigned long Frame_Pool_Miss_Count = 0;
+/**
+ * When TRUE, the JNI local references created and deleted by this library's upcalls are counted 
+ * per thread, so leaks can be detected.
+ * @see #DpRt_JNI_Set_Local_Reference_Debug
+ * @see #DpRt_JNI_Local_Reference_Created
+ * @see #DpRt_JNI_Delete_Local_Reference
+ */
+static int Local_Reference_Debug = FALSE;
+/**
+ * The hash index of the property file, used by the DpRt_JNI_Get_Property_*_From_C_File routines.
+ * NULL if the index has not been loaded yet.
+ * @see #DpRt_JNI_Property_Snapshot_Struct
+ * @see #Property_Index_Lock
+ */
+static struct DpRt_JNI_Property_Snapshot_Struct *Property_Index = NULL;
+/**
+ * Read/write lock protecting Property_Index. Lookups hold the read lock, replacing the index with
+ * a re-loaded one holds the write lock.
+ * @see #Property_Index
+ */
+static pthread_rwlock_t Property_Index_Lock = PTHREAD_RWLOCK_INITIALIZER;
+/**
+ * The time the property file was last checked for modification.
+ * @see #DpRt_JNI_Property_Index_Check
+ * @see #PROPERTY_FILE_CHECK_INTERVAL
+ */
+static time_t Property_Index_Check_Time = 0;
+/**
+ * Incremented (atomically) whenever the property file index is re-loaded, so entries in the missing
+ * property caches become stale.
+ * @see #DpRt_JNI_Property_Index_Check
+ * @see #DpRt_JNI_Property_Generation_Get
+ */
+static unsigned int Property_Index_Generation = 0;
+/**
+ * The asynchronous log queue. When Log_Queue.Running is TRUE, DpRt_JNI_Log_Handler adds records to the
+ * queue and returns immediately, rather than calling the Java logger itself.
+ * @see #Log_Queue_Struct
+ * @see #DpRt_JNI_Log_Queue_Start
+ * @see #DpRt_JNI_Log_Queue_Stop
+ */
+static struct Log_Queue_Struct Log_Queue = 
+{
+	NULL,0,0,0,DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_OLDEST,FALSE,0,0,PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_COND_INITIALIZER,PTHREAD_COND_INITIALIZER,FALSE,0,0,0,0,0,PTHREAD_COND_INITIALIZER,0
+};
+/**
+ * The deadline watchdog. The condition variable is initialised (to use CLOCK_MONOTONIC) by
+ * DpRt_JNI_Deadline_Watchdog_Initialise, the thread is started by the first DpRt_JNI_Deadline_Start.
+ * @see #Deadline_Watchdog_Struct
+ * @see #Deadline_Watchdog_Once
+ */
+static struct Deadline_Watchdog_Struct Deadline_Watchdog;
+/**
+ * The work-stealing reduction scheduler.
+ * @see #Scheduler_Struct
+ * @see #DpRt_JNI_Scheduler_Start
+ */
+static struct Scheduler_Struct Scheduler = 
+{
+	FALSE,NULL,0,PTHREAD_RWLOCK_INITIALIZER,PTHREAD_MUTEX_INITIALIZER,PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER,FALSE,0,0,0,0,0,0,0,0
+};
+/**
+ * The completion queue, used to complete the futures of asynchronous reductions.
+ * @see #Completion_Queue_Struct
+ * @see #DpRt_JNI_Completion_Queue_Start
+ */
+static struct Completion_Queue_Struct Completion_Queue = 
+{
+	FALSE,FALSE,0,PTHREAD_MUTEX_INITIALIZER,PTHREAD_COND_INITIALIZER,PTHREAD_COND_INITIALIZER,NULL,NULL,NULL,0,0
+};
+/**
+ * Whether latencies are being recorded. TRUE by default.
+ * @see #DpRt_JNI_Latency_Set_Enabled
+ * @see #DpRt_JNI_Latency_Start
+ */
+static int Latency_Enabled = TRUE;
+/**
+ * The list of live threads' latency histograms, merged by DpRt_JNI_Latency_Histogram_Get.
+ * Protected by Latency_Histogram_Lock.
+ * @see #Latency_Thread_Histogram_Struct
+ */
+static struct Latency_Thread_Histogram_Struct *Latency_Histogram_List = NULL;
+/**
+ * The latency histograms of threads that have exited, merged together. Protected by Latency_Histogram_Lock.
+ * @see #DpRt_JNI_Thread_Data_Destroy
+ */
+static struct DpRt_JNI_Latency_Histogram_Struct Latency_Retired_Histogram_List[DPRT_JNI_LATENCY_PROBE_COUNT];
+/**
+ * Mutex protecting Latency_Histogram_List and Latency_Retired_Histogram_List. It is only taken when a thread
+ * first records a latency, when it exits, and when the histograms are merged, never when recording.
+ */
+static pthread_mutex_t Latency_Histogram_Lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * Used to initialise Deadline_Watchdog once.
+ * @see #DpRt_JNI_Deadline_Watchdog_Initialise
+ */
+static pthread_once_t Deadline_Watchdog_Once = PTHREAD_ONCE_INIT;
+/**
+ * Mutex protecting the Context field of every cancellation token, so DpRt_JNI_Cancel_Token_Destroy can
+ * not use a context DpRt_JNI_Context_Destroy is freeing. Taken before the context's Cancel_Token_Lock.
+ * @see #DpRt_JNI_Cancel_Token_Struct
+ * @see #DpRt_JNI_Cancel_Token_Destroy
+ * @see #DpRt_JNI_Context_Destroy
+ */
+static pthread_mutex_t Cancel_Token_Context_Lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* ------------------------------------------------------- */
+/* internal function declarations */
+/* ------------------------------------------------------- */
+static int DpRt_JNI_Property_Index_Load(struct DpRt_JNI_Property_Snapshot_Struct **index);
+static int DpRt_JNI_Property_Index_Build(char *buffer,size_t buffer_length,
+					 struct DpRt_JNI_Property_Snapshot_Struct **index);
+static void DpRt_JNI_Property_Index_Free(struct DpRt_JNI_Property_Snapshot_Struct *index);
+static int DpRt_JNI_Property_File_Snapshot_Acquire(struct DpRt_JNI_Property_Snapshot_Struct **snapshot);
+static int DpRt_JNI_Property_Index_Check(int force);
+static struct Property_Entry_Struct *DpRt_JNI_Property_Index_Find(struct DpRt_JNI_Property_Snapshot_Struct *index,
+								  char *keyword);
+static unsigned int DpRt_JNI_Property_Hash(char *string,size_t length);
+static int DpRt_JNI_Status_Property_Cache_Get(char *keyword,int type,void *value,unsigned int *generation);
+static void DpRt_JNI_Status_Property_Cache_Put(char *keyword,unsigned int generation,int type,void *value);
+static void DpRt_JNI_Status_Property_Cache_Free(void);
+static int DpRt_JNI_Get_Property_Optional(char *keyword,int type,void *value);
+static unsigned int DpRt_JNI_Property_Generation_Get(struct DpRt_JNI_Context_Struct *context);
+static int DpRt_JNI_Missing_Property_Cache_Get(struct DpRt_JNI_Context_Struct *context,char *keyword,int type,
+					       unsigned int generation);
+static void DpRt_JNI_Missing_Property_Cache_Put(struct DpRt_JNI_Context_Struct *context,char *keyword,int type,
+						unsigned int generation);
+static void DpRt_JNI_Missing_Property_Cache_Free(struct DpRt_JNI_Context_Struct *context);
+static void DpRt_JNI_Cancel_Token_Event_Fd_Signal(int fd);
+static void DpRt_JNI_Context_Abort(struct DpRt_JNI_Context_Struct *context,int value);
+static void DpRt_JNI_Scheduler_Free(int worker_count,int thread_count);
+static void *DpRt_JNI_Scheduler_Worker_Thread(void *arg);
+static int DpRt_JNI_Scheduler_Push(struct Scheduler_Worker_Struct *worker,struct Scheduler_Job_Struct *job);
+static struct Scheduler_Job_Struct *DpRt_JNI_Scheduler_Pop(struct Scheduler_Worker_Struct *worker);
+static struct Scheduler_Job_Struct *DpRt_JNI_Scheduler_Steal(struct Scheduler_Worker_Struct *worker);
+static void DpRt_JNI_Scheduler_Job_Run(JNIEnv *env,struct Scheduler_Job_Struct *job);
+static void DpRt_JNI_Scheduler_Job_Free(JNIEnv *env,struct Scheduler_Job_Struct *job);
+static int DpRt_JNI_Scheduler_Job_Submit(JNIEnv *env,jclass cls,jobject done,jobject future,
+				 int (*reduce_fp)(JNIEnv *env,jclass cls,jobject done,void *user_data),void *user_data);
+static int DpRt_JNI_Completion_Queue_Put(jobject future,jobject done);
+static void *DpRt_JNI_Completion_Queue_Thread(void *arg);
+static unsigned long long DpRt_JNI_Latency_Start(void);
+static void DpRt_JNI_Latency_Record(int probe,unsigned long long start_time);
+static int DpRt_JNI_Latency_Bucket_Index(unsigned long long value);
+static int DpRt_JNI_Latency_Property_Probe(void (*get_property_fp)(void));
+static void DpRt_JNI_Latency_Histogram_Add(struct DpRt_JNI_Latency_Histogram_Struct *total,
+					   struct DpRt_JNI_Latency_Histogram_Struct *histogram);
+static void DpRt_JNI_Deadline_Watchdog_Initialise(void);
+static void *DpRt_JNI_Deadline_Watchdog_Thread(void *arg);
+static void DpRt_JNI_Deadline_Overrun(JNIEnv *env,struct DpRt_JNI_Deadline_Struct *deadline,
+				      struct timespec *current_time);
+static int DpRt_JNI_Status_Snapshot_Get(char *keyword,int type,void *value);
+static JNIEnv *DpRt_JNI_Get_Env(char *thread_name);
+static struct Thread_Data_Struct *DpRt_JNI_Thread_Data_Get(void);
+static void DpRt_JNI_Thread_Data_Key_Create(void);
+static void DpRt_JNI_Thread_Data_Destroy(void *data);
+static struct Error_Struct *DpRt_JNI_Error_Get(void);
+static void DpRt_JNI_Error_Format(struct Error_Struct *error);
+static int DpRt_JNI_Error_Format_Spec(char *format,char *conversion,char *length_modifier);
+static void DpRt_JNI_Local_Reference_Created(jobject object);
+static struct Done_Class_Struct *DpRt_JNI_Done_Class_Get(JNIEnv *env,jclass cls);
+static int DpRt_JNI_Done_Class_Clear_No_Such_Method(JNIEnv *env);
+static int DpRt_JNI_Exception_Clear_Instance_Of(JNIEnv *env,char *class_name);
+static int DpRt_JNI_Frame_Add(void *data,size_t length,void (*free_fp)(void *data,void *user_data),
+			      void *user_data,jobject buffer,int *frame_handle);
+static struct Frame_Struct *DpRt_JNI_Frame_Get(int frame_handle);
+static int DpRt_JNI_Frame_Pool_Size_Class_Create(struct Frame_Pool_Size_Class_Struct *size_class,size_t length,
+						 int count,int huge_pages,int lock_pages);
+static void DpRt_JNI_Frame_Pool_Size_Class_Destroy(struct Frame_Pool_Size_Class_Struct *size_class);
+static char *DpRt_JNI_Frame_Pool_Pop(struct Frame_Pool_Size_Class_Struct *size_class);
+static void DpRt_JNI_Frame_Pool_Push(void *data,void *user_data);
+static jmethodID DpRt_JNI_Done_Method_Id_Get(JNIEnv *env,jclass cls,struct Done_Class_Struct *done_class,
+					     int method_index);
+static void DpRt_JNI_Delete_Local_Reference(JNIEnv *env,jobject object);
+static void DpRt_JNI_Log_Deliver(JNIEnv *env,jobject logger,int level,int sub_system_id,int source_filename_id,
+				 int function_id,int category_id,char *string);
+static int DpRt_JNI_Log_Register_String(JNIEnv *env,jobject handler,int id);
+static void DpRt_JNI_Log_Record_Handler_Replace(JNIEnv *env,jobject handler,jmethodID register_method_id,
+						jmethodID log_method_id);
+static int DpRt_JNI_Log_Queue_Put(jobject logger,int level,int sub_system_id,int source_filename_id,
+				  int function_id,int category_id,char *string);
+static int DpRt_JNI_Log_Queue_Get(struct Log_Record_Struct *record);
+static void DpRt_JNI_Log_Queue_Signal_Not_Full(void);
+static void DpRt_JNI_Log_Queue_Flush(void);
+static void *DpRt_JNI_Log_Queue_Thread(void *arg);
+static int DpRt_JNI_Get_Property_View_From_C_File(char *keyword,struct DpRt_JNI_Property_Snapshot_Struct **snapshot,
+						  char **value_string);
+static int DpRt_JNI_Get_Property_From_C_File(char *keyword,char **value_string);
+static int DpRt_JNI_Get_Property_Integer_From_C_File(char *keyword,int *value);
+static int DpRt_JNI_Get_Property_Double_From_C_File(char *keyword,double *value);
+static int DpRt_JNI_Get_Property_Boolean_From_C_File(char *keyword,int *value);
+static int DpRt_JNI_Get_Property_List_From_C_File(struct DpRt_JNI_Property_Request_Struct *request_list,
+						  int request_count);
+static int DpRt_JNI_Property_Request_Convert(struct DpRt_JNI_Property_Request_Struct *request,char *value_string);
+static int DpRt_JNI_Property_Value_Parse(char *value_string,int type,void *value);
+static int DpRt_JNI_Property_Entry_Value_Get(struct DpRt_JNI_Property_Snapshot_Struct *index,
+					     struct Property_Entry_Struct *entry,int type,void *value);
+static int DpRt_JNI_Get_Property_Converted_From_C_File(char *keyword,int type,void *value);
+
+/* ------------------------------------------------------- */
+/* external functions */
+/* ------------------------------------------------------- */
+/* initialisation */
+/**
+ * This routine gets called when the native library is loaded. We use this routine
+ * to get a copy of the JavaVM pointer of the JVM we are running in. This is used to
+ * get the correct per-thread JNIEnv context pointer when C calls back into Java.
+ * @see #Java_VM
+ */
+void DpRt_JNI_Set_Java_VM(JavaVM *vm)
+{
+	Java_VM = vm;
+}
+
+/**
+ * Routine to retrieve how many times native threads have been attached to, and detached from, the JVM
+ * by this library. Threads are attached once, the first time they call back into Java, and detached 
+ * when they exit. Either parameter can be NULL.
+ * @param attach_count The address of an unsigned long to store the number of attaches in.
+ * @param detach_count The address of an unsigned long to store the number of detaches in.
+ * @see #Thread_Attach_Count
+ * @see #Thread_Detach_Count
+ * @see #DpRt_JNI_Get_Env
+ */
+void DpRt_JNI_Get_Thread_Attach_Statistics(unsigned long *attach_count,unsigned long *detach_count)
+{
+	if(attach_count != NULL)
+		(*attach_count) = __atomic_load_n(&Thread_Attach_Count,__ATOMIC_RELAXED);
+	if(detach_count != NULL)
+		(*detach_count) = __atomic_load_n(&Thread_Detach_Count,__ATOMIC_RELAXED);
+}
+
+/**
+ * Routine to turn on or off local reference debugging. When on, the JNI local references created and 
+ * deleted by this library's upcalls (property retrieval, logging, command dones, exceptions) are counted
+ * per thread, and a thread exiting with undeleted local references is reported on stderr.
+ * @param enable TRUE to count local references, FALSE to stop counting.
+ * @see #Local_Reference_Debug
+ * @see #DpRt_JNI_Get_Local_Reference_Count
+ */
+void DpRt_JNI_Set_Local_Reference_Debug(int enable)
+{
+	__atomic_store_n(&Local_Reference_Debug,enable,__ATOMIC_RELAXED);
+}
+
+/**
+ * Routine to retrieve the calling thread's local reference counts, when local reference debugging is on.
+ * Either parameter can be NULL.
+ * @param live_count The address of an integer to store the number of local references created by this
+ *        library on this thread that have not been deleted. This should be 0 between upcalls.
+ * @param high_water_count The address of an integer to store the maximum number of live local references
+ *        this library has held at one time on this thread.
+ * @return The routine returns TRUE if it succeeds, FALSE if the per-thread data could not be allocated.
+ * @see #Thread_Data_Struct
+ * @see #DpRt_JNI_Set_Local_Reference_Debug
+ */
+int DpRt_JNI_Get_Local_Reference_Count(int *live_count,int *high_water_count)
+{
+	struct Thread_Data_Struct *thread_data = NULL;
+
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if(thread_data == NULL)
+	{
+		DpRt_JNI_Error_Set(69,"DpRt_JNI_Get_Local_Reference_Count:Failed to get thread data.\n");
+		return FALSE;
+	}
+	if(live_count != NULL)
+		(*live_count) = thread_data->Local_Reference_Count;
+	if(high_water_count != NULL)
+		(*high_water_count) = thread_data->Local_Reference_High_Water;
+	return TRUE;
+}
+
+/**
+ * This takes the supplied ngat.dprt.DpRtStatus object reference and stores it in the 
+ * current context's DpRt_Status field as a global reference.
+ * Some method ID's from this class are also retrieved and stored in the context.
+ * If snapshots have been enabled with DpRt_JNI_Set_Status_Snapshot, the properties are then 
+ * copied into native memory by DpRt_JNI_Status_Snapshot_Refresh.
+ * @param env The JNI environment pointer.
+ * @param object The instance of ngat.dprt.DpRtLibraryInterface this method was called with.
+ * @param status The DpRt's instance of ngat.dprt.DpRtStatus.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_DpRtStatus_Property_Cache_Invalidate
+ * @see #DpRt_JNI_Status_Snapshot_Refresh
+ */
+void DpRt_JNI_Set_Status(JNIEnv *env,jobject object,jobject status)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	jclass cls = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+/* save DpRtStatus instance */
+	context->DpRt_Status = (*env)->NewGlobalRef(env,status);
+/* any cached property values and method id's came from a previous status object */
+	DpRt_JNI_DpRtStatus_Property_Cache_Invalidate();
+	context->DpRt_Status_Get_Property_Method_Id = NULL;
+	context->DpRt_Status_Get_Property_Integer_Method_Id = NULL;
+	context->DpRt_Status_Get_Property_Double_Method_Id = NULL;
+	context->DpRt_Status_Get_Property_Boolean_Method_Id = NULL;
+	context->DpRt_Status_Get_Property_List_Method_Id = NULL;
+	context->DpRt_Status_Get_Property_Snapshot_Method_Id = NULL;
+/* get the DpRtStatus class */
+	cls = (*env)->FindClass(env,"ngat/dprt/DpRtStatus");
+	/* if the class is null, one of the following exceptions occured:
+	** ClassFormatError,ClassCircularityError,NoClassDefFoundError,OutOfMemoryError */
+	if(cls == NULL)
+		return;
+/* get relevant method id's to call */
+/* String getProperty(java/lang/String keyword) */
+	context->DpRt_Status_Get_Property_Method_Id = (*env)->GetMethodID(env,cls,"getProperty",
+								 "(Ljava/lang/String;)Ljava/lang/String;");
+	if(context->DpRt_Status_Get_Property_Method_Id == NULL)
+	{
+		/* One of the following exceptions has been thrown:
+		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
+		return;
+	}
+/* int getPropertyInteger(java/lang/String keyword) */
+	context->DpRt_Status_Get_Property_Integer_Method_Id = (*env)->GetMethodID(env,cls,"getPropertyInteger",
+								 "(Ljava/lang/String;)I");
+	if(context->DpRt_Status_Get_Property_Integer_Method_Id == NULL)
+	{
+		/* One of the following exceptions has been thrown:
+		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
+		return;
+	}
+/* double getPropertyDouble(java/lang/String keyword) */
+	context->DpRt_Status_Get_Property_Double_Method_Id = (*env)->GetMethodID(env,cls,"getPropertyDouble",
+								 "(Ljava/lang/String;)D");
+	if(context->DpRt_Status_Get_Property_Double_Method_Id == NULL)
+	{
+		/* One of the following exceptions has been thrown:
+		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
+		return;
+	}
+/* boolean getPropertyBoolean(java/lang/String keyword) */
+	context->DpRt_Status_Get_Property_Boolean_Method_Id = (*env)->GetMethodID(env,cls,"getPropertyBoolean",
+								 "(Ljava/lang/String;)Z");
+	if(context->DpRt_Status_Get_Property_Boolean_Method_Id == NULL)
+	{
+		/* One of the following exceptions has been thrown:
+		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
+		return;
+	}
+/* java/lang/String[] getPropertyList(java/lang/String[] keywords). This method is optional. */
+	context->DpRt_Status_Get_Property_List_Method_Id = (*env)->GetMethodID(env,cls,"getPropertyList",
+								 "([Ljava/lang/String;)[Ljava/lang/String;");
+	if(context->DpRt_Status_Get_Property_List_Method_Id == NULL)
+	{
+		/* clear a NoSuchMethodError as DpRt_JNI_DpRtStatus_Get_Property_List falls back to retrieving 
+		** each value in turn. Any other exception (e.g. OutOfMemoryError) is left pending. */
+		if(DpRt_JNI_Done_Class_Clear_No_Such_Method(env) == FALSE)
+			return;
+	}
+/* java/nio/ByteBuffer getPropertySnapshot(java/lang/String prefix). This method is optional. */
+	context->DpRt_Status_Get_Property_Snapshot_Method_Id = (*env)->GetMethodID(env,cls,"getPropertySnapshot",
+								 "(Ljava/lang/String;)Ljava/nio/ByteBuffer;");
+	if(context->DpRt_Status_Get_Property_Snapshot_Method_Id == NULL)
+	{
+		/* clear a NoSuchMethodError, properties are retrieved with upcalls instead. 
+		** Any other exception is left pending. */
+		if(DpRt_JNI_Done_Class_Clear_No_Such_Method(env) == FALSE)
+			return;
+	}
+/* take a snapshot of the properties, if configured to do so */
+	if(context->Status_Snapshot_Enable)
+		DpRt_JNI_Status_Snapshot_Refresh(env);
+}
+
+/**
+ * This takes the supplied logger object reference and stores it in the current context's Logger field as a 
+ * global reference. The log method ID is also retrieved and stored. If the logger has a getLogLevel() method,
+ * the context's log filter level is set from it, and the context's log filter function set to 
+ * DpRt_JNI_Log_Filter_Level_Absolute. Other contexts' log filters are not changed.
+ * @param l The DpRtLibrary's specific (instrument specific) logger.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #Log_Method_Id
+ */
+void DpRt_JNI_Initialise_Logger_Reference(JNIEnv *env,jobject obj,jobject l)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	jclass cls = NULL;
+	jmethodID get_log_level_method_id = NULL;
+	jint level;
+
+	context = DpRt_JNI_Context_Get_Current();
+/* save logger instance */
+	context->Logger = (*env)->NewGlobalRef(env,l);
+/* get the ngat.util.logging.Logger class */
+	cls = (*env)->FindClass(env,"ngat/util/logging/Logger");
+	/* if the class is null, one of the following exceptions occured:
+	** ClassFormatError,ClassCircularityError,NoClassDefFoundError,OutOfMemoryError */
+	if(cls == NULL)
+		return;
+/* get relevant method id to call */
+/* log(int level,java/lang/String message) */
 	Log_Method_Id = (*env)->GetMethodID(env,cls,"log","(ILjava/lang/String;)V");
 	if(Log_Method_Id == NULL)
 	{
-		/* One of the following exceptions has been thrown:
-		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
+		/* One of the following exceptions has been thrown:
+		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
+		return;
+	}
+/* seed this context's native log filter from the logger's level, if it has a getLogLevel() method */
+	get_log_level_method_id = (*env)->GetMethodID(env,cls,"getLogLevel","()I");
+	if(get_log_level_method_id == NULL)
+	{
+		/* optional method, leave native filtering off */
+		(*env)->ExceptionClear(env);
+		return;
+	}
+	level = (*env)->CallIntMethod(env,context->Logger,get_log_level_method_id);
+	if((*env)->ExceptionCheck(env))
+	{
+		(*env)->ExceptionClear(env);
+		return;
+	}
+	DpRt_JNI_Set_Log_Filter_Level((int)level);
+	DpRt_JNI_Set_Log_Filter_Function(DpRt_JNI_Log_Filter_Level_Absolute);
+}
+
+/**
+ * This native method is called from DpRtLibrary's instrumetn specific finaliser method. 
+ * If the asynchronous log queue is running, the records already queued (which may use the current 
+ * context's logger reference) are delivered first. The queue is left running for the other contexts.
+ * It removes the global reference to logger.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Log_Queue_Flush
+ */
+void DpRt_JNI_Finalise_Logger_Reference(JNIEnv *env)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	/* queued records may still use the logger reference, but other contexts may still be logging */
+	DpRt_JNI_Log_Queue_Flush();
+	(*env)->DeleteGlobalRef(env,context->Logger);
+	context->Logger = NULL;
+}
+
+/**
+ * Routine called as DpRt is finalised, to clear up DpRt_Status global reference.
+ * The DpRtStatus property cache and snapshot are also freed.
+ * @param env The JNI environment pointer.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Status_Property_Cache_Free
+ */
+void DpRt_JNI_Finalise_Status_Reference(JNIEnv *env)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(context->DpRt_Status != NULL)
+		(*env)->DeleteGlobalRef(env,context->DpRt_Status);
+	context->DpRt_Status = NULL;
+	DpRt_JNI_Status_Property_Cache_Free();
+	pthread_rwlock_wrlock(&context->Status_Snapshot_Lock);
+	DpRt_JNI_Property_Snapshot_Release(context->Status_Snapshot_Index);
+	context->Status_Snapshot_Index = NULL;
+	pthread_rwlock_unlock(&context->Status_Snapshot_Lock);
+}
+
+/**
+ * Routine to invalidate all values held in the DpRtStatus property cache, so the next retrieval of each keyword
+ * calls up into the DpRtStatus object again. This should be called (from the instrument specific
+ * JNI layer) whenever the Java layer re-loads it's configuration. The cache generation is incremented 
+ * atomically, so this routine does not block readers of the cache.
+ * @see #DpRt_JNI_Context_Struct
+ */
+void DpRt_JNI_DpRtStatus_Property_Cache_Invalidate(void)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	__atomic_add_fetch(&context->Status_Property_Cache_Generation,1,__ATOMIC_RELEASE);
+	__atomic_add_fetch(&context->Property_Generation,1,__ATOMIC_RELEASE);
+}
+
+/**
+ * Routine to configure whether DpRt_JNI_Set_Status takes a snapshot of the DpRtStatus properties.
+ * When a snapshot has been taken, the DpRt_JNI_DpRtStatus_Get_Property* routines retrieve keywords starting
+ * with the prefix from the snapshot in native memory, so reduction threads need not attach to the JVM
+ * to read their configuration. This should be called before DpRt_JNI_Set_Status.
+ * @param enable TRUE to take a snapshot in DpRt_JNI_Set_Status, FALSE not to.
+ * @param prefix Only properties whose keyword starts with this prefix are copied into the snapshot.
+ *        Can be NULL, to copy all the properties.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Status_Snapshot_Refresh
+ */
+int DpRt_JNI_Set_Status_Snapshot(int enable,char *prefix)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	char *new_prefix = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(prefix != NULL)
+	{
+		new_prefix = strdup(prefix);
+		if(new_prefix == NULL)
+		{
+			DpRt_JNI_Error_Set(58,"DpRt_JNI_Set_Status_Snapshot:Memory allocation error(%s).\n",
+				prefix);
+			return FALSE;
+		}
+	}
+	pthread_rwlock_wrlock(&context->Status_Snapshot_Lock);
+	if(context->Status_Snapshot_Prefix != NULL)
+		free(context->Status_Snapshot_Prefix);
+	context->Status_Snapshot_Prefix = new_prefix;
+	context->Status_Snapshot_Enable = enable;
+	if((enable == FALSE)&&(context->Status_Snapshot_Index != NULL))
+	{
+		DpRt_JNI_Property_Snapshot_Release(context->Status_Snapshot_Index);
+		context->Status_Snapshot_Index = NULL;
+	}
+	pthread_rwlock_unlock(&context->Status_Snapshot_Lock);
+	return TRUE;
+}
+
+/**
+ * Routine to take a (new) snapshot of the DpRtStatus properties. The DpRtStatus getPropertySnapshot method is
+ * called with Status_Snapshot_Prefix, which should return a direct ByteBuffer containing the properties 
+ * serialised as UTF-8 <b>keyword=value</b> lines. This is indexed in place with DpRt_JNI_Property_Index_Build, 
+ * which copies the keywords and values into the index. This should be called (from the instrument specific JNI layer)
+ * whenever the Java layer re-loads it's configuration, DpRt_JNI_Set_Status calls it when snapshots are enabled.
+ * The DpRtStatus property cache is also invalidated. If getPropertySnapshot throws, the exception is left
+ * pending and the old snapshot kept.
+ * @param env The JNI environment pointer.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Property_Index_Build
+ * @see #DpRt_JNI_DpRtStatus_Property_Cache_Invalidate
+ */
+int DpRt_JNI_Status_Snapshot_Refresh(JNIEnv *env)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	struct DpRt_JNI_Property_Snapshot_Struct *new_index = NULL;
+	struct DpRt_JNI_Property_Snapshot_Struct *old_index = NULL;
+	jstring java_prefix_string = NULL;
+	jobject java_buffer = NULL;
+	void *buffer_address = NULL;
+	jlong buffer_length;
+	int retval;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(context->DpRt_Status == NULL)
+	{
+		DpRt_JNI_Error_Set(59,"DpRt_JNI_Status_Snapshot_Refresh:DpRt_Status was NULL.\n");
+		return FALSE;
+	}
+	if(context->DpRt_Status_Get_Property_Snapshot_Method_Id == NULL)
+	{
+		DpRt_JNI_Error_Set(60,"DpRt_JNI_Status_Snapshot_Refresh:Method ID was NULL.\n");
+		return FALSE;
+	}
+/* call getPropertySnapshot method on DpRt_Status instance */
+	pthread_rwlock_rdlock(&context->Status_Snapshot_Lock);
+	if(context->Status_Snapshot_Prefix != NULL)
+		java_prefix_string = (*env)->NewStringUTF(env,context->Status_Snapshot_Prefix);
+	pthread_rwlock_unlock(&context->Status_Snapshot_Lock);
+	DpRt_JNI_Local_Reference_Created(java_prefix_string);
+	java_buffer = (*env)->CallObjectMethod(env,context->DpRt_Status,context->DpRt_Status_Get_Property_Snapshot_Method_Id,
+					       java_prefix_string);
+	DpRt_JNI_Local_Reference_Created(java_buffer);
+	if(java_prefix_string != NULL)
+		DpRt_JNI_Delete_Local_Reference(env,java_prefix_string);
+	if((*env)->ExceptionCheck(env))
+	{
+		/* leave the exception pending for the Java caller */
+		if(java_buffer != NULL)
+			DpRt_JNI_Delete_Local_Reference(env,java_buffer);
+		DpRt_JNI_Error_Set(141,"DpRt_JNI_Status_Snapshot_Refresh:getPropertySnapshot threw an exception.\n");
+		return FALSE;
+	}
+	if(java_buffer != NULL)
+	{
+		buffer_address = (*env)->GetDirectBufferAddress(env,java_buffer);
+		buffer_length = (*env)->GetDirectBufferCapacity(env,java_buffer);
+	}
+	if((buffer_address == NULL)||(buffer_length < 0))
+	{
+		if(java_buffer != NULL)
+			DpRt_JNI_Delete_Local_Reference(env,java_buffer);
+		DpRt_JNI_Error_Set(61,"DpRt_JNI_Status_Snapshot_Refresh:"
+			"getPropertySnapshot did not return a direct ByteBuffer.\n");
+		return FALSE;
+	}
+/* index the serialised properties, the index copies the keywords and values out of the buffer */
+	retval = DpRt_JNI_Property_Index_Build((char *)buffer_address,(size_t)buffer_length,&new_index);
+	DpRt_JNI_Delete_Local_Reference(env,java_buffer);
+	if(retval == FALSE)
+		return FALSE;
+/* replace the old snapshot */
+	pthread_rwlock_wrlock(&context->Status_Snapshot_Lock);
+	old_index = context->Status_Snapshot_Index;
+	context->Status_Snapshot_Index = new_index;
+	pthread_rwlock_unlock(&context->Status_Snapshot_Lock);
+	__atomic_add_fetch(&context->Property_Generation,1,__ATOMIC_RELEASE);
+	DpRt_JNI_Property_Snapshot_Release(old_index);
+	DpRt_JNI_DpRtStatus_Property_Cache_Invalidate();
+	return TRUE;
+}
+
+/**
+ * This finction should be called when the library/DpRt is first initialised/loaded.
+ * It allows the C layer to perform initial initialisation.
+ * The function pointers to use a C routine to load the property from the config file are initialised.
+ * Note these function pointers will be over-written by the functions in DpRtLibrary.c if this
+ * initialise routine was called from the Java (JNI) layer.
+ * If the C file property routines are being used, the property file is loaded into the 
+ * hash index Property_Index, so later property lookups do not have to re-read the file. A failure to load
+ * the property file here is not fatal, the lookup routines will report the error.
+ * @see #DpRt_JNI_Set_Property_Function_Pointer
+ * @see #DpRt_JNI_Set_Property_Integer_Function_Pointer
+ * @see #DpRt_JNI_Set_Property_Double_Function_Pointer
+ * @see #DpRt_JNI_Set_Property_Boolean_Function_Pointer
+ * @see #DpRt_JNI_Set_Property_List_Function_Pointer
+ * @see #DpRt_JNI_Get_Property_From_C_File
+ * @see #DpRt_JNI_Get_Property_Integer_From_C_File
+ * @see #DpRt_JNI_Get_Property_Double_From_C_File
+ * @see #DpRt_JNI_Get_Property_Boolean_From_C_File
+ * @see #DpRt_JNI_Get_Property_List_From_C_File
+ * @see #DpRt_JNI_Property_Index_Check
+ */
+int DpRt_JNI_Initialise(void)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	DpRt_JNI_Error_Clear();
+	if(context->DpRt_Data.DpRt_Get_Property_Function_Pointer == NULL)
+		DpRt_JNI_Set_Property_Function_Pointer(DpRt_JNI_Get_Property_From_C_File);
+	if(context->DpRt_Data.DpRt_Get_Property_Integer_Function_Pointer == NULL)
+		DpRt_JNI_Set_Property_Integer_Function_Pointer(DpRt_JNI_Get_Property_Integer_From_C_File);
+	if(context->DpRt_Data.DpRt_Get_Property_Double_Function_Pointer == NULL)
+		DpRt_JNI_Set_Property_Double_Function_Pointer(DpRt_JNI_Get_Property_Double_From_C_File);
+	if(context->DpRt_Data.DpRt_Get_Property_Boolean_Function_Pointer == NULL)
+		DpRt_JNI_Set_Property_Boolean_Function_Pointer(DpRt_JNI_Get_Property_Boolean_From_C_File);
+	if(context->DpRt_Data.DpRt_Get_Property_List_Function_Pointer == NULL)
+		DpRt_JNI_Set_Property_List_Function_Pointer(DpRt_JNI_Get_Property_List_From_C_File);
+	if(context->DpRt_Data.DpRt_Get_Property_Function_Pointer == DpRt_JNI_Get_Property_From_C_File)
+	{
+		if(!DpRt_JNI_Property_Index_Check(TRUE))
+		{
+			DpRt_JNI_Error_Clear();
+		}
+	}
+	return TRUE;
+}
+
+/* abort */
+/**
+ * A routine to set the value of the DpRt_Abort variable. This is used to
+ * keep track of whether an abort event has occured. Setting it to TRUE also cancels all the 
+ * cancellation tokens created in the current context, waking any reductions blocked waiting on them.
+ * Reductions in other contexts are not affected.
+ * @param value The value to set the abort value to, this should be TRUE of we want the data reduction
+ * aborted, or FALSE if we don't or we are resetting the flag. Resetting the flag does not un-cancel tokens,
+ * new reductions should create new tokens.
+ * @see #DpRt_JNI_Context_Abort
+ */
+void DpRt_JNI_Set_Abort(int value)
+{
+	DpRt_JNI_Context_Abort(DpRt_JNI_Context_Get_Current(),value);
+}
+
+/**
+ * A routine to get the current value of the abort variable, to determine whether we should abort
+ * processing the FITS file or not. This is TRUE if the current context's abort flag is set, or the 
+ * cancellation token bound to the calling thread has been cancelled.
+ * @return The current value of the DpRt_Data.DpRt_Abort variable, usually TRUE if we want to abort a reduction process
+ * and FALSE if we don't.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Cancel_Token_Get_Current
+ */
+int DpRt_JNI_Get_Abort(void)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	struct DpRt_JNI_Cancel_Token_Struct *token = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(__atomic_load_n(&(context->DpRt_Data.DpRt_Abort),__ATOMIC_ACQUIRE))
+		return TRUE;
+	token = DpRt_JNI_Cancel_Token_Get_Current();
+	return (token != NULL)&&DpRt_JNI_Cancel_Token_Is_Cancelled(token);
+}
+
+/**
+ * Routine to create a new cancellation token, for one reduction. The token is registered with the current 
+ * context, so DpRt_JNI_Set_Abort cancels it, and can be cancelled individually with 
+ * DpRt_JNI_Cancel_Token_Cancel. The reduction polls it with DpRt_JNI_Cancel_Token_Is_Cancelled 
+ * (or DpRt_JNI_Get_Abort, if it is bound to the reduction's thread with DpRt_JNI_Cancel_Token_Set_Current),
+ * and blocking stages can wait for it with DpRt_JNI_Cancel_Token_Wait or poll it's eventfd.
+ * @param token The address of a pointer to store the new token in.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Cancel_Token_Struct
+ * @see #DpRt_JNI_Cancel_Token_Destroy
+ */
+int DpRt_JNI_Cancel_Token_Create(struct DpRt_JNI_Cancel_Token_Struct **token)
+{
+	struct DpRt_JNI_Cancel_Token_Struct *new_token = NULL;
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	pthread_condattr_t condition_attributes;
+
+	if(token == NULL)
+	{
+		DpRt_JNI_Error_Set(92,"DpRt_JNI_Cancel_Token_Create:token was NULL.\n");
+		return FALSE;
+	}
+	new_token = (struct DpRt_JNI_Cancel_Token_Struct *)malloc(sizeof(struct DpRt_JNI_Cancel_Token_Struct));
+	if(new_token == NULL)
+	{
+		DpRt_JNI_Error_Set(93,"DpRt_JNI_Cancel_Token_Create:Memory allocation error.\n");
+		return FALSE;
+	}
+	new_token->Cancelled = FALSE;
+	new_token->Event_Fd = -1;
+	pthread_mutex_init(&(new_token->Lock),NULL);
+	pthread_condattr_init(&condition_attributes);
+	pthread_condattr_setclock(&condition_attributes,CLOCK_MONOTONIC);
+	pthread_cond_init(&(new_token->Condition),&condition_attributes);
+	pthread_condattr_destroy(&condition_attributes);
+	context = DpRt_JNI_Context_Get_Current();
+	new_token->Context = context;
+	pthread_mutex_lock(&(context->Cancel_Token_Lock));
+	new_token->Next = context->Cancel_Token_List;
+	context->Cancel_Token_List = new_token;
+	pthread_mutex_unlock(&(context->Cancel_Token_Lock));
+	(*token) = new_token;
+	return TRUE;
+}
+
+/**
+ * Routine to destroy a cancellation token created with DpRt_JNI_Cancel_Token_Create. It is removed from
+ * it's context, and it's eventfd closed. No thread should still be using (or bound to) the token.
+ * @param token The token to destroy. Can be NULL.
+ * @see #DpRt_JNI_Cancel_Token_Create
+ */
+void DpRt_JNI_Cancel_Token_Destroy(struct DpRt_JNI_Cancel_Token_Struct *token)
+{
+	struct DpRt_JNI_Cancel_Token_Struct **token_pointer = NULL;
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	if(token == NULL)
+		return;
+/* the context may be being destroyed, keep it alive while we leave it's list */
+	pthread_mutex_lock(&Cancel_Token_Context_Lock);
+	context = token->Context;
+	if(context != NULL)
+	{
+		pthread_mutex_lock(&(context->Cancel_Token_Lock));
+		token_pointer = &(context->Cancel_Token_List);
+		while(((*token_pointer) != NULL)&&((*token_pointer) != token))
+			token_pointer = &((*token_pointer)->Next);
+		if((*token_pointer) != NULL)
+			(*token_pointer) = token->Next;
+		pthread_mutex_unlock(&(context->Cancel_Token_Lock));
+		token->Context = NULL;
+	}
+	pthread_mutex_unlock(&Cancel_Token_Context_Lock);
+	if(DpRt_JNI_Cancel_Token_Get_Current() == token)
+		DpRt_JNI_Cancel_Token_Set_Current(NULL);
+	if(token->Event_Fd >= 0)
+		close(token->Event_Fd);
+	pthread_cond_destroy(&(token->Condition));
+	pthread_mutex_destroy(&(token->Lock));
+	free(token);
+}
+
+/**
+ * Routine to cancel a cancellation token. Threads polling the token see it cancelled, threads waiting in
+ * DpRt_JNI_Cancel_Token_Wait are woken, and the token's eventfd (if any) becomes readable.
+ * Cancelling an already cancelled token has no further effect.
+ * @param token The token to cancel.
+ * @see #DpRt_JNI_Cancel_Token_Struct
+ */
+void DpRt_JNI_Cancel_Token_Cancel(struct DpRt_JNI_Cancel_Token_Struct *token)
+{
+
+	if(token == NULL)
+		return;
+	if(__atomic_exchange_n(&(token->Cancelled),TRUE,__ATOMIC_ACQ_REL))
+		return;
+	pthread_mutex_lock(&(token->Lock));
+	pthread_cond_broadcast(&(token->Condition));
+	if(token->Event_Fd >= 0)
+		DpRt_JNI_Cancel_Token_Event_Fd_Signal(token->Event_Fd);
+	pthread_mutex_unlock(&(token->Lock));
+}
+
+/**
+ * Routine to poll whether a cancellation token has been cancelled. This is a single atomic load, cheap enough
+ * to call in the inner loops of a reduction.
+ * @param token The token.
+ * @return TRUE if the token has been cancelled, FALSE otherwise.
+ * @see #DpRt_JNI_Cancel_Token_Struct
+ */
+int DpRt_JNI_Cancel_Token_Is_Cancelled(struct DpRt_JNI_Cancel_Token_Struct *token)
+{
+	return __atomic_load_n(&(token->Cancelled),__ATOMIC_ACQUIRE);
+}
+
+/**
+ * Routine to block until a cancellation token is cancelled, or a timeout elapses. Stages that would 
+ * otherwise sleep (e.g. waiting for a resource) can use this so an abort wakes them immediately.
+ * @param token The token.
+ * @param timeout_ms The maximum time to wait, in milliseconds. If negative, wait until the token is cancelled.
+ * @return The routine returns TRUE if the token was cancelled, FALSE if the timeout elapsed first.
+ * @see #DpRt_JNI_Cancel_Token_Struct
+ */
+int DpRt_JNI_Cancel_Token_Wait(struct DpRt_JNI_Cancel_Token_Struct *token,int timeout_ms)
+{
+	struct timespec wait_time;
+	int retval;
+
+	if(token == NULL)
+	{
+		DpRt_JNI_Error_Set(94,"DpRt_JNI_Cancel_Token_Wait:token was NULL.\n");
+		return FALSE;
+	}
+	if(__atomic_load_n(&(token->Cancelled),__ATOMIC_ACQUIRE))
+		return TRUE;
+	clock_gettime(CLOCK_MONOTONIC,&wait_time);
+	wait_time.tv_sec += timeout_ms/1000;
+	wait_time.tv_nsec += (timeout_ms%1000)*1000000L;
+	if(wait_time.tv_nsec >= 1000000000L)
+	{
+		wait_time.tv_sec++;
+		wait_time.tv_nsec -= 1000000000L;
+	}
+	pthread_mutex_lock(&(token->Lock));
+	retval = 0;
+	while((__atomic_load_n(&(token->Cancelled),__ATOMIC_ACQUIRE) == FALSE)&&(retval != ETIMEDOUT))
+	{
+		if(timeout_ms < 0)
+			pthread_cond_wait(&(token->Condition),&(token->Lock));
+		else
+			retval = pthread_cond_timedwait(&(token->Condition),&(token->Lock),&wait_time);
+	}
+	pthread_mutex_unlock(&(token->Lock));
+	return __atomic_load_n(&(token->Cancelled),__ATOMIC_ACQUIRE);
+}
+
+/**
+ * Routine to get an eventfd that becomes readable when a cancellation token is cancelled, so stages blocked 
+ * in <b>poll</b>/<b>select</b>/<b>epoll</b> on other file descriptors can also wait for cancellation. 
+ * The eventfd is created (non-blocking, close-on-exec) on the first call, and owned by the token.
+ * @param token The token.
+ * @param fd The address of an integer to store the file descriptor in.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails (or eventfds are not supported).
+ * @see #DpRt_JNI_Cancel_Token_Struct
+ */
+int DpRt_JNI_Cancel_Token_Get_Event_Fd(struct DpRt_JNI_Cancel_Token_Struct *token,int *fd)
+{
+	if((token == NULL)||(fd == NULL))
+	{
+		DpRt_JNI_Error_Set(131,"DpRt_JNI_Cancel_Token_Get_Event_Fd:Illegal argument(%p,%p).\n",
+			(void*)token,(void*)fd);
+		return FALSE;
+	}
+	pthread_mutex_lock(&(token->Lock));
+#ifdef __linux__
+	if(token->Event_Fd < 0)
+	{
+		token->Event_Fd = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+		if(token->Event_Fd < 0)
+		{
+			pthread_mutex_unlock(&(token->Lock));
+			DpRt_JNI_Error_Set(95,"DpRt_JNI_Cancel_Token_Get_Event_Fd:eventfd failed(%d).\n",errno);
+			return FALSE;
+		}
+		/* Cancelled is set before Lock is taken in DpRt_JNI_Cancel_Token_Cancel, so this cannot miss it */
+		if(__atomic_load_n(&(token->Cancelled),__ATOMIC_ACQUIRE))
+			DpRt_JNI_Cancel_Token_Event_Fd_Signal(token->Event_Fd);
+	}
+	(*fd) = token->Event_Fd;
+	pthread_mutex_unlock(&(token->Lock));
+	return TRUE;
+#else
+	pthread_mutex_unlock(&(token->Lock));
+	DpRt_JNI_Error_Set(95,"DpRt_JNI_Cancel_Token_Get_Event_Fd:eventfd not supported.\n");
+	return FALSE;
+#endif
+}
+
+/**
+ * Routine to bind a cancellation token to the calling thread, as the token of the reduction it is running. 
+ * DpRt_JNI_Get_Abort then also returns TRUE once the token is cancelled, so existing reduction code
+ * that polls DpRt_JNI_Get_Abort can be aborted individually.
+ * @param token The token, or NULL to unbind the current token.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Thread_Data_Struct
+ * @see #DpRt_JNI_Get_Abort
+ */
+int DpRt_JNI_Cancel_Token_Set_Current(struct DpRt_JNI_Cancel_Token_Struct *token)
+{
+	struct Thread_Data_Struct *thread_data = NULL;
+
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if(thread_data == NULL)
+	{
+		DpRt_JNI_Error_Set(96,"DpRt_JNI_Cancel_Token_Set_Current:Failed to get thread data.\n");
+		return FALSE;
+	}
+	thread_data->Cancel_Token = token;
+	return TRUE;
+}
+
+/**
+ * Routine to get the cancellation token bound to the calling thread. This does not allocate the thread's data,
+ * so it cannot fail.
+ * @return The bound token, or NULL if none is bound.
+ * @see #Thread_Data_Struct
+ */
+struct DpRt_JNI_Cancel_Token_Struct *DpRt_JNI_Cancel_Token_Get_Current(void)
+{
+	struct Thread_Data_Struct *thread_data = NULL;
+
+	pthread_once(&Thread_Data_Key_Once,DpRt_JNI_Thread_Data_Key_Create);
+	thread_data = (struct Thread_Data_Struct *)pthread_getspecific(Thread_Data_Key);
+	if(thread_data == NULL)
+		return NULL;
+	return thread_data->Cancel_Token;
+}
+
+/**
+ * Routine to start a deadline for a reduction. The reduction's latency budget (in seconds) is retrieved 
+ * from the budget_keyword property with DpRt_JNI_Get_Property_Double. If the reduction has not called 
+ * DpRt_JNI_Deadline_Finish before the budget elapses, the deadline watchdog thread aborts it by cancelling the
+ * cancellation token bound to the calling thread, and reports the overrun (and the stage that overran) to the 
+ * done object with DpRt_JNI_Set_Command_Done, with error number DPRT_JNI_DEADLINE_OVERRUN_ERROR_NUMBER. 
+ * This happens even if the stage has hung, so whatever is waiting for the done object keeps moving. 
+ * Only the one reduction is aborted, never the whole context. If no token is bound to the calling thread, 
+ * one is created and bound for the life of the deadline, and DpRt_JNI_Deadline_Finish must then be called 
+ * from the same thread. A bound token must not be destroyed before the deadline is finished. 
+ * The watchdog thread is started if it is not already running.
+ * @param env The JNI environment pointer.
+ * @param cls The class of the done object, or NULL if the overrun should not be reported.
+ * @param done The COMMAND_DONE object to report an overrun to, or NULL if the overrun should not be reported.
+ * @param budget_keyword The keyword of the property holding the budget in seconds. 
+ *        A budget of zero or less means the reduction is never aborted.
+ * @param deadline The address of a pointer to store the new deadline in.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Deadline_Struct
+ * @see #DpRt_JNI_Deadline_Stage_Set
+ * @see #DpRt_JNI_Deadline_Finish
+ * @see #DpRt_JNI_Deadline_Watchdog_Thread
+ */
+int DpRt_JNI_Deadline_Start(JNIEnv *env,jclass cls,jobject done,char *budget_keyword,
+			    struct DpRt_JNI_Deadline_Struct **deadline)
+{
+	struct DpRt_JNI_Deadline_Struct *new_deadline = NULL;
+	double budget;
+	int retval;
+
+	if((budget_keyword == NULL)||(deadline == NULL))
+	{
+		DpRt_JNI_Error_Set(98,"DpRt_JNI_Deadline_Start:Illegal argument(%p,%p).\n",
+			(void*)budget_keyword,(void*)deadline);
+		return FALSE;
+	}
+	if(!DpRt_JNI_Get_Property_Double(budget_keyword,&budget))
+		return FALSE;
+	new_deadline = (struct DpRt_JNI_Deadline_Struct *)malloc(sizeof(struct DpRt_JNI_Deadline_Struct));
+	if(new_deadline == NULL)
+	{
+		DpRt_JNI_Error_Set(99,"DpRt_JNI_Deadline_Start:Memory allocation error.\n");
+		return FALSE;
+	}
+	new_deadline->Budget = budget;
+	clock_gettime(CLOCK_MONOTONIC,&(new_deadline->Start_Time));
+	new_deadline->Expiry_Time = new_deadline->Start_Time;
+	new_deadline->Expiry_Time.tv_sec += (time_t)budget;
+	new_deadline->Expiry_Time.tv_nsec += (long)((budget-(double)((time_t)budget))*1000000000.0);
+	if(new_deadline->Expiry_Time.tv_nsec >= 1000000000L)
+	{
+		new_deadline->Expiry_Time.tv_sec++;
+		new_deadline->Expiry_Time.tv_nsec -= 1000000000L;
+	}
+	new_deadline->State = DEADLINE_STATE_ACTIVE;
+	strcpy(new_deadline->Stage,"start");
+	new_deadline->Cancel_Token = NULL;
+	new_deadline->Cancel_Token_Owned = FALSE;
+	if(budget > 0.0)
+	{
+		new_deadline->Cancel_Token = DpRt_JNI_Cancel_Token_Get_Current();
+		if(new_deadline->Cancel_Token == NULL)
+		{
+			if(!DpRt_JNI_Cancel_Token_Create(&(new_deadline->Cancel_Token)))
+			{
+				free(new_deadline);
+				return FALSE;
+			}
+			new_deadline->Cancel_Token_Owned = TRUE;
+			if(!DpRt_JNI_Cancel_Token_Set_Current(new_deadline->Cancel_Token))
+			{
+				DpRt_JNI_Cancel_Token_Destroy(new_deadline->Cancel_Token);
+				free(new_deadline);
+				return FALSE;
+			}
+		}
+	}
+	new_deadline->Done_Class = NULL;
+	new_deadline->Done = NULL;
+	if((env != NULL)&&(cls != NULL)&&(done != NULL))
+	{
+		new_deadline->Done_Class = (jclass)((*env)->NewGlobalRef(env,cls));
+		new_deadline->Done = (*env)->NewGlobalRef(env,done);
+	}
+	new_deadline->Next = NULL;
+	(*deadline) = new_deadline;
+	if(budget <= 0.0)
+		return TRUE;
+/* add the deadline to the watchdog, starting it if necessary */
+	pthread_once(&Deadline_Watchdog_Once,DpRt_JNI_Deadline_Watchdog_Initialise);
+	pthread_mutex_lock(&(Deadline_Watchdog.Lock));
+	if(Deadline_Watchdog.Running == FALSE)
+	{
+		retval = pthread_create(&(Deadline_Watchdog.Thread),NULL,DpRt_JNI_Deadline_Watchdog_Thread,NULL);
+		if(retval != 0)
+		{
+			pthread_mutex_unlock(&(Deadline_Watchdog.Lock));
+			(*deadline) = NULL;
+			if(new_deadline->Done != NULL)
+			{
+				(*env)->DeleteGlobalRef(env,new_deadline->Done);
+				(*env)->DeleteGlobalRef(env,new_deadline->Done_Class);
+			}
+			if(new_deadline->Cancel_Token_Owned)
+				DpRt_JNI_Cancel_Token_Destroy(new_deadline->Cancel_Token);
+			free(new_deadline);
+			DpRt_JNI_Error_Set(100,"DpRt_JNI_Deadline_Start:pthread_create failed(%d).\n",retval);
+			return FALSE;
+		}
+		Deadline_Watchdog.Running = TRUE;
+	}
+	new_deadline->Next = Deadline_Watchdog.Deadline_List;
+	Deadline_Watchdog.Deadline_List = new_deadline;
+	pthread_cond_broadcast(&(Deadline_Watchdog.Condition));
+	pthread_mutex_unlock(&(Deadline_Watchdog.Lock));
+	return TRUE;
+}
+
+/**
+ * Routine to record which pipeline stage a reduction is running, so an overrun can report the stage 
+ * that overran.
+ * @param deadline The reduction's deadline.
+ * @param stage The name of the stage. This is copied, and truncated to DEADLINE_STAGE_LENGTH-1 characters.
+ * @see #DpRt_JNI_Deadline_Struct
+ */
+void DpRt_JNI_Deadline_Stage_Set(struct DpRt_JNI_Deadline_Struct *deadline,char *stage)
+{
+	if((deadline == NULL)||(stage == NULL))
+		return;
+	pthread_once(&Deadline_Watchdog_Once,DpRt_JNI_Deadline_Watchdog_Initialise);
+	pthread_mutex_lock(&(Deadline_Watchdog.Lock));
+	strncpy(deadline->Stage,stage,DEADLINE_STAGE_LENGTH-1);
+	deadline->Stage[DEADLINE_STAGE_LENGTH-1] = '\0';
+	pthread_mutex_unlock(&(Deadline_Watchdog.Lock));
+}
+
+/**
+ * Routine to finish a reduction's deadline, and free it. If the budget elapsed first, this waits for the 
+ * watchdog to finish reporting the overrun, and returns FALSE: the done object has already been set 
+ * (with DPRT_JNI_DEADLINE_OVERRUN_ERROR_NUMBER), so the caller should not set it again.
+ * If DpRt_JNI_Deadline_Start created the deadline's cancellation token, it is unbound and destroyed.
+ * @param env The JNI environment pointer.
+ * @param deadline The deadline, as returned by DpRt_JNI_Deadline_Start.
+ * @return The routine returns TRUE if the reduction finished within it's budget, FALSE if it overran.
+ * @see #DpRt_JNI_Deadline_Start
+ * @see #DPRT_JNI_DEADLINE_OVERRUN_ERROR_NUMBER
+ */
+int DpRt_JNI_Deadline_Finish(JNIEnv *env,struct DpRt_JNI_Deadline_Struct *deadline)
+{
+	struct DpRt_JNI_Deadline_Struct **deadline_pointer = NULL;
+	int retval;
+
+	if(deadline == NULL)
+	{
+		DpRt_JNI_Error_Set(132,"DpRt_JNI_Deadline_Finish:deadline was NULL.\n");
+		return FALSE;
+	}
+	retval = TRUE;
+	if(deadline->Budget > 0.0)
+	{
+		pthread_mutex_lock(&(Deadline_Watchdog.Lock));
+		if(deadline->State == DEADLINE_STATE_ACTIVE)
+		{
+			deadline_pointer = &(Deadline_Watchdog.Deadline_List);
+			while(((*deadline_pointer) != NULL)&&((*deadline_pointer) != deadline))
+				deadline_pointer = &((*deadline_pointer)->Next);
+			if((*deadline_pointer) != NULL)
+				(*deadline_pointer) = deadline->Next;
+			deadline->State = DEADLINE_STATE_FINISHED;
+		}
+		else
+		{
+			while(deadline->State != DEADLINE_STATE_REPORTED)
+				pthread_cond_wait(&(Deadline_Watchdog.Condition),&(Deadline_Watchdog.Lock));
+			DpRt_JNI_Error_Set(DPRT_JNI_DEADLINE_OVERRUN_ERROR_NUMBER,"DpRt_JNI_Deadline_Finish:"
+				"Stage %s overran it's %.3f second budget.\n",deadline->Stage,deadline->Budget);
+			retval = FALSE;
+		}
+		pthread_mutex_unlock(&(Deadline_Watchdog.Lock));
+	}
+	if((env != NULL)&&(deadline->Done != NULL))
+	{
+		(*env)->DeleteGlobalRef(env,deadline->Done);
+		(*env)->DeleteGlobalRef(env,deadline->Done_Class);
+	}
+	if(deadline->Cancel_Token_Owned)
+		DpRt_JNI_Cancel_Token_Destroy(deadline->Cancel_Token);
+	free(deadline);
+	return retval;
+}
+
+/**
+ * Routine to stop the deadline watchdog thread, e.g. before the library is unloaded. This waits for the thread 
+ * to exit. Deadlines still active are no longer watched, but can still be finished. The watchdog is 
+ * re-started by the next DpRt_JNI_Deadline_Start.
+ * @return The routine returns TRUE if it succeeds, FALSE if the watchdog was not running.
+ * @see #Deadline_Watchdog
+ */
+int DpRt_JNI_Deadline_Watchdog_Stop(void)
+{
+	pthread_once(&Deadline_Watchdog_Once,DpRt_JNI_Deadline_Watchdog_Initialise);
+	pthread_mutex_lock(&(Deadline_Watchdog.Lock));
+	if(Deadline_Watchdog.Running == FALSE)
+	{
+		pthread_mutex_unlock(&(Deadline_Watchdog.Lock));
+		DpRt_JNI_Error_Set(101,"DpRt_JNI_Deadline_Watchdog_Stop:Watchdog not running.\n");
+		return FALSE;
+	}
+	Deadline_Watchdog.Running = FALSE;
+	pthread_cond_broadcast(&(Deadline_Watchdog.Condition));
+	pthread_mutex_unlock(&(Deadline_Watchdog.Lock));
+	pthread_join(Deadline_Watchdog.Thread,NULL);
+	return TRUE;
+}
+
+/**
+ * Routine to retrieve the number of reductions the deadline watchdog has aborted for overrunning their budget.
+ * @return The number of overruns.
+ * @see #Deadline_Watchdog
+ */
+unsigned long DpRt_JNI_Deadline_Get_Overrun_Count(void)
+{
+	return __atomic_load_n(&(Deadline_Watchdog.Overrun_Count),__ATOMIC_RELAXED);
+}
+
+/* property file processing */
+/* top level client API */
+/**
+ * This routine allows us to query the properties loaded into DpRt to get
+ * the value associated with a keyword in the property Hashtable.
+ * As libdprt can be called in two ways, from Java using JNI (the usual method) and
+ * from a C test program (for testing), the mechanism for retrieving the value is different
+ * in each case. A function pointer system is used.
+ * @param keyword The keyword in the property file to look up.
+ * @param value_string The address of a pointer to allocate and store the resulting value string in.
+ * 	This pointer is dynamically allocated and must be freed using <b>free()</b>. 
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Context_Struct
+ */
+int DpRt_JNI_Get_Property(char *keyword,char **value_string)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	unsigned long long latency_start;
+	int retval;
+
+	context = DpRt_JNI_Context_Get_Current();
+	DpRt_JNI_Error_Clear();
+	if(keyword == NULL)
+	{
+		DpRt_JNI_Error_Set(1,"DpRt_Get_Property failed: Keyword was NULL.\n");
+		return FALSE;
+	}
+	if(value_string == NULL)
+	{
+		DpRt_JNI_Error_Set(2,"DpRt_Get_Property failed: Value String Pointer was NULL.\n");
+		return FALSE;
+	}
+	if(context->DpRt_Data.DpRt_Get_Property_Function_Pointer == NULL)
+	{
+		DpRt_JNI_Error_Set(3,"DpRt_Get_Property failed: Function Pointer was NULL.\n");
+		return FALSE;
+	}
+	latency_start = DpRt_JNI_Latency_Start();
+	retval = context->DpRt_Data.DpRt_Get_Property_Function_Pointer(keyword,value_string);
+	DpRt_JNI_Latency_Record(DpRt_JNI_Latency_Property_Probe(
+				(void (*)(void))context->DpRt_Data.DpRt_Get_Property_Function_Pointer),latency_start);
+	return retval;
+}
+
+/**
+ * This routine allows us to query the properties loaded into DpRt to get
+ * the integer value associated with a keyword in the property Hashtable.
+ * As libdprt can be called in two ways, from Java using JNI (the usual method) and
+ * from a C test program (for testing), the mechanism for retrieving the value is different
+ * in each case. A function pointer system is used.
+ * @param keyword The keyword in the property file to look up.
+ * @param value The address of an integer to store the resulting value.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Context_Struct
+ */
+int DpRt_JNI_Get_Property_Integer(char *keyword,int *value)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	unsigned long long latency_start;
+	int retval;
+
+	context = DpRt_JNI_Context_Get_Current();
+	DpRt_JNI_Error_Clear();
+	if(keyword == NULL)
+	{
+		DpRt_JNI_Error_Set(4,"DpRt_Get_Property_Integer failed: Keyword was NULL.\n");
+		return FALSE;
+	}
+	if(value == NULL)
+	{
+		DpRt_JNI_Error_Set(5,"DpRt_Get_Property_Integer failed: Value Pointer was NULL.\n");
+		return FALSE;
+	}
+	if(context->DpRt_Data.DpRt_Get_Property_Integer_Function_Pointer == NULL)
+	{
+		DpRt_JNI_Error_Set(6,"DpRt_Get_Property_Integer failed: Function Pointer was NULL.\n");
+		return FALSE;
+	}
+	latency_start = DpRt_JNI_Latency_Start();
+	retval = context->DpRt_Data.DpRt_Get_Property_Integer_Function_Pointer(keyword,value);
+	DpRt_JNI_Latency_Record(DpRt_JNI_Latency_Property_Probe(
+				(void (*)(void))context->DpRt_Data.DpRt_Get_Property_Integer_Function_Pointer),latency_start);
+	return retval;
+}
+
+/**
+ * This routine allows us to query the properties loaded into DpRt to get
+ * the double value associated with a keyword in the property Hashtable.
+ * As libdprt can be called in two ways, from Java using JNI (the usual method) and
+ * from a C test program (for testing), the mechanism for retrieving the value is different
+ * in each case. A function pointer system is used.
+ * @param keyword The keyword in the property file to look up.
+ * @param value The address of an double to store the resulting value.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Context_Struct
+ */
+int DpRt_JNI_Get_Property_Double(char *keyword,double *value)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	unsigned long long latency_start;
+	int retval;
+
+	context = DpRt_JNI_Context_Get_Current();
+	DpRt_JNI_Error_Clear();
+	if(keyword == NULL)
+	{
+		DpRt_JNI_Error_Set(7,"DpRt_Get_Property_Double failed: Keyword was NULL.\n");
+		return FALSE;
+	}
+	if(value == NULL)
+	{
+		DpRt_JNI_Error_Set(8,"DpRt_Get_Property_Double failed: Value Pointer was NULL.\n");
+		return FALSE;
+	}
+	if(context->DpRt_Data.DpRt_Get_Property_Double_Function_Pointer == NULL)
+	{
+		DpRt_JNI_Error_Set(9,"DpRt_Get_Property_Double failed: Function Pointer was NULL.\n");
+		return FALSE;
+	}
+	latency_start = DpRt_JNI_Latency_Start();
+	retval = context->DpRt_Data.DpRt_Get_Property_Double_Function_Pointer(keyword,value);
+	DpRt_JNI_Latency_Record(DpRt_JNI_Latency_Property_Probe(
+				(void (*)(void))context->DpRt_Data.DpRt_Get_Property_Double_Function_Pointer),latency_start);
+	return retval;
+}
+
+/**
+ * This routine allows us to query the properties loaded into DpRt to get
+ * the boolean value associated with a keyword in the property Hashtable.
+ * As libdprt can be called in two ways, from Java using JNI (the usual method) and
+ * from a C test program (for testing), the mechanism for retrieving the value is different
+ * in each case. A function pointer system is used.
+ * @param keyword The keyword in the property file to look up.
+ * @param value The address of an integer to store the resulting value, 1 is TRUE, 0 is FALSE.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Context_Struct
+ */
+int DpRt_JNI_Get_Property_Boolean(char *keyword,int *value)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	unsigned long long latency_start;
+	int retval;
+
+	context = DpRt_JNI_Context_Get_Current();
+	DpRt_JNI_Error_Clear();
+	if(keyword == NULL)
+	{
+		DpRt_JNI_Error_Set(10,"DpRt_Get_Property_Boolean failed: Keyword was NULL.\n");
+		return FALSE;
+	}
+	if(value == NULL)
+	{
+		DpRt_JNI_Error_Set(11,"DpRt_Get_Property_Boolean failed: Value Pointer was NULL.\n");
+		return FALSE;
+	}
+	if(context->DpRt_Data.DpRt_Get_Property_Boolean_Function_Pointer == NULL)
+	{
+		DpRt_JNI_Error_Set(12,"DpRt_Get_Property_Boolean failed: Function Pointer was NULL.\n");
+		return FALSE;
+	}
+	latency_start = DpRt_JNI_Latency_Start();
+	retval = context->DpRt_Data.DpRt_Get_Property_Boolean_Function_Pointer(keyword,value);
+	DpRt_JNI_Latency_Record(DpRt_JNI_Latency_Property_Probe(
+				(void (*)(void))context->DpRt_Data.DpRt_Get_Property_Boolean_Function_Pointer),latency_start);
+	return retval;
+}
+
+/**
+ * This routine allows us to query the properties loaded into DpRt to get the values associated with
+ * a list of keywords in the property Hashtable, in one call. This is much faster than retrieving each value
+ * separately, particularly when the properties are held in the Java layer.
+ * As libdprt can be called in two ways, from Java using JNI (the usual method) and
+ * from a C test program (for testing), the mechanism for retrieving the values is different
+ * in each case. A function pointer system is used.
+ * Each request's Error_Number is set to zero if it's value was retrieved, or the number of the error
+ * that prevented it being retrieved. If any request failed, the error number/string are set to
+ * summarise the failures.
+ * @param request_list A list of requests. Each request's Keyword and Type should be filled in, the
+ *        value field for the Type is filled in by this routine. String values are dynamically allocated
+ *        and must be freed using <b>free()</b>.
+ * @param request_count The number of requests in request_list.
+ * @return The routine returns TRUE if every value was retrieved, FALSE if any failed.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Property_Request_Struct
+ */
+int DpRt_JNI_Get_Property_List(struct DpRt_JNI_Property_Request_Struct *request_list,int request_count)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	unsigned long long latency_start;
+	int i,failed_count;
+
+	context = DpRt_JNI_Context_Get_Current();
+	DpRt_JNI_Error_Clear();
+	if(request_list == NULL)
+	{
+		DpRt_JNI_Error_Set(47,"DpRt_Get_Property_List failed: Request List was NULL.\n");
+		return FALSE;
+	}
+	if(context->DpRt_Data.DpRt_Get_Property_List_Function_Pointer == NULL)
+	{
+		DpRt_JNI_Error_Set(48,"DpRt_Get_Property_List failed: Function Pointer was NULL.\n");
+		return FALSE;
+	}
+	for(i = 0; i < request_count; i++)
+	{
+		request_list[i].String_Value = NULL;
+		if(request_list[i].Keyword == NULL)
+			request_list[i].Error_Number = 1;
+		else if((request_list[i].Type < 0)||(request_list[i].Type >= DPRT_JNI_PROPERTY_TYPE_COUNT))
+			request_list[i].Error_Number = 49;
+		else
+			request_list[i].Error_Number = -1; /* not retrieved yet */
+	}
+	latency_start = DpRt_JNI_Latency_Start();
+	context->DpRt_Data.DpRt_Get_Property_List_Function_Pointer(request_list,request_count);
+	DpRt_JNI_Latency_Record(DpRt_JNI_Latency_Property_Probe(
+				(void (*)(void))context->DpRt_Data.DpRt_Get_Property_List_Function_Pointer),latency_start);
+	failed_count = 0;
+	for(i = 0; i < request_count; i++)
+	{
+		if(request_list[i].Error_Number != 0)
+			failed_count++;
+	}
+	if(failed_count > 0)
+	{
+		DpRt_JNI_Error_Set(50,"DpRt_Get_Property_List failed: %d of %d properties failed.\n",
+			failed_count,request_count);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to get the value of an optional keyword, using a default value if it cannot be retrieved.
+ * No error is raised if the keyword is missing. Missing keywords are remembered, so probing them again
+ * does not consult the property source until it changes. If the value cannot be retrieved for another reason,
+ * the default is still used but the error is left set (see DpRt_JNI_Get_Error_Number).
+ * @param keyword The keyword to look up.
+ * @param default_value The value to use if the keyword cannot be retrieved. Can be NULL.
+ * @param value_string The address of a pointer to store the resulting value string in. This is dynamically
+ *        allocated (a copy of default_value if that was used) and must be freed using <b>free()</b>.
+ * @return The routine returns TRUE if the keyword's value was retrieved, FALSE if the default was used.
+ * @see #DpRt_JNI_Get_Property_Optional
+ */
+int DpRt_JNI_Get_Property_Default(char *keyword,char *default_value,char **value_string)
+{
+	if(value_string == NULL)
+		return FALSE;
+	if(DpRt_JNI_Get_Property_Optional(keyword,DPRT_JNI_PROPERTY_TYPE_STRING,value_string))
+		return TRUE;
+	if(default_value != NULL)
+		(*value_string) = strdup(default_value);
+	else
+		(*value_string) = NULL;
+	return FALSE;
+}
+
+/**
+ * Routine to get the integer value of an optional keyword, using a default value if it cannot be retrieved.
+ * No error is raised if the keyword is missing. If the value cannot be retrieved for another reason 
+ * (e.g. it is not an integer), the default is still used but the error is left set.
+ * @param keyword The keyword to look up.
+ * @param default_value The value to use if the keyword cannot be retrieved.
+ * @param value The address of an integer to store the resulting value in.
+ * @return The routine returns TRUE if the keyword's value was retrieved, FALSE if the default was used.
+ * @see #DpRt_JNI_Get_Property_Optional
+ */
+int DpRt_JNI_Get_Property_Integer_Default(char *keyword,int default_value,int *value)
+{
+	if(value == NULL)
+		return FALSE;
+	if(DpRt_JNI_Get_Property_Optional(keyword,DPRT_JNI_PROPERTY_TYPE_INTEGER,value))
+		return TRUE;
+	(*value) = default_value;
+	return FALSE;
+}
+
+/**
+ * Routine to get the double value of an optional keyword, using a default value if it cannot be retrieved.
+ * No error is raised if the keyword is missing. If the value cannot be retrieved for another reason 
+ * (e.g. it is not a number), the default is still used but the error is left set.
+ * @param keyword The keyword to look up.
+ * @param default_value The value to use if the keyword cannot be retrieved.
+ * @param value The address of a double to store the resulting value in.
+ * @return The routine returns TRUE if the keyword's value was retrieved, FALSE if the default was used.
+ * @see #DpRt_JNI_Get_Property_Optional
+ */
+int DpRt_JNI_Get_Property_Double_Default(char *keyword,double default_value,double *value)
+{
+	if(value == NULL)
+		return FALSE;
+	if(DpRt_JNI_Get_Property_Optional(keyword,DPRT_JNI_PROPERTY_TYPE_DOUBLE,value))
+		return TRUE;
+	(*value) = default_value;
+	return FALSE;
+}
+
+/**
+ * Routine to get the boolean value of an optional keyword, using a default value if it cannot be retrieved.
+ * No error is raised if the keyword is missing. If the value cannot be retrieved for another reason 
+ * (e.g. it is not a boolean), the default is still used but the error is left set.
+ * @param keyword The keyword to look up.
+ * @param default_value The value (TRUE or FALSE) to use if the keyword cannot be retrieved.
+ * @param value The address of an integer to store the resulting boolean value in.
+ * @return The routine returns TRUE if the keyword's value was retrieved, FALSE if the default was used.
+ * @see #DpRt_JNI_Get_Property_Optional
+ */
+int DpRt_JNI_Get_Property_Boolean_Default(char *keyword,int default_value,int *value)
+{
+	if(value == NULL)
+		return FALSE;
+	if(DpRt_JNI_Get_Property_Optional(keyword,DPRT_JNI_PROPERTY_TYPE_BOOLEAN,value))
+		return TRUE;
+	(*value) = default_value;
+	return FALSE;
+}
+
+/**
+ * Routine to acquire a snapshot of the current context's properties, from which values can be borrowed
+ * (with DpRt_JNI_Property_Snapshot_Get) without any copying or allocation. If the context's properties
+ * come from the property file, the snapshot is the current property file index (re-loaded first if the file 
+ * has changed). Otherwise, the context's DpRtStatus snapshot is used, which must have been enabled with 
+ * DpRt_JNI_Set_Status_Snapshot and refreshed. The snapshot stays valid, and it's values unchanged, until it
+ * is released, even if the properties are re-loaded in the meantime.
+ * @param snapshot The address of a pointer to store the snapshot in.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Property_Snapshot_Struct
+ * @see #DpRt_JNI_Property_Snapshot_Get
+ * @see #DpRt_JNI_Property_Snapshot_Release
+ * @see #DpRt_JNI_Property_File_Snapshot_Acquire
+ */
+int DpRt_JNI_Property_Snapshot_Acquire(struct DpRt_JNI_Property_Snapshot_Struct **snapshot)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	if(snapshot == NULL)
+	{
+		DpRt_JNI_Error_Set(88,"DpRt_JNI_Property_Snapshot_Acquire:snapshot was NULL.\n");
+		return FALSE;
+	}
+	context = DpRt_JNI_Context_Get_Current();
+	if(context->DpRt_Data.DpRt_Get_Property_Function_Pointer == DpRt_JNI_Get_Property_From_C_File)
+		return DpRt_JNI_Property_File_Snapshot_Acquire(snapshot);
+	pthread_rwlock_rdlock(&context->Status_Snapshot_Lock);
+	(*snapshot) = context->Status_Snapshot_Index;
+	if((*snapshot) != NULL)
+		__atomic_add_fetch(&((*snapshot)->Reference_Count),1,__ATOMIC_RELAXED);
+	pthread_rwlock_unlock(&context->Status_Snapshot_Lock);
+	if((*snapshot) == NULL)
+	{
+		DpRt_JNI_Error_Set(89,"DpRt_JNI_Property_Snapshot_Acquire:No DpRtStatus snapshot available.\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to borrow the value of a keyword from a property snapshot. No copy is made, the value
+ * points into the snapshot's value arena.
+ * @param snapshot A snapshot acquired with DpRt_JNI_Property_Snapshot_Acquire.
+ * @param keyword The keyword to look up.
+ * @param value The address of a pointer to store the NULL terminated value in. This remains valid until the 
+ *        snapshot is released, and must not be modified or freed.
+ * @param length The address of a size_t to store the length of the value in (not including the NULL 
+ *        terminator). Can be NULL.
+ * @return The routine returns TRUE if it succeeds, FALSE if the keyword is not in the snapshot.
+ * @see #DpRt_JNI_Property_Snapshot_Acquire
+ * @see #DpRt_JNI_Property_Index_Find
+ */
+int DpRt_JNI_Property_Snapshot_Get(struct DpRt_JNI_Property_Snapshot_Struct *snapshot,char *keyword,
+				   const char **value,size_t *length)
+{
+	struct Property_Entry_Struct *entry = NULL;
+
+	if((snapshot == NULL)||(keyword == NULL)||(value == NULL))
+	{
+		DpRt_JNI_Error_Set(90,"DpRt_JNI_Property_Snapshot_Get:Illegal argument(%p,%p,%p).\n",
+			(void*)snapshot,(void*)keyword,(void*)value);
+		return FALSE;
+	}
+	entry = DpRt_JNI_Property_Index_Find(snapshot,keyword);
+	if(entry == NULL)
+	{
+		DpRt_JNI_Error_Set(91,"DpRt_JNI_Property_Snapshot_Get:Failed to find keyword (%s).\n",keyword);
+		return FALSE;
+	}
+	(*value) = snapshot->Value_Arena+entry->Value_String_Offset;
+	if(length != NULL)
+		(*length) = entry->Value_Length;
+	return TRUE;
+}
+
+/**
+ * Routine to release a property snapshot acquired with DpRt_JNI_Property_Snapshot_Acquire. Values borrowed
+ * from the snapshot must not be used afterwards. The snapshot is freed once it has been released by all 
+ * it's users, and replaced by a re-loaded snapshot.
+ * @param snapshot The snapshot to release. Can be NULL.
+ * @see #DpRt_JNI_Property_Snapshot_Acquire
+ * @see #DpRt_JNI_Property_Index_Free
+ */
+void DpRt_JNI_Property_Snapshot_Release(struct DpRt_JNI_Property_Snapshot_Struct *snapshot)
+{
+	if(snapshot == NULL)
+		return;
+	if(__atomic_sub_fetch(&(snapshot->Reference_Count),1,__ATOMIC_ACQ_REL) == 0)
+		DpRt_JNI_Property_Index_Free(snapshot);
+}
+
+/* routines to access proerties via DpRtStatus object.
+** external, as can be passed as parameters to DpRt_JNI_Set_Property_*_Function_Pointer */
+/**
+ * Routine to get the value of the keyword from the properties held in the instance of DpRtStatus.
+ * The value is cached, so subsequent calls for the same keyword do not call up into the JVM until
+ * the cache is invalidated by DpRt_JNI_DpRtStatus_Property_Cache_Invalidate. If the keyword is
+ * covered by a snapshot of the properties, the value is retrieved from the snapshot instead.
+ * @param keyword The keyword in the property file to look up.
+ * @param value_string The address of a pointer to allocate and store the resulting value string in.
+ * 	This pointer is dynamically allocated and must be freed using <b>free()</b>. 
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Status_Snapshot_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Put
+ */
+int DpRt_JNI_DpRtStatus_Get_Property(char *keyword,char **value_string)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	JNIEnv *env = NULL;
+	jstring java_keyword_string = NULL;
+	jobject java_value_object = NULL;
+	jstring java_value_string = NULL;
+	const char *c_value_string = NULL;
+	unsigned int cache_generation;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(context->DpRt_Status == NULL)
+	{
+		DpRt_JNI_Error_Set(13,"DpRt_JNI_DpRtStatus_Get_Property:DpRt_Status was NULL (%s).\n",
+			keyword);
+		return FALSE;
+	}
+/* is this keyword's value in the snapshot */
+	if((keyword != NULL)&&(value_string != NULL)&&
+	   DpRt_JNI_Status_Snapshot_Get(keyword,DPRT_JNI_PROPERTY_TYPE_STRING,value_string))
+		return TRUE;
+/* have we already retrieved this keyword's value */
+	if((keyword != NULL)&&(value_string != NULL)&&
+	   DpRt_JNI_Status_Property_Cache_Get(keyword,DPRT_JNI_PROPERTY_TYPE_STRING,value_string,&cache_generation))
+		return TRUE;
+	if(context->DpRt_Status_Get_Property_Method_Id == NULL)
+	{
+		DpRt_JNI_Error_Set(14,"DpRt_JNI_DpRtStatus_Get_Property:Method ID was NULL (%s).\n",
+			keyword);
+		return FALSE;
+	}
+	if(Java_VM == NULL)
+	{
+		DpRt_JNI_Error_Set(15,"DpRt_JNI_DpRtStatus_Get_Property:Java_VM was NULL (%s).\n",
+			keyword);
+		return FALSE;
+	}
+/* get (cached) java env for this thread */
+	env = DpRt_JNI_Get_Env(NULL);
+	if(env == NULL)
+	{
+		DpRt_JNI_Error_Set(16,"DpRt_JNI_DpRtStatus_Get_Property:env was NULL (%s).\n",keyword);
+		return FALSE;
+	}
+	if(keyword == NULL)
+	{
+		DpRt_JNI_Error_Set(17,"DpRt_JNI_DpRtStatus_Get_Property:string (%s) was NULL.\n",keyword);
+		return FALSE;
+	}
+	if(value_string == NULL)
+	{
+		DpRt_JNI_Error_Set(18,"DpRt_JNI_DpRtStatus_Get_Property:value_string Pointer was NULL.\n");
+		return FALSE;
+	}
+/* convert C to Java String */
+	java_keyword_string = (*env)->NewStringUTF(env,keyword);
+	DpRt_JNI_Local_Reference_Created(java_keyword_string);
+/* call getProperty method on DpRt_Status instance */
+	java_value_object = (*env)->CallObjectMethod(env,context->DpRt_Status,context->DpRt_Status_Get_Property_Method_Id,
+			java_keyword_string);
+	DpRt_JNI_Local_Reference_Created(java_value_object);
+	DpRt_JNI_Delete_Local_Reference(env,java_keyword_string);
+/* Convert Java JString to C character array */
+	java_value_string = (jstring)java_value_object;
+	if(java_value_string != NULL)
+		c_value_string = (*env)->GetStringUTFChars(env,java_value_string,0);
+/* copy c_value_string to (*value_string) */
+	if(c_value_string != NULL)
+	{
+		(*value_string) = (char *)malloc((strlen(c_value_string)+1)*sizeof(char));
+		if((*value_string) == NULL)
+		{
+			DpRt_JNI_Error_Set(19,"DpRt_JNI_DpRtStatus_Get_Property:"
+				"Memory allocation error(%s,%d).\n",
+				c_value_string,(int)strlen(c_value_string));
+			(*env)->ReleaseStringUTFChars(env,java_value_string,c_value_string);
+			DpRt_JNI_Delete_Local_Reference(env,java_value_object);
+			return FALSE;
+		}
+		strcpy((*value_string),c_value_string);
+	}
+	else
+		(*value_string) = NULL;
+/* free c_value_string */
+	if(java_value_string != NULL)
+		(*env)->ReleaseStringUTFChars(env,java_value_string,c_value_string);
+	DpRt_JNI_Delete_Local_Reference(env,java_value_object);
+/* cache the value, unless getProperty threw an exception */
+	if((*env)->ExceptionCheck(env) == JNI_FALSE)
+		DpRt_JNI_Status_Property_Cache_Put(keyword,cache_generation,DPRT_JNI_PROPERTY_TYPE_STRING,value_string);
+	return TRUE;
+}
+
+/**
+ * Routine to get the integer value of the keyword from the properties held in the instance of DpRtStatus.
+ * @param keyword The keyword in the property file to look up.
+ * @param value The address of an integer to store the resulting integer value in.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Status_Snapshot_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Put
+ */
+int DpRt_JNI_DpRtStatus_Get_Property_Integer(char *keyword,int *value)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	JNIEnv *env = NULL;
+	jstring java_keyword_string = NULL;
+	unsigned int cache_generation;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(context->DpRt_Status == NULL)
+	{
+		DpRt_JNI_Error_Set(20,"DpRt_JNI_DpRtStatus_Get_Property_Integer:"
+			"DpRt_Status was NULL (%s).\n",
+			keyword);
+		return FALSE;
+	}
+/* is this keyword's value in the snapshot */
+	if((keyword != NULL)&&(value != NULL)&&
+	   DpRt_JNI_Status_Snapshot_Get(keyword,DPRT_JNI_PROPERTY_TYPE_INTEGER,value))
+		return TRUE;
+/* have we already retrieved this keyword's value */
+	if((keyword != NULL)&&(value != NULL)&&
+	   DpRt_JNI_Status_Property_Cache_Get(keyword,DPRT_JNI_PROPERTY_TYPE_INTEGER,value,&cache_generation))
+		return TRUE;
+	if(context->DpRt_Status_Get_Property_Integer_Method_Id == NULL)
+	{
+		DpRt_JNI_Error_Set(21,"DpRt_JNI_DpRtStatus_Get_Property_Integer:Method ID was NULL(%s).\n",
+			keyword);
+		return FALSE;
+	}
+	if(Java_VM == NULL)
+	{
+		DpRt_JNI_Error_Set(22,"DpRt_JNI_DpRtStatus_Get_Property_Integer:Java_VM was NULL(%s).\n",
+			keyword);
+		return FALSE;
+	}
+/* get (cached) java env for this thread */
+	env = DpRt_JNI_Get_Env(NULL);
+	if(env == NULL)
+	{
+		DpRt_JNI_Error_Set(23,"DpRt_JNI_DpRtStatus_Get_Property_Integer:env was NULL (%s).\n",
+			keyword);
+		return FALSE;
+	}
+	if(keyword == NULL)
+	{
+		DpRt_JNI_Error_Set(24,"DpRt_JNI_DpRtStatus_Get_Property_Integer:string (%s) was NULL.\n",
+			keyword);
+		return FALSE;
+	}
+	if(value == NULL)
+	{
+		DpRt_JNI_Error_Set(25,"DpRt_JNI_DpRtStatus_Get_Property_Integer:value Pointer was NULL.\n");
+		return FALSE;
+	}
+/* convert C to Java String */
+	java_keyword_string = (*env)->NewStringUTF(env,keyword);
+	DpRt_JNI_Local_Reference_Created(java_keyword_string);
+/* call getProperty method on DpRt_Status instance */
+	(*value) = (int)((*env)->CallIntMethod(env,context->DpRt_Status,context->DpRt_Status_Get_Property_Integer_Method_Id,
+			java_keyword_string));
+	DpRt_JNI_Delete_Local_Reference(env,java_keyword_string);
+/* cache the value, unless getPropertyInteger threw an exception */
+	if((*env)->ExceptionCheck(env) == JNI_FALSE)
+		DpRt_JNI_Status_Property_Cache_Put(keyword,cache_generation,DPRT_JNI_PROPERTY_TYPE_INTEGER,value);
+	return TRUE;
+}
+
+/**
+ * Routine to get the double value of the keyword from the properties held in the instance of DpRtStatus.
+ * @param keyword The keyword in the property file to look up.
+ * @param value The address of an double to store the resulting value in.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Status_Snapshot_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Put
+ */
+int DpRt_JNI_DpRtStatus_Get_Property_Double(char *keyword,double *value)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	JNIEnv *env = NULL;
+	jstring java_keyword_string = NULL;
+	unsigned int cache_generation;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(context->DpRt_Status == NULL)
+	{
+		DpRt_JNI_Error_Set(26,"DpRt_JNI_DpRtStatus_Get_Property_Double:DpRt_Status was NULL(%s).\n",
+			keyword);
+		return FALSE;
+	}
+/* is this keyword's value in the snapshot */
+	if((keyword != NULL)&&(value != NULL)&&
+	   DpRt_JNI_Status_Snapshot_Get(keyword,DPRT_JNI_PROPERTY_TYPE_DOUBLE,value))
+		return TRUE;
+/* have we already retrieved this keyword's value */
+	if((keyword != NULL)&&(value != NULL)&&
+	   DpRt_JNI_Status_Property_Cache_Get(keyword,DPRT_JNI_PROPERTY_TYPE_DOUBLE,value,&cache_generation))
+		return TRUE;
+	if(context->DpRt_Status_Get_Property_Double_Method_Id == NULL)
+	{
+		DpRt_JNI_Error_Set(27,"DpRt_JNI_DpRtStatus_Get_Property_Double:Method ID was NULL (%s).\n",
+			keyword);
+		return FALSE;
+	}
+	if(Java_VM == NULL)
+	{
+		DpRt_JNI_Error_Set(28,"DpRt_JNI_DpRtStatus_Get_Property_Double:Java_VM was NULL(%s).\n",
+			keyword);
+		return FALSE;
+	}
+/* get (cached) java env for this thread */
+	env = DpRt_JNI_Get_Env(NULL);
+	if(env == NULL)
+	{
+		DpRt_JNI_Error_Set(29,"DpRt_JNI_DpRtStatus_Get_Property_Double:env was NULL (%s).\n",
+			keyword);
+		return FALSE;
+	}
+	if(keyword == NULL)
+	{
+		DpRt_JNI_Error_Set(30,"DpRt_JNI_DpRtStatus_Get_Property_Double:string (%s) was NULL.\n",
+			keyword);
+		return FALSE;
+	}
+	if(value == NULL)
+	{
+		DpRt_JNI_Error_Set(31,"DpRt_JNI_DpRtStatus_Get_Property_Double:value Pointer was NULL.\n");
+		return FALSE;
+	}
+/* convert C to Java String */
+	java_keyword_string = (*env)->NewStringUTF(env,keyword);
+	DpRt_JNI_Local_Reference_Created(java_keyword_string);
+/* call getProperty method on DpRt_Status instance */
+	(*value) = (double)((*env)->CallDoubleMethod(env,context->DpRt_Status,
+			context->DpRt_Status_Get_Property_Double_Method_Id,java_keyword_string));
+	DpRt_JNI_Delete_Local_Reference(env,java_keyword_string);
+/* cache the value, unless getPropertyDouble threw an exception */
+	if((*env)->ExceptionCheck(env) == JNI_FALSE)
+		DpRt_JNI_Status_Property_Cache_Put(keyword,cache_generation,DPRT_JNI_PROPERTY_TYPE_DOUBLE,value);
+	return TRUE;
+}
+
+/**
+ * Routine to get the boolean value of the keyword from the properties held in the instance of DpRtStatus.
+ * @param keyword The keyword in the property file to look up.
+ * @param value The address of an boolean to store the resulting value in.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Status_Snapshot_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Put
+ */
+int DpRt_JNI_DpRtStatus_Get_Property_Boolean(char *keyword,int *value)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	JNIEnv *env = NULL;
+	jstring java_keyword_string = NULL;
+	jboolean boolean_value;
+	unsigned int cache_generation;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(context->DpRt_Status == NULL)
+	{
+		DpRt_JNI_Error_Set(32,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:"
+			"DpRt_Status was NULL(%s).\n",keyword);
+		return FALSE;
+	}
+/* is this keyword's value in the snapshot */
+	if((keyword != NULL)&&(value != NULL)&&
+	   DpRt_JNI_Status_Snapshot_Get(keyword,DPRT_JNI_PROPERTY_TYPE_BOOLEAN,value))
+		return TRUE;
+/* have we already retrieved this keyword's value */
+	if((keyword != NULL)&&(value != NULL)&&
+	   DpRt_JNI_Status_Property_Cache_Get(keyword,DPRT_JNI_PROPERTY_TYPE_BOOLEAN,value,&cache_generation))
+		return TRUE;
+	if(context->DpRt_Status_Get_Property_Boolean_Method_Id == NULL)
+	{
+		DpRt_JNI_Error_Set(33,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:Method ID was NULL(%s).\n",
+			keyword);
+		return FALSE;
+	}
+	if(Java_VM == NULL)
+	{
+		DpRt_JNI_Error_Set(34,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:Java_VM was NULL(%s).\n",
+			keyword);
+		return FALSE;
+	}
+/* get (cached) java env for this thread */
+	env = DpRt_JNI_Get_Env(NULL);
+	if(env == NULL)
+	{
+		DpRt_JNI_Error_Set(35,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:env was NULL (%s).\n",
+			keyword);
+		return FALSE;
+	}
+	if(keyword == NULL)
+	{
+		DpRt_JNI_Error_Set(36,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:string (%s) was NULL.\n",
+			keyword);
+		return FALSE;
+	}
+	if(value == NULL)
+	{
+		DpRt_JNI_Error_Set(37,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:value Pointer was NULL.\n");
+		return FALSE;
+	}
+/* convert C to Java String */
+	java_keyword_string = (*env)->NewStringUTF(env,keyword);
+	DpRt_JNI_Local_Reference_Created(java_keyword_string);
+/* call getProperty method on DpRt_Status instance */
+	boolean_value = (double)((*env)->CallBooleanMethod(env,context->DpRt_Status,
+			context->DpRt_Status_Get_Property_Boolean_Method_Id,java_keyword_string));
+	DpRt_JNI_Delete_Local_Reference(env,java_keyword_string);
+	if(boolean_value)
+		(*value) = TRUE;
+	else
+		(*value) = FALSE;
+/* cache the value, unless getPropertyBoolean threw an exception */
+	if((*env)->ExceptionCheck(env) == JNI_FALSE)
+		DpRt_JNI_Status_Property_Cache_Put(keyword,cache_generation,DPRT_JNI_PROPERTY_TYPE_BOOLEAN,value);
+	return TRUE;
+}
+
+/**
+ * Routine to get the values of a list of keywords from the properties held in the instance of DpRtStatus.
+ * Values in the snapshot or the DpRtStatus property cache are retrieved from there. If the DpRtStatus class
+ * has a getPropertyList method, the remaining values are retrieved as strings with one call to it, 
+ * and converted to the requested types in C. Otherwise each remaining value is retrieved using the 
+ * relevant DpRt_JNI_DpRtStatus_Get_Property* routine.
+ * Requests with an Error_Number of -1 are retrieved, others are left alone. A Java exception thrown while 
+ * retrieving a value is cleared, and fails that request (or, for getPropertyList, all the remaining requests)
+ * with it's own error number, as does getPropertyList returning fewer values than keywords.
+ * @param request_list A list of requests.
+ * @param request_count The number of requests in request_list.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails (the individual requests
+ *         Error_Number's are also set).
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Status_Snapshot_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Get
+ * @see #DpRt_JNI_Status_Property_Cache_Put
+ * @see #DpRt_JNI_Property_Request_Convert
+ */
+int DpRt_JNI_DpRtStatus_Get_Property_List(struct DpRt_JNI_Property_Request_Struct *request_list,
+					  int request_count)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	JNIEnv *env = NULL;
+	jclass string_class = NULL;
+	jobjectArray java_keyword_list = NULL;
+	jobjectArray java_value_list = NULL;
+	jstring java_string = NULL;
+	const char *c_value_string = NULL;
+	unsigned int cache_generation;
+	void *value = NULL;
+	int i,missing_count,missing_index,retval;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(context->DpRt_Status == NULL)
+	{
+		DpRt_JNI_Error_Set(51,"DpRt_JNI_DpRtStatus_Get_Property_List:DpRt_Status was NULL.\n");
+		for(i = 0; i < request_count; i++)
+		{
+			if(request_list[i].Error_Number == -1)
+				request_list[i].Error_Number = 51;
+		}
+		return FALSE;
+	}
+/* retrieve values already in the cache */
+	missing_count = 0;
+	for(i = 0; i < request_count; i++)
+	{
+		if(request_list[i].Error_Number != -1)
+			continue;
+		switch(request_list[i].Type)
+		{
+			case DPRT_JNI_PROPERTY_TYPE_STRING:
+				value = &(request_list[i].String_Value);
+				break;
+			case DPRT_JNI_PROPERTY_TYPE_INTEGER:
+				value = &(request_list[i].Integer_Value);
+				break;
+			case DPRT_JNI_PROPERTY_TYPE_DOUBLE:
+				value = &(request_list[i].Double_Value);
+				break;
+			case DPRT_JNI_PROPERTY_TYPE_BOOLEAN:
+				value = &(request_list[i].Boolean_Value);
+				break;
+		}
+		if(DpRt_JNI_Status_Snapshot_Get(request_list[i].Keyword,request_list[i].Type,value)||
+		   DpRt_JNI_Status_Property_Cache_Get(request_list[i].Keyword,request_list[i].Type,value,
+						      &cache_generation))
+			request_list[i].Error_Number = 0;
+		else
+			missing_count++;
+	}
+	if(missing_count == 0)
+		return TRUE;
+	if(Java_VM == NULL)
+	{
+		DpRt_JNI_Error_Set(52,"DpRt_JNI_DpRtStatus_Get_Property_List:Java_VM was NULL.\n");
+		for(i = 0; i < request_count; i++)
+		{
+			if(request_list[i].Error_Number == -1)
+				request_list[i].Error_Number = 52;
+		}
+		return FALSE;
+	}
+/* get (cached) java env for this thread */
+	env = DpRt_JNI_Get_Env(NULL);
+	if(env == NULL)
+	{
+		DpRt_JNI_Error_Set(53,"DpRt_JNI_DpRtStatus_Get_Property_List:env was NULL.\n");
+		for(i = 0; i < request_count; i++)
+		{
+			if(request_list[i].Error_Number == -1)
+				request_list[i].Error_Number = 53;
+		}
+		return FALSE;
+	}
+/* if the DpRtStatus has no getPropertyList method, get the rest one at a time */
+	if(context->DpRt_Status_Get_Property_List_Method_Id == NULL)
+	{
+		for(i = 0; i < request_count; i++)
+		{
+			if(request_list[i].Error_Number != -1)
+				continue;
+			switch(request_list[i].Type)
+			{
+				case DPRT_JNI_PROPERTY_TYPE_STRING:
+					retval = DpRt_JNI_DpRtStatus_Get_Property(request_list[i].Keyword,
+										 &(request_list[i].String_Value));
+					break;
+				case DPRT_JNI_PROPERTY_TYPE_INTEGER:
+					retval = DpRt_JNI_DpRtStatus_Get_Property_Integer(request_list[i].Keyword,
+										 &(request_list[i].Integer_Value));
+					break;
+				case DPRT_JNI_PROPERTY_TYPE_DOUBLE:
+					retval = DpRt_JNI_DpRtStatus_Get_Property_Double(request_list[i].Keyword,
+										 &(request_list[i].Double_Value));
+					break;
+				case DPRT_JNI_PROPERTY_TYPE_BOOLEAN:
+				default:
+					retval = DpRt_JNI_DpRtStatus_Get_Property_Boolean(request_list[i].Keyword,
+										 &(request_list[i].Boolean_Value));
+					break;
+			}
+			/* the getters succeed even if the DpRtStatus method threw (e.g. NumberFormatException),
+			** clear it before the next upcall */
+			if((*env)->ExceptionCheck(env))
+			{
+				(*env)->ExceptionClear(env);
+				if((request_list[i].Type == DPRT_JNI_PROPERTY_TYPE_STRING)&&
+				   (request_list[i].String_Value != NULL))
+				{
+					free(request_list[i].String_Value);
+					request_list[i].String_Value = NULL;
+				}
+				DpRt_JNI_Error_Set(138,"DpRt_JNI_DpRtStatus_Get_Property_List:"
+					"Getting %s threw an exception.\n",request_list[i].Keyword);
+				request_list[i].Error_Number = 138;
+			}
+			/* getProperty returns null for keywords not in the property file */
+			else if(retval && (request_list[i].Type == DPRT_JNI_PROPERTY_TYPE_STRING)&&
+				(request_list[i].String_Value == NULL))
+				request_list[i].Error_Number = 55;
+			else if(retval)
+				request_list[i].Error_Number = 0;
+			else
+				request_list[i].Error_Number = DpRt_JNI_Error_Number;
+		}
+		return TRUE;
+	}
+/* create a String[] of the keywords not in the cache */
+	string_class = (*env)->FindClass(env,"java/lang/String");
+	DpRt_JNI_Local_Reference_Created(string_class);
+	if(string_class != NULL)
+	{
+		java_keyword_list = (*env)->NewObjectArray(env,missing_count,string_class,NULL);
+		DpRt_JNI_Local_Reference_Created(java_keyword_list);
+		DpRt_JNI_Delete_Local_Reference(env,string_class);
+	}
+	if(java_keyword_list == NULL)
+	{
+		DpRt_JNI_Error_Set(54,"DpRt_JNI_DpRtStatus_Get_Property_List:"
+			"Failed to create keyword list(%d).\n",missing_count);
+		for(i = 0; i < request_count; i++)
+		{
+			if(request_list[i].Error_Number == -1)
+				request_list[i].Error_Number = 54;
+		}
+		return FALSE;
+	}
+	missing_index = 0;
+	for(i = 0; i < request_count; i++)
+	{
+		if(request_list[i].Error_Number != -1)
+			continue;
+		java_string = (*env)->NewStringUTF(env,request_list[i].Keyword);
+		DpRt_JNI_Local_Reference_Created(java_string);
+		(*env)->SetObjectArrayElement(env,java_keyword_list,missing_index++,java_string);
+		DpRt_JNI_Delete_Local_Reference(env,java_string);
+	}
+/* call getPropertyList method on DpRt_Status instance */
+	java_value_list = (jobjectArray)((*env)->CallObjectMethod(env,context->DpRt_Status,
+								  context->DpRt_Status_Get_Property_List_Method_Id,
+								  java_keyword_list));
+	DpRt_JNI_Local_Reference_Created(java_value_list);
+	DpRt_JNI_Delete_Local_Reference(env,java_keyword_list);
+	if((*env)->ExceptionCheck(env))
+	{
+		(*env)->ExceptionClear(env);
+		if(java_value_list != NULL)
+			DpRt_JNI_Delete_Local_Reference(env,java_value_list);
+		DpRt_JNI_Error_Set(139,"DpRt_JNI_DpRtStatus_Get_Property_List:"
+			"getPropertyList threw an exception(%d).\n",missing_count);
+		for(i = 0; i < request_count; i++)
+		{
+			if(request_list[i].Error_Number == -1)
+				request_list[i].Error_Number = 139;
+		}
+		return FALSE;
+	}
+	if(java_value_list == NULL)
+	{
+		DpRt_JNI_Error_Set(121,"DpRt_JNI_DpRtStatus_Get_Property_List:"
+			"getPropertyList returned NULL(%d).\n",missing_count);
+		for(i = 0; i < request_count; i++)
+		{
+			if(request_list[i].Error_Number == -1)
+				request_list[i].Error_Number = 121;
+		}
+		return FALSE;
+	}
+	if((*env)->GetArrayLength(env,java_value_list) < missing_count)
+	{
+		DpRt_JNI_Error_Set(140,"DpRt_JNI_DpRtStatus_Get_Property_List:"
+			"getPropertyList returned %d values for %d keywords.\n",
+			(*env)->GetArrayLength(env,java_value_list),missing_count);
+		DpRt_JNI_Delete_Local_Reference(env,java_value_list);
+		for(i = 0; i < request_count; i++)
+		{
+			if(request_list[i].Error_Number == -1)
+				request_list[i].Error_Number = 140;
+		}
+		return FALSE;
+	}
+/* convert each returned value to the requested type */
+	missing_index = 0;
+	for(i = 0; i < request_count; i++)
+	{
+		if(request_list[i].Error_Number != -1)
+			continue;
+		java_string = (jstring)((*env)->GetObjectArrayElement(env,java_value_list,missing_index++));
+		DpRt_JNI_Local_Reference_Created(java_string);
+		c_value_string = NULL;
+		if(java_string != NULL)
+			c_value_string = (*env)->GetStringUTFChars(env,java_string,0);
+		if(c_value_string == NULL)
+			request_list[i].Error_Number = 55;
+		else
+		{
+			if(DpRt_JNI_Property_Request_Convert(&(request_list[i]),(char *)c_value_string))
+			{
+				request_list[i].Error_Number = 0;
+				DpRt_JNI_Status_Property_Cache_Put(request_list[i].Keyword,cache_generation,
+								   DPRT_JNI_PROPERTY_TYPE_STRING,&c_value_string);
+			}
+			else if(request_list[i].Type == DPRT_JNI_PROPERTY_TYPE_STRING)
+				request_list[i].Error_Number = 56;
+			else
+				request_list[i].Error_Number = 57;
+			(*env)->ReleaseStringUTFChars(env,java_string,c_value_string);
+		}
+		if(java_string != NULL)
+			DpRt_JNI_Delete_Local_Reference(env,java_string);
+	}
+	DpRt_JNI_Delete_Local_Reference(env,java_value_list);
+	return TRUE;
+}
+
+/* set property function pointers */
+/**
+ * Routine to set the function pointer that is called from <b>DpRt_Get_Property</b> .
+ * @see #DpRt_Get_Property
+ * @see #DpRt_JNI_Context_Struct
+ */
+void DpRt_JNI_Set_Property_Function_Pointer(int (*get_property_fp)(char *keyword,char **value_string))
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	context->DpRt_Data.DpRt_Get_Property_Function_Pointer = get_property_fp;
+	__atomic_add_fetch(&context->Property_Generation,1,__ATOMIC_RELEASE);
+}
+
+/**
+ * Routine to set the function pointer that is called from <b>DpRt_Get_Property_Integer</b> .
+ * @see #DpRt_Get_Property_Integer
+ * @see #DpRt_JNI_Context_Struct
+ */
+void DpRt_JNI_Set_Property_Integer_Function_Pointer(int (*get_property_integer_fp)(char *keyword,int *value))
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	context->DpRt_Data.DpRt_Get_Property_Integer_Function_Pointer = get_property_integer_fp;
+	__atomic_add_fetch(&context->Property_Generation,1,__ATOMIC_RELEASE);
+}
+
+/**
+ * Routine to set the function pointer that is called from <b>DpRt_Get_Property_Double</b> .
+ * @see #DpRt_Get_Property_Double
+ * @see #DpRt_JNI_Context_Struct
+ */
+void DpRt_JNI_Set_Property_Double_Function_Pointer(int (*get_property_double_fp)(char *keyword,double *value))
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	context->DpRt_Data.DpRt_Get_Property_Double_Function_Pointer = get_property_double_fp;
+	__atomic_add_fetch(&context->Property_Generation,1,__ATOMIC_RELEASE);
+}
+
+/**
+ * Routine to set the function pointer that is called from <b>DpRt_Get_Property_Boolean</b> .
+ * @see #DpRt_Get_Property_Boolean
+ * @see #DpRt_JNI_Context_Struct
+ */
+void DpRt_JNI_Set_Property_Boolean_Function_Pointer(int (*get_property_boolean_fp)(char *keyword,int *value))
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	context->DpRt_Data.DpRt_Get_Property_Boolean_Function_Pointer = get_property_boolean_fp;
+	__atomic_add_fetch(&context->Property_Generation,1,__ATOMIC_RELEASE);
+}
+
+/**
+ * Routine to set the function pointer that is called from <b>DpRt_Get_Property_List</b> .
+ * @see #DpRt_Get_Property_List
+ * @see #DpRt_JNI_Context_Struct
+ */
+void DpRt_JNI_Set_Property_List_Function_Pointer(int (*get_property_list_fp)(
+				struct DpRt_JNI_Property_Request_Struct *request_list,int request_count))
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	context->DpRt_Data.DpRt_Get_Property_List_Function_Pointer = get_property_list_fp;
+	__atomic_add_fetch(&context->Property_Generation,1,__ATOMIC_RELEASE);
+}
+
+/* command done */
+/**
+ * Routine to set the COMMAND_DONE return parameters for a JNI command.
+ * @param env The usual JNI parameter.
+ * @param cls The JNI class identifier to get the methods for.
+ * @param done The object to call the methods for.
+ * @param successful The value to set the COMMAND_DONE.successful to.
+ * @param error_number The value to set the COMMAND_DONE.errorNumber to.
+ * @param error_string The value to set the COMMAND_DONE.errorString to.
+ * @return TRUE if all the methods were called successfully, FALSE if a method call failed.
+ * @see #DpRt_JNI_Done_Class_Get
+ * @see #DpRt_JNI_Done_Method_Id_Get
+ */
+int DpRt_JNI_Set_Command_Done(JNIEnv *env,jclass cls,jobject done,
+					int successful,int error_number,char *error_string)
+{
+	jstring java_string = NULL;
+	jmethodID mid;
+	struct Done_Class_Struct *done_class = NULL;
+	unsigned long long latency_start;
+
+	latency_start = DpRt_JNI_Latency_Start();
+/* get this class's registered setter method IDs, resolving them the first time it is seen */
+	done_class = DpRt_JNI_Done_Class_Get(env,cls);
+
+	/* successful */
+	/* get the (registered) method id in this class */
+	mid = DpRt_JNI_Done_Method_Id_Get(env,cls,done_class,DONE_METHOD_SET_SUCCESSFUL);
+	/* did we find the method id? */
+	if (mid == 0)
+	{
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_SET_COMMAND_DONE,latency_start);
+		return FALSE;
+	}
+	/* call the method */
+	(*env)->CallVoidMethod(env,done,mid,successful);
+
+	/* error number */
+	/* get the (registered) method id in this class */
+	mid = DpRt_JNI_Done_Method_Id_Get(env,cls,done_class,DONE_METHOD_SET_ERROR_NUM);
+	/* did we find the method id? */
+	if (mid == 0)
+	{
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_SET_COMMAND_DONE,latency_start);
+		return FALSE;
+	}
+	/* call the method */
+	(*env)->CallVoidMethod(env,done,mid,error_number);
+
+	/* error string */
+	/* get the (registered) method id in this class */
+	mid = DpRt_JNI_Done_Method_Id_Get(env,cls,done_class,DONE_METHOD_SET_ERROR_STRING);
+	/* did we find the method id? */
+	if (mid == 0)
+	{
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_SET_COMMAND_DONE,latency_start);
+		return FALSE;
+	}
+	/* call the method */
+	java_string = (*env)->NewStringUTF(env,error_string);
+	DpRt_JNI_Local_Reference_Created(java_string);
+	(*env)->CallVoidMethod(env,done,mid,java_string);
+	DpRt_JNI_Delete_Local_Reference(env,java_string);
+
+	DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_SET_COMMAND_DONE,latency_start);
+	return TRUE;
+}
+
+/**
+ * Internal routine to set the REDUCE_DONE return parameters for a JNI command.
+ * @param env The usual JNI parameter.
+ * @param cls The JNI class identifier to get the methods for.
+ * @param done The object to call the methods for.
+ * @param output_filename The value to set the REDUCE_DONE.filename to.
+ * @return TRUE if all the methods were called successfully, FALSE if a method call failed.
+ * @see #DpRt_JNI_Done_Class_Get
+ * @see #DpRt_JNI_Done_Method_Id_Get
+ */
+int DpRt_JNI_Set_Reduce_Done(JNIEnv *env,jclass cls,jobject done,char *output_filename)
+{
+	jstring java_string = NULL;
+	jmethodID mid;
+	struct Done_Class_Struct *done_class = NULL;
+	unsigned long long latency_start;
+
+	latency_start = DpRt_JNI_Latency_Start();
+/* get this class's registered setter method IDs, resolving them the first time it is seen */
+	done_class = DpRt_JNI_Done_Class_Get(env,cls);
+
+	/* output_filename */
+	/* get the (registered) method id in this class */
+	mid = DpRt_JNI_Done_Method_Id_Get(env,cls,done_class,DONE_METHOD_SET_FILENAME);
+	/* did we find the method id? */
+	if (mid == 0)
+	{
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_SET_REDUCE_DONE,latency_start);
+		return FALSE;
+	}
+	/* call the method */
+	if(output_filename != NULL)
+	{
+		java_string = (*env)->NewStringUTF(env,output_filename);
+		DpRt_JNI_Local_Reference_Created(java_string);
+	}
+	(*env)->CallVoidMethod(env,done,mid,java_string);
+	DpRt_JNI_Delete_Local_Reference(env,java_string);
+	DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_SET_REDUCE_DONE,latency_start);
+	return TRUE;
+}
+
+/**
+ * Routine to set the reduce results of a REDUCE_DONE subclass in one Java call. If the done class has a 
+ * setReduceResults(double[] results,int resultSetMask) method, a double array of result_count elements, 
+ * indexed by the DPRT_JNI_REDUCE_RESULT_ defines, is passed to it with result_set_mask. The Java layer should
+ * only use the results whose bit is set in resultSetMask (unset results are passed as NaN), so a genuine NaN
+ * result is still distinguishable from an unset one. This keeps full double precision, and new results only 
+ * need a new index. Otherwise, each result whose bit is set in result_set_mask is set using it's individual 
+ * (float) setter method, whatever it's value. Either way, if a setter throws the routine fails with the 
+ * exception left pending.
+ * @param env The usual JNI parameter.
+ * @param cls The JNI class identifier to get the methods for.
+ * @param done The object to call the methods for.
+ * @param result_list A list of results, indexed by the DPRT_JNI_REDUCE_RESULT_ defines.
+ * @param result_count The number of elements in result_list. Only the first DPRT_JNI_REDUCE_RESULT_COUNT
+ *        are used.
+ * @param result_set_mask Which results in result_list are set, a bitwise OR of
+ *        DPRT_JNI_REDUCE_RESULT_BIT(index) for each result that is set.
+ * @return TRUE if all the methods were called successfully, FALSE if a method call failed.
+ * @see #DpRt_JNI_Done_Class_Get
+ * @see #DpRt_JNI_Done_Method_Id_Get
+ * @see #Reduce_Result_Method_List
+ * @see #DPRT_JNI_REDUCE_RESULT_COUNT
+ * @see #DPRT_JNI_REDUCE_RESULT_BIT
+ */
+int DpRt_JNI_Set_Reduce_Results(JNIEnv *env,jclass cls,jobject done,double *result_list,int result_count,
+				unsigned int result_set_mask)
+{
+	struct Done_Class_Struct *done_class = NULL;
+	jdoubleArray java_result_list = NULL;
+	jdouble java_result_list_value[DPRT_JNI_REDUCE_RESULT_COUNT];
+	jmethodID mid;
+	int i;
+
+	if((result_list == NULL)||(result_count < 0))
+	{
+		DpRt_JNI_Error_Set(142,"DpRt_JNI_Set_Reduce_Results:Illegal argument(%p,%d).\n",(void*)result_list,
+			result_count);
+		return FALSE;
+	}
+	/* result_set_mask only describes the results we know about */
+	if(result_count > DPRT_JNI_REDUCE_RESULT_COUNT)
+		result_count = DPRT_JNI_REDUCE_RESULT_COUNT;
+/* get this class's registered setter method IDs, resolving them the first time it is seen */
+	done_class = DpRt_JNI_Done_Class_Get(env,cls);
+	if((done_class != NULL)&&(done_class->Method_Id_List[DONE_METHOD_SET_REDUCE_RESULTS] != NULL))
+	{
+		/* one call to setReduceResults(double[],int) */
+		java_result_list = (*env)->NewDoubleArray(env,result_count);
+		if(java_result_list == NULL)
+		{
+			DpRt_JNI_Error_Set(143,"DpRt_JNI_Set_Reduce_Results:Failed to create result list(%d).\n",
+				result_count);
+			return FALSE;
+		}
+		DpRt_JNI_Local_Reference_Created(java_result_list);
+		for(i = 0; i < result_count; i++)
+		{
+			if(result_set_mask & DPRT_JNI_REDUCE_RESULT_BIT(i))
+				java_result_list_value[i] = result_list[i];
+			else
+				java_result_list_value[i] = NAN;
+		}
+		(*env)->SetDoubleArrayRegion(env,java_result_list,0,result_count,java_result_list_value);
+		(*env)->CallVoidMethod(env,done,done_class->Method_Id_List[DONE_METHOD_SET_REDUCE_RESULTS],
+				       java_result_list,(jint)result_set_mask);
+		DpRt_JNI_Delete_Local_Reference(env,java_result_list);
+		if((*env)->ExceptionCheck(env))
+		{
+			DpRt_JNI_Error_Set(144,"DpRt_JNI_Set_Reduce_Results:setReduceResults threw an exception.\n");
+			return FALSE;
+		}
+		return TRUE;
+	}
+	/* fall back to the individual setters */
+	for(i = 0; i < result_count; i++)
+	{
+		if((result_set_mask & DPRT_JNI_REDUCE_RESULT_BIT(i)) == 0)
+			continue;
+		/* get the (registered) method id in this class */
+		mid = DpRt_JNI_Done_Method_Id_Get(env,cls,done_class,Reduce_Result_Method_List[i]);
+		/* did we find the method id? */
+		if (mid == 0)
+			return FALSE;
+		/* call the method */
+		if(i == DPRT_JNI_REDUCE_RESULT_SATURATED)
+			(*env)->CallVoidMethod(env,done,mid,(jboolean)(result_list[i] != 0.0));
+		else
+			(*env)->CallVoidMethod(env,done,mid,(float)(result_list[i]));
+		/* don't make further calls with an exception pending */
+		if((*env)->ExceptionCheck(env))
+		{
+			DpRt_JNI_Error_Set(145,"DpRt_JNI_Set_Reduce_Results:Result setter %d threw an exception.\n",i);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to pass a source catalogue to an EXPOSE_REDUCE_DONE (or subclass) in one Java call.
+ * The catalogue's columns are packed, column after column, into one direct ByteBuffer allocated by
+ * ByteBuffer.allocateDirect, which is passed to the done class's 
+ * setSourceCatalogue(int sourceCount,ByteBuffer columns) method. The layout is:
+ * DPRT_JNI_SOURCE_CATALOGUE_DOUBLE_COLUMN_COUNT columns of sourceCount doubles 
+ * (indexed by the DPRT_JNI_SOURCE_CATALOGUE_COLUMN_ defines), followed by sourceCount ints of flags.
+ * Values are in native byte order, so the Java layer must call order(ByteOrder.nativeOrder()) on the buffer.
+ * The buffer's memory is owned by the JVM, so the Java layer may keep the buffer after the call.
+ * If sourceCount is 0 the buffer is null.
+ * @param env The usual JNI parameter.
+ * @param cls The JNI class identifier to get the methods for.
+ * @param done The object to call the methods for.
+ * @param catalogue The source catalogue.
+ * @return TRUE if the method was called successfully, FALSE if a method call failed.
+ * @see #DpRt_JNI_Done_Class_Get
+ * @see #DpRt_JNI_Done_Method_Id_Get
+ * @see #DPRT_JNI_SOURCE_CATALOGUE_COLUMN_X_PIX
+ */
+int DpRt_JNI_Set_Source_Catalogue(JNIEnv *env,jclass cls,jobject done,
+				  struct DpRt_JNI_Source_Catalogue_Struct *catalogue)
+{
+	struct Done_Class_Struct *done_class = NULL;
+	double *column_list[DPRT_JNI_SOURCE_CATALOGUE_DOUBLE_COLUMN_COUNT];
+	jclass byte_buffer_class = NULL;
+	jmethodID allocate_direct_mid;
+	jobject java_buffer = NULL;
+	char *buffer = NULL;
+	size_t buffer_length,column_length;
+	jmethodID mid;
+	int i;
+
+	if(catalogue == NULL)
+	{
+		DpRt_JNI_Error_Set(146,"DpRt_JNI_Set_Source_Catalogue:catalogue was NULL.\n");
+		return FALSE;
+	}
+	if(catalogue->Source_Count < 0)
+	{
+		DpRt_JNI_Error_Set(147,"DpRt_JNI_Set_Source_Catalogue:Illegal source count %d.\n",
+			catalogue->Source_Count);
+		return FALSE;
+	}
+/* get this class's registered setter method IDs, resolving them the first time it is seen */
+	done_class = DpRt_JNI_Done_Class_Get(env,cls);
+	mid = DpRt_JNI_Done_Method_Id_Get(env,cls,done_class,DONE_METHOD_SET_SOURCE_CATALOGUE);
+	if (mid == 0)
+		return FALSE;
+	if(catalogue->Source_Count > 0)
+	{
+		column_list[DPRT_JNI_SOURCE_CATALOGUE_COLUMN_X_PIX] = catalogue->X_Pix;
+		column_list[DPRT_JNI_SOURCE_CATALOGUE_COLUMN_Y_PIX] = catalogue->Y_Pix;
+		column_list[DPRT_JNI_SOURCE_CATALOGUE_COLUMN_FLUX] = catalogue->Flux;
+		column_list[DPRT_JNI_SOURCE_CATALOGUE_COLUMN_FWHM] = catalogue->FWHM;
+		column_list[DPRT_JNI_SOURCE_CATALOGUE_COLUMN_ELLIPTICITY] = catalogue->Ellipticity;
+		for(i = 0; i < DPRT_JNI_SOURCE_CATALOGUE_DOUBLE_COLUMN_COUNT; i++)
+		{
+			if(column_list[i] == NULL)
+			{
+				DpRt_JNI_Error_Set(148,"DpRt_JNI_Set_Source_Catalogue:Column %d was NULL.\n",i);
+				return FALSE;
+			}
+		}
+		if(catalogue->Flags == NULL)
+		{
+			DpRt_JNI_Error_Set(149,"DpRt_JNI_Set_Source_Catalogue:Flags was NULL.\n");
+			return FALSE;
+		}
+		column_length = ((size_t)catalogue->Source_Count)*sizeof(double);
+		buffer_length = (DPRT_JNI_SOURCE_CATALOGUE_DOUBLE_COLUMN_COUNT*column_length)+
+			(((size_t)catalogue->Source_Count)*sizeof(int));
+		if(buffer_length > INT_MAX)
+		{
+			DpRt_JNI_Error_Set(150,"DpRt_JNI_Set_Source_Catalogue:Catalogue too large(%d,%lu).\n",
+				catalogue->Source_Count,(unsigned long)buffer_length);
+			return FALSE;
+		}
+	/* allocate a JVM owned direct buffer, so it stays valid for as long as Java keeps it */
+		byte_buffer_class = (*env)->FindClass(env,"java/nio/ByteBuffer");
+		if(byte_buffer_class == NULL)
+		{
+			DpRt_JNI_Error_Set(151,"DpRt_JNI_Set_Source_Catalogue:Failed to find ByteBuffer class.\n");
+			return FALSE;
+		}
+		DpRt_JNI_Local_Reference_Created(byte_buffer_class);
+		allocate_direct_mid = (*env)->GetStaticMethodID(env,byte_buffer_class,"allocateDirect",
+								 "(I)Ljava/nio/ByteBuffer;");
+		if(allocate_direct_mid != 0)
+		{
+			java_buffer = (*env)->CallStaticObjectMethod(env,byte_buffer_class,allocate_direct_mid,
+								     (jint)buffer_length);
+			DpRt_JNI_Local_Reference_Created(java_buffer);
+		}
+		DpRt_JNI_Delete_Local_Reference(env,byte_buffer_class);
+		if(java_buffer == NULL)
+		{
+			DpRt_JNI_Error_Set(152,"DpRt_JNI_Set_Source_Catalogue:ByteBuffer.allocateDirect(%lu) failed.\n",
+				(unsigned long)buffer_length);
+			return FALSE;
+		}
+		buffer = (char *)((*env)->GetDirectBufferAddress(env,java_buffer));
+		if(buffer == NULL)
+		{
+			DpRt_JNI_Delete_Local_Reference(env,java_buffer);
+			DpRt_JNI_Error_Set(153,"DpRt_JNI_Set_Source_Catalogue:Failed to get direct buffer address.\n");
+			return FALSE;
+		}
+	/* pack the columns */
+		for(i = 0; i < DPRT_JNI_SOURCE_CATALOGUE_DOUBLE_COLUMN_COUNT; i++)
+			memcpy(buffer+(i*column_length),column_list[i],column_length);
+		memcpy(buffer+(DPRT_JNI_SOURCE_CATALOGUE_DOUBLE_COLUMN_COUNT*column_length),catalogue->Flags,
+		       ((size_t)catalogue->Source_Count)*sizeof(int));
+	}
+	/* call the method */
+	(*env)->CallVoidMethod(env,done,mid,(jint)catalogue->Source_Count,java_buffer);
+	DpRt_JNI_Delete_Local_Reference(env,java_buffer);
+	if((*env)->ExceptionCheck(env))
+	{
+		DpRt_JNI_Error_Set(154,"DpRt_JNI_Set_Source_Catalogue:setSourceCatalogue threw an exception.\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to pass a frame to a REDUCE_DONE (or subclass), without writing it to disk or copying it.
+ * The frame is wrapped in a direct ByteBuffer (see DpRt_JNI_Frame_New_Buffer) and passed with it's handle 
+ * to the done class's setFrame(int frameHandle,ByteBuffer frame) method. The buffer holds a reference to
+ * the frame, which the Java layer must release (DpRt_JNI_Frame_Release, via the instrument's JNI interface)
+ * when it has finished with the buffer. The caller's own reference is not affected.
+ * @param env The usual JNI parameter.
+ * @param cls The JNI class identifier to get the methods for.
+ * @param done The object to call the methods for.
+ * @param frame_handle The handle of the frame.
+ * @return TRUE if the method was called successfully, FALSE if a method call failed.
+ * @see #DpRt_JNI_Frame_New_Buffer
+ * @see #DpRt_JNI_Done_Class_Get
+ * @see #DpRt_JNI_Done_Method_Id_Get
+ */
+int DpRt_JNI_Set_Reduce_Frame(JNIEnv *env,jclass cls,jobject done,int frame_handle)
+{
+	struct Done_Class_Struct *done_class = NULL;
+	jobject java_buffer = NULL;
+	jmethodID mid;
+
+/* get this class's registered setter method IDs, resolving them the first time it is seen */
+	done_class = DpRt_JNI_Done_Class_Get(env,cls);
+	mid = DpRt_JNI_Done_Method_Id_Get(env,cls,done_class,DONE_METHOD_SET_FRAME);
+	if (mid == 0)
+		return FALSE;
+	java_buffer = DpRt_JNI_Frame_New_Buffer(env,frame_handle);
+	if(java_buffer == NULL)
+		return FALSE;
+	/* call the method */
+	(*env)->CallVoidMethod(env,done,mid,(jint)frame_handle,java_buffer);
+	DpRt_JNI_Delete_Local_Reference(env,java_buffer);
+	if((*env)->ExceptionCheck(env))
+	{
+		/* Java did not take ownership of the buffer's reference */
+		DpRt_JNI_Frame_Release(frame_handle);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to set the CALIBRATE_REDUCE_DONE return parameters for a JNI command.
+ * The results are set using DpRt_JNI_Set_Reduce_Results.
+ * @param env The usual JNI parameter.
+ * @param cls The JNI class identifier to get the methods for.
+ * @param done The object to call the methods for. Should be an instance of CALIBRATE_REDUCE_DONE.
+ * @param mean_counts The mean counts parameter.
+ * @param peak_counts The peak counts parameter.
+ * @return TRUE if all the methods were called successfully, FALSE if a method call failed.
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+int DpRt_JNI_Set_Calibrate_Reduce_Done(JNIEnv *env,jclass cls,jobject done,
+					double mean_counts,double peak_counts)
+{
+	double result_list[DPRT_JNI_REDUCE_RESULT_COUNT];
+	int i,retval;
+	unsigned long long latency_start;
+
+	latency_start = DpRt_JNI_Latency_Start();
+	for(i = 0; i < DPRT_JNI_REDUCE_RESULT_COUNT; i++)
+		result_list[i] = NAN;
+	result_list[DPRT_JNI_REDUCE_RESULT_MEAN_COUNTS] = mean_counts;
+	result_list[DPRT_JNI_REDUCE_RESULT_PEAK_COUNTS] = peak_counts;
+	retval = DpRt_JNI_Set_Reduce_Results(env,cls,done,result_list,DPRT_JNI_REDUCE_RESULT_COUNT,
+					     DPRT_JNI_REDUCE_RESULT_BIT(DPRT_JNI_REDUCE_RESULT_MEAN_COUNTS)|
+					     DPRT_JNI_REDUCE_RESULT_BIT(DPRT_JNI_REDUCE_RESULT_PEAK_COUNTS));
+	DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_SET_CALIBRATE_REDUCE_DONE,latency_start);
+	return retval;
+}
+
+/**
+ * Routine to set the EXPOSE_REDUCE_DONE return parameters for a JNI command.
+ * The results are set using DpRt_JNI_Set_Reduce_Results.
+ * @param env The usual JNI parameter.
+ * @param cls The JNI class identifier to get the methods for.
+ * @param done The object to call the methods for. Should be an instance of EXPOSE_REDUCE_DONE.
+ * @param seeing The seeing parameter.
+ * @param counts The counts of the brightest object parameter.
+ * @param x_pix The X position in pixels of the brightest object.
+ * @param y_pix The Y position in pixels of the brightest object.
+ * @param photometricity A measure of the photometricity of the field (if a standard).
+ * @param sky_brightness A measure of the sky brightness.
+ * @param saturated An integer (boolean), set to TRUE if the field contains saturated stars.
+ * @return TRUE if all the methods were called successfully, FALSE if a method call failed.
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+int DpRt_JNI_Set_Expose_Reduce_Done(JNIEnv *env,jclass cls,jobject done,double seeing,double counts,
+				    double x_pix,double y_pix,double photometricity,
+				    double sky_brightness,int saturated)
+{
+	double result_list[DPRT_JNI_REDUCE_RESULT_COUNT];
+	int i,retval;
+	unsigned long long latency_start;
+
+	latency_start = DpRt_JNI_Latency_Start();
+	for(i = 0; i < DPRT_JNI_REDUCE_RESULT_COUNT; i++)
+		result_list[i] = NAN;
+	result_list[DPRT_JNI_REDUCE_RESULT_SEEING] = seeing;
+	result_list[DPRT_JNI_REDUCE_RESULT_COUNTS] = counts;
+	result_list[DPRT_JNI_REDUCE_RESULT_X_PIX] = x_pix;
+	result_list[DPRT_JNI_REDUCE_RESULT_Y_PIX] = y_pix;
+	result_list[DPRT_JNI_REDUCE_RESULT_PHOTOMETRICITY] = photometricity;
+	result_list[DPRT_JNI_REDUCE_RESULT_SKY_BRIGHTNESS] = sky_brightness;
+	if(saturated)
+		result_list[DPRT_JNI_REDUCE_RESULT_SATURATED] = 1.0;
+	else
+		result_list[DPRT_JNI_REDUCE_RESULT_SATURATED] = 0.0;
+	retval = DpRt_JNI_Set_Reduce_Results(env,cls,done,result_list,DPRT_JNI_REDUCE_RESULT_COUNT,
+					     DPRT_JNI_REDUCE_RESULT_BIT(DPRT_JNI_REDUCE_RESULT_SEEING)|
+					     DPRT_JNI_REDUCE_RESULT_BIT(DPRT_JNI_REDUCE_RESULT_COUNTS)|
+					     DPRT_JNI_REDUCE_RESULT_BIT(DPRT_JNI_REDUCE_RESULT_X_PIX)|
+					     DPRT_JNI_REDUCE_RESULT_BIT(DPRT_JNI_REDUCE_RESULT_Y_PIX)|
+					     DPRT_JNI_REDUCE_RESULT_BIT(DPRT_JNI_REDUCE_RESULT_PHOTOMETRICITY)|
+					     DPRT_JNI_REDUCE_RESULT_BIT(DPRT_JNI_REDUCE_RESULT_SKY_BRIGHTNESS)|
+					     DPRT_JNI_REDUCE_RESULT_BIT(DPRT_JNI_REDUCE_RESULT_SATURATED));
+	DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_SET_EXPOSE_REDUCE_DONE,latency_start);
+	return retval;
+}
+
+/**
+ * Routine to remove the done class registry, deleting the global class references.
+ * This must only be called when no thread is setting done parameters, e.g. as the library is finalised.
+ * @param env The JNI environment pointer.
+ * @see #Done_Class_List
+ */
+void DpRt_JNI_Finalise_Done_Class_References(JNIEnv *env)
+{
+	struct Done_Class_Struct *done_class = NULL;
+	struct Done_Class_Struct *next_done_class = NULL;
+
+	pthread_mutex_lock(&Done_Class_Lock);
+	done_class = Done_Class_List;
+	__atomic_store_n(&Done_Class_List,NULL,__ATOMIC_RELEASE);
+	pthread_mutex_unlock(&Done_Class_Lock);
+	while(done_class != NULL)
+	{
+		next_done_class = done_class->Next;
+		(*env)->DeleteGlobalRef(env,done_class->Class);
+		free(done_class);
+		done_class = next_done_class;
+	}
+}
+
+/* exception handling */
+/**
+ * This routine throws an exception. The error generated is from the error codes in dprt, it assumes
+ * another routine has generated an error and this routine packs this error into an exception to return
+ * to the Java code, using DpRt_JNI_Throw_Exception_String. The total length of the error string should
+ * not be longer than DPRT_ERROR_STRING_LENGTH. A new line is added to the start of the error string,
+ * so that the error string returned from libdprt is formatted properly.
+ * @param env The JNI environment pointer.
+ * @param function_name The name of the function in which this exception is being generated for.
+ * @see #DpRt_JNI_Get_Error_Number
+ * @see #DpRt_JNI_Get_Error_String
+ * @see #DpRt_JNI_Throw_Exception_String
+ * @see #DPRT_ERROR_STRING_LENGTH
+ */
+void DpRt_JNI_Throw_Exception(JNIEnv *env,char *function_name)
+{
+	char error_string[DPRT_ERROR_STRING_LENGTH];
+	int error_number;
+
+	error_number = DpRt_JNI_Get_Error_Number();
+	strcpy(error_string,"\n");
+	DpRt_JNI_Get_Error_String(error_string+strlen(error_string));
+	DpRt_JNI_Throw_Exception_String(env,function_name,error_number,error_string);
+}
+
+/**
+ * This routine throws an exception of class ngat.dprt.ccs.DpRtLibraryNativeException. This is used to report
+ * all libdprt error messages back to the Java layer.
+ * @param env The JNI environment pointer.
+ * @param function_name The name of the function in which this exception is being generated for.
+ * @param error_number The error number to pass to the constructor of the exception.
+ * @param error_string The string to pass to the constructor of the exception.
+ * @see #DpRt_JNI_Error_Number
+ * @see #DpRt_JNI_Error_String
+ */
+void DpRt_JNI_Throw_Exception_String(JNIEnv *env,char *function_name,int error_number,char *error_string)
+{
+	jclass exception_class = NULL;
+	jobject exception_instance = NULL;
+	jstring error_jstring = NULL;
+	jstring dprt_library_error_jstring = NULL;
+	jmethodID mid;
+	int retval;
+	unsigned long long latency_start;
+
+	latency_start = DpRt_JNI_Latency_Start();
+	exception_class = (*env)->FindClass(env,"ngat/dprt/DpRtLibraryNativeException");
+	DpRt_JNI_Local_Reference_Created(exception_class);
+	if(exception_class == NULL)
+	{
+		fprintf(stderr,"DpRt_JNI_Throw_Exception_String:FindClass failed:%s:%d:%s\n",function_name,
+			error_number,error_string);
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_THROW_EXCEPTION_STRING,latency_start);
+		return;
+	}
+/* get ngat.dprt.DpRtLibraryNativeException(int errorNumber,String errorString) constructor */
+	mid = (*env)->GetMethodID(env,exception_class,"<init>","(ILjava/lang/String;ILjava/lang/String;)V");
+	if(mid == 0)
+	{
+		/* One of the following exceptions has been thrown:
+		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
+		fprintf(stderr,"DpRt_JNI_Throw_Exception_String:GetMethodID failed:%s:%s\n",function_name,
+			error_string);
+		DpRt_JNI_Delete_Local_Reference(env,exception_class);
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_THROW_EXCEPTION_STRING,latency_start);
+		return;
+	}
+/* convert error_string to JString */
+	error_jstring = (*env)->NewStringUTF(env,error_string);
+	DpRt_JNI_Local_Reference_Created(error_jstring);
+	dprt_library_error_jstring = (*env)->NewStringUTF(env,DpRt_JNI_Error_String);
+	DpRt_JNI_Local_Reference_Created(dprt_library_error_jstring);
+/* call constructor */
+	exception_instance = (*env)->NewObject(env,exception_class,mid,(jint)DpRt_JNI_Error_Number,
+					       dprt_library_error_jstring,
+					       (jint)error_number,error_jstring);
+	DpRt_JNI_Local_Reference_Created(exception_instance);
+	DpRt_JNI_Delete_Local_Reference(env,error_jstring);
+	DpRt_JNI_Delete_Local_Reference(env,dprt_library_error_jstring);
+	DpRt_JNI_Delete_Local_Reference(env,exception_class);
+	if(exception_instance == NULL)
+	{
+		/* One of the following exceptions has been thrown:
+		** InstantiationException, OutOfMemoryError */
+		fprintf(stderr,"DpRt_JNI_Throw_Exception_String:NewObject failed %s:%d:%s:%d:%s\n",
+			function_name,DpRt_JNI_Error_Number,DpRt_JNI_Error_String,error_number,error_string);
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_THROW_EXCEPTION_STRING,latency_start);
+		return;
+	}
+/* throw instance */
+	retval = (*env)->Throw(env,(jthrowable)exception_instance);
+	if(retval !=0)
+	{
+		fprintf(stderr,"DpRt_JNI_Throw_Exception_String:Throw failed %d:%s:%d:%s:%d:%s\n",retval,
+			function_name,DpRt_JNI_Error_Number,DpRt_JNI_Error_String,error_number,error_string);
+	}
+/* the pending exception is held by the JVM, our local reference to it is no longer needed */
+	DpRt_JNI_Delete_Local_Reference(env,exception_instance);
+	DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_THROW_EXCEPTION_STRING,latency_start);
+}
+
+/**
+ * libdprt Log Handler for the Java layer interface. This calls the ngat.dprt.ccs.DpRtLibrary logger's 
+ * log(int level,String message) method with the parameters supplied to this routine.
+ * If the Logger instance is NULL, or the Log_Method_Id is NULL the call is not made.
+ * If a log filter function has been set, and it returns FALSE for this message, the call is not made.
+ * If a log record handler has been set, the sub_system, source_filename, function and category are interned,
+ * and the record is sent to the handler's log method as integer IDs plus the message instead.
+ * If the asynchronous log queue is running, the message is copied into the queue and this routine returns
+ * immediately, the log queue thread calls log() later.
+ * Otherwise, A java.lang.String instance is constructed from the string parameter,
+ * and the JNI CallVoidMEthod routine called to call log().
+ * @param sub_system The sub system. Can be NULL.
+ * @param source_file The source filename. Can be NULL.
+ * @param function The function calling the log. Can be NULL.
+ * @param level The log level of the message.(TERSE/high level or VERBOSE/low level), 
+ *         a valid member of LOG_VERBOSITY.
+ * @param category What sort of information is the message. Designed to be used as a filter. Can be NULL.
+ * @param string The message to log.
+ * @see #Java_VM
+ * @see #DpRt_JNI_Context_Struct
+ * @see #Log_Method_Id
+ * @see #DpRt_JNI_Context_Struct
+ * @see #Log_Record_Handler
+ * @see #DpRt_JNI_Log_Intern
+ * @see #Log_Queue
+ * @see #DpRt_JNI_Log_Queue_Put
+ * @see #DpRt_JNI_Log_Deliver
+ */
+void DpRt_JNI_Log_Handler(char* sub_system,char* source_filename,char* function,int level,char* category,char *string)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	int (*filter_function)(char *sub_system,char *source_filename,char *function,int level,char *category,
+			       char *string) = NULL;
+	JNIEnv *env = NULL;
+	int sub_system_id = 0,source_filename_id = 0,function_id = 0,category_id = 0;
+	unsigned long long latency_start;
+
+	latency_start = DpRt_JNI_Latency_Start();
+	context = DpRt_JNI_Context_Get_Current();
+	if(context->Logger == NULL)
+	{
+		fprintf(stderr,"DpRt_JNI_Log_Handler:Logger was NULL (%d,%s).\n",level,string);
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_LOG_HANDLER,latency_start);
+		return;
+	}
+	if(Log_Method_Id == NULL)
+	{
+		fprintf(stderr,"DpRt_JNI_Log_Handler:Log_Method_Id was NULL (%d,%s).\n",level,string);
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_LOG_HANDLER,latency_start);
+		return;
+	}
+	if(Java_VM == NULL)
+	{
+		fprintf(stderr,"DpRt_JNI_Log_Handler:Java_VM was NULL (%d,%s).\n",level,string);
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_LOG_HANDLER,latency_start);
+		return;
+	}
+	if(string == NULL)
+	{
+		fprintf(stderr,"DpRt_JNI_Log_Handler:string (%d) was NULL.\n",level);
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_LOG_HANDLER,latency_start);
+		return;
+	}
+/* discard messages the Java logger would not emit, before marshalling them */
+	filter_function = __atomic_load_n(&(context->Log_Filter_Function),__ATOMIC_ACQUIRE);
+	if((filter_function != NULL)&&
+	   (filter_function(sub_system,source_filename,function,level,category,string) == FALSE))
+	{
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_LOG_HANDLER,latency_start);
+		return;
+	}
+/* if there is a structured log record handler, intern the record's metadata */
+	if(__atomic_load_n(&Log_Record_Handler,__ATOMIC_ACQUIRE) != NULL)
+	{
+		sub_system_id = DpRt_JNI_Log_Intern(sub_system);
+		source_filename_id = DpRt_JNI_Log_Intern(source_filename);
+		function_id = DpRt_JNI_Log_Intern(function);
+		category_id = DpRt_JNI_Log_Intern(category);
+	}
+/* if the log queue is running, queue the record for the log queue thread to deliver */
+	if(__atomic_load_n(&Log_Queue.Running,__ATOMIC_ACQUIRE))
+	{
+		if(DpRt_JNI_Log_Queue_Put(context->Logger,level,sub_system_id,source_filename_id,function_id,
+					  category_id,string))
+		{
+			DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_LOG_HANDLER,latency_start);
+			return;
+		}
+	}
+/* get (cached) java env for this thread */
+	env = DpRt_JNI_Get_Env(NULL);
+	if(env == NULL)
+	{
+		fprintf(stderr,"DpRt_JNI_Log_Handler:env was NULL (%d,%s).\n",level,string);
+		DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_LOG_HANDLER,latency_start);
+		return;
+	}
+	DpRt_JNI_Log_Deliver(env,context->Logger,level,sub_system_id,source_filename_id,function_id,category_id,string);
+	DpRt_JNI_Latency_Record(DPRT_JNI_LATENCY_PROBE_LOG_HANDLER,latency_start);
+}
+
+/**
+ * Routine to intern a log string (sub-system, source filename, function or category name). 
+ * Each distinct string is given an integer ID once, which is what is sent to the Java log record handler
+ * per record. The string's address is looked up in a lock-free pointer cache first (these strings are 
+ * usually literals); otherwise the string is hashed and looked up (or added) in the interned string table.
+ * @param string The string to intern. Can be NULL.
+ * @return The string's ID (greater than 0), or 0 if string is NULL, or the table is full or 
+ *         a memory allocation failed.
+ * @see #Log_String_List
+ * @see #Log_String_Cache
+ * @see #LOG_STRING_MAX_COUNT
+ */
+int DpRt_JNI_Log_Intern(char *string)
+{
+	struct Log_String_Cache_Entry_Struct *cache_entry = NULL;
+	char *cache_pointer = NULL;
+	unsigned int hash,cache_index;
+	int i,id;
+
+	if(string == NULL)
+		return 0;
+/* lock-free pointer cache lookup */
+	cache_index = (unsigned int)((((uintptr_t)string)>>3)*2654435761U);
+	for(i = 0; i < LOG_STRING_CACHE_PROBE_COUNT; i++)
+	{
+		cache_entry = &(Log_String_Cache[(cache_index+i)&(LOG_STRING_CACHE_LENGTH-1)]);
+		cache_pointer = __atomic_load_n(&(cache_entry->Pointer),__ATOMIC_ACQUIRE);
+		if(cache_pointer == NULL)
+			break;
+		if(cache_pointer == string)
+		{
+			id = cache_entry->Id;
+			/* the caller may re-use a buffer for different strings, so check the contents too */
+			if(strcmp(Log_String_List[id-1].String,string) == 0)
+				return id;
+			break;
+		}
+	}
+/* hash table lookup */
+	hash = DpRt_JNI_Property_Hash(string,strlen(string));
+	pthread_mutex_lock(&Log_String_Lock);
+	id = Log_String_Bucket_List[hash%LOG_STRING_BUCKET_COUNT];
+	while((id != 0)&&((Log_String_List[id-1].Hash != hash)||(strcmp(Log_String_List[id-1].String,string) != 0)))
+		id = Log_String_List[id-1].Next;
+	if(id == 0)
+	{
+		if(Log_String_Count >= LOG_STRING_MAX_COUNT)
+		{
+			pthread_mutex_unlock(&Log_String_Lock);
+			return 0;
+		}
+		Log_String_List[Log_String_Count].String = strdup(string);
+		if(Log_String_List[Log_String_Count].String == NULL)
+		{
+			pthread_mutex_unlock(&Log_String_Lock);
+			return 0;
+		}
+		Log_String_List[Log_String_Count].Hash = hash;
+		Log_String_List[Log_String_Count].Registered = LOG_STRING_UNREGISTERED;
+		Log_String_List[Log_String_Count].Next = Log_String_Bucket_List[hash%LOG_STRING_BUCKET_COUNT];
+		Log_String_Count++;
+		id = Log_String_Count;
+		Log_String_Bucket_List[hash%LOG_STRING_BUCKET_COUNT] = id;
+	}
+/* add/update the pointer cache entry. The ID is written before the pointer is published. */
+	for(i = 0; i < LOG_STRING_CACHE_PROBE_COUNT; i++)
+	{
+		cache_entry = &(Log_String_Cache[(cache_index+i)&(LOG_STRING_CACHE_LENGTH-1)]);
+		cache_pointer = __atomic_load_n(&(cache_entry->Pointer),__ATOMIC_ACQUIRE);
+		if(cache_pointer == NULL)
+		{
+			cache_entry->Id = id;
+			__atomic_store_n(&(cache_entry->Pointer),string,__ATOMIC_RELEASE);
+			break;
+		}
+		if(cache_pointer == string)
+			break; /* re-used buffer, leave the entry alone, the contents check will miss */
+	}
+	pthread_mutex_unlock(&Log_String_Lock);
+	return id;
+}
+
+/**
+ * Routine to set the Java object structured log records are sent to. When set, DpRt_JNI_Log_Handler sends
+ * the record's sub-system, source filename, function and category as interned integer IDs to the handler's
+ * log(int level,int subSystemId,int sourceFilenameId,int functionId,int categoryId,String message) method, 
+ * rather than calling the logger. Each ID is sent once, before the first record using it, to the handler's 
+ * registerLogString(int id,String string) method. ID 0 means none.
+ * If the methods cannot be found, the handler is not set and a Java exception is left pending.
+ * @param env The JNI environment pointer.
+ * @param obj The instance of DpRtLibrary that called this routine.
+ * @param handler The log record handler object.
+ * @see #Log_Record_Handler
+ * @see #Log_Record_Handler_Register_Method_Id
+ * @see #Log_Record_Handler_Log_Method_Id
+ */
+void DpRt_JNI_Initialise_Log_Record_Handler_Reference(JNIEnv *env,jobject obj,jobject handler)
+{
+	jclass cls = NULL;
+	jmethodID register_method_id = NULL,log_method_id = NULL;
+
+	cls = (*env)->GetObjectClass(env,handler);
+	if(cls == NULL)
+		return;
+	register_method_id = (*env)->GetMethodID(env,cls,"registerLogString","(ILjava/lang/String;)V");
+	if(register_method_id == NULL)
+		return;
+	log_method_id = (*env)->GetMethodID(env,cls,"log","(IIIIILjava/lang/String;)V");
+	if(log_method_id == NULL)
+		return;
+	DpRt_JNI_Log_Record_Handler_Replace(env,(*env)->NewGlobalRef(env,handler),register_method_id,log_method_id);
+}
+
+/**
+ * Routine to remove the structured log record handler. Subsequent records are sent to the logger.
+ * If the asynchronous log queue is running, it should be stopped first, so queued records are delivered.
+ * This routine waits for threads still calling the handler, so it must not be called from the handler.
+ * @param env The JNI environment pointer.
+ * @see #Log_Record_Handler
+ * @see #DpRt_JNI_Log_Record_Handler_Replace
+ */
+void DpRt_JNI_Finalise_Log_Record_Handler_Reference(JNIEnv *env)
+{
+	DpRt_JNI_Log_Record_Handler_Replace(env,NULL,NULL,NULL);
+}
+
+/**
+ * printf-style logging routine. The log filter function (if set) is called with a NULL string before the
+ * message is formatted, so a message the Java logger would discard costs no formatting or JNI calls.
+ * Otherwise the message is formatted (into a stack buffer if it fits) and passed to DpRt_JNI_Log_Handler.
+ * @param sub_system The sub system. Can be NULL.
+ * @param source_filename The source filename. Can be NULL.
+ * @param function The function calling the log. Can be NULL.
+ * @param level At what level is the log message (TERSE/high level or VERBOSE/low level), 
+ *         a valid member of LOG_VERBOSITY.
+ * @param category What sort of information is the message. Designed to be used as a filter. Can be NULL.
+ * @param format A printf style format string.
+ * @param ... Arguments for the format string.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Log_Handler
+ * @see #LOG_QUEUE_MESSAGE_LENGTH
+ */
+void DpRt_JNI_Log_Format(char *sub_system,char *source_filename,char *function,int level,char *category,
+			 char *format,...)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	int (*filter_function)(char *sub_system,char *source_filename,char *function,int level,char *category,
+			       char *string) = NULL;
+	char buff[LOG_QUEUE_MESSAGE_LENGTH];
+	char *string = NULL;
+	va_list ap;
+	int length;
+
+	if(format == NULL)
+	{
+		fprintf(stderr,"DpRt_JNI_Log_Format:format (%d) was NULL.\n",level);
+		return;
+	}
+	context = DpRt_JNI_Context_Get_Current();
+	filter_function = __atomic_load_n(&(context->Log_Filter_Function),__ATOMIC_ACQUIRE);
+	if((filter_function != NULL)&&
+	   (filter_function(sub_system,source_filename,function,level,category,NULL) == FALSE))
+		return;
+/* format the message */
+	va_start(ap,format);
+	length = vsnprintf(buff,LOG_QUEUE_MESSAGE_LENGTH,format,ap);
+	va_end(ap);
+	if(length < 0)
+		return;
+	string = buff;
+	if(length >= LOG_QUEUE_MESSAGE_LENGTH)
+	{
+		string = (char *)malloc(length+1);
+		if(string == NULL)
+			string = buff; /* log the truncated message */
+		else
+		{
+			va_start(ap,format);
+			vsnprintf(string,length+1,format,ap);
+			va_end(ap);
+		}
+	}
+	DpRt_JNI_Log_Handler(sub_system,source_filename,function,level,category,string);
+	if(string != buff)
+		free(string);
+}
+
+/**
+ * Routine to set the current context's native copy of the Java logger's level threshold. 
+ * The Java layer should call this (via the instrument's JNI interface) whenever the logger's level changes.
+ * @param level The log level to filter against.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Log_Filter_Level_Absolute
+ * @see #DpRt_JNI_Log_Filter_Level_Bitwise
+ */
+void DpRt_JNI_Set_Log_Filter_Level(int level)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	__atomic_store_n(&(context->Log_Filter_Level),level,__ATOMIC_RELAXED);
+}
+
+/**
+ * Routine to set the current context's log filter function, used to discard messages logged in the 
+ * context before they are formatted and passed to the Java layer.
+ * @param filter_fp A function pointer to the filter to use, e.g. DpRt_JNI_Log_Filter_Level_Absolute or
+ *        DpRt_JNI_Log_Filter_Level_Bitwise. It should return TRUE if the message should be logged, and
+ *        must cope with a NULL string (the message has not been formatted yet). 
+ *        Use NULL to log all messages.
+ * @see #DpRt_JNI_Context_Struct
+ */
+void DpRt_JNI_Set_Log_Filter_Function(int (*filter_fp)(char *sub_system,char *source_filename,char *function,
+						       int level,char *category,char *string))
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	__atomic_store_n(&(context->Log_Filter_Function),filter_fp,__ATOMIC_RELEASE);
+}
+
+/**
+ * A log filter routine, that returns TRUE if level is less than or equal to the current context's log filter 
+ * level (the level scheme used by ngat.util.logging.Logger).
+ * @param sub_system The sub system. Can be NULL.
+ * @param source_filename The source filename. Can be NULL.
+ * @param function The function calling the log. Can be NULL.
+ * @param level The log level of the message.
+ * @param category What sort of information is the message. Can be NULL.
+ * @param string The log message. Can be NULL.
+ * @return The routine returns TRUE if the message should be logged, FALSE if it should be discarded.
+ * @see #DpRt_JNI_Context_Struct
+ */
+int DpRt_JNI_Log_Filter_Level_Absolute(char *sub_system,char *source_filename,char *function,int level,
+				       char *category,char *string)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	return (level <= __atomic_load_n(&(context->Log_Filter_Level),__ATOMIC_RELAXED));
+}
+
+/**
+ * A log filter routine, that returns TRUE if any of the bits set in level are also set in the current context's 
+ * log filter level.
+ * @param sub_system The sub system. Can be NULL.
+ * @param source_filename The source filename. Can be NULL.
+ * @param function The function calling the log. Can be NULL.
+ * @param level The log level of the message.
+ * @param category What sort of information is the message. Can be NULL.
+ * @param string The log message. Can be NULL.
+ * @return The routine returns TRUE if the message should be logged, FALSE if it should be discarded.
+ * @see #DpRt_JNI_Context_Struct
+ */
+int DpRt_JNI_Log_Filter_Level_Bitwise(char *sub_system,char *source_filename,char *function,int level,
+				      char *category,char *string)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	return ((level & __atomic_load_n(&(context->Log_Filter_Level),__ATOMIC_RELAXED)) != 0);
+}
+
+/**
+ * Routine to allocate a new frame of native memory, e.g. for a pipeline to write a reduced frame into.
+ * The caller owns one reference to the frame, and must call DpRt_JNI_Frame_Release when it has finished 
+ * with it.
+ * @param length The length of the frame in bytes.
+ * @param frame_handle The address of an integer to store the new frame's handle in.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Frame_Add
+ * @see #DpRt_JNI_Frame_Release
+ */
+int DpRt_JNI_Frame_Create(size_t length,int *frame_handle)
+{
+	void *data = NULL;
+
+	if((length == 0)||(frame_handle == NULL))
+	{
+		DpRt_JNI_Error_Set(70,"DpRt_JNI_Frame_Create:Illegal length/frame handle (%lu,%p).\n",
+			(unsigned long)length,(void*)frame_handle);
+		return FALSE;
+	}
+	data = malloc(length);
+	if(data == NULL)
+	{
+		DpRt_JNI_Error_Set(72,"DpRt_JNI_Frame_Create:Memory allocation error(%lu).\n",
+			(unsigned long)length);
+		return FALSE;
+	}
+	if(!DpRt_JNI_Frame_Add(data,length,NULL,NULL,NULL,frame_handle))
+	{
+		free(data);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to wrap existing native memory (e.g. a frame just read from a camera) as a frame, without copying
+ * it. The caller owns one reference to the frame, and must call DpRt_JNI_Frame_Release when it has finished
+ * with it. The memory must remain valid until the frame is freed, when free_fp is called.
+ * @param data The frame's memory.
+ * @param length The length of data in bytes.
+ * @param free_fp A function called with data and user_data when the last reference to the frame is
+ *        released. Can be NULL, if the caller manages the memory's lifetime itself.
+ * @param user_data Passed to free_fp.
+ * @param frame_handle The address of an integer to store the new frame's handle in.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Frame_Add
+ * @see #DpRt_JNI_Frame_Release
+ */
+int DpRt_JNI_Frame_Wrap(void *data,size_t length,void (*free_fp)(void *data,void *user_data),void *user_data,
+			int *frame_handle)
+{
+	if((data == NULL)||(length == 0)||(frame_handle == NULL))
+	{
+		DpRt_JNI_Error_Set(122,"DpRt_JNI_Frame_Wrap:Illegal data/length/frame handle (%p,%lu,%p).\n",
+			data,(unsigned long)length,(void*)frame_handle);
+		return FALSE;
+	}
+	return DpRt_JNI_Frame_Add(data,length,free_fp,user_data,NULL,frame_handle);
+}
+
+/**
+ * Routine to make a frame from a Java direct ByteBuffer (e.g. a frame the instrument software has just read),
+ * without copying it. A global reference to the buffer is kept until the frame is freed, so the memory 
+ * stays valid. The caller owns one reference to the frame, and must call DpRt_JNI_Frame_Release when it 
+ * has finished with it.
+ * @param env The JNI environment pointer.
+ * @param buffer A direct java.nio.ByteBuffer.
+ * @param frame_handle The address of an integer to store the new frame's handle in.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Frame_Add
+ * @see #DpRt_JNI_Frame_Release
+ */
+int DpRt_JNI_Frame_From_Buffer(JNIEnv *env,jobject buffer,int *frame_handle)
+{
+	jobject global_buffer = NULL;
+	void *data = NULL;
+	jlong length;
+
+	if((buffer == NULL)||(frame_handle == NULL))
+	{
+		DpRt_JNI_Error_Set(123,"DpRt_JNI_Frame_From_Buffer:Illegal buffer/frame handle (%p,%p).\n",
+			(void*)buffer,(void*)frame_handle);
+		return FALSE;
+	}
+	data = (*env)->GetDirectBufferAddress(env,buffer);
+	length = (*env)->GetDirectBufferCapacity(env,buffer);
+	if((data == NULL)||(length <= 0))
+	{
+		DpRt_JNI_Error_Set(75,"DpRt_JNI_Frame_From_Buffer:Not a direct buffer (%p,%ld).\n",
+			data,(long)length);
+		return FALSE;
+	}
+	global_buffer = (*env)->NewGlobalRef(env,buffer);
+	if(global_buffer == NULL)
+	{
+		DpRt_JNI_Error_Set(76,"DpRt_JNI_Frame_From_Buffer:NewGlobalRef failed.\n");
+		return FALSE;
+	}
+	if(!DpRt_JNI_Frame_Add(data,(size_t)length,NULL,NULL,global_buffer,frame_handle))
+	{
+		(*env)->DeleteGlobalRef(env,global_buffer);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to get a frame's memory.
+ * @param frame_handle The frame's handle.
+ * @param data The address of a pointer to store the frame's memory address in.
+ * @param length The address of a size_t to store the frame's length in bytes in. Can be NULL.
+ * @return The routine returns TRUE if it succeeds, FALSE if the handle is not a current frame.
+ * @see #DpRt_JNI_Frame_Get
+ */
+int DpRt_JNI_Frame_Get_Data(int frame_handle,void **data,size_t *length)
+{
+	struct Frame_Struct *frame = NULL;
+
+	if(data == NULL)
+	{
+		DpRt_JNI_Error_Set(124,"DpRt_JNI_Frame_Get_Data:data was NULL.\n");
+		return FALSE;
+	}
+	pthread_mutex_lock(&Frame_Lock);
+	frame = DpRt_JNI_Frame_Get(frame_handle);
+	if(frame == NULL)
+	{
+		pthread_mutex_unlock(&Frame_Lock);
+		return FALSE;
+	}
+	(*data) = frame->Data;
+	if(length != NULL)
+		(*length) = frame->Length;
+	pthread_mutex_unlock(&Frame_Lock);
+	return TRUE;
+}
+
+/**
+ * Routine to add a reference (owner) to a frame. Each reference must be released with 
+ * DpRt_JNI_Frame_Release.
+ * @param frame_handle The frame's handle.
+ * @return The routine returns TRUE if it succeeds, FALSE if the handle is not a current frame.
+ * @see #DpRt_JNI_Frame_Release
+ */
+int DpRt_JNI_Frame_Retain(int frame_handle)
+{
+	struct Frame_Struct *frame = NULL;
+
+	pthread_mutex_lock(&Frame_Lock);
+	frame = DpRt_JNI_Frame_Get(frame_handle);
+	if(frame == NULL)
+	{
+		pthread_mutex_unlock(&Frame_Lock);
+		return FALSE;
+	}
+	frame->Reference_Count++;
+	pthread_mutex_unlock(&Frame_Lock);
+	return TRUE;
+}
+
+/**
+ * Routine to release a reference to a frame. When the last reference is released, the frame's memory
+ * is freed (or it's free function called, or it's ByteBuffer's global reference deleted), and the
+ * handle becomes invalid. ByteBuffer views of the frame must not be used after their reference is released.
+ * Deleting a ByteBuffer's global reference needs a JNI environment. If one cannot be got when the last
+ * reference is released, the reference is not released, and the routine fails, so the caller can retry.
+ * @param frame_handle The frame's handle.
+ * @return The routine returns TRUE if it succeeds, FALSE if the handle is not a current frame, or the
+ *         last reference to a ByteBuffer frame could not be released.
+ * @see #DpRt_JNI_Frame_Retain
+ * @see #DpRt_JNI_Get_Env
+ */
+int DpRt_JNI_Frame_Release(int frame_handle)
+{
+	struct Frame_Struct *frame = NULL;
+	struct Frame_Struct released_frame;
+	JNIEnv *env = NULL;
+
+	pthread_mutex_lock(&Frame_Lock);
+	frame = DpRt_JNI_Frame_Get(frame_handle);
+	while((frame != NULL)&&(frame->Reference_Count == 1)&&(frame->Buffer != NULL)&&(env == NULL))
+	{
+		/* get the environment to delete the buffer's global reference with, before the frame is released */
+		pthread_mutex_unlock(&Frame_Lock);
+		env = DpRt_JNI_Get_Env(NULL);
+		if(env == NULL)
+		{
+			DpRt_JNI_Error_Set(126,"DpRt_JNI_Frame_Release:Failed to get JNI environment, "
+					   "frame %d not released.\n",frame_handle);
+			return FALSE;
+		}
+		pthread_mutex_lock(&Frame_Lock);
+		frame = DpRt_JNI_Frame_Get(frame_handle);
+	}
+	if(frame == NULL)
+	{
+		pthread_mutex_unlock(&Frame_Lock);
+		return FALSE;
+	}
+	frame->Reference_Count--;
+	if(frame->Reference_Count > 0)
+	{
+		pthread_mutex_unlock(&Frame_Lock);
+		return TRUE;
+	}
+	released_frame = (*frame);
+	frame->In_Use = FALSE;
+	frame->Data = NULL;
+	frame->Buffer = NULL;
+	pthread_mutex_unlock(&Frame_Lock);
+/* free the frame's memory outside the lock */
+	if(released_frame.Buffer != NULL)
+		(*env)->DeleteGlobalRef(env,released_frame.Buffer);
+	else if(released_frame.Free_Function != NULL)
+		released_frame.Free_Function(released_frame.Data,released_frame.Free_User_Data);
+	else
+		free(released_frame.Data);
+	return TRUE;
+}
+
+/**
+ * Routine to create a direct ByteBuffer view of a frame, so Java can read or write the frame's memory 
+ * in place. The view holds a new reference to the frame, which the Java layer must release 
+ * (DpRt_JNI_Frame_Release, via the instrument's JNI interface) when it has finished with the buffer.
+ * The returned buffer is a local reference.
+ * @param env The JNI environment pointer.
+ * @param frame_handle The frame's handle.
+ * @return A direct ByteBuffer, or NULL if it fails.
+ * @see #DpRt_JNI_Frame_Retain
+ * @see #DpRt_JNI_Frame_Release
+ */
+jobject DpRt_JNI_Frame_New_Buffer(JNIEnv *env,int frame_handle)
+{
+	jobject java_buffer = NULL;
+	void *data = NULL;
+	size_t length;
+
+	if(!DpRt_JNI_Frame_Retain(frame_handle))
+		return NULL;
+	DpRt_JNI_Frame_Get_Data(frame_handle,&data,&length);
+	java_buffer = (*env)->NewDirectByteBuffer(env,data,(jlong)length);
+	if(java_buffer == NULL)
+	{
+		DpRt_JNI_Frame_Release(frame_handle);
+		DpRt_JNI_Error_Set(74,"DpRt_JNI_Frame_New_Buffer:NewDirectByteBuffer failed(%d).\n",
+			frame_handle);
+		return NULL;
+	}
+	DpRt_JNI_Local_Reference_Created(java_buffer);
+	return java_buffer;
+}
+
+/**
+ * Routine to create the frame buffer pool, so pipelines can get full-frame buffers without page-faulting
+ * fresh memory in for each reduction. The pool's configuration is retrieved using the property API:
+ * <dl>
+ * <dt>&lt;prefix&gt;.size_class.count</dt><dd>The number of size classes.</dd>
+ * <dt>&lt;prefix&gt;.size_class.&lt;n&gt;.length</dt><dd>The length in bytes of buffers in size class n
+ *     (numbered from 0). This is parsed as an unsigned 64 bit number, so it is not limited to 2 GB.</dd>
+ * <dt>&lt;prefix&gt;.size_class.&lt;n&gt;.count</dt><dd>The number of buffers to pre-allocate in size class n.</dd>
+ * <dt>&lt;prefix&gt;.huge_pages</dt><dd>Optional boolean. If true, each size class is mapped with explicit huge 
+ *     pages, falling back to transparent huge pages if none are reserved.</dd>
+ * <dt>&lt;prefix&gt;.mlock</dt><dd>Optional boolean. If true, each size class is locked into RAM. Failing 
+ *     to lock (e.g. because of RLIMIT_MEMLOCK) is not an error.</dd>
+ * </dl>
+ * This must not be called whilst other threads are getting frames from the pool.
+ * @param property_prefix The keyword prefix of the pool's properties, e.g. "dprt.frame_pool".
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #FRAME_POOL_SIZE_CLASS_MAX_COUNT
+ * @see #Frame_Pool_Size_Class_List
+ * @see #DpRt_JNI_Frame_Pool_Size_Class_Create
+ * @see #DpRt_JNI_Get_Property_Integer
+ * @see #DpRt_JNI_Get_Property_Boolean
+ * @see #DpRt_JNI_Frame_Pool_Finalise
+ */
+int DpRt_JNI_Frame_Pool_Initialise(char *property_prefix)
+{
+	struct Frame_Pool_Size_Class_Struct size_class;
+	char keyword[FRAME_POOL_KEYWORD_LENGTH];
+	char *length_string = NULL;
+	char *end_ptr = NULL;
+	unsigned long long length;
+	int size_class_count,count,huge_pages,lock_pages,i,j;
+
+	if(property_prefix == NULL)
+	{
+		DpRt_JNI_Error_Set(77,"DpRt_JNI_Frame_Pool_Initialise:property_prefix was NULL.\n");
+		return FALSE;
+	}
+	if(__atomic_load_n(&Frame_Pool_Size_Class_Count,__ATOMIC_ACQUIRE) > 0)
+	{
+		DpRt_JNI_Error_Set(78,"DpRt_JNI_Frame_Pool_Initialise:Frame pool already initialised.\n");
+		return FALSE;
+	}
+	snprintf(keyword,FRAME_POOL_KEYWORD_LENGTH,"%s.size_class.count",property_prefix);
+	if(!DpRt_JNI_Get_Property_Integer(keyword,&size_class_count))
+		return FALSE;
+	if((size_class_count < 1)||(size_class_count > FRAME_POOL_SIZE_CLASS_MAX_COUNT))
+	{
+		DpRt_JNI_Error_Set(79,"DpRt_JNI_Frame_Pool_Initialise:Illegal size class count %d (1..%d).\n",
+			size_class_count,FRAME_POOL_SIZE_CLASS_MAX_COUNT);
+		return FALSE;
+	}
+/* huge pages and mlock are optional, and default to off */
+	snprintf(keyword,FRAME_POOL_KEYWORD_LENGTH,"%s.huge_pages",property_prefix);
+	if(!DpRt_JNI_Get_Property_Boolean(keyword,&huge_pages))
+		huge_pages = FALSE;
+	snprintf(keyword,FRAME_POOL_KEYWORD_LENGTH,"%s.mlock",property_prefix);
+	if(!DpRt_JNI_Get_Property_Boolean(keyword,&lock_pages))
+		lock_pages = FALSE;
+	for(i = 0; i < size_class_count; i++)
+	{
+		/* the length is parsed from the property string, an int property would limit buffers to 2 GB */
+		snprintf(keyword,FRAME_POOL_KEYWORD_LENGTH,"%s.size_class.%d.length",property_prefix,i);
+		if(!DpRt_JNI_Get_Property(keyword,&length_string))
+			break;
+		errno = 0;
+		length = strtoull(length_string,&end_ptr,10);
+		if((errno != 0)||(end_ptr == length_string)||((*end_ptr) != '\0')||
+		   (strchr(length_string,'-') != NULL)||(length < 1)||(length > SIZE_MAX))
+		{
+			DpRt_JNI_Error_Set(127,"DpRt_JNI_Frame_Pool_Initialise:"
+				"Illegal size class %d length '%s'.\n",i,length_string);
+			free(length_string);
+			break;
+		}
+		free(length_string);
+		snprintf(keyword,FRAME_POOL_KEYWORD_LENGTH,"%s.size_class.%d.count",property_prefix,i);
+		if(!DpRt_JNI_Get_Property_Integer(keyword,&count))
+			break;
+		if(count < 1)
+		{
+			DpRt_JNI_Error_Set(80,"DpRt_JNI_Frame_Pool_Initialise:"
+				"Illegal size class %d length/count (%llu,%d).\n",i,length,count);
+			break;
+		}
+		if(!DpRt_JNI_Frame_Pool_Size_Class_Create(&(Frame_Pool_Size_Class_List[i]),(size_t)length,count,
+							  huge_pages,lock_pages))
+			break;
+	}
+	if(i < size_class_count)
+	{
+		for(j = 0; j < i; j++)
+			DpRt_JNI_Frame_Pool_Size_Class_Destroy(&(Frame_Pool_Size_Class_List[j]));
+		return FALSE;
+	}
+/* sort size classes into ascending buffer length, so DpRt_JNI_Frame_Pool_Get uses the smallest that fits */
+	for(i = 1; i < size_class_count; i++)
+	{
+		size_class = Frame_Pool_Size_Class_List[i];
+		for(j = i; (j > 0)&&(Frame_Pool_Size_Class_List[j-1].Buffer_Length > size_class.Buffer_Length); j--)
+			Frame_Pool_Size_Class_List[j] = Frame_Pool_Size_Class_List[j-1];
+		Frame_Pool_Size_Class_List[j] = size_class;
+	}
+	__atomic_store_n(&Frame_Pool_Size_Class_Count,size_class_count,__ATOMIC_RELEASE);
+	return TRUE;
+}
+
+/**
+ * Routine to destroy the frame buffer pool. This fails if any pool buffers are still in use.
+ * This must not be called whilst other threads are getting frames from the pool.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Frame_Pool_Size_Class_List
+ * @see #DpRt_JNI_Frame_Pool_Size_Class_Destroy
+ */
+int DpRt_JNI_Frame_Pool_Finalise(void)
+{
+	int i,size_class_count;
+
+	size_class_count = __atomic_load_n(&Frame_Pool_Size_Class_Count,__ATOMIC_ACQUIRE);
+	for(i = 0; i < size_class_count; i++)
+	{
+		if(__atomic_load_n(&(Frame_Pool_Size_Class_List[i].Free_Count),__ATOMIC_ACQUIRE) != 
+		   Frame_Pool_Size_Class_List[i].Buffer_Count)
+		{
+			DpRt_JNI_Error_Set(81,"DpRt_JNI_Frame_Pool_Finalise:"
+				"%d buffers of size class %d (%lu bytes) still in use.\n",
+				Frame_Pool_Size_Class_List[i].Buffer_Count-Frame_Pool_Size_Class_List[i].Free_Count,i,
+				(unsigned long)Frame_Pool_Size_Class_List[i].Buffer_Length);
+			return FALSE;
+		}
+	}
+	__atomic_store_n(&Frame_Pool_Size_Class_Count,0,__ATOMIC_RELEASE);
+	for(i = 0; i < size_class_count; i++)
+		DpRt_JNI_Frame_Pool_Size_Class_Destroy(&(Frame_Pool_Size_Class_List[i]));
+	return TRUE;
+}
+
+/**
+ * Routine to get a frame from the frame buffer pool. A buffer is popped, without locking, from the smallest 
+ * size class that is large enough, and wrapped as a frame, so it can be passed to Java with 
+ * DpRt_JNI_Frame_New_Buffer or DpRt_JNI_Set_Reduce_Frame. When the frame's last reference is released
+ * (DpRt_JNI_Frame_Release) the buffer is pushed back onto the pool. If the pool is not initialised, 
+ * or no buffer that is large enough is free, the frame is allocated with DpRt_JNI_Frame_Create instead.
+ * The pool buffer's contents are not cleared. Only the size class free stacks are lock-free: registering the
+ * buffer as a frame (DpRt_JNI_Frame_Add) and releasing it (DpRt_JNI_Frame_Release) take Frame_Lock, as 
+ * for any other frame, so the handout as a whole is not lock-free. The pool saves the allocation and page
+ * faults, not the lock.
+ * @param length The length of the frame in bytes. The frame's memory may be longer than this.
+ * @param frame_handle The address of an integer to store the new frame's handle in.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Frame_Pool_Pop
+ * @see #DpRt_JNI_Frame_Pool_Push
+ * @see #DpRt_JNI_Frame_Add
+ * @see #DpRt_JNI_Frame_Create
+ */
+int DpRt_JNI_Frame_Pool_Get(size_t length,int *frame_handle)
+{
+	struct Frame_Pool_Size_Class_Struct *size_class = NULL;
+	char *data = NULL;
+	int i,size_class_count;
+
+	if((length == 0)||(frame_handle == NULL))
+	{
+		DpRt_JNI_Error_Set(125,"DpRt_JNI_Frame_Pool_Get:Illegal length/frame handle (%lu,%p).\n",
+			(unsigned long)length,(void*)frame_handle);
+		return FALSE;
+	}
+	size_class_count = __atomic_load_n(&Frame_Pool_Size_Class_Count,__ATOMIC_ACQUIRE);
+	for(i = 0; i < size_class_count; i++)
+	{
+		size_class = &(Frame_Pool_Size_Class_List[i]);
+		if(size_class->Buffer_Length < length)
+			continue;
+		data = DpRt_JNI_Frame_Pool_Pop(size_class);
+		if(data != NULL)
+			break;
+	}
+	if(data == NULL)
+	{
+		__atomic_add_fetch(&Frame_Pool_Miss_Count,1,__ATOMIC_RELAXED);
+		return DpRt_JNI_Frame_Create(length,frame_handle);
+	}
+	if(!DpRt_JNI_Frame_Add(data,size_class->Buffer_Length,DpRt_JNI_Frame_Pool_Push,size_class,NULL,frame_handle))
+	{
+		DpRt_JNI_Frame_Pool_Push(data,size_class);
+		return FALSE;
+	}
+	__atomic_add_fetch(&Frame_Pool_Get_Count,1,__ATOMIC_RELAXED);
+	return TRUE;
+}
+
+/**
+ * Routine to get the frame buffer pool's statistics.
+ * @param get_count The address of an unsigned long to store the number of frames got from the pool in.
+ * @param miss_count The address of an unsigned long to store the number of frames DpRt_JNI_Frame_Pool_Get
+ *        allocated with malloc, because no pool buffer was free, in.
+ * @see #Frame_Pool_Get_Count
+ * @see #Frame_Pool_Miss_Count
+ */
+void DpRt_JNI_Frame_Pool_Get_Statistics(unsigned long *get_count,unsigned long *miss_count)
+{
+	if(get_count != NULL)
+		(*get_count) = __atomic_load_n(&Frame_Pool_Get_Count,__ATOMIC_RELAXED);
+	if(miss_count != NULL)
+		(*miss_count) = __atomic_load_n(&Frame_Pool_Miss_Count,__ATOMIC_RELAXED);
+}
+
+/**
+ * Routine to start the asynchronous log queue. Once started, DpRt_JNI_Log_Handler copies each record into a 
+ * bounded queue and returns immediately. A dedicated thread, attached to the JVM as a daemon thread, 
+ * delivers queued records to the Java logger in batches. 
+ * DpRt_JNI_Initialise_Logger_Reference and DpRt_JNI_Set_Java_VM must have been called first.
+ * @param capacity The maximum number of records the queue can hold. This is rounded up to a power of two.
+ * @param overflow_policy What DpRt_JNI_Log_Handler does when the queue is full, one of:
+ *        DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_OLDEST (discard the oldest queued record to make room), 
+ *        DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_NEWEST (discard the new record),
+ *        DPRT_JNI_LOG_QUEUE_OVERFLOW_BLOCK (wait for the queue thread to make room).
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Log_Queue
+ * @see #DpRt_JNI_Log_Queue_Thread
+ * @see #DpRt_JNI_Log_Queue_Stop
+ */
+int DpRt_JNI_Log_Queue_Start(int capacity,int overflow_policy)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	unsigned long actual_capacity,i;
+	int retval;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(Log_Queue.Running)
+	{
+		DpRt_JNI_Error_Set(63,"DpRt_JNI_Log_Queue_Start:Log queue already running.\n");
+		return FALSE;
+	}
+	if((capacity < 1)||((overflow_policy != DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_OLDEST)&&
+			    (overflow_policy != DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_NEWEST)&&
+			    (overflow_policy != DPRT_JNI_LOG_QUEUE_OVERFLOW_BLOCK)))
+	{
+		DpRt_JNI_Error_Set(64,"DpRt_JNI_Log_Queue_Start:Illegal capacity/overflow policy (%d,%d).\n",
+			capacity,overflow_policy);
+		return FALSE;
+	}
+	if((Java_VM == NULL)||(context->Logger == NULL)||(Log_Method_Id == NULL))
+	{
+		DpRt_JNI_Error_Set(65,"DpRt_JNI_Log_Queue_Start:Java_VM/Logger not initialised.\n");
+		return FALSE;
+	}
+	actual_capacity = 1;
+	while(actual_capacity < (unsigned long)capacity)
+		actual_capacity <<= 1;
+	Log_Queue.Record_List = (struct Log_Record_Struct *)malloc(actual_capacity*sizeof(struct Log_Record_Struct));
+	if(Log_Queue.Record_List == NULL)
+	{
+		DpRt_JNI_Error_Set(66,"DpRt_JNI_Log_Queue_Start:Memory allocation error(%lu).\n",
+			actual_capacity);
+		return FALSE;
+	}
+	for(i = 0; i < actual_capacity; i++)
+		Log_Queue.Record_List[i].Sequence = i;
+	Log_Queue.Capacity = actual_capacity;
+	Log_Queue.Enqueue_Position = 0;
+	Log_Queue.Dequeue_Position = 0;
+	Log_Queue.Flushed_Position = 0;
+	Log_Queue.Overflow_Policy = overflow_policy;
+	Log_Queue.Consumer_Waiting = FALSE;
+	Log_Queue.Producer_Waiting_Count = 0;
+	__atomic_store_n(&Log_Queue.Running,TRUE,__ATOMIC_RELEASE);
+	retval = pthread_create(&(Log_Queue.Thread),NULL,DpRt_JNI_Log_Queue_Thread,NULL);
+	if(retval != 0)
+	{
+		__atomic_store_n(&Log_Queue.Running,FALSE,__ATOMIC_RELEASE);
+		while(__atomic_load_n(&Log_Queue.Active_Producer_Count,__ATOMIC_ACQUIRE) > 0)
+			sched_yield();
+		free(Log_Queue.Record_List);
+		Log_Queue.Record_List = NULL;
+		DpRt_JNI_Error_Set(67,"DpRt_JNI_Log_Queue_Start:pthread_create failed(%d).\n",retval);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to stop the asynchronous log queue. New records are delivered synchronously by 
+ * DpRt_JNI_Log_Handler again. Any records already queued are delivered to the Java logger before the 
+ * log queue thread exits. This routine waits for the log queue thread to exit.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Log_Queue
+ * @see #DpRt_JNI_Log_Queue_Start
+ */
+int DpRt_JNI_Log_Queue_Stop(void)
+{
+	if(Log_Queue.Running == FALSE)
+	{
+		DpRt_JNI_Error_Set(68,"DpRt_JNI_Log_Queue_Stop:Log queue not running.\n");
+		return FALSE;
+	}
+	__atomic_store_n(&Log_Queue.Running,FALSE,__ATOMIC_RELEASE);
+/* wait for producers already adding records, so none are added after the queue thread exits */
+	while(__atomic_load_n(&Log_Queue.Active_Producer_Count,__ATOMIC_ACQUIRE) > 0)
+	{
+		DpRt_JNI_Log_Queue_Signal_Not_Full();
+		sched_yield();
+	}
+	pthread_mutex_lock(&(Log_Queue.Lock));
+	pthread_cond_signal(&(Log_Queue.Not_Empty_Condition));
+	pthread_mutex_unlock(&(Log_Queue.Lock));
+	pthread_join(Log_Queue.Thread,NULL);
+	free(Log_Queue.Record_List);
+	Log_Queue.Record_List = NULL;
+	return TRUE;
+}
+
+/**
+ * Routine to retrieve the asynchronous log queue's counters. Any of the parameters can be NULL.
+ * The counters are not reset when the queue is stopped and re-started.
+ * @param record_count The address of an unsigned long to store the number of records queued in.
+ * @param dropped_count The address of an unsigned long to store the number of records dropped 
+ *        because the queue was full in.
+ * @param blocked_count The address of an unsigned long to store the number of times a logging thread 
+ *        blocked because the queue was full in.
+ * @see #Log_Queue
+ */
+void DpRt_JNI_Log_Queue_Get_Statistics(unsigned long *record_count,unsigned long *dropped_count,
+				       unsigned long *blocked_count)
+{
+	if(record_count != NULL)
+		(*record_count) = __atomic_load_n(&Log_Queue.Record_Count,__ATOMIC_RELAXED);
+	if(dropped_count != NULL)
+		(*dropped_count) = __atomic_load_n(&Log_Queue.Dropped_Count,__ATOMIC_RELAXED);
+	if(blocked_count != NULL)
+		(*blocked_count) = __atomic_load_n(&Log_Queue.Blocked_Count,__ATOMIC_RELAXED);
+}
+
+/* scheduler */
+/**
+ * Routine to start the work-stealing reduction scheduler, a pool of native worker threads that run 
+ * reduction jobs submitted with DpRt_JNI_Scheduler_Submit. Each worker has it's own job deque, idle workers
+ * steal jobs from the others, so a backlog of (e.g. calibration) frames keeps all the workers busy.
+ * The workers attach themselves to the JVM (using the Java_VM set by DpRt_JNI_Set_Java_VM) as they start,
+ * and this routine fails if any of them cannot. The following properties configure the scheduler:
+ * <dl>
+ * <dt>&lt;property_prefix&gt;.thread.count</dt><dd>The number of worker threads. If not set (or zero or less), 
+ *     one per online processor.</dd>
+ * <dt>&lt;property_prefix&gt;.deque.length</dt><dd>The initial capacity of each worker's job deque 
+ *     (SCHEDULER_DEQUE_DEFAULT_LENGTH if not set). Deques grow as needed.</dd>
+ * </dl>
+ * @param property_prefix The prefix of the scheduler's properties, e.g. "dprt.scheduler".
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Scheduler
+ * @see #DpRt_JNI_Scheduler_Submit
+ * @see #DpRt_JNI_Scheduler_Stop
+ * @see #DpRt_JNI_Scheduler_Worker_Thread
+ */
+int DpRt_JNI_Scheduler_Start(char *property_prefix)
+{
+	struct Scheduler_Worker_Struct *worker = NULL;
+	char keyword[256];
+	int worker_count,deque_length,attach_failed_count,i,retval;
+	unsigned long capacity;
+
+	if(property_prefix == NULL)
+	{
+		DpRt_JNI_Error_Set(102,"DpRt_JNI_Scheduler_Start:property_prefix was NULL.\n");
+		return FALSE;
+	}
+	if(__atomic_load_n(&Scheduler.Running,__ATOMIC_ACQUIRE))
+	{
+		DpRt_JNI_Error_Set(103,"DpRt_JNI_Scheduler_Start:Scheduler already running.\n");
+		return FALSE;
+	}
+	if(Java_VM == NULL)
+	{
+		DpRt_JNI_Error_Set(104,"DpRt_JNI_Scheduler_Start:Java_VM not initialised.\n");
+		return FALSE;
+	}
+	snprintf(keyword,sizeof(keyword),"%s.thread.count",property_prefix);
+	DpRt_JNI_Get_Property_Integer_Default(keyword,0,&worker_count);
+	if(worker_count < 1)
+		worker_count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(worker_count < 1)
+		worker_count = 1;
+	snprintf(keyword,sizeof(keyword),"%s.deque.length",property_prefix);
+	DpRt_JNI_Get_Property_Integer_Default(keyword,SCHEDULER_DEQUE_DEFAULT_LENGTH,&deque_length);
+	capacity = 1;
+	while(capacity < (unsigned long)deque_length)
+		capacity <<= 1;
+	Scheduler.Worker_List = (struct Scheduler_Worker_Struct *)calloc(worker_count,
+									 sizeof(struct Scheduler_Worker_Struct));
+	if(Scheduler.Worker_List == NULL)
+	{
+		DpRt_JNI_Error_Set(105,"DpRt_JNI_Scheduler_Start:Memory allocation error(%d).\n",worker_count);
+		return FALSE;
+	}
+	for(i = 0; i < worker_count; i++)
+	{
+		worker = &(Scheduler.Worker_List[i]);
+		worker->Index = i;
+		pthread_mutex_init(&(worker->Lock),NULL);
+		worker->Job_List = (struct Scheduler_Job_Struct **)malloc(capacity*sizeof(struct Scheduler_Job_Struct *));
+		worker->Capacity = capacity;
+		worker->Top = 0;
+		worker->Bottom = 0;
+		if(worker->Job_List == NULL)
+		{
+			DpRt_JNI_Scheduler_Free(i+1,0);
+			DpRt_JNI_Error_Set(133,"DpRt_JNI_Scheduler_Start:Memory allocation error(%d,%lu).\n",i,capacity);
+			return FALSE;
+		}
+	}
+	Scheduler.Worker_Count = worker_count;
+	Scheduler.Sleeping_Count = 0;
+	Scheduler.Pending_Count = 0;
+	Scheduler.Starting = TRUE;
+	Scheduler.Started_Count = 0;
+	Scheduler.Attach_Failed_Count = 0;
+	for(i = 0; i < worker_count; i++)
+	{
+		retval = pthread_create(&(Scheduler.Worker_List[i].Thread),NULL,DpRt_JNI_Scheduler_Worker_Thread,
+					&(Scheduler.Worker_List[i]));
+		if(retval != 0)
+		{
+		/* release, and join, only the workers that were created. Running is still FALSE so they exit */
+			pthread_mutex_lock(&(Scheduler.Lock));
+			Scheduler.Starting = FALSE;
+			pthread_cond_broadcast(&(Scheduler.Started_Condition));
+			pthread_mutex_unlock(&(Scheduler.Lock));
+			DpRt_JNI_Scheduler_Free(worker_count,i);
+			DpRt_JNI_Error_Set(106,"DpRt_JNI_Scheduler_Start:pthread_create failed(%d,%d).\n",i,retval);
+			return FALSE;
+		}
+	}
+/* wait for the workers to attach to the JVM, a worker that can't would never complete it's jobs */
+	pthread_rwlock_wrlock(&(Scheduler.Submit_Lock));
+	pthread_mutex_lock(&(Scheduler.Lock));
+	while(Scheduler.Started_Count < worker_count)
+		pthread_cond_wait(&(Scheduler.Started_Condition),&(Scheduler.Lock));
+	attach_failed_count = Scheduler.Attach_Failed_Count;
+	if(attach_failed_count == 0)
+		__atomic_store_n(&Scheduler.Running,TRUE,__ATOMIC_RELEASE);
+	Scheduler.Starting = FALSE;
+	pthread_cond_broadcast(&(Scheduler.Started_Condition));
+	pthread_mutex_unlock(&(Scheduler.Lock));
+	pthread_rwlock_unlock(&(Scheduler.Submit_Lock));
+	if(attach_failed_count > 0)
+	{
+		DpRt_JNI_Scheduler_Free(worker_count,worker_count);
+		DpRt_JNI_Error_Set(136,"DpRt_JNI_Scheduler_Start:%d of %d workers failed to attach to the JVM.\n",
+			attach_failed_count,worker_count);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to submit a reduction job to the scheduler. The job is run on a worker thread, in the current 
+ * context, with it's own cancellation token bound (so DpRt_JNI_Get_Abort on the worker reports
+ * DpRt_JNI_Set_Abort in this context, and DpRt_JNI_Deadline_Start picks the token up). The reduce function
+ * should do the reduction and set the done object's reduction specific results (DpRt_JNI_Set_Reduce_Done etc).
+ * The worker then reports completion with DpRt_JNI_Set_Command_Done: successful if the reduce function
+ * returns TRUE, otherwise with the worker's error number and string. If the job is cancelled before it starts,
+ * it is not run, and the cancellation is reported instead. Jobs submitted from a worker (e.g. by a job) are
+ * queued on that worker's deque, other jobs are distributed round-robin across the workers.
+ * @param env The JNI environment pointer.
+ * @param cls The class of the done object.
+ * @param done The done object to report completion to.
+ * @param reduce_fp The function that does the reduction. It is passed the worker's JNI environment pointer,
+ *        global references to cls and done (valid until it returns), and user_data. It should return TRUE
+ *        if the reduction succeeded, and FALSE (having set the error number and string) if it failed.
+ * @param user_data Passed to reduce_fp. The caller retains ownership.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Scheduler
+ * @see #DpRt_JNI_Scheduler_Job_Submit
+ */
+int DpRt_JNI_Scheduler_Submit(JNIEnv *env,jclass cls,jobject done,
+			      int (*reduce_fp)(JNIEnv *env,jclass cls,jobject done,void *user_data),void *user_data)
+{
+	return DpRt_JNI_Scheduler_Job_Submit(env,cls,done,NULL,reduce_fp,user_data);
+}
+
+/**
+ * Routine to stop the scheduler. No more jobs are accepted, the jobs already queued are run, 
+ * and then the workers exit (detaching from the JVM). This routine waits for submits already in progress
+ * to finish queueing their jobs, and for the workers to exit. It must not be called from a worker.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Scheduler
+ * @see #DpRt_JNI_Scheduler_Start
+ */
+int DpRt_JNI_Scheduler_Stop(void)
+{
+	if(Scheduler.Worker_List == NULL)
+	{
+		DpRt_JNI_Error_Set(110,"DpRt_JNI_Scheduler_Stop:Scheduler not running.\n");
+		return FALSE;
+	}
+/* wait for in progress submits, after this no submit can reach Worker_List */
+	pthread_rwlock_wrlock(&(Scheduler.Submit_Lock));
+	pthread_mutex_lock(&(Scheduler.Lock));
+	__atomic_store_n(&Scheduler.Running,FALSE,__ATOMIC_RELEASE);
+	pthread_cond_broadcast(&(Scheduler.Work_Condition));
+	pthread_mutex_unlock(&(Scheduler.Lock));
+	pthread_rwlock_unlock(&(Scheduler.Submit_Lock));
+	DpRt_JNI_Scheduler_Free(Scheduler.Worker_Count,Scheduler.Worker_Count);
+	return TRUE;
+}
+
+/**
+ * Routine to retrieve the scheduler's counters. Any of the parameters can be NULL.
+ * The counters are not reset when the scheduler is stopped and re-started.
+ * @param submitted_count The address of an unsigned long to store the number of jobs submitted in.
+ * @param completed_count The address of an unsigned long to store the number of jobs completed in.
+ * @param stolen_count The address of an unsigned long to store the number of jobs stolen by idle workers in.
+ * @see #Scheduler
+ */
+void DpRt_JNI_Scheduler_Get_Statistics(unsigned long *submitted_count,unsigned long *completed_count,
+				       unsigned long *stolen_count)
+{
+	if(submitted_count != NULL)
+		(*submitted_count) = __atomic_load_n(&Scheduler.Submitted_Count,__ATOMIC_RELAXED);
+	if(completed_count != NULL)
+		(*completed_count) = __atomic_load_n(&Scheduler.Completed_Count,__ATOMIC_RELAXED);
+	if(stolen_count != NULL)
+		(*stolen_count) = __atomic_load_n(&Scheduler.Stolen_Count,__ATOMIC_RELAXED);
+}
+
+/* asynchronous reductions */
+/**
+ * Routine to start the completion queue, and it's thread. The completion thread attaches itself to the JVM
+ * as a daemon thread, and completes the futures of reductions submitted with DpRt_JNI_Reduce_Async_Submit.
+ * This routine waits for the thread to attach, and fails if it cannot (the workers then keep completing 
+ * futures themselves).
+ * @param env The JNI environment pointer, used to look up CompletableFuture.complete.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Completion_Queue
+ * @see #DpRt_JNI_Completion_Queue_Thread
+ * @see #DpRt_JNI_Completion_Queue_Stop
+ */
+int DpRt_JNI_Completion_Queue_Start(JNIEnv *env)
+{
+	jclass cls = NULL;
+	int running,retval;
+
+	if(__atomic_load_n(&Completion_Queue.Running,__ATOMIC_ACQUIRE))
+	{
+		DpRt_JNI_Error_Set(112,"DpRt_JNI_Completion_Queue_Start:Completion queue already running.\n");
+		return FALSE;
+	}
+	if((env == NULL)||(Java_VM == NULL))
+	{
+		DpRt_JNI_Error_Set(113,"DpRt_JNI_Completion_Queue_Start:env/Java_VM not initialised(%p).\n",
+			(void*)env);
+		return FALSE;
+	}
+	cls = (*env)->FindClass(env,"java/util/concurrent/CompletableFuture");
+	if(cls != NULL)
+	{
+		Completion_Queue.Complete_Method_Id = (*env)->GetMethodID(env,cls,"complete","(Ljava/lang/Object;)Z");
+		(*env)->DeleteLocalRef(env,cls);
+	}
+	if((cls == NULL)||(Completion_Queue.Complete_Method_Id == NULL))
+	{
+		(*env)->ExceptionClear(env);
+		DpRt_JNI_Error_Set(114,"DpRt_JNI_Completion_Queue_Start:CompletableFuture.complete not found.\n");
+		return FALSE;
+	}
+	Completion_Queue.Head = NULL;
+	Completion_Queue.Tail = NULL;
+	Completion_Queue.Starting = TRUE;
+	retval = pthread_create(&(Completion_Queue.Thread),NULL,DpRt_JNI_Completion_Queue_Thread,NULL);
+	if(retval != 0)
+	{
+		Completion_Queue.Starting = FALSE;
+		DpRt_JNI_Error_Set(115,"DpRt_JNI_Completion_Queue_Start:pthread_create failed(%d).\n",retval);
+		return FALSE;
+	}
+/* the thread sets Running once it has attached */
+	pthread_mutex_lock(&(Completion_Queue.Lock));
+	while(Completion_Queue.Starting)
+		pthread_cond_wait(&(Completion_Queue.Started_Condition),&(Completion_Queue.Lock));
+	running = Completion_Queue.Running;
+	pthread_mutex_unlock(&(Completion_Queue.Lock));
+	if(running == FALSE)
+	{
+		pthread_join(Completion_Queue.Thread,NULL);
+		DpRt_JNI_Error_Set(137,"DpRt_JNI_Completion_Queue_Start:Completion thread failed to attach to the JVM.\n");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to stop the completion queue. Completions already queued are delivered before the completion
+ * thread exits. This routine waits for the completion thread to exit. Asynchronous reductions that 
+ * finish after the queue has stopped complete their futures on the scheduler worker instead, 
+ * so the scheduler should be stopped first.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Completion_Queue
+ * @see #DpRt_JNI_Completion_Queue_Start
+ */
+int DpRt_JNI_Completion_Queue_Stop(void)
+{
+	pthread_mutex_lock(&(Completion_Queue.Lock));
+	if(Completion_Queue.Running == FALSE)
+	{
+		pthread_mutex_unlock(&(Completion_Queue.Lock));
+		DpRt_JNI_Error_Set(116,"DpRt_JNI_Completion_Queue_Stop:Completion queue not running.\n");
+		return FALSE;
+	}
+	__atomic_store_n(&Completion_Queue.Running,FALSE,__ATOMIC_RELEASE);
+	pthread_cond_signal(&(Completion_Queue.Not_Empty_Condition));
+	pthread_mutex_unlock(&(Completion_Queue.Lock));
+	pthread_join(Completion_Queue.Thread,NULL);
+	return TRUE;
+}
+
+/**
+ * Routine to retrieve the completion queue's counters. Any of the parameters can be NULL.
+ * The counters are not reset when the queue is stopped and re-started.
+ * @param completion_count The address of an unsigned long to store the number of futures completed in.
+ * @param batch_count The address of an unsigned long to store the number of batches they were completed in.
+ * @see #Completion_Queue
+ */
+void DpRt_JNI_Completion_Queue_Get_Statistics(unsigned long *completion_count,unsigned long *batch_count)
+{
+	if(completion_count != NULL)
+		(*completion_count) = __atomic_load_n(&Completion_Queue.Completion_Count,__ATOMIC_RELAXED);
+	if(batch_count != NULL)
+		(*batch_count) = __atomic_load_n(&Completion_Queue.Batch_Count,__ATOMIC_RELAXED);
+}
+
+/**
+ * Routine to submit a reduction that completes asynchronously. The calling (Java) thread returns as soon 
+ * as the job is queued. The job is run by the scheduler exactly as for DpRt_JNI_Scheduler_Submit, and once 
+ * the done object has been filled in, future is completed with done (future.complete(done)) by the 
+ * completion thread. A single Java thread can therefore keep many reductions in flight. The future is
+ * always completed normally, the done object's successful/error number/error string report failures.
+ * Both the scheduler and the completion queue must be running.
+ * @param env The JNI environment pointer.
+ * @param cls The class of the done object.
+ * @param done The done object to fill in.
+ * @param future The java.util.concurrent.CompletableFuture to complete with done.
+ * @param reduce_fp The function that does the reduction, see DpRt_JNI_Scheduler_Submit.
+ * @param user_data Passed to reduce_fp. The caller retains ownership, and must keep it valid until
+ *        future has completed.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Scheduler_Job_Submit
+ * @see #DpRt_JNI_Completion_Queue_Start
+ * @see #DpRt_JNI_Scheduler_Job_Run
+ */
+int DpRt_JNI_Reduce_Async_Submit(JNIEnv *env,jclass cls,jobject done,jobject future,
+				 int (*reduce_fp)(JNIEnv *env,jclass cls,jobject done,void *user_data),void *user_data)
+{
+	if(future == NULL)
+	{
+		DpRt_JNI_Error_Set(117,"DpRt_JNI_Reduce_Async_Submit:future was NULL.\n");
+		return FALSE;
+	}
+	if(__atomic_load_n(&Completion_Queue.Running,__ATOMIC_ACQUIRE) == FALSE)
+	{
+		DpRt_JNI_Error_Set(118,"DpRt_JNI_Reduce_Async_Submit:Completion queue not running.\n");
+		return FALSE;
+	}
+	return DpRt_JNI_Scheduler_Job_Submit(env,cls,done,future,reduce_fp,user_data);
+}
+
+/* latency histograms */
+/**
+ * Routine to turn latency recording on or off. Recording is on by default. When it is off, each boundary
+ * function only pays for a load of Latency_Enabled. The histograms are kept.
+ * @param enable TRUE to record latencies, FALSE to stop recording them.
+ * @see #Latency_Enabled
+ */
+void DpRt_JNI_Latency_Set_Enabled(int enable)
+{
+	__atomic_store_n(&Latency_Enabled,enable,__ATOMIC_RELAXED);
+}
+
+/**
+ * Routine to merge the latency histograms of all threads, for one probe. Each thread records into it's
+ * own histograms without locks, this routine adds them (and those of threads that have exited) together.
+ * Latencies being recorded whilst the histograms are merged may or may not be included.
+ * @param probe Which boundary function to retrieve the histogram of, one of the DPRT_JNI_LATENCY_PROBE_ defines.
+ * @param histogram The address of a structure to fill in with the merged histogram.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Latency_Histogram_List
+ * @see #Latency_Retired_Histogram_List
+ * @see #DpRt_JNI_Latency_Histogram_Add
+ */
+int DpRt_JNI_Latency_Histogram_Get(int probe,struct DpRt_JNI_Latency_Histogram_Struct *histogram)
+{
+	struct Latency_Thread_Histogram_Struct *thread_histogram = NULL;
+
+	if((probe < 0)||(probe >= DPRT_JNI_LATENCY_PROBE_COUNT)||(histogram == NULL))
+	{
+		DpRt_JNI_Error_Set(119,"DpRt_JNI_Latency_Histogram_Get:Illegal argument(%d,%p).\n",probe,
+			(void*)histogram);
+		return FALSE;
+	}
+	memset(histogram,0,sizeof(struct DpRt_JNI_Latency_Histogram_Struct));
+	pthread_mutex_lock(&Latency_Histogram_Lock);
+	DpRt_JNI_Latency_Histogram_Add(histogram,&(Latency_Retired_Histogram_List[probe]));
+	for(thread_histogram = Latency_Histogram_List; thread_histogram != NULL; 
+	    thread_histogram = thread_histogram->Next)
+	{
+		DpRt_JNI_Latency_Histogram_Add(histogram,&(thread_histogram->Probe_List[probe]));
+	}
+	pthread_mutex_unlock(&Latency_Histogram_Lock);
+	return TRUE;
+}
+
+/**
+ * Routine to return the lowest latency counted in a histogram bucket. Bucket i counts latencies from
+ * DpRt_JNI_Latency_Bucket_Value(i) up to (but not including) DpRt_JNI_Latency_Bucket_Value(i+1).
+ * Buckets below 2^DPRT_JNI_LATENCY_SUB_BUCKET_BITS nanoseconds are 1ns wide, above that each power of two 
+ * is split into 2^DPRT_JNI_LATENCY_SUB_BUCKET_BITS equal buckets. The last bucket also counts all longer 
+ * latencies.
+ * @param bucket_index The index of the bucket, 0..DPRT_JNI_LATENCY_BUCKET_COUNT-1.
+ * @return The lowest latency counted in the bucket, in nanoseconds.
+ * @see #DpRt_JNI_Latency_Bucket_Index
+ */
+unsigned long long DpRt_JNI_Latency_Bucket_Value(int bucket_index)
+{
+	int magnitude,sub_bucket;
+
+	magnitude = bucket_index>>DPRT_JNI_LATENCY_SUB_BUCKET_BITS;
+	sub_bucket = bucket_index&((1<<DPRT_JNI_LATENCY_SUB_BUCKET_BITS)-1);
+	if(magnitude == 0)
+		return (unsigned long long)sub_bucket;
+	return ((1ULL<<DPRT_JNI_LATENCY_SUB_BUCKET_BITS)+sub_bucket)<<(magnitude-1);
+}
+
+/**
+ * Routine to estimate a percentile of the latencies in a histogram, e.g. 99.0 for the latency 
+ * 99% of calls completed within. The estimate is the lowest latency of the bucket the percentile
+ * falls in, so it is at most 1/2^DPRT_JNI_LATENCY_SUB_BUCKET_BITS too small.
+ * @param histogram The histogram, retrieved with DpRt_JNI_Latency_Histogram_Get.
+ * @param percentile The percentile, 0.0 to 100.0.
+ * @return The latency in nanoseconds, or 0 if the histogram is empty.
+ * @see #DpRt_JNI_Latency_Bucket_Value
+ */
+unsigned long long DpRt_JNI_Latency_Histogram_Get_Percentile(struct DpRt_JNI_Latency_Histogram_Struct *histogram,
+							     double percentile)
+{
+	unsigned long long rank,count;
+	int i;
+
+	if((histogram == NULL)||(histogram->Count == 0))
+		return 0;
+	if(percentile >= 100.0)
+		return histogram->Maximum;
+	if(percentile < 0.0)
+		percentile = 0.0;
+	rank = (unsigned long long)((percentile/100.0)*histogram->Count)+1;
+	count = 0;
+	for(i = 0; i < DPRT_JNI_LATENCY_BUCKET_COUNT; i++)
+	{
+		count += histogram->Bucket_List[i];
+		if(count >= rank)
+			break;
+	}
+	if(i == DPRT_JNI_LATENCY_BUCKET_COUNT)
+		return histogram->Maximum;
+	if(DpRt_JNI_Latency_Bucket_Value(i) < histogram->Minimum)
+		return histogram->Minimum;
+	return DpRt_JNI_Latency_Bucket_Value(i);
+}
+
+/**
+ * Routine to retrieve the merged latency histogram of one probe as a Java long array, for return from a 
+ * native statistics method. The array is indexed by the DPRT_JNI_LATENCY_STATISTIC_ defines: the call count,
+ * total, minimum and maximum latency (in nanoseconds), followed by DPRT_JNI_LATENCY_BUCKET_COUNT bucket counts
+ * (see DpRt_JNI_Latency_Bucket_Value for the bucket boundaries).
+ * @param env The JNI environment pointer.
+ * @param probe Which boundary function to retrieve the histogram of, one of the DPRT_JNI_LATENCY_PROBE_ defines.
+ * @return A new local reference to the array, or NULL if it fails.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+jlongArray DpRt_JNI_Latency_Statistics_Get(JNIEnv *env,int probe)
+{
+	struct DpRt_JNI_Latency_Histogram_Struct histogram;
+	jlong statistic_list[DPRT_JNI_LATENCY_STATISTIC_COUNT];
+	jlongArray java_statistic_list = NULL;
+	int i;
+
+	if(!DpRt_JNI_Latency_Histogram_Get(probe,&histogram))
+		return NULL;
+	statistic_list[DPRT_JNI_LATENCY_STATISTIC_CALL_COUNT] = (jlong)histogram.Count;
+	statistic_list[DPRT_JNI_LATENCY_STATISTIC_TOTAL] = (jlong)histogram.Total;
+	statistic_list[DPRT_JNI_LATENCY_STATISTIC_MINIMUM] = (jlong)histogram.Minimum;
+	statistic_list[DPRT_JNI_LATENCY_STATISTIC_MAXIMUM] = (jlong)histogram.Maximum;
+	for(i = 0; i < DPRT_JNI_LATENCY_BUCKET_COUNT; i++)
+		statistic_list[DPRT_JNI_LATENCY_STATISTIC_BUCKET+i] = (jlong)histogram.Bucket_List[i];
+	java_statistic_list = (*env)->NewLongArray(env,DPRT_JNI_LATENCY_STATISTIC_COUNT);
+	if(java_statistic_list == NULL)
+	{
+		DpRt_JNI_Error_Set(120,"DpRt_JNI_Latency_Statistics_Get:NewLongArray failed(%d).\n",probe);
+		return NULL;
+	}
+	(*env)->SetLongArrayRegion(env,java_statistic_list,0,DPRT_JNI_LATENCY_STATISTIC_COUNT,statistic_list);
+	return java_statistic_list;
+}
+
+/* contexts */
+/**
+ * Routine to create a new, independent, pipeline context. The new context has no property backend,
+ * logger or status object: bind it to a thread with DpRt_JNI_Context_Set_Current, and then call the usual
+ * initialisation routines (DpRt_JNI_Set_Property_Function_Pointer etc, DpRt_JNI_Initialise, 
+ * DpRt_JNI_Initialise_Logger_Reference, DpRt_JNI_Set_Status) on that thread. 
+ * @param context The address of a pointer to store the new context in.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Context_Destroy
+ */
+int DpRt_JNI_Context_Create(struct DpRt_JNI_Context_Struct **context)
+{
+	struct DpRt_JNI_Context_Struct *new_context = NULL;
+
+	if(context == NULL)
+	{
+		DpRt_JNI_Error_Set(84,"DpRt_JNI_Context_Create:context was NULL.\n");
+		return FALSE;
+	}
+	new_context = (struct DpRt_JNI_Context_Struct *)calloc(1,sizeof(struct DpRt_JNI_Context_Struct));
+	if(new_context == NULL)
+	{
+		DpRt_JNI_Error_Set(85,"DpRt_JNI_Context_Create:Memory allocation error.\n");
+		return FALSE;
+	}
+	new_context->DpRt_Data.DpRt_Abort = FALSE;
+	pthread_mutex_init(&(new_context->Status_Property_Cache_Lock),NULL);
+	pthread_rwlock_init(&(new_context->Status_Snapshot_Lock),NULL);
+	pthread_mutex_init(&(new_context->Missing_Property_Cache_Lock),NULL);
+	pthread_mutex_init(&(new_context->Cancel_Token_Lock),NULL);
+	new_context->Cancel_Token_List = NULL;
+	new_context->Status_Snapshot_Enable = FALSE;
+	new_context->Property_Generation = 0;
+	(*context) = new_context;
+	return TRUE;
+}
+
+/**
+ * Routine to destroy a context created with DpRt_JNI_Context_Create. It's logger and status references 
+ * are finalised, and it's memory freed. If the asynchronous log queue is running, the records already 
+ * queued (which may use the context's logger reference) are delivered before the logger reference is 
+ * deleted. The queue is left running for the other contexts. The context must not be bound to any other 
+ * thread, or be logging.
+ * @param env The JNI environment pointer.
+ * @param context The context to destroy. This cannot be the default context.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #DpRt_JNI_Context_Create
+ * @see #DpRt_JNI_Log_Queue_Flush
+ * @see #DpRt_JNI_Finalise_Status_Reference
+ */
+int DpRt_JNI_Context_Destroy(JNIEnv *env,struct DpRt_JNI_Context_Struct *context)
+{
+	struct Thread_Data_Struct *thread_data = NULL;
+	struct DpRt_JNI_Context_Struct *previous_context = NULL;
+
+	if((context == NULL)||(context == &Default_Context))
+	{
+		DpRt_JNI_Error_Set(86,"DpRt_JNI_Context_Destroy:Illegal context %p.\n",(void*)context);
+		return FALSE;
+	}
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if(thread_data == NULL)
+	{
+		DpRt_JNI_Error_Set(87,"DpRt_JNI_Context_Destroy:Failed to get thread data.\n");
+		return FALSE;
+	}
+/* the finalise routines operate on the current context, so bind the context whilst calling them */
+	previous_context = thread_data->Context;
+	thread_data->Context = context;
+	if(context->Logger != NULL)
+	{
+		/* queued records may still use the logger reference, but other contexts may still be logging */
+		DpRt_JNI_Log_Queue_Flush();
+		(*env)->DeleteGlobalRef(env,context->Logger);
+		context->Logger = NULL;
+	}
+	DpRt_JNI_Finalise_Status_Reference(env);
+	thread_data->Context = previous_context;
+	if(thread_data->Context == context)
+		thread_data->Context = NULL;
+	if(context->Status_Snapshot_Prefix != NULL)
+		free(context->Status_Snapshot_Prefix);
+	DpRt_JNI_Missing_Property_Cache_Free(context);
+/* tokens outlive their context, they just leave it's list */
+	pthread_mutex_lock(&Cancel_Token_Context_Lock);
+	pthread_mutex_lock(&(context->Cancel_Token_Lock));
+	while(context->Cancel_Token_List != NULL)
+	{
+		context->Cancel_Token_List->Context = NULL;
+		context->Cancel_Token_List = context->Cancel_Token_List->Next;
+	}
+	pthread_mutex_unlock(&(context->Cancel_Token_Lock));
+	pthread_mutex_unlock(&Cancel_Token_Context_Lock);
+	pthread_mutex_destroy(&(context->Status_Property_Cache_Lock));
+	pthread_rwlock_destroy(&(context->Status_Snapshot_Lock));
+	pthread_mutex_destroy(&(context->Missing_Property_Cache_Lock));
+	pthread_mutex_destroy(&(context->Cancel_Token_Lock));
+	free(context);
+	return TRUE;
+}
+
+/**
+ * Routine to get the default context, used by threads that have not bound another context.
+ * @return The default context.
+ * @see #Default_Context
+ */
+struct DpRt_JNI_Context_Struct *DpRt_JNI_Context_Get_Default(void)
+{
+	return &Default_Context;
+}
+
+/**
+ * Routine to bind a context to the calling thread. All the routines in this library called on this thread 
+ * (property retrieval, logging, abort etc) then operate on that context. 
+ * Different threads can be bound to different contexts, and reduce in parallel.
+ * @param context The context, or NULL to use the default context again.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Thread_Data_Struct
+ * @see #DpRt_JNI_Context_Get_Current
+ */
+int DpRt_JNI_Context_Set_Current(struct DpRt_JNI_Context_Struct *context)
+{
+	struct Thread_Data_Struct *thread_data = NULL;
+
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if(thread_data == NULL)
+	{
+		DpRt_JNI_Error_Set(129,"DpRt_JNI_Context_Set_Current:Failed to get thread data.\n");
+		return FALSE;
+	}
+	if(context == &Default_Context)
+		context = NULL;
+	thread_data->Context = context;
+	return TRUE;
+}
+
+/**
+ * Routine to get the context bound to the calling thread. This does not allocate the thread's data,
+ * so it cannot fail.
+ * @return The bound context, or the default context if none is bound.
+ * @see #Thread_Data_Key
+ * @see #Default_Context
+ */
+struct DpRt_JNI_Context_Struct *DpRt_JNI_Context_Get_Current(void)
+{
+	struct Thread_Data_Struct *thread_data = NULL;
+
+	pthread_once(&Thread_Data_Key_Once,DpRt_JNI_Thread_Data_Key_Create);
+	thread_data = (struct Thread_Data_Struct *)pthread_getspecific(Thread_Data_Key);
+	if((thread_data != NULL)&&(thread_data->Context != NULL))
+		return thread_data->Context;
+	return &Default_Context;
+}
+
+/**
+ * A routine to return the current value of the error number. The error number is usually 0 for success,
+ * and non-zero when an error occurs.
+ * @return The current value of the error number.
+ * @see #DpRt_JNI_Error_Number
+ */
+int DpRt_JNI_Get_Error_Number(void)
+{
+	return DpRt_JNI_Error_Number;
+}
+
+/**
+ * A routine to get the current value of the error string. The current value is strcpyed into the 
+ * supplied paramater. The error string is usually blank when no errors have occured, and non-blank when
+ * an error has occured.
+ * @param error_string A pointer to an area of memory reserved to accept the error string. This area of 
+ * memory should be at least <a href="#DPRT_ERROR_STRING_LENGTH">DPRT_ERROR_STRING_LENGTH</a> in length.
+ * @see #DpRt_JNI_Error_String
+ */
+void DpRt_JNI_Get_Error_String(char *error_string)
+{
+	strcpy(error_string,DpRt_JNI_Error_String);
+}
+
+/**
+ * Routine to set the calling thread's error. The message is not formatted now: the format and it's 
+ * arguments (string arguments are copied) are stored, and only formatted when the error string is retrieved
+ * (DpRt_JNI_Get_Error_String, DpRt_JNI_Throw_Exception, or the DpRt_JNI_Error_String macro). Formats with 
+ * more than ERROR_ARGUMENT_MAX_COUNT arguments, '*' widths/precisions, or that are longer than 
+ * DPRT_ERROR_STRING_LENGTH, are formatted immediately.
+ * @param error_number The error number.
+ * @param format The printf format of the error message. This is copied, so it need not be a string literal.
+ * @see #Error_Struct
+ * @see #DpRt_JNI_Error_Get
+ * @see #DpRt_JNI_Error_Format_Spec
+ * @see #DpRt_JNI_Error_Format
+ */
+void DpRt_JNI_Error_Set(int error_number,char *format,...)
+{
+	struct Error_Struct *error = NULL;
+	union Error_Argument_Union *argument = NULL;
+	va_list argument_list,eager_argument_list;
+	char *format_pointer = NULL;
+	char *string = NULL;
+	char conversion,length_modifier;
+	size_t length;
+	int spec_length;
+
+	error = DpRt_JNI_Error_Get();
+	error->Number = error_number;
+	/* copy the format, it may not exist by the time the message is formatted */
+	length = strlen(format);
+	if(length < DPRT_ERROR_STRING_LENGTH)
+	{
+		memcpy(error->Format_Buffer,format,length+1);
+		error->Format = error->Format_Buffer;
+	}
+	else
+		error->Format = NULL;
+	error->Argument_Count = 0;
+	error->String_Argument_Length = 0;
+	va_start(argument_list,format);
+	va_copy(eager_argument_list,argument_list);
+	format_pointer = format;
+	while((error->Format != NULL)&&((format_pointer = strchr(format_pointer,'%')) != NULL))
+	{
+		spec_length = DpRt_JNI_Error_Format_Spec(format_pointer,&conversion,&length_modifier);
+		format_pointer += spec_length;
+		if(conversion == '%')
+			continue;
+		if((conversion == '\0')||(error->Argument_Count == ERROR_ARGUMENT_MAX_COUNT))
+		{
+			/* cannot store this argument, format the message now */
+			error->Format = NULL;
+			break;
+		}
+		argument = &(error->Argument_List[error->Argument_Count++]);
+		switch(conversion)
+		{
+			case 'd': case 'i': case 'c':
+				if(length_modifier == 'l')
+					argument->Integer_Value = va_arg(argument_list,long);
+				else if(length_modifier == 'q')
+					argument->Integer_Value = va_arg(argument_list,long long);
+				else if(length_modifier == 'z')
+					argument->Integer_Value = (long long)va_arg(argument_list,size_t);
+				else
+					argument->Integer_Value = va_arg(argument_list,int);
+				break;
+			case 'u': case 'x': case 'X': case 'o':
+				if(length_modifier == 'l')
+					argument->Unsigned_Value = va_arg(argument_list,unsigned long);
+				else if(length_modifier == 'q')
+					argument->Unsigned_Value = va_arg(argument_list,unsigned long long);
+				else if(length_modifier == 'z')
+					argument->Unsigned_Value = va_arg(argument_list,size_t);
+				else
+					argument->Unsigned_Value = va_arg(argument_list,unsigned int);
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+				argument->Double_Value = va_arg(argument_list,double);
+				break;
+			case 'p':
+				argument->Pointer_Value = va_arg(argument_list,void*);
+				break;
+			case 's':
+				string = va_arg(argument_list,char*);
+				if(string == NULL)
+					string = "(null)";
+				/* once the buffer is full, further strings are truncated to it's final empty string */
+				if(error->String_Argument_Length >= DPRT_ERROR_STRING_LENGTH)
+				{
+					argument->String_Offset = DPRT_ERROR_STRING_LENGTH-1;
+					break;
+				}
+				length = strlen(string);
+				if(length > (DPRT_ERROR_STRING_LENGTH-error->String_Argument_Length-1))
+					length = DPRT_ERROR_STRING_LENGTH-error->String_Argument_Length-1;
+				memcpy(error->String_Argument_Buffer+error->String_Argument_Length,string,length);
+				argument->String_Offset = error->String_Argument_Length;
+				error->String_Argument_Length += length;
+				error->String_Argument_Buffer[error->String_Argument_Length++] = '\0';
+				break;
+			default:
+				error->Format = NULL;
+				break;
+		}
+	}
+	if(error->Format == NULL)
+		vsnprintf(error->String,DPRT_ERROR_STRING_LENGTH,format,eager_argument_list);
+	va_end(eager_argument_list);
+	va_end(argument_list);
+}
+
+/**
+ * Routine to clear the calling thread's error, without formatting anything.
+ * @see #DpRt_JNI_Error_Get
+ */
+void DpRt_JNI_Error_Clear(void)
+{
+	struct Error_Struct *error = NULL;
+
+	error = DpRt_JNI_Error_Get();
+	error->Number = 0;
+	error->Format = NULL;
+	error->String[0] = '\0';
+}
+
+/**
+ * Routine returning the address of the calling thread's error number. This is what the 
+ * DpRt_JNI_Error_Number macro expands to, in the same way as errno.
+ * @return The address of the thread's error number.
+ * @see #DpRt_JNI_Error_Get
+ */
+int *DpRt_JNI_Error_Number_Location(void)
+{
+	return &(DpRt_JNI_Error_Get()->Number);
+}
+
+/**
+ * Routine returning the calling thread's error string, formatting it first if necessary. This is what 
+ * the DpRt_JNI_Error_String macro expands to, in the same way as errno. The string can be written to,
+ * replacing the current message. A pointer to the array is returned, so sizeof(DpRt_JNI_Error_String)
+ * is the array's length.
+ * @return The address of the thread's error string, DPRT_ERROR_STRING_LENGTH long.
+ * @see #DpRt_JNI_Error_Get
+ * @see #DpRt_JNI_Error_Format
+ */
+char (*DpRt_JNI_Error_String_Location(void))[DPRT_ERROR_STRING_LENGTH]
+{
+	struct Error_Struct *error = NULL;
+
+	error = DpRt_JNI_Error_Get();
+	if(error->Format != NULL)
+		DpRt_JNI_Error_Format(error);
+	return &(error->String);
+}
+
+/* ------------------------------------------------------- */
+/* internal functions */
+/* ------------------------------------------------------- */
+/**
+ * Routine to get the value of the keyword from the property file.
+ * This routine assumes keyword and value_string have been checked as being non-null.
+ * DpRt_JNI_Get_Property_View_From_C_File is used to borrow the keyword's value, which is then copied.
+ * @param keyword The keyword in the property file to look up.
+ * @param value_string The address of a pointer to allocate and store the resulting value string in.
+ * 	This pointer is dynamically allocated and must be freed using <b>free()</b>. 
+ * @see #DpRt_JNI_Get_Property_View_From_C_File
+ */
+static int DpRt_JNI_Get_Property_From_C_File(char *keyword,char **value_string)
+{
+	struct DpRt_JNI_Property_Snapshot_Struct *snapshot = NULL;
+	char *view_string = NULL;
+
+	(*value_string) = NULL;
+	if(!DpRt_JNI_Get_Property_View_From_C_File(keyword,&snapshot,&view_string))
+		return FALSE;
+	(*value_string) = strdup(view_string);
+	DpRt_JNI_Property_Snapshot_Release(snapshot);
+	if((*value_string) == NULL)
+	{
+		DpRt_JNI_Error_Set(39,"DpRt_Get_Property_From_C_File failed: "
+			"Memory Allocation error(%s,%s) failed.\n",PROPERTY_FILE_NAME,keyword);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to get the integer value of the keyword from the property file.
+ * This routine assumes keyword and value have been checked as being non-null.
+ * @param keyword The keyword in the property file to look up.
+ * @param value_string The address of an integer to store the resulting value string in.
+ * @see #DpRt_JNI_Get_Property_Converted_From_C_File
+ */
+static int DpRt_JNI_Get_Property_Integer_From_C_File(char *keyword,int *value)
+{
+	return DpRt_JNI_Get_Property_Converted_From_C_File(keyword,DPRT_JNI_PROPERTY_TYPE_INTEGER,value);
+}
+
+/**
+ * Routine to get the double value of the keyword from the property file.
+ * This routine assumes keyword and value have been checked as being non-null.
+ * @param keyword The keyword in the property file to look up.
+ * @param value_string The address of an double to store the resulting value string in.
+ * @see #DpRt_JNI_Get_Property_Converted_From_C_File
+ */
+static int DpRt_JNI_Get_Property_Double_From_C_File(char *keyword,double *value)
+{
+	return DpRt_JNI_Get_Property_Converted_From_C_File(keyword,DPRT_JNI_PROPERTY_TYPE_DOUBLE,value);
+}
+
+/**
+ * Routine to get the boolean value of the keyword from the property file.
+ * This routine assumes keyword and value have been checked as being non-null.
+ * @param keyword The keyword in the property file to look up.
+ * @param value_string The address of an integer to store the resulting value, either TRUE (1) or FALSE (0).
+ * @see #DpRt_JNI_Get_Property_Converted_From_C_File
+ */
+static int DpRt_JNI_Get_Property_Boolean_From_C_File(char *keyword,int *value)
+{
+	return DpRt_JNI_Get_Property_Converted_From_C_File(keyword,DPRT_JNI_PROPERTY_TYPE_BOOLEAN,value);
+}
+
+/**
+ * Routine to get the values of a list of keywords from the property file.
+ * The property index is checked once, and all the keywords looked up whilst holding the index read lock once.
+ * Requests with an Error_Number of -1 are retrieved, others are left alone. Each retrieved request's
+ * Error_Number is set to 0, or 40 if the keyword is not in the property file, 41/42/43 if the value cannot
+ * be converted to an integer/double/boolean, or 39 if a string value could not be allocated.
+ * @param request_list A list of requests.
+ * @param request_count The number of requests in request_list.
+ * @return The routine returns TRUE if it succeeds, FALSE if the property file could not be loaded.
+ * @see #Property_Index
+ * @see #Property_Index_Lock
+ * @see #DpRt_JNI_Property_Index_Check
+ * @see #DpRt_JNI_Property_Index_Find
+ * @see #DpRt_JNI_Property_Entry_Value_Get
+ */
+static int DpRt_JNI_Get_Property_List_From_C_File(struct DpRt_JNI_Property_Request_Struct *request_list,
+						  int request_count)
+{
+	struct Property_Entry_Struct *entry = NULL;
+	void *value = NULL;
+	int i,error_number;
+
+	if(!DpRt_JNI_Property_Index_Check(FALSE))
+	{
+		for(i = 0; i < request_count; i++)
+		{
+			if(request_list[i].Error_Number == -1)
+				request_list[i].Error_Number = DpRt_JNI_Error_Number;
+		}
+		return FALSE;
+	}
+	pthread_rwlock_rdlock(&Property_Index_Lock);
+	for(i = 0; i < request_count; i++)
+	{
+		if(request_list[i].Error_Number != -1)
+			continue;
+		entry = DpRt_JNI_Property_Index_Find(Property_Index,request_list[i].Keyword);
+		if(entry == NULL)
+		{
+			request_list[i].Error_Number = 40;
+			continue;
+		}
+		switch(request_list[i].Type)
+		{
+			case DPRT_JNI_PROPERTY_TYPE_STRING:
+				value = &(request_list[i].String_Value);
+				break;
+			case DPRT_JNI_PROPERTY_TYPE_INTEGER:
+				value = &(request_list[i].Integer_Value);
+				break;
+			case DPRT_JNI_PROPERTY_TYPE_DOUBLE:
+				value = &(request_list[i].Double_Value);
+				break;
+			default:
+				value = &(request_list[i].Boolean_Value);
+				break;
+		}
+		if(DpRt_JNI_Property_Entry_Value_Get(Property_Index,entry,request_list[i].Type,value))
+			error_number = 0;
+		else if(request_list[i].Type == DPRT_JNI_PROPERTY_TYPE_STRING)
+			error_number = 39;
+		else if(request_list[i].Type == DPRT_JNI_PROPERTY_TYPE_INTEGER)
+			error_number = 41;
+		else if(request_list[i].Type == DPRT_JNI_PROPERTY_TYPE_DOUBLE)
+			error_number = 42;
+		else
+			error_number = 43;
+		request_list[i].Error_Number = error_number;
+	}
+	pthread_rwlock_unlock(&Property_Index_Lock);
+	return TRUE;
+}
+
+/**
+ * Routine to convert a value string into the value of the type specified in a property request.
+ * DpRt_JNI_Property_Value_Parse is used to convert integer, double and boolean values.
+ * @param request The request, the value field of the request's type is set.
+ * @param value_string The value string to convert. String values are copied into an allocated string.
+ * @return The routine returns TRUE if it succeeds, FALSE if the string could not be converted 
+ *         (or copied).
+ * @see #DpRt_JNI_Property_Value_Parse
+ */
+static int DpRt_JNI_Property_Request_Convert(struct DpRt_JNI_Property_Request_Struct *request,char *value_string)
+{
+	switch(request->Type)
+	{
+		case DPRT_JNI_PROPERTY_TYPE_STRING:
+			request->String_Value = strdup(value_string);
+			return (request->String_Value != NULL);
+		case DPRT_JNI_PROPERTY_TYPE_INTEGER:
+			return DpRt_JNI_Property_Value_Parse(value_string,request->Type,&(request->Integer_Value));
+		case DPRT_JNI_PROPERTY_TYPE_DOUBLE:
+			return DpRt_JNI_Property_Value_Parse(value_string,request->Type,&(request->Double_Value));
+		case DPRT_JNI_PROPERTY_TYPE_BOOLEAN:
+			return DpRt_JNI_Property_Value_Parse(value_string,request->Type,&(request->Boolean_Value));
+	}
+	return FALSE;
+}
+
+/**
+ * Routine to parse a value string as an integer, double or boolean. 
+ * Integers are converted using strtol (base 0, so "0x" and "0" prefixes select hexadecimal and octal, 
+ * as sscanf "%i" did), and must fit in an int. Doubles are converted using strtod (as sscanf "%lf" did).
+ * In both cases leading whitespace is skipped, and trailing characters after the number are ignored.
+ * Booleans must be one of <b>true</b>, <b>TRUE</b>, <b>True</b>, <b>false</b>, <b>FALSE</b> or <b>False</b>.
+ * @param value_string The NULL terminated value string to parse.
+ * @param type Which type to parse the value as, one of DPRT_JNI_PROPERTY_TYPE_INTEGER, 
+ *        DPRT_JNI_PROPERTY_TYPE_DOUBLE, DPRT_JNI_PROPERTY_TYPE_BOOLEAN.
+ * @param value The address to store the value in, an (int *), (double *) or (int *) respectively.
+ * @return The routine returns TRUE if it succeeds, FALSE if the string could not be converted.
+ */
+static int DpRt_JNI_Property_Value_Parse(char *value_string,int type,void *value)
+{
+	char *end_pointer = NULL;
+	long long_value;
+	double double_value;
+
+	switch(type)
+	{
+		case DPRT_JNI_PROPERTY_TYPE_INTEGER:
+			errno = 0;
+			long_value = strtol(value_string,&end_pointer,0);
+			if((end_pointer == value_string)||(errno == ERANGE)||(long_value < INT_MIN)||
+			   (long_value > INT_MAX))
+				return FALSE;
+			(*(int *)value) = (int)long_value;
+			return TRUE;
+		case DPRT_JNI_PROPERTY_TYPE_DOUBLE:
+			double_value = strtod(value_string,&end_pointer);
+			if(end_pointer == value_string)
+				return FALSE;
+			(*(double *)value) = double_value;
+			return TRUE;
+		case DPRT_JNI_PROPERTY_TYPE_BOOLEAN:
+			if((strcmp(value_string,"true")==0)||(strcmp(value_string,"TRUE")==0)||
+			   (strcmp(value_string,"True")==0))
+				(*(int *)value) = TRUE;
+			else if((strcmp(value_string,"false")==0)||(strcmp(value_string,"FALSE")==0)||
+				(strcmp(value_string,"False")==0))
+				(*(int *)value) = FALSE;
+			else
+				return FALSE;
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * Routine to get the value of the specified type of a property index entry. Integer, double and boolean values 
+ * were converted when the index was built, so are just copied out of the entry.
+ * The caller should hold the index (by a lock or reference).
+ * @param index The index containing the entry.
+ * @param entry The entry.
+ * @param type Which value to retrieve, one of DPRT_JNI_PROPERTY_TYPE_STRING, DPRT_JNI_PROPERTY_TYPE_INTEGER,
+ *        DPRT_JNI_PROPERTY_TYPE_DOUBLE, DPRT_JNI_PROPERTY_TYPE_BOOLEAN.
+ * @param value The address to store the value in. For DPRT_JNI_PROPERTY_TYPE_STRING, this is a (char **),
+ *        and the string is allocated and must be freed using <b>free()</b>. Otherwise this is an (int *),
+ *        (double *) or (int *) respectively.
+ * @return The routine returns TRUE if it succeeds, FALSE if the value could not be converted to the type 
+ *         (or copied).
+ * @see #Property_Entry_Struct
+ */
+static int DpRt_JNI_Property_Entry_Value_Get(struct DpRt_JNI_Property_Snapshot_Struct *index,
+					     struct Property_Entry_Struct *entry,int type,void *value)
+{
+	if((type < 0)||(type >= DPRT_JNI_PROPERTY_TYPE_COUNT)||(entry->Valid_List[type] == FALSE))
+		return FALSE;
+	switch(type)
+	{
+		case DPRT_JNI_PROPERTY_TYPE_STRING:
+			(*(char **)value) = strdup(index->Value_Arena+entry->Value_String_Offset);
+			return ((*(char **)value) != NULL);
+		case DPRT_JNI_PROPERTY_TYPE_INTEGER:
+			(*(int *)value) = entry->Integer_Value;
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_DOUBLE:
+			(*(double *)value) = entry->Double_Value;
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_BOOLEAN:
+			(*(int *)value) = entry->Boolean_Value;
+			break;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to get the integer, double or boolean value of the keyword from the property file. 
+ * The keyword is looked up in the property file hash index Property_Index, which is (re-)loaded 
+ * if necessary by DpRt_JNI_Property_Index_Check, and the value (converted when the index was built) copied out
+ * of it's entry under the read lock.
+ * @param keyword The keyword in the property file to look up.
+ * @param type Which value to retrieve, one of DPRT_JNI_PROPERTY_TYPE_INTEGER, DPRT_JNI_PROPERTY_TYPE_DOUBLE,
+ *        DPRT_JNI_PROPERTY_TYPE_BOOLEAN.
+ * @param value The address to store the value in, an (int *), (double *) or (int *) respectively.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #PROPERTY_FILE_NAME
+ * @see #Property_Index
+ * @see #Property_Index_Lock
+ * @see #DpRt_JNI_Property_Index_Find
+ * @see #DpRt_JNI_Property_Entry_Value_Get
+ */
+static int DpRt_JNI_Get_Property_Converted_From_C_File(char *keyword,int type,void *value)
+{
+	struct Property_Entry_Struct *entry = NULL;
+
+	if(!DpRt_JNI_Property_Index_Check(FALSE))
+		return FALSE;
+	pthread_rwlock_rdlock(&Property_Index_Lock);
+	entry = DpRt_JNI_Property_Index_Find(Property_Index,keyword);
+	if(entry == NULL)
+	{
+		pthread_rwlock_unlock(&Property_Index_Lock);
+		DpRt_JNI_Error_Set(40,"DpRt_Get_Property_From_C_File failed:Failed to find keyword (%s,%s).\n",
+			PROPERTY_FILE_NAME,keyword);
+		return FALSE;
+	}
+	if(DpRt_JNI_Property_Entry_Value_Get(Property_Index,entry,type,value))
+	{
+		pthread_rwlock_unlock(&Property_Index_Lock);
+		return TRUE;
+	}
+	if(type == DPRT_JNI_PROPERTY_TYPE_INTEGER)
+	{
+		DpRt_JNI_Error_Set(41,"DpRt_Get_Property_Integer_From_C_File failed:"
+			"Failed to convert (%s,%s,%s).\n",PROPERTY_FILE_NAME,keyword,
+			Property_Index->Value_Arena+entry->Value_String_Offset);
+	}
+	else if(type == DPRT_JNI_PROPERTY_TYPE_DOUBLE)
+	{
+		DpRt_JNI_Error_Set(42,"DpRt_Get_Property_Double_From_C_File failed:"
+			"Failed to convert (%s,%s,%s).\n",PROPERTY_FILE_NAME,keyword,
+			Property_Index->Value_Arena+entry->Value_String_Offset);
+	}
+	else
+	{
+		DpRt_JNI_Error_Set(43,"DpRt_Get_Property_Boolean_From_C_File failed:"
+			"Failed to convert (%s,%s,%s).\n",PROPERTY_FILE_NAME,keyword,
+			Property_Index->Value_Arena+entry->Value_String_Offset);
+	}
+	pthread_rwlock_unlock(&Property_Index_Lock);
+	return FALSE;
+}
+
+/**
+ * Routine to borrow the NULL terminated value of the keyword from the property file, without copying it.
+ * This routine assumes keyword has been checked as being non-null.
+ * The property file snapshot is acquired with DpRt_JNI_Property_File_Snapshot_Acquire (which (re-)loads 
+ * the index if necessary), and the keyword looked up in it. 
+ * @param keyword The keyword in the property file to look up.
+ * @param snapshot The address of a pointer to store the acquired snapshot in. On success, the caller must 
+ *        release it with DpRt_JNI_Property_Snapshot_Release once it has finished with value_string.
+ * @param value_string The address of a pointer to store the value string in. This points into the snapshot's
+ *        value arena, and must not be modified or freed.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails (the snapshot is not held).
+ * @see #PROPERTY_FILE_NAME
+ * @see #DpRt_JNI_Property_File_Snapshot_Acquire
+ * @see #DpRt_JNI_Property_Index_Find
+ */
+static int DpRt_JNI_Get_Property_View_From_C_File(char *keyword,struct DpRt_JNI_Property_Snapshot_Struct **snapshot,
+						  char **value_string)
+{
+	struct Property_Entry_Struct *entry = NULL;
+
+	(*value_string) = NULL;
+	if(!DpRt_JNI_Property_File_Snapshot_Acquire(snapshot))
+		return FALSE;
+	entry = DpRt_JNI_Property_Index_Find((*snapshot),keyword);
+	if(entry == NULL)
+	{
+		DpRt_JNI_Property_Snapshot_Release((*snapshot));
+		(*snapshot) = NULL;
+		DpRt_JNI_Error_Set(40,"DpRt_Get_Property_From_C_File failed:Failed to find keyword (%s,%s).\n",
+			PROPERTY_FILE_NAME,keyword);
+		return FALSE;
+	}
+	(*value_string) = (*snapshot)->Value_Arena+entry->Value_String_Offset;
+	return TRUE;
+}
+
+/**
+ * Routine to acquire a reference to the current property file index, (re-)loading it if necessary
+ * with DpRt_JNI_Property_Index_Check. The index stays valid (even if it is replaced by a re-loaded index)
+ * until the reference is released.
+ * @param snapshot The address of a pointer to store the index in.
+ * @return The routine returns TRUE if it succeeds, FALSE if the property file could not be loaded.
+ * @see #Property_Index
+ * @see #Property_Index_Lock
+ * @see #DpRt_JNI_Property_Index_Check
+ * @see #DpRt_JNI_Property_Snapshot_Release
+ */
+static int DpRt_JNI_Property_File_Snapshot_Acquire(struct DpRt_JNI_Property_Snapshot_Struct **snapshot)
+{
+	(*snapshot) = NULL;
+	if(!DpRt_JNI_Property_Index_Check(FALSE))
+		return FALSE;
+	pthread_rwlock_rdlock(&Property_Index_Lock);
+	(*snapshot) = Property_Index;
+	if((*snapshot) != NULL)
+		__atomic_add_fetch(&((*snapshot)->Reference_Count),1,__ATOMIC_RELAXED);
+	pthread_rwlock_unlock(&Property_Index_Lock);
+	if((*snapshot) == NULL)
+	{
+		DpRt_JNI_Error_Set(130,"DpRt_Get_Property_From_C_File failed:No property index (%s).\n",
+			PROPERTY_FILE_NAME);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Routine to load the property file into a new hash index. The property file is mapped read-only into memory
+ * using <b>mmap</b>, and DpRt_JNI_Property_Index_Build used to index it. The index copies the keywords and 
+ * values, so the file is unmapped as soon as it has been indexed, and lookups never touch the mapping.
+ * The property file should still be replaced (e.g. written to a new file and renamed) rather than 
+ * truncated and re-written in place, as truncating it whilst it is being indexed would raise SIGBUS.
+ * @param index The address of a pointer to store the newly allocated index in. The index should be freed using
+ *        DpRt_JNI_Property_Index_Free.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #PROPERTY_FILE_NAME
+ * @see #DpRt_JNI_Property_Index_Build
+ * @see #DpRt_JNI_Property_Index_Free
+ */
+static int DpRt_JNI_Property_Index_Load(struct DpRt_JNI_Property_Snapshot_Struct **index)
+{
+	struct stat file_status;
+	char *buffer = NULL;
+	int fd,retval;
+
+	(*index) = NULL;
+	fd = open(PROPERTY_FILE_NAME,O_RDONLY);
+	if(fd < 0)
+	{
+		DpRt_JNI_Error_Set(38,"DpRt_Get_Property_From_C_File failed: File open (%s) failed.\n",
+			PROPERTY_FILE_NAME);
+		return FALSE;
+	}
+	if(fstat(fd,&file_status) != 0)
+	{
+		close(fd);
+		DpRt_JNI_Error_Set(44,"DpRt_JNI_Property_Index_Load failed: File stat (%s) failed.\n",
+			PROPERTY_FILE_NAME);
+		return FALSE;
+	}
+	/* mmap fails for zero length files, which are treated as containing no properties */
+	if(file_status.st_size > 0)
+	{
+		buffer = (char *)mmap(NULL,(size_t)file_status.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+		if(buffer == MAP_FAILED)
+		{
+			close(fd);
+			DpRt_JNI_Error_Set(45,"DpRt_JNI_Property_Index_Load failed: File mmap (%s,%ld) failed.\n",
+				PROPERTY_FILE_NAME,(long)file_status.st_size);
+			return FALSE;
+		}
+		madvise(buffer,(size_t)file_status.st_size,MADV_SEQUENTIAL);
+	}
+	close(fd);
+	retval = DpRt_JNI_Property_Index_Build(buffer,(size_t)file_status.st_size,index);
+	if(buffer != NULL)
+		munmap(buffer,(size_t)file_status.st_size);
+	if(retval == FALSE)
+		return FALSE;
+	(*index)->Device = file_status.st_dev;
+	(*index)->Inode = file_status.st_ino;
+	(*index)->Size = file_status.st_size;
+	(*index)->Modification_Time = file_status.st_mtime;
+	return TRUE;
+}
+
+/**
+ * Routine to build a new hash index of the properties in a buffer. 
+ * The buffer is split into lines using <b>memchr</b> (which is vectorised in the C library), 
+ * so there is no limit on the line length.
+ * Each line of the form <b>keyword=value</b> is added to the index, comment lines (starting with '#' or '!') 
+ * and lines without an '=' are ignored. If a keyword occurs more than once, the first occurence is the one 
+ * found by DpRt_JNI_Property_Index_Find, as with the original line by line search of the property file.
+ * The index, it's bucket list, entry list and arena are allocated in one block. The arena holds a NULL 
+ * terminated copy of each keyword and value, so values can be borrowed without copying them again, and the
+ * index does not refer to the buffer once it has been built.
+ * Each value is also converted to an integer, double and boolean once here, with DpRt_JNI_Property_Value_Parse,
+ * so typed lookups need not parse it again.
+ * The caller keeps ownership of the buffer, and can release it as soon as this returns.
+ * The new index has a reference count of one.
+ * @param buffer The buffer containing the properties. Can be NULL if buffer_length is zero.
+ * @param buffer_length The length of the buffer in bytes.
+ * @param index The address of a pointer to store the newly allocated index in. The index should be freed using
+ *        DpRt_JNI_Property_Index_Free.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #PROPERTY_INDEX_MIN_BUCKET_COUNT
+ * @see #DpRt_JNI_Property_Snapshot_Struct
+ * @see #DpRt_JNI_Property_Hash
+ * @see #DpRt_JNI_Property_Value_Parse
+ * @see #DpRt_JNI_Property_Index_Free
+ */
+static int DpRt_JNI_Property_Index_Build(char *buffer,size_t buffer_length,
+					 struct DpRt_JNI_Property_Snapshot_Struct **index)
+{
+	struct Property_Entry_Struct *entry = NULL;
+	char *line_start = NULL;
+	char *line_end = NULL;
+	char *buffer_end = NULL;
+	char *value_string = NULL;
+	char *ch = NULL;
+	size_t keyword_length;
+	size_t arena_length;
+	unsigned int bucket_count,bucket;
+	int line_count,entry_index,*tail_list = NULL;
+
+	(*index) = NULL;
+	buffer_end = buffer+buffer_length;
+/* count the lines, to size the entry list and hash table */
+	line_count = 0;
+	line_start = buffer;
+	while(line_start < buffer_end)
+	{
+		line_end = (char *)memchr(line_start,'\n',buffer_end-line_start);
+		line_count++;
+		if(line_end == NULL)
+			break;
+		line_start = line_end+1;
+	}
+	bucket_count = PROPERTY_INDEX_MIN_BUCKET_COUNT;
+	while(bucket_count < (unsigned int)(line_count*2))
+		bucket_count <<= 1;
+/* allocate the index, bucket list, entry list and arena in one block.
+** A keyword and value (plus their NULL terminators) are at most one byte longer than their line (which also 
+** holds the '='), so the arena is at most buffer_length+line_count.
+** The bucket tail list is only needed whilst building the index, to keep entries in file order. */
+	(*index) = (struct DpRt_JNI_Property_Snapshot_Struct *)malloc(sizeof(struct DpRt_JNI_Property_Snapshot_Struct)+
+							  (line_count*sizeof(struct Property_Entry_Struct))+
+							  (bucket_count*sizeof(int))+buffer_length+line_count);
+	tail_list = (int *)malloc(bucket_count*sizeof(int));
+	if(((*index) == NULL)||(tail_list == NULL))
+	{
+		if((*index) != NULL)
+			free((*index));
+		(*index) = NULL;
+		if(tail_list != NULL)
+			free(tail_list);
+		DpRt_JNI_Error_Set(46,"DpRt_JNI_Property_Index_Build failed: "
+			"Memory Allocation error(%d,%u).\n",line_count,bucket_count);
+		return FALSE;
+	}
+	(*index)->Entry_List = (struct Property_Entry_Struct *)((*index)+1);
+	(*index)->Entry_Count = 0;
+	(*index)->Bucket_List = (int *)((*index)->Entry_List+line_count);
+	(*index)->Bucket_Count = bucket_count;
+	(*index)->Value_Arena = (char *)((*index)->Bucket_List+bucket_count);
+	(*index)->Reference_Count = 1;
+	(*index)->Device = 0;
+	(*index)->Inode = 0;
+	(*index)->Size = (off_t)buffer_length;
+	(*index)->Modification_Time = 0;
+	memset((*index)->Bucket_List,-1,bucket_count*sizeof(int));
+	memset(tail_list,-1,bucket_count*sizeof(int));
+	arena_length = 0;
+/* add each keyword=value line to the index */
+	line_start = buffer;
+	while(line_start < buffer_end)
+	{
+		line_end = (char *)memchr(line_start,'\n',buffer_end-line_start);
+		if(line_end == NULL)
+			line_end = buffer_end;
+		if((line_start[0] != '#')&&(line_start[0] != '!')&&
+		   ((ch = (char *)memchr(line_start,'=',line_end-line_start)) != NULL))
+		{
+			keyword_length = ch-line_start;
+			while((keyword_length > 0)&&((line_start[keyword_length-1] == ' ')||
+						     (line_start[keyword_length-1] == '\t')))
+				keyword_length--;
+			entry_index = (*index)->Entry_Count++;
+			entry = &((*index)->Entry_List[entry_index]);
+			entry->Keyword_String_Offset = arena_length;
+			entry->Keyword_Length = keyword_length;
+			memcpy((*index)->Value_Arena+arena_length,line_start,keyword_length);
+			arena_length += keyword_length;
+			(*index)->Value_Arena[arena_length++] = '\0';
+			entry->Value_Length = line_end-(ch+1);
+			entry->Value_String_Offset = arena_length;
+			memcpy((*index)->Value_Arena+arena_length,ch+1,entry->Value_Length);
+			arena_length += entry->Value_Length;
+			(*index)->Value_Arena[arena_length++] = '\0';
+			value_string = (*index)->Value_Arena+entry->Value_String_Offset;
+			entry->Valid_List[DPRT_JNI_PROPERTY_TYPE_STRING] = TRUE;
+			entry->Valid_List[DPRT_JNI_PROPERTY_TYPE_INTEGER] = DpRt_JNI_Property_Value_Parse(value_string,
+							DPRT_JNI_PROPERTY_TYPE_INTEGER,&(entry->Integer_Value));
+			entry->Valid_List[DPRT_JNI_PROPERTY_TYPE_DOUBLE] = DpRt_JNI_Property_Value_Parse(value_string,
+							DPRT_JNI_PROPERTY_TYPE_DOUBLE,&(entry->Double_Value));
+			entry->Valid_List[DPRT_JNI_PROPERTY_TYPE_BOOLEAN] = DpRt_JNI_Property_Value_Parse(value_string,
+							DPRT_JNI_PROPERTY_TYPE_BOOLEAN,&(entry->Boolean_Value));
+			entry->Hash = DpRt_JNI_Property_Hash(line_start,keyword_length);
+			entry->Next = -1;
+			bucket = entry->Hash&(bucket_count-1);
+			if(tail_list[bucket] < 0)
+				(*index)->Bucket_List[bucket] = entry_index;
+			else
+				(*index)->Entry_List[tail_list[bucket]].Next = entry_index;
+			tail_list[bucket] = entry_index;
+		}
+		line_start = line_end+1;
+	}
+	free(tail_list);
+	return TRUE;
+}
+
+/**
+ * Routine to free a property index allocated by DpRt_JNI_Property_Index_Build. Indexes that may have
+ * been acquired as snapshots should be released with DpRt_JNI_Property_Snapshot_Release instead.
+ * @param index The index to free. Can be NULL.
+ * @see #DpRt_JNI_Property_Index_Build
+ */
+static void DpRt_JNI_Property_Index_Free(struct DpRt_JNI_Property_Snapshot_Struct *index)
+{
+	if(index == NULL)
 		return;
+	free(index);
+}
+
+/**
+ * Routine to check whether the property index needs (re-)loading, and to load it if so.
+ * If the index is loaded and force is FALSE, the property file is only checked if 
+ * PROPERTY_FILE_CHECK_INTERVAL seconds have elapsed since the last check. The file is re-loaded if
+ * it's device, inode, size or modification time differ from those the current index was loaded from.
+ * A re-loaded index replaces the current index under the write lock, the old index is then released
+ * (and freed once no acquired snapshots refer to it).
+ * @param force If TRUE, always stat the property file rather than waiting for the check interval to elapse.
+ * @return The routine returns TRUE if an up to date index is available, and FALSE if one could not be loaded.
+ * @see #Property_Index
+ * @see #Property_Index_Lock
+ * @see #Property_Index_Check_Time
+ * @see #PROPERTY_FILE_CHECK_INTERVAL
+ * @see #DpRt_JNI_Property_Index_Load
+ * @see #DpRt_JNI_Property_Index_Free
+ */
+static int DpRt_JNI_Property_Index_Check(int force)
+{
+	struct DpRt_JNI_Property_Snapshot_Struct *new_index = NULL;
+	struct DpRt_JNI_Property_Snapshot_Struct *old_index = NULL;
+	struct stat file_status;
+	time_t current_time;
+	int reload;
+
+	current_time = time(NULL);
+	pthread_rwlock_rdlock(&Property_Index_Lock);
+	if((Property_Index != NULL)&&(force == FALSE)&&
+	   ((current_time-Property_Index_Check_Time) < PROPERTY_FILE_CHECK_INTERVAL))
+	{
+		pthread_rwlock_unlock(&Property_Index_Lock);
+		return TRUE;
+	}
+	pthread_rwlock_unlock(&Property_Index_Lock);
+	pthread_rwlock_wrlock(&Property_Index_Lock);
+	Property_Index_Check_Time = current_time;
+	if(Property_Index == NULL)
+		reload = TRUE;
+	else if(stat(PROPERTY_FILE_NAME,&file_status) != 0)
+		reload = FALSE; /* keep using the current index if the file has (temporarily) gone */
+	else
+	{
+		reload = (file_status.st_dev != Property_Index->Device)||
+			(file_status.st_ino != Property_Index->Inode)||
+			(file_status.st_size != Property_Index->Size)||
+			(file_status.st_mtime != Property_Index->Modification_Time);
+	}
+	if(reload)
+	{
+		if(!DpRt_JNI_Property_Index_Load(&new_index))
+		{
+			reload = (Property_Index != NULL);
+			pthread_rwlock_unlock(&Property_Index_Lock);
+			return reload;
+		}
+		old_index = Property_Index;
+		Property_Index = new_index;
+		__atomic_add_fetch(&Property_Index_Generation,1,__ATOMIC_RELEASE);
+	}
+	pthread_rwlock_unlock(&Property_Index_Lock);
+	DpRt_JNI_Property_Snapshot_Release(old_index);
+	return TRUE;
+}
+
+/**
+ * Routine to find the entry for a keyword in a property index. The caller should hold 
+ * at least the read lock of Property_Index_Lock.
+ * @param index The index to search.
+ * @param keyword The keyword to look for.
+ * @return The entry for the keyword, or NULL if the keyword is not in the index.
+ * @see #DpRt_JNI_Property_Hash
+ */
+static struct Property_Entry_Struct *DpRt_JNI_Property_Index_Find(struct DpRt_JNI_Property_Snapshot_Struct *index,
+								  char *keyword)
+{
+	struct Property_Entry_Struct *entry = NULL;
+	size_t keyword_length;
+	unsigned int hash;
+	int entry_index;
+
+	if(index == NULL)
+		return NULL;
+	keyword_length = strlen(keyword);
+	hash = DpRt_JNI_Property_Hash(keyword,keyword_length);
+	entry_index = index->Bucket_List[hash&(index->Bucket_Count-1)];
+	while(entry_index >= 0)
+	{
+		entry = &(index->Entry_List[entry_index]);
+		if((entry->Hash == hash)&&(entry->Keyword_Length == keyword_length)&&
+		   (memcmp(index->Value_Arena+entry->Keyword_String_Offset,keyword,keyword_length) == 0))
+			return entry;
+		entry_index = entry->Next;
 	}
+	return NULL;
 }
 
 /**
- * This native method is called from DpRtLibrary's instrumetn specific finaliser method. 
- * It removes the global reference to logger.
- * @see #Logger
+ * Routine to compute the hash of a string, used to index the property hash table.
+ * The 32 bit FNV-1a hash is used.
+ * @param string The string to hash.
+ * @param length The number of characters in the string to hash.
+ * @return The hash value.
  */
-void DpRt_JNI_Finalise_Logger_Reference(JNIEnv *env)
+static unsigned int DpRt_JNI_Property_Hash(char *string,size_t length)
 {
-	(*env)->DeleteGlobalRef(env,Logger);
+	unsigned int hash = 2166136261U;
+	size_t i;
+
+	for(i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)string[i];
+		hash *= 16777619U;
+	}
+	return hash;
 }
 
 /**
- * Routine called as DpRt is finalised, to clear up DpRt_Status global reference.
+ * Routine to look up a keyword's value of the specified type in the snapshot of the DpRtStatus properties.
+ * Keywords that do not start with the snapshot prefix are not looked up. String values for keywords
+ * not in the snapshot are returned as NULL, as the DpRtStatus getProperty method does.
+ * @param keyword The keyword to look up.
+ * @param type Which value to retrieve, one of DPRT_JNI_PROPERTY_TYPE_STRING, DPRT_JNI_PROPERTY_TYPE_INTEGER,
+ *        DPRT_JNI_PROPERTY_TYPE_DOUBLE, DPRT_JNI_PROPERTY_TYPE_BOOLEAN.
+ * @param value The address to store the value in. For DPRT_JNI_PROPERTY_TYPE_STRING, this is a (char **),
+ *        and the string is allocated and must be freed using <b>free()</b>. Otherwise this is an (int *),
+ *        (double *) or (int *) respectively.
+ * @return The routine returns TRUE if the value was retrieved from the snapshot, and FALSE if there is no 
+ *         snapshot covering the keyword, or the value could not be converted (or copied).
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Property_Index_Find
+ * @see #DpRt_JNI_Property_Entry_Value_Get
+ */
+static int DpRt_JNI_Status_Snapshot_Get(char *keyword,int type,void *value)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	struct Property_Entry_Struct *entry = NULL;
+	int retval;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if(__atomic_load_n(&context->Status_Snapshot_Index,__ATOMIC_ACQUIRE) == NULL)
+		return FALSE;
+	pthread_rwlock_rdlock(&context->Status_Snapshot_Lock);
+	if((context->Status_Snapshot_Index == NULL)||((context->Status_Snapshot_Prefix != NULL)&&
+		(strncmp(keyword,context->Status_Snapshot_Prefix,strlen(context->Status_Snapshot_Prefix)) != 0)))
+	{
+		pthread_rwlock_unlock(&context->Status_Snapshot_Lock);
+		return FALSE;
+	}
+	entry = DpRt_JNI_Property_Index_Find(context->Status_Snapshot_Index,keyword);
+	if(entry == NULL)
+	{
+		pthread_rwlock_unlock(&context->Status_Snapshot_Lock);
+		if(type != DPRT_JNI_PROPERTY_TYPE_STRING)
+			return FALSE;
+		(*(char **)value) = NULL;
+		return TRUE;
+	}
+	retval = DpRt_JNI_Property_Entry_Value_Get(context->Status_Snapshot_Index,entry,type,value);
+	pthread_rwlock_unlock(&context->Status_Snapshot_Lock);
+	return retval;
+}
+
+/**
+ * Routine to look up a keyword's value of the specified type in the DpRtStatus property cache.
+ * @param keyword The keyword to look up.
+ * @param type Which value to retrieve, one of DPRT_JNI_PROPERTY_TYPE_STRING, DPRT_JNI_PROPERTY_TYPE_INTEGER,
+ *        DPRT_JNI_PROPERTY_TYPE_DOUBLE, DPRT_JNI_PROPERTY_TYPE_BOOLEAN.
+ * @param value The address to store the value in. For DPRT_JNI_PROPERTY_TYPE_STRING, this is a (char **),
+ *        and the string is allocated and must be freed using <b>free()</b>. Otherwise this is an (int *),
+ *        (double *) or (int *) respectively.
+ * @param generation The address of an unsigned integer to store the cache generation the lookup was made in.
+ *        This should be passed to DpRt_JNI_Status_Property_Cache_Put if the value is retrieved from the 
+ *        DpRtStatus object after a cache miss, so a value retrieved across an invalidation is not cached as current.
+ * @return The routine returns TRUE if an up to date value was found in the cache, and FALSE if it was not
+ *         (or a copy of the string could not be allocated).
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Property_Hash
+ */
+static int DpRt_JNI_Status_Property_Cache_Get(char *keyword,int type,void *value,unsigned int *generation)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	struct Status_Property_Cache_Entry_Struct *entry = NULL;
+	unsigned int hash;
+	char *string_value = NULL;
+
+	context = DpRt_JNI_Context_Get_Current();
+	(*generation) = __atomic_load_n(&context->Status_Property_Cache_Generation,__ATOMIC_ACQUIRE);
+	hash = DpRt_JNI_Property_Hash(keyword,strlen(keyword));
+	pthread_mutex_lock(&context->Status_Property_Cache_Lock);
+	entry = context->Status_Property_Cache[hash&(STATUS_PROPERTY_CACHE_BUCKET_COUNT-1)];
+	while((entry != NULL)&&((entry->Hash != hash)||(strcmp(entry->Keyword,keyword) != 0)))
+		entry = entry->Next;
+	if((entry == NULL)||(entry->Generation != (*generation))||(entry->Valid_List[type] == FALSE))
+	{
+		pthread_mutex_unlock(&context->Status_Property_Cache_Lock);
+		return FALSE;
+	}
+	switch(type)
+	{
+		case DPRT_JNI_PROPERTY_TYPE_STRING:
+			if(entry->String_Value != NULL)
+			{
+				string_value = strdup(entry->String_Value);
+				if(string_value == NULL)
+				{
+					pthread_mutex_unlock(&context->Status_Property_Cache_Lock);
+					return FALSE;
+				}
+			}
+			(*(char **)value) = string_value;
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_INTEGER:
+			(*(int *)value) = entry->Integer_Value;
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_DOUBLE:
+			(*(double *)value) = entry->Double_Value;
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_BOOLEAN:
+			(*(int *)value) = entry->Boolean_Value;
+			break;
+	}
+	pthread_mutex_unlock(&context->Status_Property_Cache_Lock);
+	return TRUE;
+}
+
+/**
+ * Routine to store a keyword's value of the specified type in the DpRtStatus property cache.
+ * If the keyword's existing entry is from an older generation, it's values are discarded first.
+ * If memory cannot be allocated for the entry, the value is just not cached.
+ * @param keyword The keyword.
+ * @param generation The cache generation returned by DpRt_JNI_Status_Property_Cache_Get before the value
+ *        was retrieved. If the cache has since been invalidated, the value is not cached.
+ * @param type Which value to store, one of DPRT_JNI_PROPERTY_TYPE_STRING, DPRT_JNI_PROPERTY_TYPE_INTEGER,
+ *        DPRT_JNI_PROPERTY_TYPE_DOUBLE, DPRT_JNI_PROPERTY_TYPE_BOOLEAN.
+ * @param value The address of the value. For DPRT_JNI_PROPERTY_TYPE_STRING, this is a (char **), the string
+ *        is copied. Otherwise this is an (int *), (double *) or (int *) respectively.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #DpRt_JNI_Property_Hash
+ */
+static void DpRt_JNI_Status_Property_Cache_Put(char *keyword,unsigned int generation,int type,void *value)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	struct Status_Property_Cache_Entry_Struct *entry = NULL;
+	unsigned int hash,bucket;
+	char *string_value = NULL;
+	int i;
+
+	context = DpRt_JNI_Context_Get_Current();
+	if((type == DPRT_JNI_PROPERTY_TYPE_STRING)&&((*(char **)value) != NULL))
+	{
+		string_value = strdup((*(char **)value));
+		if(string_value == NULL)
+			return;
+	}
+	hash = DpRt_JNI_Property_Hash(keyword,strlen(keyword));
+	bucket = hash&(STATUS_PROPERTY_CACHE_BUCKET_COUNT-1);
+	pthread_mutex_lock(&context->Status_Property_Cache_Lock);
+	if(generation != __atomic_load_n(&context->Status_Property_Cache_Generation,__ATOMIC_ACQUIRE))
+	{
+		pthread_mutex_unlock(&context->Status_Property_Cache_Lock);
+		if(string_value != NULL)
+			free(string_value);
+		return;
+	}
+	entry = context->Status_Property_Cache[bucket];
+	while((entry != NULL)&&((entry->Hash != hash)||(strcmp(entry->Keyword,keyword) != 0)))
+		entry = entry->Next;
+	if(entry == NULL)
+	{
+		entry = (struct Status_Property_Cache_Entry_Struct *)malloc(
+						sizeof(struct Status_Property_Cache_Entry_Struct)+strlen(keyword)+1);
+		if(entry == NULL)
+		{
+			pthread_mutex_unlock(&context->Status_Property_Cache_Lock);
+			if(string_value != NULL)
+				free(string_value);
+			return;
+		}
+		entry->Keyword = (char *)(entry+1);
+		strcpy(entry->Keyword,keyword);
+		entry->Hash = hash;
+		entry->String_Value = NULL;
+		for(i = 0; i < DPRT_JNI_PROPERTY_TYPE_COUNT; i++)
+			entry->Valid_List[i] = FALSE;
+		entry->Generation = generation;
+		entry->Next = context->Status_Property_Cache[bucket];
+		context->Status_Property_Cache[bucket] = entry;
+	}
+	if(entry->Generation != generation)
+	{
+		for(i = 0; i < DPRT_JNI_PROPERTY_TYPE_COUNT; i++)
+			entry->Valid_List[i] = FALSE;
+		entry->Generation = generation;
+	}
+	switch(type)
+	{
+		case DPRT_JNI_PROPERTY_TYPE_STRING:
+			if(entry->String_Value != NULL)
+				free(entry->String_Value);
+			entry->String_Value = string_value;
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_INTEGER:
+			entry->Integer_Value = (*(int *)value);
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_DOUBLE:
+			entry->Double_Value = (*(double *)value);
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_BOOLEAN:
+			entry->Boolean_Value = (*(int *)value);
+			break;
+	}
+	entry->Valid_List[type] = TRUE;
+	pthread_mutex_unlock(&context->Status_Property_Cache_Lock);
+}
+
+/**
+ * Routine to free all the entries in the DpRtStatus property cache.
+ * @see #DpRt_JNI_Context_Struct
+ */
+static void DpRt_JNI_Status_Property_Cache_Free(void)
+{
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	struct Status_Property_Cache_Entry_Struct *entry = NULL;
+	struct Status_Property_Cache_Entry_Struct *next_entry = NULL;
+	int bucket;
+
+	context = DpRt_JNI_Context_Get_Current();
+	pthread_mutex_lock(&context->Status_Property_Cache_Lock);
+	for(bucket = 0; bucket < STATUS_PROPERTY_CACHE_BUCKET_COUNT; bucket++)
+	{
+		entry = context->Status_Property_Cache[bucket];
+		while(entry != NULL)
+		{
+			next_entry = entry->Next;
+			if(entry->String_Value != NULL)
+				free(entry->String_Value);
+			free(entry);
+			entry = next_entry;
+		}
+		context->Status_Property_Cache[bucket] = NULL;
+	}
+	pthread_mutex_unlock(&context->Status_Property_Cache_Lock);
+}
+
+/**
+ * Routine to deliver a log message to the Java layer. A java.lang.String instance is constructed from
+ * the string parameter, and the local reference deleted afterwards.
+ * If a log record handler is set, any of the interned IDs not yet registered with it are registered,
+ * and the handler's log method is called with the IDs and message. Otherwise the logger's log method is called.
+ * If log() throws an exception, it is described and cleared, so it cannot affect the caller.
+ * @param env The JNI environment pointer for the calling thread.
+ * @param logger The global reference to the logger of the context the message was logged in.
+ * @param level The log level of the message.
+ * @param sub_system_id The interned ID of the sub-system, or 0.
+ * @param source_filename_id The interned ID of the source filename, or 0.
+ * @param function_id The interned ID of the function, or 0.
+ * @param category_id The interned ID of the category, or 0.
+ * @param string The message to log.
+ * @see #Log_Method_Id
+ * @see #Log_Record_Handler
+ * @see #DpRt_JNI_Log_Register_String
+ */
+static void DpRt_JNI_Log_Deliver(JNIEnv *env,jobject logger,int level,int sub_system_id,int source_filename_id,
+				 int function_id,int category_id,char *string)
+{
+	jobject handler = NULL;
+	jstring java_string = NULL;
+
+/* we count as a user of the handler before loading it, so it's reference is not deleted whilst we use it */
+	__atomic_add_fetch(&Log_Record_Handler_User_Count,1,__ATOMIC_SEQ_CST);
+	handler = __atomic_load_n(&Log_Record_Handler,__ATOMIC_SEQ_CST);
+	if((handler != NULL)&&
+	   ((DpRt_JNI_Log_Register_String(env,handler,sub_system_id) == FALSE)||
+	    (DpRt_JNI_Log_Register_String(env,handler,source_filename_id) == FALSE)||
+	    (DpRt_JNI_Log_Register_String(env,handler,function_id) == FALSE)||
+	    (DpRt_JNI_Log_Register_String(env,handler,category_id) == FALSE)))
+	{
+		/* registration failed, fall back to the logger */
+		handler = NULL;
+	}
+/* convert C to Java String */
+	java_string = (*env)->NewStringUTF(env,string);
+	DpRt_JNI_Local_Reference_Created(java_string);
+/* call log method on log record handler or logger instance */
+	if(handler != NULL)
+	{
+		(*env)->CallVoidMethod(env,handler,Log_Record_Handler_Log_Method_Id,(jint)level,(jint)sub_system_id,
+				       (jint)source_filename_id,(jint)function_id,(jint)category_id,java_string);
+	}
+	else
+		(*env)->CallVoidMethod(env,logger,Log_Method_Id,(jint)level,java_string);
+	__atomic_sub_fetch(&Log_Record_Handler_User_Count,1,__ATOMIC_SEQ_CST);
+	if((*env)->ExceptionCheck(env))
+	{
+		(*env)->ExceptionDescribe(env);
+		(*env)->ExceptionClear(env);
+	}
+	if(java_string != NULL)
+		DpRt_JNI_Delete_Local_Reference(env,java_string);
+}
+
+/**
+ * Routine to register an interned log string with the Java log record handler, if it has not already been.
+ * The fast path (already registered) does not lock. The ID is claimed under Log_String_Lock (so it is sent 
+ * once per handler, and always before a record using it), but the Java upcall is made with the lock released,
+ * so a handler that logs back into this library cannot deadlock. If another call is registering the ID 
+ * (including a re-entrant call from the handler itself), FALSE is returned and the caller falls back to 
+ * the logger for that record.
+ * @param env The JNI environment pointer for the calling thread.
+ * @param handler The log record handler, which the caller is counted as a user of.
+ * @param id The interned string ID. 0 (none) is never registered.
+ * @return The routine returns TRUE if the ID is registered (or 0), FALSE if it is not (yet).
+ * @see #Log_String_List
+ * @see #Log_Record_Handler
+ * @see #Log_Record_Handler_Register_Method_Id
+ * @see #Log_Record_Handler_Generation
+ */
+static int DpRt_JNI_Log_Register_String(JNIEnv *env,jobject handler,int id)
+{
+	jstring java_string = NULL;
+	jmethodID register_method_id = NULL;
+	unsigned int generation;
+	int retval;
+
+	if(id == 0)
+		return TRUE;
+	if(__atomic_load_n(&(Log_String_List[id-1].Registered),__ATOMIC_ACQUIRE) == LOG_STRING_REGISTERED)
+		return TRUE;
+/* claim the ID */
+	pthread_mutex_lock(&Log_String_Lock);
+	if((Log_String_List[id-1].Registered != LOG_STRING_UNREGISTERED)||(Log_Record_Handler != handler))
+	{
+		retval = (Log_String_List[id-1].Registered == LOG_STRING_REGISTERED);
+		pthread_mutex_unlock(&Log_String_Lock);
+		return retval;
+	}
+	__atomic_store_n(&(Log_String_List[id-1].Registered),LOG_STRING_REGISTERING,__ATOMIC_RELAXED);
+	generation = Log_Record_Handler_Generation;
+	register_method_id = Log_Record_Handler_Register_Method_Id;
+	pthread_mutex_unlock(&Log_String_Lock);
+/* send it, without holding the lock */
+	java_string = (*env)->NewStringUTF(env,Log_String_List[id-1].String);
+	DpRt_JNI_Local_Reference_Created(java_string);
+	(*env)->CallVoidMethod(env,handler,register_method_id,(jint)id,java_string);
+	retval = TRUE;
+	if((*env)->ExceptionCheck(env))
+	{
+		(*env)->ExceptionDescribe(env);
+		(*env)->ExceptionClear(env);
+		retval = FALSE;
+	}
+	if(java_string != NULL)
+		DpRt_JNI_Delete_Local_Reference(env,java_string);
+/* the handler may have been replaced whilst we were registering with it, the new one needs the ID too */
+	pthread_mutex_lock(&Log_String_Lock);
+	if(retval && (generation == Log_Record_Handler_Generation))
+		__atomic_store_n(&(Log_String_List[id-1].Registered),LOG_STRING_REGISTERED,__ATOMIC_RELEASE);
+	else
+		__atomic_store_n(&(Log_String_List[id-1].Registered),LOG_STRING_UNREGISTERED,__ATOMIC_RELEASE);
+	pthread_mutex_unlock(&Log_String_Lock);
+	return retval;
+}
+
+/**
+ * Routine to replace the structured log record handler. All interned IDs have to be registered again
+ * with the new handler. The old handler is removed first, and it's global reference deleted once no thread
+ * is using it, so this routine must not be called from the handler. Records logged in between go to the logger.
  * @param env The JNI environment pointer.
- * @see #DpRt_Status
+ * @param handler A global reference to the new handler, or NULL to remove the handler.
+ * @param register_method_id The new handler's registerLogString method ID.
+ * @param log_method_id The new handler's log method ID.
+ * @see #Log_Record_Handler
+ * @see #Log_Record_Handler_User_Count
+ * @see #Log_Record_Handler_Generation
  */
-void DpRt_JNI_Finalise_Status_Reference(JNIEnv *env)
+static void DpRt_JNI_Log_Record_Handler_Replace(JNIEnv *env,jobject handler,jmethodID register_method_id,
+						jmethodID log_method_id)
 {
-	if(DpRt_Status != NULL)
-		(*env)->DeleteGlobalRef(env,DpRt_Status);
+	jobject old_handler = NULL;
+	int i;
+
+	pthread_mutex_lock(&Log_String_Lock);
+	for(i = 0; i < Log_String_Count; i++)
+	{
+		/* an in-flight registration is reset when it completes, as the generation has changed */
+		if(Log_String_List[i].Registered == LOG_STRING_REGISTERED)
+			__atomic_store_n(&(Log_String_List[i].Registered),LOG_STRING_UNREGISTERED,__ATOMIC_RELEASE);
+	}
+	Log_Record_Handler_Generation++;
+	old_handler = Log_Record_Handler;
+	__atomic_store_n(&Log_Record_Handler,NULL,__ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&Log_String_Lock);
+/* wait for threads that loaded the old handler, so none uses it (or it's method IDs) after this */
+	if(old_handler != NULL)
+	{
+		while(__atomic_load_n(&Log_Record_Handler_User_Count,__ATOMIC_SEQ_CST) > 0)
+			sched_yield();
+		(*env)->DeleteGlobalRef(env,old_handler);
+	}
+	if(handler == NULL)
+		return;
+/* the method IDs are written before the handler is published */
+	pthread_mutex_lock(&Log_String_Lock);
+	Log_Record_Handler_Register_Method_Id = register_method_id;
+	Log_Record_Handler_Log_Method_Id = log_method_id;
+	__atomic_store_n(&Log_Record_Handler,handler,__ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&Log_String_Lock);
 }
 
 /**
- * This finction should be called when the library/DpRt is first initialised/loaded.
- * It allows the C layer to perform initial initialisation.
- * The function pointers to use a C routine to load the property from the config file are initialised.
- * Note these function pointers will be over-written by the functions in DpRtLibrary.c if this
- * initialise routine was called from the Java (JNI) layer.
- * @see #DpRt_JNI_Set_Property_Function_Pointer
- * @see #DpRt_JNI_Set_Property_Integer_Function_Pointer
- * @see #DpRt_JNI_Set_Property_Double_Function_Pointer
- * @see #DpRt_JNI_Set_Property_Boolean_Function_Pointer
- * @see #DpRt_JNI_Get_Property_From_C_File
- * @see #DpRt_JNI_Get_Property_Integer_From_C_File
- * @see #DpRt_JNI_Get_Property_Double_From_C_File
- * @see #DpRt_JNI_Get_Property_Boolean_From_C_File
+ * Routine to add a log record to the asynchronous log queue. The queue is a bounded multi-producer
+ * multi-consumer ring buffer: each record slot has a sequence number, a producer claims a slot by
+ * atomically advancing Enqueue_Position when the slot's sequence number equals the position, and publishes
+ * the record by setting the sequence number to position+1. No locks are taken unless the queue is full
+ * and the overflow policy is DPRT_JNI_LOG_QUEUE_OVERFLOW_BLOCK, or the queue thread is idle and needs waking.
+ * With DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_OLDEST, the producer removes the oldest record itself to make room.
+ * @param logger The global reference to the logger of the context the message was logged in.
+ * @param level The log level of the message.
+ * @param sub_system_id The interned ID of the sub-system, or 0.
+ * @param source_filename_id The interned ID of the source filename, or 0.
+ * @param function_id The interned ID of the function, or 0.
+ * @param category_id The interned ID of the category, or 0.
+ * @param string The message to log. This is copied (and truncated to LOG_QUEUE_MESSAGE_LENGTH if necessary).
+ * @return The routine returns TRUE if the record was queued (or dropped according to the overflow policy), 
+ *         FALSE if the queue is not running, in which case the caller should deliver the record itself.
+ * @see #Log_Queue
+ * @see #DpRt_JNI_Log_Queue_Get
  */
-int DpRt_JNI_Initialise(void)
+static int DpRt_JNI_Log_Queue_Put(jobject logger,int level,int sub_system_id,int source_filename_id,
+				  int function_id,int category_id,char *string)
 {
-	DpRt_JNI_Error_Number = 0;
-	DpRt_JNI_Error_String[0] = '\0';
-	if(DpRt_Data.DpRt_Get_Property_Function_Pointer == NULL)
-		DpRt_JNI_Set_Property_Function_Pointer(DpRt_JNI_Get_Property_From_C_File);
-	if(DpRt_Data.DpRt_Get_Property_Integer_Function_Pointer == NULL)
-		DpRt_JNI_Set_Property_Integer_Function_Pointer(DpRt_JNI_Get_Property_Integer_From_C_File);
-	if(DpRt_Data.DpRt_Get_Property_Double_Function_Pointer == NULL)
-		DpRt_JNI_Set_Property_Double_Function_Pointer(DpRt_JNI_Get_Property_Double_From_C_File);
-	if(DpRt_Data.DpRt_Get_Property_Boolean_Function_Pointer == NULL)
-		DpRt_JNI_Set_Property_Boolean_Function_Pointer(DpRt_JNI_Get_Property_Boolean_From_C_File);
+	struct Log_Record_Struct *record = NULL;
+	struct Log_Record_Struct dropped_record;
+	struct timespec wait_time;
+	unsigned long position,sequence;
+	long difference;
+	int blocked = FALSE;
+
+	__atomic_add_fetch(&Log_Queue.Active_Producer_Count,1,__ATOMIC_ACQ_REL);
+	if(__atomic_load_n(&Log_Queue.Running,__ATOMIC_ACQUIRE) == FALSE)
+	{
+		__atomic_sub_fetch(&Log_Queue.Active_Producer_Count,1,__ATOMIC_ACQ_REL);
+		return FALSE;
+	}
+	position = __atomic_load_n(&Log_Queue.Enqueue_Position,__ATOMIC_RELAXED);
+	while(TRUE)
+	{
+		record = &(Log_Queue.Record_List[position&(Log_Queue.Capacity-1)]);
+		sequence = __atomic_load_n(&(record->Sequence),__ATOMIC_ACQUIRE);
+		difference = (long)sequence-(long)position;
+		if(difference == 0)
+		{
+			/* the slot is free, try to claim it */
+			if(__atomic_compare_exchange_n(&Log_Queue.Enqueue_Position,&position,position+1,TRUE,
+						       __ATOMIC_RELAXED,__ATOMIC_RELAXED))
+				break;
+			/* position has been updated to the current enqueue position */
+		}
+		else if(difference < 0)
+		{
+			/* the queue is full */
+			if(Log_Queue.Overflow_Policy == DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_NEWEST)
+			{
+				__atomic_add_fetch(&Log_Queue.Dropped_Count,1,__ATOMIC_RELAXED);
+				__atomic_sub_fetch(&Log_Queue.Active_Producer_Count,1,__ATOMIC_ACQ_REL);
+				return TRUE;
+			}
+			else if(Log_Queue.Overflow_Policy == DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_OLDEST)
+			{
+				if(DpRt_JNI_Log_Queue_Get(&dropped_record))
+					__atomic_add_fetch(&Log_Queue.Dropped_Count,1,__ATOMIC_RELAXED);
+			}
+			else /* DPRT_JNI_LOG_QUEUE_OVERFLOW_BLOCK */
+			{
+				if(blocked == FALSE)
+					__atomic_add_fetch(&Log_Queue.Blocked_Count,1,__ATOMIC_RELAXED);
+				blocked = TRUE;
+				pthread_mutex_lock(&(Log_Queue.Lock));
+				Log_Queue.Producer_Waiting_Count++;
+				clock_gettime(CLOCK_REALTIME,&wait_time);
+				wait_time.tv_nsec += LOG_QUEUE_WAIT_MS*1000000L;
+				if(wait_time.tv_nsec >= 1000000000L)
+				{
+					wait_time.tv_sec++;
+					wait_time.tv_nsec -= 1000000000L;
+				}
+				pthread_cond_timedwait(&(Log_Queue.Not_Full_Condition),&(Log_Queue.Lock),&wait_time);
+				Log_Queue.Producer_Waiting_Count--;
+				pthread_mutex_unlock(&(Log_Queue.Lock));
+			}
+			position = __atomic_load_n(&Log_Queue.Enqueue_Position,__ATOMIC_RELAXED);
+		}
+		else
+			position = __atomic_load_n(&Log_Queue.Enqueue_Position,__ATOMIC_RELAXED);
+	}
+/* fill in and publish the record */
+	record->Level = level;
+	record->Sub_System_Id = sub_system_id;
+	record->Source_Filename_Id = source_filename_id;
+	record->Function_Id = function_id;
+	record->Category_Id = category_id;
+	record->Logger = logger;
+	strncpy(record->Message,string,LOG_QUEUE_MESSAGE_LENGTH-1);
+	record->Message[LOG_QUEUE_MESSAGE_LENGTH-1] = '\0';
+	__atomic_store_n(&(record->Sequence),position+1,__ATOMIC_RELEASE);
+	__atomic_add_fetch(&Log_Queue.Record_Count,1,__ATOMIC_RELAXED);
+/* wake the queue thread if it is idle. The fence orders publishing the record before reading Consumer_Waiting */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if(__atomic_load_n(&Log_Queue.Consumer_Waiting,__ATOMIC_SEQ_CST))
+	{
+		pthread_mutex_lock(&(Log_Queue.Lock));
+		pthread_cond_signal(&(Log_Queue.Not_Empty_Condition));
+		pthread_mutex_unlock(&(Log_Queue.Lock));
+	}
+	__atomic_sub_fetch(&Log_Queue.Active_Producer_Count,1,__ATOMIC_ACQ_REL);
+	return TRUE;
+}
+
+/**
+ * Routine to remove the oldest record from the asynchronous log queue. A consumer claims a slot by
+ * atomically advancing Dequeue_Position when the slot's sequence number equals position+1 (i.e. a record
+ * has been published there), copies the record out, and releases the slot to producers by setting it's 
+ * sequence number to position+Capacity.
+ * @param record The address of a record to copy the removed record into.
+ * @return The routine returns TRUE if a record was removed, FALSE if the queue was empty.
+ * @see #Log_Queue
+ * @see #DpRt_JNI_Log_Queue_Put
+ */
+static int DpRt_JNI_Log_Queue_Get(struct Log_Record_Struct *record)
+{
+	struct Log_Record_Struct *queue_record = NULL;
+	unsigned long position,sequence;
+	long difference;
+
+	position = __atomic_load_n(&Log_Queue.Dequeue_Position,__ATOMIC_RELAXED);
+	while(TRUE)
+	{
+		queue_record = &(Log_Queue.Record_List[position&(Log_Queue.Capacity-1)]);
+		sequence = __atomic_load_n(&(queue_record->Sequence),__ATOMIC_ACQUIRE);
+		difference = (long)sequence-(long)(position+1);
+		if(difference == 0)
+		{
+			if(__atomic_compare_exchange_n(&Log_Queue.Dequeue_Position,&position,position+1,TRUE,
+						       __ATOMIC_RELAXED,__ATOMIC_RELAXED))
+				break;
+		}
+		else if(difference < 0)
+			return FALSE;
+		else
+			position = __atomic_load_n(&Log_Queue.Dequeue_Position,__ATOMIC_RELAXED);
+	}
+	record->Level = queue_record->Level;
+	record->Sub_System_Id = queue_record->Sub_System_Id;
+	record->Source_Filename_Id = queue_record->Source_Filename_Id;
+	record->Function_Id = queue_record->Function_Id;
+	record->Category_Id = queue_record->Category_Id;
+	record->Logger = queue_record->Logger;
+	strcpy(record->Message,queue_record->Message);
+	__atomic_store_n(&(queue_record->Sequence),position+Log_Queue.Capacity,__ATOMIC_RELEASE);
 	return TRUE;
 }
 
-/* abort */
 /**
- * A routine to set the value of the DpRt_Abort variable. This is used to
- * keep track of whether an abort event has occured.
- * @param value The value to set the abort value to, this should be TRUE of we want the data reduction
- * aborted, or FALSE if we don't or we are resetting the flag.
- * @see #DpRt_Data
+ * Routine to wake any producers blocked on a full asynchronous log queue.
+ * @see #Log_Queue
+ */
+static void DpRt_JNI_Log_Queue_Signal_Not_Full(void)
+{
+	pthread_mutex_lock(&(Log_Queue.Lock));
+	if(Log_Queue.Producer_Waiting_Count > 0)
+		pthread_cond_broadcast(&(Log_Queue.Not_Full_Condition));
+	pthread_mutex_unlock(&(Log_Queue.Lock));
+}
+
+/**
+ * Routine to wait until every record queued before it was called has been delivered (or dropped) by
+ * the asynchronous log queue thread, so their logger references are no longer in use. The queue is left
+ * running. If the queue is not running (or has been stopped) this returns at once, as there is nothing
+ * queued.
+ * @see #Log_Queue
+ * @see #DpRt_JNI_Log_Queue_Thread
+ * @see #DpRt_JNI_Context_Destroy
+ * @see #DpRt_JNI_Finalise_Logger_Reference
+ */
+static void DpRt_JNI_Log_Queue_Flush(void)
+{
+	struct timespec wait_time;
+	unsigned long target_position;
+
+	target_position = __atomic_load_n(&Log_Queue.Enqueue_Position,__ATOMIC_SEQ_CST);
+	pthread_mutex_lock(&(Log_Queue.Lock));
+	__atomic_add_fetch(&Log_Queue.Flush_Waiting_Count,1,__ATOMIC_SEQ_CST);
+	while(((long)(__atomic_load_n(&Log_Queue.Flushed_Position,__ATOMIC_SEQ_CST)-target_position)) < 0)
+	{
+		/* wake the queue thread, in case it is idle */
+		pthread_cond_signal(&(Log_Queue.Not_Empty_Condition));
+		clock_gettime(CLOCK_REALTIME,&wait_time);
+		wait_time.tv_nsec += LOG_QUEUE_WAIT_MS*1000000L;
+		if(wait_time.tv_nsec >= 1000000000L)
+		{
+			wait_time.tv_sec++;
+			wait_time.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&(Log_Queue.Flushed_Condition),&(Log_Queue.Lock),&wait_time);
+	}
+	__atomic_sub_fetch(&Log_Queue.Flush_Waiting_Count,1,__ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&(Log_Queue.Lock));
+}
+
+/**
+ * The asynchronous log queue thread. This attaches itself to the JVM as a daemon thread 
+ * (using DpRt_JNI_Get_Env), and then repeatedly
+ * removes up to LOG_QUEUE_BATCH_LENGTH records from the queue and delivers them to the Java logger
+ * inside one local reference frame. When the queue is empty it waits to be signalled by a producer 
+ * (or LOG_QUEUE_WAIT_MS). When the queue is stopped, the remaining records are delivered and the thread
+ * exits, detaching from the JVM as it does so.
+ * @param arg Unused.
+ * @return NULL.
+ * @see #Log_Queue
+ * @see #DpRt_JNI_Log_Queue_Get
+ * @see #DpRt_JNI_Log_Deliver
+ * @see #LOG_QUEUE_BATCH_LENGTH
+ * @see #LOG_QUEUE_WAIT_MS
+ */
+static void *DpRt_JNI_Log_Queue_Thread(void *arg)
+{
+	struct Log_Record_Struct record;
+	JNIEnv *env = NULL;
+	struct timespec wait_time;
+	unsigned long position;
+	int count,running;
+
+	env = DpRt_JNI_Get_Env("DpRt log queue");
+	if(env == NULL)
+		fprintf(stderr,"DpRt_JNI_Log_Queue_Thread:Failed to attach to the JVM, log records will be lost.\n");
+	do
+	{
+		running = __atomic_load_n(&Log_Queue.Running,__ATOMIC_ACQUIRE);
+		if((env != NULL)&&((*env)->PushLocalFrame(env,LOG_QUEUE_BATCH_LENGTH*2) != 0))
+			(*env)->ExceptionClear(env);
+		count = 0;
+		while((count < LOG_QUEUE_BATCH_LENGTH)&&DpRt_JNI_Log_Queue_Get(&record))
+		{
+			if(env != NULL)
+			{
+				DpRt_JNI_Log_Deliver(env,record.Logger,record.Level,record.Sub_System_Id,
+						     record.Source_Filename_Id,record.Function_Id,record.Category_Id,
+						     record.Message);
+			}
+			count++;
+		}
+		if(env != NULL)
+			(*env)->PopLocalFrame(env,NULL);
+		/* every record before the dequeue position has now been delivered or dropped */
+		__atomic_store_n(&Log_Queue.Flushed_Position,__atomic_load_n(&Log_Queue.Dequeue_Position,
+				 __ATOMIC_SEQ_CST),__ATOMIC_SEQ_CST);
+		if(__atomic_load_n(&Log_Queue.Flush_Waiting_Count,__ATOMIC_SEQ_CST) > 0)
+		{
+			pthread_mutex_lock(&(Log_Queue.Lock));
+			pthread_cond_broadcast(&(Log_Queue.Flushed_Condition));
+			pthread_mutex_unlock(&(Log_Queue.Lock));
+		}
+		if(count > 0)
+			DpRt_JNI_Log_Queue_Signal_Not_Full();
+		else if(running)
+		{
+			/* nothing to do, wait for a producer to signal us */
+			pthread_mutex_lock(&(Log_Queue.Lock));
+			__atomic_store_n(&Log_Queue.Consumer_Waiting,TRUE,__ATOMIC_SEQ_CST);
+			/* re-check after setting Consumer_Waiting, a record may have been added in between */
+			position = __atomic_load_n(&Log_Queue.Dequeue_Position,__ATOMIC_SEQ_CST);
+			if(__atomic_load_n(&(Log_Queue.Record_List[position&(Log_Queue.Capacity-1)].Sequence),
+					   __ATOMIC_SEQ_CST) != position+1)
+			{
+				clock_gettime(CLOCK_REALTIME,&wait_time);
+				wait_time.tv_nsec += LOG_QUEUE_WAIT_MS*1000000L;
+				if(wait_time.tv_nsec >= 1000000000L)
+				{
+					wait_time.tv_sec++;
+					wait_time.tv_nsec -= 1000000000L;
+				}
+				pthread_cond_timedwait(&(Log_Queue.Not_Empty_Condition),&(Log_Queue.Lock),&wait_time);
+			}
+			__atomic_store_n(&Log_Queue.Consumer_Waiting,FALSE,__ATOMIC_SEQ_CST);
+			pthread_mutex_unlock(&(Log_Queue.Lock));
+		}
+	}
+	while(running || (count > 0));
+	/* the thread is detached from the JVM by DpRt_JNI_Thread_Data_Destroy as it exits */
+	return NULL;
+}
+
+/**
+ * Routine to get the JNI environment pointer for the calling thread. The pointer is cached in the thread's
+ * Thread_Data_Struct, so the JVM is only asked once per thread. If the thread is already attached to the
+ * JVM (e.g. it is a Java thread calling native code) it's existing environment is used, and the thread is 
+ * not detached by this library. Otherwise the thread is attached as a daemon thread (so it does not stop 
+ * the JVM exiting), and is detached automatically when it exits.
+ * @param thread_name The name to give the thread's java.lang.Thread if it is attached. If NULL,
+ *        a name of the form "DpRt native thread <n>" is used.
+ * @return The JNI environment pointer, or NULL if Java_VM is NULL or the thread could not be attached.
+ * @see #Java_VM
+ * @see #Thread_Data_Struct
+ * @see #DpRt_JNI_Thread_Data_Get
+ * @see #DpRt_JNI_Thread_Data_Destroy
+ * @see #Thread_Attach_Count
  */
-void DpRt_JNI_Set_Abort(int value)
+static JNIEnv *DpRt_JNI_Get_Env(char *thread_name)
 {
-	DpRt_Data.DpRt_Abort = value;
+	struct Thread_Data_Struct *thread_data = NULL;
+	JavaVMAttachArgs attach_args;
+	JNIEnv *env = NULL;
+	char buff[64];
+	unsigned long attach_count;
+
+	if(Java_VM == NULL)
+		return NULL;
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if((thread_data != NULL)&&(thread_data->Env != NULL))
+		return thread_data->Env;
+	if((*Java_VM)->GetEnv(Java_VM,(void**)&env,JNI_VERSION_1_2) != JNI_OK)
+	{
+		attach_count = __atomic_add_fetch(&Thread_Attach_Count,1,__ATOMIC_RELAXED);
+		if(thread_name == NULL)
+		{
+			sprintf(buff,"DpRt native thread %lu",attach_count);
+			thread_name = buff;
+		}
+		attach_args.version = JNI_VERSION_1_2;
+		attach_args.name = thread_name;
+		attach_args.group = NULL;
+		if(((*Java_VM)->AttachCurrentThreadAsDaemon(Java_VM,(void**)&env,&attach_args) != JNI_OK)||
+		   (env == NULL))
+		{
+			__atomic_sub_fetch(&Thread_Attach_Count,1,__ATOMIC_RELAXED);
+			return NULL;
+		}
+		if(thread_data != NULL)
+			thread_data->Attached = TRUE;
+	}
+	if(thread_data != NULL)
+		thread_data->Env = env;
+	return env;
 }
 
 /**
- * A routine to get the current value of the abort variable, to determine whether we should abort
- * processing the FITS file or not.
- * @return The current value of the DpRt_Data.DpRt_Abort variable, usually TRUE if we want to abort a reduction process
- * and FALSE if we don't.
- * @see #DpRt_Data
+ * Routine to get the calling thread's Thread_Data_Struct, allocating it (and creating Thread_Data_Key)
+ * if necessary.
+ * @return The thread's data, or NULL if it could not be allocated.
+ * @see #Thread_Data_Key
+ * @see #Thread_Data_Struct
  */
-int DpRt_JNI_Get_Abort(void)
+static struct Thread_Data_Struct *DpRt_JNI_Thread_Data_Get(void)
 {
-	return DpRt_Data.DpRt_Abort;
+	struct Thread_Data_Struct *thread_data = NULL;
+
+	pthread_once(&Thread_Data_Key_Once,DpRt_JNI_Thread_Data_Key_Create);
+	thread_data = (struct Thread_Data_Struct *)pthread_getspecific(Thread_Data_Key);
+	if(thread_data != NULL)
+		return thread_data;
+	thread_data = (struct Thread_Data_Struct *)calloc(1,sizeof(struct Thread_Data_Struct));
+	if(thread_data == NULL)
+		return NULL;
+	thread_data->Env = NULL;
+	thread_data->Attached = FALSE;
+	thread_data->Local_Reference_Count = 0;
+	thread_data->Local_Reference_High_Water = 0;
+	thread_data->Context = NULL;
+	thread_data->Error.Number = 0;
+	thread_data->Error.Format = NULL;
+	thread_data->Error.String[0] = '\0';
+	if(pthread_setspecific(Thread_Data_Key,thread_data) != 0)
+	{
+		free(thread_data);
+		return NULL;
+	}
+	return thread_data;
 }
 
-/* property file processing */
-/* top level client API */
 /**
- * This routine allows us to query the properties loaded into DpRt to get
- * the value associated with a keyword in the property Hashtable.
- * As libdprt can be called in two ways, from Java using JNI (the usual method) and
- * from a C test program (for testing), the mechanism for retrieving the value is different
- * in each case. A function pointer system is used.
- * @param keyword The keyword in the property file to look up.
- * @param value_string The address of a pointer to allocate and store the resulting value string in.
- * 	This pointer is dynamically allocated and must be freed using <b>free()</b>. 
- * @return The routine returns TRUE if it succeeds, FALSE if it fails.
- * @see #DpRt_Data
+ * Routine to create Thread_Data_Key, called once by pthread_once.
+ * @see #Thread_Data_Key
+ * @see #Thread_Data_Key_Once
+ * @see #DpRt_JNI_Thread_Data_Destroy
  */
-int DpRt_JNI_Get_Property(char *keyword,char **value_string)
+static void DpRt_JNI_Thread_Data_Key_Create(void)
 {
-	DpRt_JNI_Error_Number = 0;
-	DpRt_JNI_Error_String[0] = '\0';
-	if(keyword == NULL)
-	{
-		DpRt_JNI_Error_Number = 1;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property failed: Keyword was NULL.\n");
-		return FALSE;
-	}
-	if(value_string == NULL)
-	{
-		DpRt_JNI_Error_Number = 2;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property failed: Value String Pointer was NULL.\n");
-		return FALSE;
-	}
-	if(DpRt_Data.DpRt_Get_Property_Function_Pointer == NULL)
-	{
-		DpRt_JNI_Error_Number = 3;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property failed: Function Pointer was NULL.\n");
-		return FALSE;
-	}
-	return DpRt_Data.DpRt_Get_Property_Function_Pointer(keyword,value_string);
+	pthread_key_create(&Thread_Data_Key,DpRt_JNI_Thread_Data_Destroy);
 }
 
 /**
- * This routine allows us to query the properties loaded into DpRt to get
- * the integer value associated with a keyword in the property Hashtable.
- * As libdprt can be called in two ways, from Java using JNI (the usual method) and
- * from a C test program (for testing), the mechanism for retrieving the value is different
- * in each case. A function pointer system is used.
- * @param keyword The keyword in the property file to look up.
- * @param value The address of an integer to store the resulting value.
- * @return The routine returns TRUE if it succeeds, FALSE if it fails.
- * @see #DpRt_Data
+ * Destructor for Thread_Data_Key, called as a thread with per-thread data exits. If this library attached
+ * the thread to the JVM, it is detached, so it's java.lang.Thread can be collected.
+ * @param data The thread's Thread_Data_Struct.
+ * @see #Thread_Data_Key
+ * @see #Thread_Detach_Count
  */
-int DpRt_JNI_Get_Property_Integer(char *keyword,int *value)
+static void DpRt_JNI_Thread_Data_Destroy(void *data)
 {
-	DpRt_JNI_Error_Number = 0;
-	DpRt_JNI_Error_String[0] = '\0';
-	if(keyword == NULL)
+	struct Thread_Data_Struct *thread_data = (struct Thread_Data_Struct *)data;
+	int i;
+
+	if(thread_data == NULL)
+		return;
+	if(Local_Reference_Debug && (thread_data->Local_Reference_Count != 0))
 	{
-		DpRt_JNI_Error_Number = 4;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Integer failed: Keyword was NULL.\n");
-		return FALSE;
+		fprintf(stderr,"DpRt_JNI_Thread_Data_Destroy:Thread exiting with %d undeleted local references "
+			"(high water %d).\n",thread_data->Local_Reference_Count,thread_data->Local_Reference_High_Water);
 	}
-	if(value == NULL)
+	if(thread_data->Attached && (Java_VM != NULL))
 	{
-		DpRt_JNI_Error_Number = 5;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Integer failed: Value Pointer was NULL.\n");
-		return FALSE;
+		(*Java_VM)->DetachCurrentThread(Java_VM);
+		__atomic_add_fetch(&Thread_Detach_Count,1,__ATOMIC_RELAXED);
 	}
-	if(DpRt_Data.DpRt_Get_Property_Integer_Function_Pointer == NULL)
+/* keep the exiting thread's latencies, in the retired histograms */
+	if(thread_data->Latency_Histogram != NULL)
 	{
-		DpRt_JNI_Error_Number = 6;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Integer failed: Function Pointer was NULL.\n");
-		return FALSE;
+		pthread_mutex_lock(&Latency_Histogram_Lock);
+		for(i = 0; i < DPRT_JNI_LATENCY_PROBE_COUNT; i++)
+		{
+			DpRt_JNI_Latency_Histogram_Add(&(Latency_Retired_Histogram_List[i]),
+						       &(thread_data->Latency_Histogram->Probe_List[i]));
+		}
+		if(thread_data->Latency_Histogram->Previous != NULL)
+			thread_data->Latency_Histogram->Previous->Next = thread_data->Latency_Histogram->Next;
+		else
+			Latency_Histogram_List = thread_data->Latency_Histogram->Next;
+		if(thread_data->Latency_Histogram->Next != NULL)
+			thread_data->Latency_Histogram->Next->Previous = thread_data->Latency_Histogram->Previous;
+		pthread_mutex_unlock(&Latency_Histogram_Lock);
+		free(thread_data->Latency_Histogram);
 	}
-	return DpRt_Data.DpRt_Get_Property_Integer_Function_Pointer(keyword,value);
+	free(thread_data);
 }
 
 /**
- * This routine allows us to query the properties loaded into DpRt to get
- * the double value associated with a keyword in the property Hashtable.
- * As libdprt can be called in two ways, from Java using JNI (the usual method) and
- * from a C test program (for testing), the mechanism for retrieving the value is different
- * in each case. A function pointer system is used.
- * @param keyword The keyword in the property file to look up.
- * @param value The address of an double to store the resulting value.
- * @return The routine returns TRUE if it succeeds, FALSE if it fails.
- * @see #DpRt_Data
+ * Routine to note a JNI local reference has been created by one of this library's upcalls.
+ * When Local_Reference_Debug is TRUE, the calling thread's live local reference count is incremented.
+ * @param object The local reference created. If NULL, nothing is counted.
+ * @see #Local_Reference_Debug
+ * @see #Thread_Data_Struct
+ * @see #DpRt_JNI_Delete_Local_Reference
  */
-int DpRt_JNI_Get_Property_Double(char *keyword,double *value)
+static void DpRt_JNI_Local_Reference_Created(jobject object)
 {
-	DpRt_JNI_Error_Number = 0;
-	DpRt_JNI_Error_String[0] = '\0';
-	if(keyword == NULL)
-	{
-		DpRt_JNI_Error_Number = 7;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Double failed: Keyword was NULL.\n");
-		return FALSE;
-	}
-	if(value == NULL)
-	{
-		DpRt_JNI_Error_Number = 8;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Double failed: Value Pointer was NULL.\n");
-		return FALSE;
-	}
-	if(DpRt_Data.DpRt_Get_Property_Double_Function_Pointer == NULL)
-	{
-		DpRt_JNI_Error_Number = 9;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Double failed: Function Pointer was NULL.\n");
-		return FALSE;
-	}
-	return DpRt_Data.DpRt_Get_Property_Double_Function_Pointer(keyword,value);
+	struct Thread_Data_Struct *thread_data = NULL;
+
+	if((object == NULL)||(__atomic_load_n(&Local_Reference_Debug,__ATOMIC_RELAXED) == FALSE))
+		return;
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if(thread_data == NULL)
+		return;
+	thread_data->Local_Reference_Count++;
+	if(thread_data->Local_Reference_Count > thread_data->Local_Reference_High_Water)
+		thread_data->Local_Reference_High_Water = thread_data->Local_Reference_Count;
 }
 
 /**
- * This routine allows us to query the properties loaded into DpRt to get
- * the boolean value associated with a keyword in the property Hashtable.
- * As libdprt can be called in two ways, from Java using JNI (the usual method) and
- * from a C test program (for testing), the mechanism for retrieving the value is different
- * in each case. A function pointer system is used.
- * @param keyword The keyword in the property file to look up.
- * @param value The address of an integer to store the resulting value, 1 is TRUE, 0 is FALSE.
- * @return The routine returns TRUE if it succeeds, FALSE if it fails.
- * @see #DpRt_Data
+ * Routine to delete a JNI local reference created by one of this library's upcalls. Native threads that
+ * never return to Java never have their local references freed by the JVM, so every upcall deletes the
+ * references it creates. When Local_Reference_Debug is TRUE, the calling thread's live local 
+ * reference count is decremented.
+ * @param env The JNI environment pointer for the calling thread.
+ * @param object The local reference to delete. If NULL, nothing is done.
+ * @see #Local_Reference_Debug
+ * @see #DpRt_JNI_Local_Reference_Created
  */
-int DpRt_JNI_Get_Property_Boolean(char *keyword,int *value)
+static void DpRt_JNI_Delete_Local_Reference(JNIEnv *env,jobject object)
 {
-	DpRt_JNI_Error_Number = 0;
-	DpRt_JNI_Error_String[0] = '\0';
-	if(keyword == NULL)
-	{
-		DpRt_JNI_Error_Number = 10;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Boolean failed: Keyword was NULL.\n");
-		return FALSE;
-	}
-	if(value == NULL)
-	{
-		DpRt_JNI_Error_Number = 11;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Boolean failed: Value Pointer was NULL.\n");
-		return FALSE;
-	}
-	if(DpRt_Data.DpRt_Get_Property_Boolean_Function_Pointer == NULL)
-	{
-		DpRt_JNI_Error_Number = 12;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Boolean failed: Function Pointer was NULL.\n");
-		return FALSE;
-	}
-	return DpRt_Data.DpRt_Get_Property_Boolean_Function_Pointer(keyword,value);
+	struct Thread_Data_Struct *thread_data = NULL;
+
+	if(object == NULL)
+		return;
+	(*env)->DeleteLocalRef(env,object);
+	if(__atomic_load_n(&Local_Reference_Debug,__ATOMIC_RELAXED) == FALSE)
+		return;
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if(thread_data != NULL)
+		thread_data->Local_Reference_Count--;
 }
 
-/* routines to access proerties via DpRtStatus object.
-** external, as can be passed as parameters to DpRt_JNI_Set_Property_*_Function_Pointer */
 /**
- * Routine to get the value of the keyword from the properties held in the instance of DpRtStatus.
- * @param keyword The keyword in the property file to look up.
- * @param value_string The address of a pointer to allocate and store the resulting value string in.
- * 	This pointer is dynamically allocated and must be freed using <b>free()</b>. 
- * @see #DpRt_Status
- * @see #DpRt_Status_Get_Property_Method_Id
+ * Routine to get the registry entry for a done class, resolving all it's done setter method IDs 
+ * the first time the class is seen. Classes are compared with IsSameObject, so each instrument specific
+ * subclass passed as cls gets it's own entry. Methods the class does not have are stored as NULL,
+ * and the NoSuchMethodError cleared. Nothing is probed if an exception is already pending on entry, and any
+ * other exception raised whilst probing is left pending.
+ * @param env The JNI environment pointer.
+ * @param cls The done class.
+ * @return The registry entry, or NULL if it could not be created (the caller should then look up methods
+ *         itself).
+ * @see #Done_Class_List
+ * @see #Done_Method_List
  */
-int DpRt_JNI_DpRtStatus_Get_Property(char *keyword,char **value_string)
+static struct Done_Class_Struct *DpRt_JNI_Done_Class_Get(JNIEnv *env,jclass cls)
 {
-	JNIEnv *env = NULL;
-	jstring java_keyword_string = NULL;
-	jobject java_value_object = NULL;
-	jstring java_value_string = NULL;
-	const char *c_value_string = NULL;
+	struct Done_Class_Struct *done_class = NULL;
+	int i;
 
-	if(DpRt_Status == NULL)
-	{
-		DpRt_JNI_Error_Number = 13;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property:DpRt_Status was NULL (%s).\n",
-			keyword);
-		return FALSE;
-	}
-	if(DpRt_Status_Get_Property_Method_Id == NULL)
-	{
-		DpRt_JNI_Error_Number = 14;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property:Method ID was NULL (%s).\n",
-			keyword);
-		return FALSE;
-	}
-	if(Java_VM == NULL)
+	if(cls == NULL)
+		return NULL;
+	/* probing the optional setters below needs a clean exception state, and must not lose the caller's exception */
+	if((*env)->ExceptionCheck(env))
+		return NULL;
+	for(done_class = __atomic_load_n(&Done_Class_List,__ATOMIC_ACQUIRE); done_class != NULL;
+	    done_class = done_class->Next)
 	{
-		DpRt_JNI_Error_Number = 15;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property:Java_VM was NULL (%s).\n",
-			keyword);
-		return FALSE;
+		if((*env)->IsSameObject(env,done_class->Class,cls))
+			return done_class;
 	}
-/* get java env for this thread */
-	(*Java_VM)->AttachCurrentThread(Java_VM,(void**)&env,NULL);
-	if(env == NULL)
+	pthread_mutex_lock(&Done_Class_Lock);
+	/* another thread may have added the class whilst we waited for the lock */
+	for(done_class = Done_Class_List; done_class != NULL; done_class = done_class->Next)
 	{
-		DpRt_JNI_Error_Number = 16;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property:env was NULL (%s).\n",keyword);
-		return FALSE;
+		if((*env)->IsSameObject(env,done_class->Class,cls))
+		{
+			pthread_mutex_unlock(&Done_Class_Lock);
+			return done_class;
+		}
 	}
-	if(keyword == NULL)
+	done_class = (struct Done_Class_Struct *)malloc(sizeof(struct Done_Class_Struct));
+	if(done_class == NULL)
 	{
-		DpRt_JNI_Error_Number = 17;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property:string (%s) was NULL.\n",keyword);
-		return FALSE;
+		pthread_mutex_unlock(&Done_Class_Lock);
+		return NULL;
 	}
-	if(value_string == NULL)
+	done_class->Class = (jclass)((*env)->NewGlobalRef(env,cls));
+	if(done_class->Class == NULL)
 	{
-		DpRt_JNI_Error_Number = 18;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property:value_string Pointer was NULL.\n");
-		return FALSE;
+		pthread_mutex_unlock(&Done_Class_Lock);
+		free(done_class);
+		return NULL;
 	}
-/* convert C to Java String */
-	java_keyword_string = (*env)->NewStringUTF(env,keyword);
-/* call getProperty method on DpRt_Status instance */
-	java_value_object = (*env)->CallObjectMethod(env,DpRt_Status,DpRt_Status_Get_Property_Method_Id,
-			java_keyword_string);
-/* Convert Java JString to C character array */
-	java_value_string = (jstring)java_value_object;
-	if(java_value_string != NULL)
-		c_value_string = (*env)->GetStringUTFChars(env,java_value_string,0);
-/* copy c_value_string to (*value_string) */
-	if(c_value_string != NULL)
+	for(i = 0; i < DONE_METHOD_COUNT; i++)
 	{
-		(*value_string) = (char *)malloc((strlen(c_value_string)+1)*sizeof(char));
-		if((*value_string) == NULL)
+		done_class->Method_Id_List[i] = (*env)->GetMethodID(env,cls,Done_Method_List[i].Name,
+								    Done_Method_List[i].Signature);
+		if((done_class->Method_Id_List[i] == NULL)&&
+		   (DpRt_JNI_Done_Class_Clear_No_Such_Method(env) == FALSE))
 		{
-			DpRt_JNI_Error_Number = 19;
-			sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property:"
-				"Memory allocation error(%s,%d).\n",
-				c_value_string,strlen(c_value_string));
-			return FALSE;
+			pthread_mutex_unlock(&Done_Class_Lock);
+			(*env)->DeleteGlobalRef(env,done_class->Class);
+			free(done_class);
+			return NULL;
 		}
-		strcpy((*value_string),c_value_string);
 	}
-	else
-		(*value_string) = NULL;
-/* free c_value_string */
-	if(java_value_string != NULL)
-		(*env)->ReleaseStringUTFChars(env,java_value_string,c_value_string);
-	return TRUE;
+	done_class->Next = Done_Class_List;
+	__atomic_store_n(&Done_Class_List,done_class,__ATOMIC_RELEASE);
+	pthread_mutex_unlock(&Done_Class_Lock);
+	return done_class;
 }
 
 /**
- * Routine to get the integer value of the keyword from the properties held in the instance of DpRtStatus.
- * @param keyword The keyword in the property file to look up.
- * @param value The address of an integer to store the resulting integer value in.
- * @see #DpRt_Status
- * @see #DpRt_Status_Get_Property_Integer_Method_Id
+ * Routine to clear the pending exception, if it is the NoSuchMethodError raised by probing for an optional
+ * method (a done setter, or DpRtStatus getPropertyList/getPropertySnapshot). Any other exception 
+ * (e.g. an OutOfMemoryError) is re-thrown so it stays pending.
+ * @param env The JNI environment pointer.
+ * @return The routine returns TRUE if the pending exception was a NoSuchMethodError (or there was none),
+ *         and FALSE if another exception is still pending.
+ * @see #DpRt_JNI_Done_Class_Get
+ * @see #DpRt_JNI_Set_Status
+ * @see #DpRt_JNI_Exception_Clear_Instance_Of
  */
-int DpRt_JNI_DpRtStatus_Get_Property_Integer(char *keyword,int *value)
+static int DpRt_JNI_Done_Class_Clear_No_Such_Method(JNIEnv *env)
 {
-	JNIEnv *env = NULL;
-	jstring java_keyword_string = NULL;
+	return DpRt_JNI_Exception_Clear_Instance_Of(env,"java/lang/NoSuchMethodError");
+}
 
-	if(DpRt_Status == NULL)
-	{
-		DpRt_JNI_Error_Number = 20;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Integer:"
-			"DpRt_Status was NULL (%s).\n",
-			keyword);
-		return FALSE;
-	}
-	if(DpRt_Status_Get_Property_Integer_Method_Id == NULL)
-	{
-		DpRt_JNI_Error_Number = 21;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Integer:Method ID was NULL(%s).\n",
-			keyword);
-		return FALSE;
-	}
-	if(Java_VM == NULL)
-	{
-		DpRt_JNI_Error_Number = 22;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Integer:Java_VM was NULL(%s).\n",
-			keyword);
-		return FALSE;
-	}
-/* get java env for this thread */
-	(*Java_VM)->AttachCurrentThread(Java_VM,(void**)&env,NULL);
-	if(env == NULL)
+/**
+ * Routine to clear the pending exception, if it is an instance of the specified class. Any other exception 
+ * (e.g. an OutOfMemoryError) is re-thrown so it stays pending.
+ * @param env The JNI environment pointer.
+ * @param class_name The JNI name of the exception class to clear, e.g. "java/lang/NoSuchMethodError".
+ * @return The routine returns TRUE if the pending exception was an instance of the class (or there was none),
+ *         and FALSE if another exception is still pending.
+ * @see #DpRt_JNI_Done_Class_Clear_No_Such_Method
+ * @see #DpRt_JNI_Get_Property_Optional
+ */
+static int DpRt_JNI_Exception_Clear_Instance_Of(JNIEnv *env,char *class_name)
+{
+	jthrowable exception = NULL;
+	jclass exception_cls = NULL;
+	int is_instance;
+
+	exception = (*env)->ExceptionOccurred(env);
+	if(exception == NULL)
+		return TRUE;
+	(*env)->ExceptionClear(env);
+	exception_cls = (*env)->FindClass(env,class_name);
+	if(exception_cls == NULL)
 	{
-		DpRt_JNI_Error_Number = 23;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Integer:env was NULL (%s).\n",
-			keyword);
+		/* leave the FindClass failure pending */
+		(*env)->DeleteLocalRef(env,exception);
 		return FALSE;
 	}
-	if(keyword == NULL)
+	is_instance = (*env)->IsInstanceOf(env,exception,exception_cls);
+	(*env)->DeleteLocalRef(env,exception_cls);
+	if(is_instance == FALSE)
+		(*env)->Throw(env,exception);
+	(*env)->DeleteLocalRef(env,exception);
+	return is_instance;
+}
+
+/**
+ * Routine to get a done setter method ID from a registry entry. If the entry is NULL, or the class does
+ * not have the method, GetMethodID is called, so the caller sees the same result (a NULL method ID
+ * and a pending NoSuchMethodError) as an unregistered lookup.
+ * @param env The JNI environment pointer.
+ * @param cls The done class.
+ * @param done_class The registry entry for cls, or NULL.
+ * @param method_index Which method, one of the DONE_METHOD_ defines.
+ * @return The method ID, or NULL if the class does not have the method.
+ * @see #Done_Method_List
+ * @see #DpRt_JNI_Done_Class_Get
+ */
+static jmethodID DpRt_JNI_Done_Method_Id_Get(JNIEnv *env,jclass cls,struct Done_Class_Struct *done_class,
+					     int method_index)
+{
+	if((done_class != NULL)&&(done_class->Method_Id_List[method_index] != NULL))
+		return done_class->Method_Id_List[method_index];
+	return (*env)->GetMethodID(env,cls,Done_Method_List[method_index].Name,
+				   Done_Method_List[method_index].Signature);
+}
+
+/**
+ * Routine to add a frame to Frame_List, with a reference count of 1.
+ * @param data The frame's memory.
+ * @param length The length of data in bytes.
+ * @param free_fp The function to free data with, or NULL.
+ * @param user_data Passed to free_fp.
+ * @param buffer A global reference to the Java direct ByteBuffer that owns data, or NULL.
+ * @param frame_handle The address of an integer to store the new frame's handle in.
+ * @return The routine returns TRUE if it succeeds, FALSE if Frame_List is full.
+ * @see #Frame_List
+ * @see #FRAME_HANDLE_INDEX_BITS
+ */
+static int DpRt_JNI_Frame_Add(void *data,size_t length,void (*free_fp)(void *data,void *user_data),
+			      void *user_data,jobject buffer,int *frame_handle)
+{
+	int i;
+
+	pthread_mutex_lock(&Frame_Lock);
+	for(i = 0; i < FRAME_MAX_COUNT; i++)
 	{
-		DpRt_JNI_Error_Number = 24;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Integer:string (%s) was NULL.\n",
-			keyword);
-		return FALSE;
+		if(Frame_List[i].In_Use == FALSE)
+			break;
 	}
-	if(value == NULL)
+	if(i == FRAME_MAX_COUNT)
 	{
-		DpRt_JNI_Error_Number = 25;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Integer:value Pointer was NULL.\n");
+		pthread_mutex_unlock(&Frame_Lock);
+		DpRt_JNI_Error_Set(71,"DpRt_JNI_Frame_Add:Too many frames (%d).\n",FRAME_MAX_COUNT);
 		return FALSE;
 	}
-/* convert C to Java String */
-	java_keyword_string = (*env)->NewStringUTF(env,keyword);
-/* call getProperty method on DpRt_Status instance */
-	(*value) = (int)((*env)->CallIntMethod(env,DpRt_Status,DpRt_Status_Get_Property_Integer_Method_Id,
-			java_keyword_string));
+	Frame_List[i].In_Use = TRUE;
+	/* keep handles positive */
+	Frame_List[i].Generation = (Frame_List[i].Generation+1)&(((unsigned int)INT_MAX)>>FRAME_HANDLE_INDEX_BITS);
+	Frame_List[i].Reference_Count = 1;
+	Frame_List[i].Data = data;
+	Frame_List[i].Length = length;
+	Frame_List[i].Free_Function = free_fp;
+	Frame_List[i].Free_User_Data = user_data;
+	Frame_List[i].Buffer = buffer;
+	(*frame_handle) = (int)((Frame_List[i].Generation<<FRAME_HANDLE_INDEX_BITS)|((unsigned int)i));
+	pthread_mutex_unlock(&Frame_Lock);
 	return TRUE;
 }
 
 /**
- * Routine to get the double value of the keyword from the properties held in the instance of DpRtStatus.
- * @param keyword The keyword in the property file to look up.
- * @param value The address of an double to store the resulting value in.
- * @see #DpRt_Status
- * @see #DpRt_Status_Get_Property_Double_Method_Id
+ * Routine to map and pre-fault a frame buffer pool size class, and push all it's buffers onto it's free stack.
+ * @param size_class The size class to create.
+ * @param length The minimum length of each buffer in bytes.
+ * @param count The number of buffers.
+ * @param huge_pages If TRUE, try to map the size class with explicit huge pages (MAP_HUGETLB), falling
+ *        back to advising the kernel to use transparent huge pages (MADV_HUGEPAGE).
+ * @param lock_pages If TRUE, try to lock the size class into RAM.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails (including if the size class's length
+ *         does not fit in a size_t).
+ * @see #FRAME_POOL_HUGE_PAGE_LENGTH
  */
-int DpRt_JNI_DpRtStatus_Get_Property_Double(char *keyword,double *value)
+static int DpRt_JNI_Frame_Pool_Size_Class_Create(struct Frame_Pool_Size_Class_Struct *size_class,size_t length,
+						 int count,int huge_pages,int lock_pages)
 {
-	JNIEnv *env = NULL;
-	jstring java_keyword_string = NULL;
+	size_t page_length;
+	int flags,i;
 
-	if(DpRt_Status == NULL)
+	if(huge_pages)
+		page_length = FRAME_POOL_HUGE_PAGE_LENGTH;
+	else
+		page_length = (size_t)sysconf(_SC_PAGESIZE);
+	/* rounding up to a whole page, and then multiplying by count, must not overflow */
+	if((length > (SIZE_MAX-page_length+1))||
+	   ((((length+page_length-1)/page_length)*page_length) > (SIZE_MAX/((size_t)count))))
 	{
-		DpRt_JNI_Error_Number = 26;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Double:DpRt_Status was NULL(%s).\n",
-			keyword);
+		DpRt_JNI_Error_Set(128,"DpRt_JNI_Frame_Pool_Size_Class_Create:Size class too large(%lu,%d).\n",
+			(unsigned long)length,count);
 		return FALSE;
 	}
-	if(DpRt_Status_Get_Property_Double_Method_Id == NULL)
+	size_class->Buffer_Length = ((length+page_length-1)/page_length)*page_length;
+	size_class->Buffer_Count = count;
+	size_class->Region_Length = size_class->Buffer_Length*((size_t)count);
+	size_class->Huge_Pages = FALSE;
+	size_class->Locked = FALSE;
+	size_class->Region = MAP_FAILED;
+	flags = MAP_PRIVATE|MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+	flags |= MAP_POPULATE;
+#endif
+#ifdef MAP_HUGETLB
+	if(huge_pages)
 	{
-		DpRt_JNI_Error_Number = 27;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Double:Method ID was NULL (%s).\n",
-			keyword);
-		return FALSE;
+		size_class->Region = (char *)mmap(NULL,size_class->Region_Length,PROT_READ|PROT_WRITE,
+						  flags|MAP_HUGETLB,-1,0);
+		if(size_class->Region != MAP_FAILED)
+			size_class->Huge_Pages = TRUE;
 	}
-	if(Java_VM == NULL)
+#endif
+	if(size_class->Region == MAP_FAILED)
 	{
-		DpRt_JNI_Error_Number = 28;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Double:Java_VM was NULL(%s).\n",
-			keyword);
-		return FALSE;
+		size_class->Region = (char *)mmap(NULL,size_class->Region_Length,PROT_READ|PROT_WRITE,flags,-1,0);
+		if(size_class->Region == MAP_FAILED)
+		{
+			DpRt_JNI_Error_Set(82,"DpRt_JNI_Frame_Pool_Size_Class_Create:mmap failed(%lu,%d,%s).\n",
+				(unsigned long)size_class->Region_Length,count,strerror(errno));
+			return FALSE;
+		}
+#ifdef MADV_HUGEPAGE
+		if(huge_pages)
+			madvise(size_class->Region,size_class->Region_Length,MADV_HUGEPAGE);
+#endif
 	}
-/* get java env for this thread */
-	(*Java_VM)->AttachCurrentThread(Java_VM,(void**)&env,NULL);
-	if(env == NULL)
+	if(lock_pages)
+		size_class->Locked = (mlock(size_class->Region,size_class->Region_Length) == 0);
+	size_class->Next_List = (int *)malloc(count*sizeof(int));
+	if(size_class->Next_List == NULL)
 	{
-		DpRt_JNI_Error_Number = 29;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Double:env was NULL (%s).\n",
-			keyword);
+		munmap(size_class->Region,size_class->Region_Length);
+		DpRt_JNI_Error_Set(83,"DpRt_JNI_Frame_Pool_Size_Class_Create:Memory allocation error(%d).\n",
+			count);
 		return FALSE;
 	}
-	if(keyword == NULL)
+/* chain all the buffers onto the free stack, buffer 0 on top */
+	for(i = 0; i < count; i++)
+		size_class->Next_List[i] = ((i+1) < count) ? (i+1) : -1;
+	size_class->Free_Head = 1;
+	size_class->Free_Count = count;
+	return TRUE;
+}
+
+/**
+ * Routine to unmap a frame buffer pool size class.
+ * @param size_class The size class to destroy.
+ */
+static void DpRt_JNI_Frame_Pool_Size_Class_Destroy(struct Frame_Pool_Size_Class_Struct *size_class)
+{
+	if(size_class->Locked)
+		munlock(size_class->Region,size_class->Region_Length);
+	munmap(size_class->Region,size_class->Region_Length);
+	free(size_class->Next_List);
+	size_class->Region = NULL;
+	size_class->Next_List = NULL;
+	size_class->Buffer_Count = 0;
+	size_class->Free_Count = 0;
+}
+
+/**
+ * Routine to pop a free buffer off a size class's free stack, without locking. The head's tag is
+ * incremented by each successful compare and swap, so a head that has been popped and pushed back by 
+ * other threads since it was loaded is not mistaken for an unchanged one.
+ * @param size_class The size class.
+ * @return The buffer, or NULL if the size class has no free buffers.
+ * @see #Frame_Pool_Size_Class_Struct
+ */
+static char *DpRt_JNI_Frame_Pool_Pop(struct Frame_Pool_Size_Class_Struct *size_class)
+{
+	uint64_t head,new_head;
+	int index,next_index;
+
+	head = __atomic_load_n(&(size_class->Free_Head),__ATOMIC_ACQUIRE);
+	do
+	{
+		index = ((int)(head&0xffffffff))-1;
+		if(index < 0)
+			return NULL;
+		next_index = __atomic_load_n(&(size_class->Next_List[index]),__ATOMIC_RELAXED);
+		new_head = ((((head>>32)+1)&0xffffffff)<<32)|((uint64_t)(next_index+1));
+	} while(!__atomic_compare_exchange_n(&(size_class->Free_Head),&head,new_head,TRUE,__ATOMIC_ACQUIRE,
+					     __ATOMIC_ACQUIRE));
+	__atomic_sub_fetch(&(size_class->Free_Count),1,__ATOMIC_RELAXED);
+	return size_class->Region+(((size_t)index)*size_class->Buffer_Length);
+}
+
+/**
+ * Routine to push a buffer back onto it's size class's free stack, without locking. This is used as
+ * the free function of frames got from the pool, so it is called when the frame's last reference is released.
+ * @param data The buffer.
+ * @param user_data The buffer's size class (a struct Frame_Pool_Size_Class_Struct pointer).
+ * @see #DpRt_JNI_Frame_Pool_Get
+ * @see #DpRt_JNI_Frame_Pool_Pop
+ */
+static void DpRt_JNI_Frame_Pool_Push(void *data,void *user_data)
+{
+	struct Frame_Pool_Size_Class_Struct *size_class = (struct Frame_Pool_Size_Class_Struct *)user_data;
+	uint64_t head,new_head;
+	int index;
+
+	index = (int)((((char *)data)-size_class->Region)/size_class->Buffer_Length);
+	head = __atomic_load_n(&(size_class->Free_Head),__ATOMIC_RELAXED);
+	do
 	{
-		DpRt_JNI_Error_Number = 30;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Double:string (%s) was NULL.\n",
-			keyword);
-		return FALSE;
-	}
-	if(value == NULL)
+		__atomic_store_n(&(size_class->Next_List[index]),((int)(head&0xffffffff))-1,__ATOMIC_RELAXED);
+		new_head = ((((head>>32)+1)&0xffffffff)<<32)|((uint64_t)(index+1));
+	} while(!__atomic_compare_exchange_n(&(size_class->Free_Head),&head,new_head,TRUE,__ATOMIC_RELEASE,
+					     __ATOMIC_RELAXED));
+	__atomic_add_fetch(&(size_class->Free_Count),1,__ATOMIC_RELEASE);
+}
+
+/**
+ * Routine to find a frame from it's handle. Frame_Lock must be held by the caller.
+ * @param frame_handle The frame's handle.
+ * @return The frame, or NULL (with DpRt_JNI_Error_Number set) if the handle is not a current frame.
+ * @see #Frame_List
+ */
+static struct Frame_Struct *DpRt_JNI_Frame_Get(int frame_handle)
+{
+	struct Frame_Struct *frame = NULL;
+
+	if(frame_handle >= 0)
 	{
-		DpRt_JNI_Error_Number = 31;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Double:value Pointer was NULL.\n");
-		return FALSE;
+		frame = &(Frame_List[frame_handle&(FRAME_MAX_COUNT-1)]);
+		if(frame->In_Use && (frame->Generation == (((unsigned int)frame_handle)>>FRAME_HANDLE_INDEX_BITS)))
+			return frame;
 	}
-/* convert C to Java String */
-	java_keyword_string = (*env)->NewStringUTF(env,keyword);
-/* call getProperty method on DpRt_Status instance */
-	(*value) = (double)((*env)->CallDoubleMethod(env,DpRt_Status,DpRt_Status_Get_Property_Double_Method_Id,
-			java_keyword_string));
-	return TRUE;
+	DpRt_JNI_Error_Set(73,"DpRt_JNI_Frame_Get:Illegal frame handle %d.\n",frame_handle);
+	return NULL;
 }
 
 /**
- * Routine to get the boolean value of the keyword from the properties held in the instance of DpRtStatus.
- * @param keyword The keyword in the property file to look up.
- * @param value The address of an boolean to store the resulting value in.
- * @see #DpRt_Status
- * @see #DpRt_Status_Get_Property_Boolean_Method_Id
+ * Routine to retrieve an optional keyword's value, for the DpRt_JNI_Get_Property_*_Default routines.
+ * If the keyword is recorded as missing in the current context's missing property cache (for the current
+ * property generation), FALSE is returned at once. Otherwise the value is retrieved with the usual getter.
+ * The keyword is missing if the getter fails to find it (error 40 or 55), a string value is NULL, or the 
+ * getter threw a NumberFormatException (the DpRtStatus numeric getters do, for keywords that do not exist); 
+ * the exception and error are cleared, and the keyword recorded as missing. Any other failure 
+ * (e.g. a value that cannot be converted, or an allocation failure) leaves the error set (and any other 
+ * Java exception pending), and is not recorded. No upcall is attempted if a Java exception is already pending.
+ * @param keyword The keyword to look up.
+ * @param type Which type of value to retrieve, one of DPRT_JNI_PROPERTY_TYPE_*.
+ * @param value The address to store the value in: a char* for DPRT_JNI_PROPERTY_TYPE_STRING, an int for
+ *        DPRT_JNI_PROPERTY_TYPE_INTEGER or DPRT_JNI_PROPERTY_TYPE_BOOLEAN, a double for 
+ *        DPRT_JNI_PROPERTY_TYPE_DOUBLE.
+ * @return TRUE if the value was retrieved, FALSE if it is missing (with no error set) or could not be 
+ *         retrieved (with the error set).
+ * @see #DpRt_JNI_Property_Generation_Get
+ * @see #DpRt_JNI_Missing_Property_Cache_Get
+ * @see #DpRt_JNI_Missing_Property_Cache_Put
+ * @see #DpRt_JNI_Exception_Clear_Instance_Of
  */
-int DpRt_JNI_DpRtStatus_Get_Property_Boolean(char *keyword,int *value)
+static int DpRt_JNI_Get_Property_Optional(char *keyword,int type,void *value)
 {
-	JNIEnv *env = NULL;
-	jstring java_keyword_string = NULL;
-	jboolean boolean_value;
+	struct DpRt_JNI_Context_Struct *context = NULL;
+	struct Thread_Data_Struct *thread_data = NULL;
+	unsigned int generation;
+	int retval,missing,error_number;
 
-	if(DpRt_Status == NULL)
-	{
-		DpRt_JNI_Error_Number = 32;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:"
-			"DpRt_Status was NULL(%s).\n",keyword);
+	if(keyword == NULL)
 		return FALSE;
-	}
-	if(DpRt_Status_Get_Property_Boolean_Method_Id == NULL)
+	context = DpRt_JNI_Context_Get_Current();
+/* an exception pending before this call is not ours to clear, and no upcall can be made with it pending */
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if((thread_data != NULL)&&(thread_data->Env != NULL)&&
+	   ((*(thread_data->Env))->ExceptionCheck(thread_data->Env)))
 	{
-		DpRt_JNI_Error_Number = 33;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:Method ID was NULL(%s).\n",
-			keyword);
+		DpRt_JNI_Error_Set(155,"DpRt_JNI_Get_Property_Optional:Java exception already pending (%s).\n",
+				   keyword);
 		return FALSE;
 	}
-	if(Java_VM == NULL)
-	{
-		DpRt_JNI_Error_Number = 34;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:Java_VM was NULL(%s).\n",
-			keyword);
+/* let the property file index notice the file has changed, before trusting the missing property cache */
+	if(context->DpRt_Data.DpRt_Get_Property_Function_Pointer == DpRt_JNI_Get_Property_From_C_File)
+		DpRt_JNI_Property_Index_Check(FALSE);
+	generation = DpRt_JNI_Property_Generation_Get(context);
+	if(DpRt_JNI_Missing_Property_Cache_Get(context,keyword,type,generation))
 		return FALSE;
-	}
-/* get java env for this thread */
-	(*Java_VM)->AttachCurrentThread(Java_VM,(void**)&env,NULL);
-	if(env == NULL)
+	missing = FALSE;
+	switch(type)
 	{
-		DpRt_JNI_Error_Number = 35;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:env was NULL (%s).\n",
-			keyword);
-		return FALSE;
+		case DPRT_JNI_PROPERTY_TYPE_STRING:
+			retval = DpRt_JNI_Get_Property(keyword,(char **)value);
+			if(retval && ((*(char **)value) == NULL))
+			{
+				retval = FALSE;
+				missing = TRUE;
+			}
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_INTEGER:
+			retval = DpRt_JNI_Get_Property_Integer(keyword,(int *)value);
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_DOUBLE:
+			retval = DpRt_JNI_Get_Property_Double(keyword,(double *)value);
+			break;
+		case DPRT_JNI_PROPERTY_TYPE_BOOLEAN:
+			retval = DpRt_JNI_Get_Property_Boolean(keyword,(int *)value);
+			break;
+		default:
+			return FALSE;
 	}
-	if(keyword == NULL)
+/* an upcall into the JVM throws a NumberFormatException for a missing keyword. 
+** Any other exception (e.g. an OutOfMemoryError) is left pending. */
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if((thread_data != NULL)&&(thread_data->Env != NULL)&&
+	   ((*(thread_data->Env))->ExceptionCheck(thread_data->Env)))
 	{
-		DpRt_JNI_Error_Number = 36;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:string (%s) was NULL.\n",
-			keyword);
-		return FALSE;
+		if(DpRt_JNI_Exception_Clear_Instance_Of(thread_data->Env,"java/lang/NumberFormatException") == FALSE)
+		{
+			if((type == DPRT_JNI_PROPERTY_TYPE_STRING)&&retval&&((*(char **)value) != NULL))
+			{
+				free(*(char **)value);
+				(*(char **)value) = NULL;
+			}
+			DpRt_JNI_Error_Set(156,"DpRt_JNI_Get_Property_Optional:Getter threw an exception (%s).\n",
+					   keyword);
+			return FALSE;
+		}
+		retval = FALSE;
+		missing = TRUE;
 	}
-	if(value == NULL)
+	if(retval)
+		return TRUE;
+/* only a keyword that was not found is missing, other errors (e.g. a conversion failure) are left set */
+	if(missing == FALSE)
 	{
-		DpRt_JNI_Error_Number = 37;
-		sprintf(DpRt_JNI_Error_String,"DpRt_JNI_DpRtStatus_Get_Property_Boolean:value Pointer was NULL.\n");
-		return FALSE;
+		error_number = DpRt_JNI_Get_Error_Number();
+		if((error_number != 40)&&(error_number != 55))
+			return FALSE;
 	}
-/* convert C to Java String */
-	java_keyword_string = (*env)->NewStringUTF(env,keyword);
-/* call getProperty method on DpRt_Status instance */
-	boolean_value = (double)((*env)->CallBooleanMethod(env,DpRt_Status,DpRt_Status_Get_Property_Boolean_Method_Id,
-			java_keyword_string));
-	if(boolean_value)
-		(*value) = TRUE;
-	else
-		(*value) = FALSE;
-	return TRUE;
+	DpRt_JNI_Error_Clear();
+	DpRt_JNI_Missing_Property_Cache_Put(context,keyword,type,generation);
+	return FALSE;
 }
 
-/* set property function pointers */
 /**
- * Routine to set the function pointer that is called from <b>DpRt_Get_Property</b> .
- * @see #DpRt_Get_Property
- * @see #DpRt_Data
+ * Routine to get the current property generation of a context. This changes whenever the context's property
+ * source changes (a new backend or DpRtStatus, a cache invalidation or snapshot refresh), or the property
+ * file is re-loaded.
+ * @param context The context.
+ * @return The property generation.
+ * @see #DpRt_JNI_Context_Struct
+ * @see #Property_Index_Generation
  */
-void DpRt_JNI_Set_Property_Function_Pointer(int (*get_property_fp)(char *keyword,char **value_string))
+static unsigned int DpRt_JNI_Property_Generation_Get(struct DpRt_JNI_Context_Struct *context)
 {
-	DpRt_Data.DpRt_Get_Property_Function_Pointer = get_property_fp;
+	return __atomic_load_n(&context->Property_Generation,__ATOMIC_ACQUIRE)+
+		__atomic_load_n(&Property_Index_Generation,__ATOMIC_ACQUIRE);
 }
 
 /**
- * Routine to set the function pointer that is called from <b>DpRt_Get_Property_Integer</b> .
- * @see #DpRt_Get_Property_Integer
- * @see #DpRt_Data
+ * Routine to check whether a keyword is recorded as missing in a context's missing property cache.
+ * @param context The context.
+ * @param keyword The keyword.
+ * @param type The type of value, one of DPRT_JNI_PROPERTY_TYPE_*.
+ * @param generation The current property generation. Entries from other generations are ignored.
+ * @return TRUE if the keyword is known to be missing, FALSE otherwise.
+ * @see #Missing_Property_Entry_Struct
  */
-void DpRt_JNI_Set_Property_Integer_Function_Pointer(int (*get_property_integer_fp)(char *keyword,int *value))
+static int DpRt_JNI_Missing_Property_Cache_Get(struct DpRt_JNI_Context_Struct *context,char *keyword,int type,
+					       unsigned int generation)
 {
-	DpRt_Data.DpRt_Get_Property_Integer_Function_Pointer = get_property_integer_fp;
+	struct Missing_Property_Entry_Struct *entry = NULL;
+	unsigned int hash;
+	int retval;
+
+	hash = DpRt_JNI_Property_Hash(keyword,strlen(keyword));
+	pthread_mutex_lock(&context->Missing_Property_Cache_Lock);
+	entry = context->Missing_Property_Cache[hash&(MISSING_PROPERTY_CACHE_BUCKET_COUNT-1)];
+	while((entry != NULL)&&((entry->Hash != hash)||(strcmp(entry->Keyword,keyword) != 0)))
+		entry = entry->Next;
+	retval = (entry != NULL)&&(entry->Generation == generation)&&(entry->Missing_List[type]);
+	pthread_mutex_unlock(&context->Missing_Property_Cache_Lock);
+	return retval;
 }
 
 /**
- * Routine to set the function pointer that is called from <b>DpRt_Get_Property_Double</b> .
- * @see #DpRt_Get_Property_Double
- * @see #DpRt_Data
+ * Routine to record a keyword as missing in a context's missing property cache. An existing entry 
+ * for the keyword from an older generation is re-used.
+ * @param context The context.
+ * @param keyword The keyword.
+ * @param type The type of value, one of DPRT_JNI_PROPERTY_TYPE_*.
+ * @param generation The property generation the keyword was found to be missing in.
+ * @see #Missing_Property_Entry_Struct
  */
-void DpRt_JNI_Set_Property_Double_Function_Pointer(int (*get_property_double_fp)(char *keyword,double *value))
+static void DpRt_JNI_Missing_Property_Cache_Put(struct DpRt_JNI_Context_Struct *context,char *keyword,int type,
+						unsigned int generation)
 {
-	DpRt_Data.DpRt_Get_Property_Double_Function_Pointer = get_property_double_fp;
+	struct Missing_Property_Entry_Struct *entry = NULL;
+	unsigned int hash,bucket;
+	int i;
+
+	hash = DpRt_JNI_Property_Hash(keyword,strlen(keyword));
+	bucket = hash&(MISSING_PROPERTY_CACHE_BUCKET_COUNT-1);
+	pthread_mutex_lock(&context->Missing_Property_Cache_Lock);
+	entry = context->Missing_Property_Cache[bucket];
+	while((entry != NULL)&&((entry->Hash != hash)||(strcmp(entry->Keyword,keyword) != 0)))
+		entry = entry->Next;
+	if(entry == NULL)
+	{
+		entry = (struct Missing_Property_Entry_Struct *)malloc(sizeof(struct Missing_Property_Entry_Struct));
+		if(entry == NULL)
+		{
+			pthread_mutex_unlock(&context->Missing_Property_Cache_Lock);
+			return;
+		}
+		entry->Keyword = strdup(keyword);
+		if(entry->Keyword == NULL)
+		{
+			pthread_mutex_unlock(&context->Missing_Property_Cache_Lock);
+			free(entry);
+			return;
+		}
+		entry->Hash = hash;
+		entry->Generation = generation+1; /* force the missing list to be reset below */
+		entry->Next = context->Missing_Property_Cache[bucket];
+		context->Missing_Property_Cache[bucket] = entry;
+	}
+	if(entry->Generation != generation)
+	{
+		for(i = 0; i < DPRT_JNI_PROPERTY_TYPE_COUNT; i++)
+			entry->Missing_List[i] = FALSE;
+		entry->Generation = generation;
+	}
+	entry->Missing_List[type] = TRUE;
+	pthread_mutex_unlock(&context->Missing_Property_Cache_Lock);
 }
 
 /**
- * Routine to set the function pointer that is called from <b>DpRt_Get_Property_Boolean</b> .
- * @see #DpRt_Get_Property_Boolean
- * @see #DpRt_Data
+ * Routine to free all the entries in a context's missing property cache.
+ * @param context The context.
+ * @see #Missing_Property_Entry_Struct
  */
-void DpRt_JNI_Set_Property_Boolean_Function_Pointer(int (*get_property_boolean_fp)(char *keyword,int *value))
+static void DpRt_JNI_Missing_Property_Cache_Free(struct DpRt_JNI_Context_Struct *context)
 {
-	DpRt_Data.DpRt_Get_Property_Boolean_Function_Pointer = get_property_boolean_fp;
+	struct Missing_Property_Entry_Struct *entry = NULL;
+	struct Missing_Property_Entry_Struct *next_entry = NULL;
+	int bucket;
+
+	pthread_mutex_lock(&context->Missing_Property_Cache_Lock);
+	for(bucket = 0; bucket < MISSING_PROPERTY_CACHE_BUCKET_COUNT; bucket++)
+	{
+		entry = context->Missing_Property_Cache[bucket];
+		while(entry != NULL)
+		{
+			next_entry = entry->Next;
+			free(entry->Keyword);
+			free(entry);
+			entry = next_entry;
+		}
+		context->Missing_Property_Cache[bucket] = NULL;
+	}
+	pthread_mutex_unlock(&context->Missing_Property_Cache_Lock);
 }
 
-/* command done */
 /**
- * Routine to set the COMMAND_DONE return parameters for a JNI command.
- * @param env The usual JNI parameter.
- * @param cls The JNI class identifier to get the methods for.
- * @param done The object to call the methods for.
- * @param successful The value to set the COMMAND_DONE.successful to.
- * @param error_number The value to set the COMMAND_DONE.errorNumber to.
- * @param error_string The value to set the COMMAND_DONE.errorString to.
- * @return TRUE if all the methods were called successfully, FALSE if a method call failed.
+ * Routine to free the scheduler's workers, once Running is FALSE and Starting has been cleared. The first 
+ * thread_count worker threads are joined, then the deques and locks of the first worker_count workers are 
+ * freed, followed by Worker_List itself.
+ * @param worker_count The number of workers whose lock has been initialised (their Job_List may be NULL).
+ * @param thread_count The number of worker threads that were created, and must be joined.
+ * @see #Scheduler
+ * @see #DpRt_JNI_Scheduler_Start
+ * @see #DpRt_JNI_Scheduler_Stop
  */
-int DpRt_JNI_Set_Command_Done(JNIEnv *env,jclass cls,jobject done,
-					int successful,int error_number,char *error_string)
+static void DpRt_JNI_Scheduler_Free(int worker_count,int thread_count)
 {
-	jmethodID mid;
-
-	/* successful */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setSuccessful","(Z)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,successful);
-
-	/* error number */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setErrorNum","(I)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,error_number);
-
-	/* error string */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setErrorString","(Ljava/lang/String;)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,(*env)->NewStringUTF(env,error_string));
+	int i;
 
-	return TRUE;
+	for(i = 0; i < thread_count; i++)
+		pthread_join(Scheduler.Worker_List[i].Thread,NULL);
+	for(i = 0; i < worker_count; i++)
+	{
+		if(Scheduler.Worker_List[i].Job_List != NULL)
+			free(Scheduler.Worker_List[i].Job_List);
+		pthread_mutex_destroy(&(Scheduler.Worker_List[i].Lock));
+	}
+	free(Scheduler.Worker_List);
+	Scheduler.Worker_List = NULL;
+	Scheduler.Worker_Count = 0;
 }
 
 /**
- * Internal routine to set the REDUCE_DONE return parameters for a JNI command.
- * @param env The usual JNI parameter.
- * @param cls The JNI class identifier to get the methods for.
- * @param done The object to call the methods for.
- * @param output_filename The value to set the REDUCE_DONE.filename to.
- * @return TRUE if all the methods were called successfully, FALSE if a method call failed.
+ * A scheduler worker thread. The worker repeatedly pops the newest job from it's own deque, or if that is 
+ * empty steals the oldest job from another worker's deque (starting with the next worker), and runs it.
+ * When there are no jobs anywhere, it sleeps on the scheduler's Work_Condition. Once the scheduler has been 
+ * stopped and all the jobs have been run, the worker exits. The worker first attaches itself to the JVM as a
+ * daemon thread (using DpRt_JNI_Get_Env), reports whether it could to DpRt_JNI_Scheduler_Start, and waits 
+ * for the scheduler to finish starting. If it could not attach it exits straight away, without taking jobs. 
+ * It is detached when it exits.
+ * @param arg The worker's Scheduler_Worker_Struct.
+ * @return NULL.
+ * @see #Scheduler
+ * @see #DpRt_JNI_Scheduler_Pop
+ * @see #DpRt_JNI_Scheduler_Steal
+ * @see #DpRt_JNI_Scheduler_Job_Run
  */
-int DpRt_JNI_Set_Reduce_Done(JNIEnv *env,jclass cls,jobject done,char *output_filename)
+static void *DpRt_JNI_Scheduler_Worker_Thread(void *arg)
 {
-	jmethodID mid;
+	struct Scheduler_Worker_Struct *worker = (struct Scheduler_Worker_Struct *)arg;
+	struct Scheduler_Job_Struct *job = NULL;
+	struct Thread_Data_Struct *thread_data = NULL;
+	JNIEnv *env = NULL;
+	char thread_name[32];
 
-	/* output_filename */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setFilename","(Ljava/lang/String;)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	if(output_filename != NULL)
-		(*env)->CallVoidMethod(env,done,mid,(*env)->NewStringUTF(env,output_filename));
-	else
-		(*env)->CallVoidMethod(env,done,mid,NULL);
-	return TRUE;
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if(thread_data != NULL)
+		thread_data->Scheduler_Worker = worker;
+	snprintf(thread_name,sizeof(thread_name),"DpRt scheduler worker %d",worker->Index);
+	env = DpRt_JNI_Get_Env(thread_name);
+	pthread_mutex_lock(&(Scheduler.Lock));
+	Scheduler.Started_Count++;
+	if(env == NULL)
+		Scheduler.Attach_Failed_Count++;
+	pthread_cond_broadcast(&(Scheduler.Started_Condition));
+	while((env != NULL)&&Scheduler.Starting)
+		pthread_cond_wait(&(Scheduler.Started_Condition),&(Scheduler.Lock));
+	pthread_mutex_unlock(&(Scheduler.Lock));
+	while(env != NULL)
+	{
+		job = DpRt_JNI_Scheduler_Pop(worker);
+		if(job == NULL)
+			job = DpRt_JNI_Scheduler_Steal(worker);
+		if(job != NULL)
+		{
+			DpRt_JNI_Scheduler_Job_Run(env,job);
+			DpRt_JNI_Scheduler_Job_Free(env,job);
+			__atomic_add_fetch(&Scheduler.Completed_Count,1,__ATOMIC_RELAXED);
+			continue;
+		}
+		pthread_mutex_lock(&(Scheduler.Lock));
+		while((__atomic_load_n(&Scheduler.Pending_Count,__ATOMIC_SEQ_CST) == 0)&&
+		      __atomic_load_n(&Scheduler.Running,__ATOMIC_ACQUIRE))
+		{
+			Scheduler.Sleeping_Count++;
+			pthread_cond_wait(&(Scheduler.Work_Condition),&(Scheduler.Lock));
+			Scheduler.Sleeping_Count--;
+		}
+		if((__atomic_load_n(&Scheduler.Pending_Count,__ATOMIC_SEQ_CST) == 0)&&
+		   (__atomic_load_n(&Scheduler.Running,__ATOMIC_ACQUIRE) == FALSE))
+		{
+			pthread_mutex_unlock(&(Scheduler.Lock));
+			break;
+		}
+		pthread_mutex_unlock(&(Scheduler.Lock));
+	}
+	if(thread_data != NULL)
+		thread_data->Scheduler_Worker = NULL;
+	return NULL;
 }
 
 /**
- * Routine to set the CALIBRATE_REDUCE_DONE return parameters for a JNI command.
- * @param env The usual JNI parameter.
- * @param cls The JNI class identifier to get the methods for.
- * @param done The object to call the methods for. Should be an instance of CALIBRATE_REDUCE_DONE.
- * @param mean_counts The mean counts parameter.
- * @param peak_counts The peak counts parameter.
- * @return TRUE if all the methods were called successfully, FALSE if a method call failed.
+ * Routine to push a job onto the bottom of a worker's deque, doubling the deque's capacity if it is full.
+ * @param worker The worker.
+ * @param job The job.
+ * @return The routine returns TRUE if it succeeds, FALSE if the deque could not be grown.
+ * @see #Scheduler_Worker_Struct
  */
-int DpRt_JNI_Set_Calibrate_Reduce_Done(JNIEnv *env,jclass cls,jobject done,
-					double mean_counts,double peak_counts)
+static int DpRt_JNI_Scheduler_Push(struct Scheduler_Worker_Struct *worker,struct Scheduler_Job_Struct *job)
 {
-	jmethodID mid;
-
-	/* meanCounts */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setMeanCounts","(F)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method	*/
-	(*env)->CallVoidMethod(env,done,mid,(float)mean_counts);
+	struct Scheduler_Job_Struct **new_job_list = NULL;
+	unsigned long position;
 
-	/* peakCounts */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setPeakCounts","(F)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,(float)peak_counts);
+	pthread_mutex_lock(&(worker->Lock));
+	if((worker->Bottom-worker->Top) == worker->Capacity)
+	{
+		new_job_list = (struct Scheduler_Job_Struct **)malloc(worker->Capacity*2*
+								      sizeof(struct Scheduler_Job_Struct *));
+		if(new_job_list == NULL)
+		{
+			pthread_mutex_unlock(&(worker->Lock));
+			return FALSE;
+		}
+		for(position = worker->Top; position != worker->Bottom; position++)
+		{
+			new_job_list[position&((worker->Capacity*2)-1)] = 
+				worker->Job_List[position&(worker->Capacity-1)];
+		}
+		free(worker->Job_List);
+		worker->Job_List = new_job_list;
+		worker->Capacity *= 2;
+	}
+	worker->Job_List[worker->Bottom&(worker->Capacity-1)] = job;
+	worker->Bottom++;
+	pthread_mutex_unlock(&(worker->Lock));
 	return TRUE;
 }
 
 /**
- * Routine to set the EXPOSE_REDUCE_DONE return parameters for a JNI command.
- * @param env The usual JNI parameter.
- * @param cls The JNI class identifier to get the methods for.
- * @param done The object to call the methods for. Should be an instance of EXPOSE_REDUCE_DONE.
- * @param seeing The seeing parameter.
- * @param counts The counts of the brightest object parameter.
- * @param x_pix The X position in pixels of the brightest object.
- * @param y_pix The Y position in pixels of the brightest object.
- * @param photometricity A measure of the photometricity of the field (if a standard).
- * @param sky_brightness A measure of the sky brightness.
- * @param saturated An integer (boolean), set to TRUE if the field contains saturated stars.
- * @return TRUE if all the methods were called successfully, FALSE if a method call failed.
+ * Routine to pop the newest job from the bottom of a worker's own deque.
+ * @param worker The worker.
+ * @return The job, or NULL if the deque is empty.
+ * @see #Scheduler_Worker_Struct
  */
-int DpRt_JNI_Set_Expose_Reduce_Done(JNIEnv *env,jclass cls,jobject done,double seeing,double counts,
-				    double x_pix,double y_pix,double photometricity,
-				    double sky_brightness,int saturated)
+static struct Scheduler_Job_Struct *DpRt_JNI_Scheduler_Pop(struct Scheduler_Worker_Struct *worker)
 {
-	jmethodID mid;
-
-	/* seeing */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setSeeing","(F)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,(float)seeing);
-
-	/* counts */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setCounts","(F)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,(float)counts);
+	struct Scheduler_Job_Struct *job = NULL;
 
-	/* x_pix */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setXpix","(F)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,(float)x_pix);
+	pthread_mutex_lock(&(worker->Lock));
+	if(worker->Bottom != worker->Top)
+	{
+		worker->Bottom--;
+		job = worker->Job_List[worker->Bottom&(worker->Capacity-1)];
+	}
+	pthread_mutex_unlock(&(worker->Lock));
+	if(job != NULL)
+		__atomic_sub_fetch(&Scheduler.Pending_Count,1,__ATOMIC_SEQ_CST);
+	return job;
+}
 
-	/* y_pix */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setYpix","(F)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,(float)y_pix);
+/**
+ * Routine to steal the oldest job from the top of another worker's deque. The other workers are tried
+ * in turn, starting with the next one. A deque whose lock is held (by it's owner or another thief) is
+ * skipped rather than waited for.
+ * @param worker The stealing worker.
+ * @return The job, or NULL if no job could be stolen.
+ * @see #Scheduler_Worker_Struct
+ */
+static struct Scheduler_Job_Struct *DpRt_JNI_Scheduler_Steal(struct Scheduler_Worker_Struct *worker)
+{
+	struct Scheduler_Worker_Struct *victim = NULL;
+	struct Scheduler_Job_Struct *job = NULL;
+	int i,contended;
 
-	/* photometricity */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setPhotometricity","(F)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,(float)photometricity);
+	do
+	{
+		contended = FALSE;
+		for(i = 1; (i < Scheduler.Worker_Count)&&(job == NULL); i++)
+		{
+			victim = &(Scheduler.Worker_List[(worker->Index+i)%Scheduler.Worker_Count]);
+			if(pthread_mutex_trylock(&(victim->Lock)) != 0)
+			{
+				contended = TRUE;
+				continue;
+			}
+			if(victim->Bottom != victim->Top)
+			{
+				job = victim->Job_List[victim->Top&(victim->Capacity-1)];
+				victim->Top++;
+			}
+			pthread_mutex_unlock(&(victim->Lock));
+		}
+	/* only re-scan the contended deques if there are jobs to be had */
+	} while((job == NULL)&&contended&&(__atomic_load_n(&Scheduler.Pending_Count,__ATOMIC_SEQ_CST) > 0));
+	if(job != NULL)
+	{
+		__atomic_sub_fetch(&Scheduler.Pending_Count,1,__ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&Scheduler.Stolen_Count,1,__ATOMIC_RELAXED);
+	}
+	return job;
+}
 
-	/* sky_brightness */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setSkyBrightness","(F)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,(float)sky_brightness);
+/**
+ * Routine to run a job on a worker. The job's context and cancellation token are bound to the worker 
+ * whilst it runs, and it runs inside it's own local reference frame. If the job was cancelled, or it's 
+ * context aborted, before it started, or the frame could not be pushed, it is not run. Completion is 
+ * reported to the job's done object with DpRt_JNI_Set_Command_Done either way. The job's future, if any,
+ * is then passed to the completion queue (or completed here, if the completion queue has been stopped).
+ * @param env The worker's JNI environment pointer.
+ * @param job The job.
+ * @see #Scheduler_Job_Struct
+ * @see #DpRt_JNI_Set_Command_Done
+ */
+static void DpRt_JNI_Scheduler_Job_Run(JNIEnv *env,struct Scheduler_Job_Struct *job)
+{
+	int frame_pushed,retval;
 
-	/* saturated */
-	/* get the method id in this class */
-	mid = (*env)->GetMethodID(env,cls,"setSaturation","(Z)V");
-	/* did we find the method id? */
-	if (mid == 0)
-		return FALSE;
-	/* call the method */
-	(*env)->CallVoidMethod(env,done,mid,(jboolean)saturated);
-	return TRUE;
+	DpRt_JNI_Context_Set_Current(job->Context);
+	DpRt_JNI_Cancel_Token_Set_Current(job->Cancel_Token);
+	DpRt_JNI_Error_Clear();
+	frame_pushed = ((*env)->PushLocalFrame(env,16) == 0);
+	if(frame_pushed == FALSE)
+	{
+		(*env)->ExceptionClear(env);
+		DpRt_JNI_Error_Set(135,"DpRt_JNI_Scheduler_Job_Run:Failed to push a local reference frame.\n");
+		retval = FALSE;
+	}
+	else if(DpRt_JNI_Get_Abort())
+	{
+		DpRt_JNI_Error_Set(111,"DpRt_JNI_Scheduler_Job_Run:Job aborted before it started.\n");
+		retval = FALSE;
+	}
+	else
+		retval = job->Reduce_Function(env,job->Done_Class,job->Done,job->User_Data);
+	if((*env)->ExceptionCheck(env))
+		(*env)->ExceptionClear(env);
+/* completion is still reported (and the future completed) without a frame, these calls delete their own 
+** local references */
+	if(retval)
+		DpRt_JNI_Set_Command_Done(env,job->Done_Class,job->Done,TRUE,0,"");
+	else
+	{
+		DpRt_JNI_Set_Command_Done(env,job->Done_Class,job->Done,FALSE,DpRt_JNI_Error_Number,
+					  DpRt_JNI_Error_String);
+	}
+	if((*env)->ExceptionCheck(env))
+		(*env)->ExceptionClear(env);
+	if(job->Future != NULL)
+	{
+		/* the completion queue takes over the future and done global references */
+		if(DpRt_JNI_Completion_Queue_Put(job->Future,job->Done))
+		{
+			job->Future = NULL;
+			job->Done = NULL;
+		}
+		else
+		{
+			(*env)->CallBooleanMethod(env,job->Future,Completion_Queue.Complete_Method_Id,job->Done);
+			if((*env)->ExceptionCheck(env))
+				(*env)->ExceptionClear(env);
+		}
+	}
+	if(frame_pushed)
+		(*env)->PopLocalFrame(env,NULL);
+	DpRt_JNI_Cancel_Token_Set_Current(NULL);
+	DpRt_JNI_Context_Set_Current(NULL);
 }
 
-
-/* exception handling */
 /**
- * This routine throws an exception. The error generated is from the error codes in dprt, it assumes
- * another routine has generated an error and this routine packs this error into an exception to return
- * to the Java code, using DpRt_JNI_Throw_Exception_String. The total length of the error string should
- * not be longer than DPRT_ERROR_STRING_LENGTH. A new line is added to the start of the error string,
- * so that the error string returned from libdprt is formatted properly.
- * @param env The JNI environment pointer.
- * @param function_name The name of the function in which this exception is being generated for.
- * @see #DpRt_JNI_Get_Error_Number
- * @see #DpRt_JNI_Get_Error_String
- * @see #DpRt_JNI_Throw_Exception_String
- * @see #DPRT_ERROR_STRING_LENGTH
+ * Routine to free a job, deleting it's global references and destroying it's cancellation token.
+ * @param env A JNI environment pointer, or NULL if the global references cannot be deleted.
+ * @param job The job.
+ * @see #Scheduler_Job_Struct
  */
-void DpRt_JNI_Throw_Exception(JNIEnv *env,char *function_name)
+static void DpRt_JNI_Scheduler_Job_Free(JNIEnv *env,struct Scheduler_Job_Struct *job)
 {
-	char error_string[DPRT_ERROR_STRING_LENGTH];
-	int error_number;
-
-	error_number = DpRt_JNI_Get_Error_Number();
-	strcpy(error_string,"\n");
-	DpRt_JNI_Get_Error_String(error_string+strlen(error_string));
-	DpRt_JNI_Throw_Exception_String(env,function_name,error_number,error_string);
+	if(env != NULL)
+	{
+		if(job->Done != NULL)
+			(*env)->DeleteGlobalRef(env,job->Done);
+		if(job->Future != NULL)
+			(*env)->DeleteGlobalRef(env,job->Future);
+		(*env)->DeleteGlobalRef(env,job->Done_Class);
+	}
+	DpRt_JNI_Cancel_Token_Destroy(job->Cancel_Token);
+	free(job);
 }
 
 /**
- * This routine throws an exception of class ngat.dprt.ccs.DpRtLibraryNativeException. This is used to report
- * all libdprt error messages back to the Java layer.
+ * Routine to create a scheduler job and queue it on a worker's deque. Jobs submitted from a worker are 
+ * queued on that worker's own deque, other jobs are distributed round-robin across the workers.
  * @param env The JNI environment pointer.
- * @param function_name The name of the function in which this exception is being generated for.
- * @param error_number The error number to pass to the constructor of the exception.
- * @param error_string The string to pass to the constructor of the exception.
- * @see #DpRt_JNI_Error_Number
- * @see #DpRt_JNI_Error_String
+ * @param cls The class of the done object.
+ * @param done The done object to report completion to.
+ * @param future A CompletableFuture to complete with done (through the completion queue) once completion
+ *        has been reported, or NULL.
+ * @param reduce_fp The function that does the reduction.
+ * @param user_data Passed to reduce_fp.
+ * @return The routine returns TRUE if it succeeds, FALSE if it fails.
+ * @see #Scheduler
+ * @see #Scheduler_Job_Struct
+ * @see #DpRt_JNI_Scheduler_Submit
+ * @see #DpRt_JNI_Reduce_Async_Submit
+ * @see #DpRt_JNI_Scheduler_Push
  */
-void DpRt_JNI_Throw_Exception_String(JNIEnv *env,char *function_name,int error_number,char *error_string)
+static int DpRt_JNI_Scheduler_Job_Submit(JNIEnv *env,jclass cls,jobject done,jobject future,
+				 int (*reduce_fp)(JNIEnv *env,jclass cls,jobject done,void *user_data),void *user_data)
 {
-	jclass exception_class = NULL;
-	jobject exception_instance = NULL;
-	jstring error_jstring = NULL;
-	jstring dprt_library_error_jstring = NULL;
-	jmethodID mid;
-	int retval;
+	struct Scheduler_Job_Struct *job = NULL;
+	struct Scheduler_Worker_Struct *worker = NULL;
+	struct Thread_Data_Struct *thread_data = NULL;
+	unsigned long position;
 
-	exception_class = (*env)->FindClass(env,"ngat/dprt/DpRtLibraryNativeException");
-	if(exception_class == NULL)
+	if((env == NULL)||(cls == NULL)||(done == NULL)||(reduce_fp == NULL))
 	{
-		fprintf(stderr,"DpRt_JNI_Throw_Exception_String:FindClass failed:%s:%d:%s\n",function_name,
-			error_number,error_string);
-		return;
+		DpRt_JNI_Error_Set(107,"DpRt_JNI_Scheduler_Job_Submit:Illegal argument(%p,%p,%p).\n",(void*)env,
+			(void*)cls,(void*)done);
+		return FALSE;
 	}
-/* get ngat.dprt.DpRtLibraryNativeException(int errorNumber,String errorString) constructor */
-	mid = (*env)->GetMethodID(env,exception_class,"<init>","(ILjava/lang/String;ILjava/lang/String;)V");
-	if(mid == 0)
+	job = (struct Scheduler_Job_Struct *)malloc(sizeof(struct Scheduler_Job_Struct));
+	if(job == NULL)
 	{
-		/* One of the following exceptions has been thrown:
-		** NoSuchMethodError, ExceptionInInitializerError, OutOfMemoryError */
-		fprintf(stderr,"DpRt_JNI_Throw_Exception_String:GetMethodID failed:%s:%s\n",function_name,
-			error_string);
-		return;
+		DpRt_JNI_Error_Set(109,"DpRt_JNI_Scheduler_Job_Submit:Memory allocation error.\n");
+		return FALSE;
 	}
-/* convert error_string to JString */
-	error_jstring = (*env)->NewStringUTF(env,error_string);
-	dprt_library_error_jstring = (*env)->NewStringUTF(env,DpRt_JNI_Error_String);
-/* call constructor */
-	exception_instance = (*env)->NewObject(env,exception_class,mid,(jint)DpRt_JNI_Error_Number,
-					       dprt_library_error_jstring,
-					       (jint)error_number,error_jstring);
-	if(exception_instance == NULL)
+	if(!DpRt_JNI_Cancel_Token_Create(&(job->Cancel_Token)))
 	{
-		/* One of the following exceptions has been thrown:
-		** InstantiationException, OutOfMemoryError */
-		fprintf(stderr,"DpRt_JNI_Throw_Exception_String:NewObject failed %s:%d:%s:%d:%s\n",
-			function_name,DpRt_JNI_Error_Number,DpRt_JNI_Error_String,error_number,error_string);
-		return;
+		free(job);
+		return FALSE;
 	}
-/* throw instance */
-	retval = (*env)->Throw(env,(jthrowable)exception_instance);
-	if(retval !=0)
+	job->Reduce_Function = reduce_fp;
+	job->User_Data = user_data;
+	job->Done_Class = (jclass)((*env)->NewGlobalRef(env,cls));
+	job->Done = (*env)->NewGlobalRef(env,done);
+	if(future != NULL)
+		job->Future = (*env)->NewGlobalRef(env,future);
+	else
+		job->Future = NULL;
+	job->Context = DpRt_JNI_Context_Get_Current();
+/* Stop can not free Worker_List until the job is queued */
+	pthread_rwlock_rdlock(&(Scheduler.Submit_Lock));
+	if(__atomic_load_n(&Scheduler.Running,__ATOMIC_ACQUIRE) == FALSE)
 	{
-		fprintf(stderr,"DpRt_JNI_Throw_Exception_String:Throw failed %d:%s:%d:%s:%d:%s\n",retval,
-			function_name,DpRt_JNI_Error_Number,DpRt_JNI_Error_String,error_number,error_string);
+		pthread_rwlock_unlock(&(Scheduler.Submit_Lock));
+		DpRt_JNI_Scheduler_Job_Free(env,job);
+		DpRt_JNI_Error_Set(108,"DpRt_JNI_Scheduler_Job_Submit:Scheduler not running.\n");
+		return FALSE;
 	}
+/* queue on our own deque if we are a worker, otherwise round-robin */
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if((thread_data != NULL)&&(thread_data->Scheduler_Worker != NULL))
+		worker = thread_data->Scheduler_Worker;
+	else
+	{
+		position = __atomic_fetch_add(&Scheduler.Submit_Position,1,__ATOMIC_RELAXED);
+		worker = &(Scheduler.Worker_List[position%Scheduler.Worker_Count]);
+	}
+	if(!DpRt_JNI_Scheduler_Push(worker,job))
+	{
+		DpRt_JNI_Error_Set(134,"DpRt_JNI_Scheduler_Job_Submit:Memory allocation error(%lu).\n",
+			worker->Capacity*2);
+		pthread_rwlock_unlock(&(Scheduler.Submit_Lock));
+		DpRt_JNI_Scheduler_Job_Free(env,job);
+		return FALSE;
+	}
+	__atomic_add_fetch(&Scheduler.Submitted_Count,1,__ATOMIC_RELAXED);
+/* Pending_Count is incremented before Lock is taken, so a worker about to sleep either sees it, 
+** or is already waiting and receives the signal */
+	__atomic_add_fetch(&Scheduler.Pending_Count,1,__ATOMIC_SEQ_CST);
+	pthread_mutex_lock(&(Scheduler.Lock));
+	if(Scheduler.Sleeping_Count > 0)
+		pthread_cond_signal(&(Scheduler.Work_Condition));
+	pthread_mutex_unlock(&(Scheduler.Lock));
+	pthread_rwlock_unlock(&(Scheduler.Submit_Lock));
+	return TRUE;
 }
 
 /**
- * libdprt Log Handler for the Java layer interface. This calls the ngat.dprt.ccs.DpRtLibrary logger's 
- * log(int level,String message) method with the parameters supplied to this routine.
- * If the Logger instance is NULL, or the Log_Method_Id is NULL the call is not made.
- * Otherwise, A java.lang.String instance is constructed from the string parameter,
- * and the JNI CallVoidMEthod routine called to call log().
- * @param sub_system The sub system. Can be NULL.
- * @param source_file The source filename. Can be NULL.
- * @param function The function calling the log. Can be NULL.
- * @param level The log level of the message.(TERSE/high level or VERBOSE/low level), 
- *         a valid member of LOG_VERBOSITY.
- * @param category What sort of information is the message. Designed to be used as a filter. Can be NULL.
- * @param string The message to log.
- * @see #Java_VM
- * @see #Logger
- * @see #Log_Method_Id
+ * Routine to add a completion to the completion queue.
+ * @param future A global reference to the CompletableFuture to complete. The queue takes ownership.
+ * @param done A global reference to the done object to complete it with. The queue takes ownership.
+ * @return The routine returns TRUE if the completion was queued, and FALSE if the queue is not running 
+ *         or memory could not be allocated (the caller retains ownership of the references).
+ * @see #Completion_Queue
  */
-void DpRt_JNI_Log_Handler(char* sub_system,char* source_filename,char* function,int level,char* category,char *string)
+static int DpRt_JNI_Completion_Queue_Put(jobject future,jobject done)
 {
-	JNIEnv *env = NULL;
-	jstring java_string = NULL;
+	struct Completion_Struct *completion = NULL;
 
-	if(Logger == NULL)
-	{
-		fprintf(stderr,"DpRt_JNI_Log_Handler:Logger was NULL (%d,%s).\n",level,string);
-		return;
-	}
-	if(Log_Method_Id == NULL)
+	completion = (struct Completion_Struct *)malloc(sizeof(struct Completion_Struct));
+	if(completion == NULL)
+		return FALSE;
+	completion->Future = future;
+	completion->Done = done;
+	completion->Next = NULL;
+	pthread_mutex_lock(&(Completion_Queue.Lock));
+	if(Completion_Queue.Running == FALSE)
 	{
-		fprintf(stderr,"DpRt_JNI_Log_Handler:Log_Method_Id was NULL (%d,%s).\n",level,string);
-		return;
+		pthread_mutex_unlock(&(Completion_Queue.Lock));
+		free(completion);
+		return FALSE;
 	}
-	if(Java_VM == NULL)
+	if(Completion_Queue.Tail == NULL)
 	{
-		fprintf(stderr,"DpRt_JNI_Log_Handler:Java_VM was NULL (%d,%s).\n",level,string);
-		return;
+		Completion_Queue.Head = completion;
+		pthread_cond_signal(&(Completion_Queue.Not_Empty_Condition));
 	}
-/* get java env for this thread */
-	(*Java_VM)->AttachCurrentThread(Java_VM,(void**)&env,NULL);
+	else
+		Completion_Queue.Tail->Next = completion;
+	Completion_Queue.Tail = completion;
+	pthread_mutex_unlock(&(Completion_Queue.Lock));
+	return TRUE;
+}
+
+/**
+ * The completion thread. The thread attaches to the JVM, and sets Running if it could (otherwise it exits,
+ * and DpRt_JNI_Completion_Queue_Start fails). It then waits for completions to be queued, and removes all the queued
+ * completions at once, completing their futures in order, COMPLETION_QUEUE_BATCH_LENGTH at a time inside 
+ * a JNI local reference frame. Once the queue has been stopped and emptied the thread exits.
+ * @param arg Not used.
+ * @return NULL.
+ * @see #Completion_Queue
+ * @see #DpRt_JNI_Completion_Queue_Put
+ */
+static void *DpRt_JNI_Completion_Queue_Thread(void *arg)
+{
+	struct Completion_Struct *completion = NULL,*next_completion = NULL;
+	JNIEnv *env = NULL;
+	int running,count;
+
+	env = DpRt_JNI_Get_Env("DpRt completion thread");
+	pthread_mutex_lock(&(Completion_Queue.Lock));
+	if(env != NULL)
+		__atomic_store_n(&Completion_Queue.Running,TRUE,__ATOMIC_RELEASE);
+	Completion_Queue.Starting = FALSE;
+	pthread_cond_signal(&(Completion_Queue.Started_Condition));
+	pthread_mutex_unlock(&(Completion_Queue.Lock));
 	if(env == NULL)
+		return NULL;
+	do
 	{
-		fprintf(stderr,"DpRt_JNI_Log_Handler:env was NULL (%d,%s).\n",level,string);
-		return;
+		pthread_mutex_lock(&(Completion_Queue.Lock));
+		while((Completion_Queue.Head == NULL)&&Completion_Queue.Running)
+			pthread_cond_wait(&(Completion_Queue.Not_Empty_Condition),&(Completion_Queue.Lock));
+		completion = Completion_Queue.Head;
+		Completion_Queue.Head = NULL;
+		Completion_Queue.Tail = NULL;
+		running = Completion_Queue.Running;
+		pthread_mutex_unlock(&(Completion_Queue.Lock));
+		if(completion != NULL)
+			__atomic_add_fetch(&Completion_Queue.Batch_Count,1,__ATOMIC_RELAXED);
+		count = 0;
+		while(completion != NULL)
+		{
+			next_completion = completion->Next;
+			if((count%COMPLETION_QUEUE_BATCH_LENGTH) == 0)
+			{
+				if(count > 0)
+					(*env)->PopLocalFrame(env,NULL);
+				(*env)->PushLocalFrame(env,COMPLETION_QUEUE_BATCH_LENGTH);
+			}
+			(*env)->CallBooleanMethod(env,completion->Future,Completion_Queue.Complete_Method_Id,
+						  completion->Done);
+			if((*env)->ExceptionCheck(env))
+				(*env)->ExceptionClear(env);
+			(*env)->DeleteGlobalRef(env,completion->Future);
+			(*env)->DeleteGlobalRef(env,completion->Done);
+			free(completion);
+			completion = next_completion;
+			count++;
+		}
+		if(count > 0)
+			(*env)->PopLocalFrame(env,NULL);
+		__atomic_add_fetch(&Completion_Queue.Completion_Count,count,__ATOMIC_RELAXED);
 	}
-	if(string == NULL)
-	{
-		fprintf(stderr,"DpRt_JNI_Log_Handler:string (%d) was NULL.\n",level);
+	while(running);
+	/* the thread is detached from the JVM by DpRt_JNI_Thread_Data_Destroy as it exits */
+	return NULL;
+}
+
+/**
+ * Routine to get the start time of a latency measurement.
+ * @return The current CLOCK_MONOTONIC time in nanoseconds, or 0 if latency recording is off.
+ * @see #Latency_Enabled
+ * @see #DpRt_JNI_Latency_Record
+ */
+static unsigned long long DpRt_JNI_Latency_Start(void)
+{
+	struct timespec current_time;
+
+	if(__atomic_load_n(&Latency_Enabled,__ATOMIC_RELAXED) == FALSE)
+		return 0;
+	clock_gettime(CLOCK_MONOTONIC,&current_time);
+	return (((unsigned long long)current_time.tv_sec)*1000000000ULL)+current_time.tv_nsec;
+}
+
+/**
+ * Routine to record the latency of a boundary function call in the calling thread's histogram for the probe. 
+ * The thread's histograms are allocated, and added to Latency_Histogram_List, the first time it records a 
+ * latency. After that no locks are taken.
+ * @param probe Which boundary function was called, one of the DPRT_JNI_LATENCY_PROBE_ defines.
+ * @param start_time The start time returned by DpRt_JNI_Latency_Start. If 0, nothing is recorded.
+ * @see #Latency_Thread_Histogram_Struct
+ * @see #DpRt_JNI_Latency_Bucket_Index
+ */
+static void DpRt_JNI_Latency_Record(int probe,unsigned long long start_time)
+{
+	struct Thread_Data_Struct *thread_data = NULL;
+	struct DpRt_JNI_Latency_Histogram_Struct *histogram = NULL;
+	struct timespec current_time;
+	unsigned long long latency;
+	int bucket_index;
+
+	if(start_time == 0)
 		return;
+	clock_gettime(CLOCK_MONOTONIC,&current_time);
+	latency = (((unsigned long long)current_time.tv_sec)*1000000000ULL)+current_time.tv_nsec-start_time;
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if(thread_data == NULL)
+		return;
+	if(thread_data->Latency_Histogram == NULL)
+	{
+		thread_data->Latency_Histogram = (struct Latency_Thread_Histogram_Struct *)calloc(1,
+							    sizeof(struct Latency_Thread_Histogram_Struct));
+		if(thread_data->Latency_Histogram == NULL)
+			return;
+		pthread_mutex_lock(&Latency_Histogram_Lock);
+		thread_data->Latency_Histogram->Previous = NULL;
+		thread_data->Latency_Histogram->Next = Latency_Histogram_List;
+		if(Latency_Histogram_List != NULL)
+			Latency_Histogram_List->Previous = thread_data->Latency_Histogram;
+		Latency_Histogram_List = thread_data->Latency_Histogram;
+		pthread_mutex_unlock(&Latency_Histogram_Lock);
 	}
-/* convert C to Java String */
-	java_string = (*env)->NewStringUTF(env,string);
-/* call log method on logger instance */
-	(*env)->CallVoidMethod(env,Logger,Log_Method_Id,(jint)level,java_string);
+	histogram = &(thread_data->Latency_Histogram->Probe_List[probe]);
+	bucket_index = DpRt_JNI_Latency_Bucket_Index(latency);
+/* only this thread writes it's histogram, so plain reads are safe, the stores are atomic for the merger */
+	if((histogram->Count == 0)||(latency < histogram->Minimum))
+		__atomic_store_n(&(histogram->Minimum),latency,__ATOMIC_RELAXED);
+	if(latency > histogram->Maximum)
+		__atomic_store_n(&(histogram->Maximum),latency,__ATOMIC_RELAXED);
+	__atomic_store_n(&(histogram->Total),histogram->Total+latency,__ATOMIC_RELAXED);
+	__atomic_store_n(&(histogram->Bucket_List[bucket_index]),histogram->Bucket_List[bucket_index]+1,
+			 __ATOMIC_RELAXED);
+	__atomic_store_n(&(histogram->Count),histogram->Count+1,__ATOMIC_RELEASE);
 }
 
 /**
- * A routine to return the current value of the error number. The error number is usually 0 for success,
- * and non-zero when an error occurs.
- * @return The current value of the error number.
- * @see #DpRt_JNI_Error_Number
+ * Routine to find which histogram bucket a latency is counted in. The bucket is found from the position of
+ * the latency's most significant bit (the power of two) and the DPRT_JNI_LATENCY_SUB_BUCKET_BITS bits 
+ * below it, so no search is needed.
+ * @param value The latency, in nanoseconds.
+ * @return The index of the bucket, 0..DPRT_JNI_LATENCY_BUCKET_COUNT-1.
+ * @see #DpRt_JNI_Latency_Bucket_Value
  */
-int DpRt_JNI_Get_Error_Number(void)
+static int DpRt_JNI_Latency_Bucket_Index(unsigned long long value)
 {
-	return DpRt_JNI_Error_Number;
+	int most_significant_bit,bucket_index;
+
+	if(value < (1ULL<<DPRT_JNI_LATENCY_SUB_BUCKET_BITS))
+		return (int)value;
+	most_significant_bit = 63-__builtin_clzll(value);
+	bucket_index = ((most_significant_bit-DPRT_JNI_LATENCY_SUB_BUCKET_BITS+1)<<DPRT_JNI_LATENCY_SUB_BUCKET_BITS)+
+		(int)((value>>(most_significant_bit-DPRT_JNI_LATENCY_SUB_BUCKET_BITS))&
+		      ((1ULL<<DPRT_JNI_LATENCY_SUB_BUCKET_BITS)-1));
+	if(bucket_index >= DPRT_JNI_LATENCY_BUCKET_COUNT)
+		bucket_index = DPRT_JNI_LATENCY_BUCKET_COUNT-1;
+	return bucket_index;
 }
 
 /**
- * A routine to get the current value of the error string. The current value is strcpyed into the 
- * supplied paramater. The error string is usually blank when no errors have occured, and non-blank when
- * an error has occured.
- * @param error_string A pointer to an area of memory reserved to accept the error string. This area of 
- * memory should be at least <a href="#DPRT_ERROR_STRING_LENGTH">DPRT_ERROR_STRING_LENGTH</a> in length.
- * @see #DpRt_JNI_Error_String
+ * Routine to find which latency probe a property getter is recorded against, from which backend it belongs to.
+ * @param get_property_fp The property getter function pointer called.
+ * @return DPRT_JNI_LATENCY_PROBE_GET_PROPERTY_DPRTSTATUS for the Java DpRtStatus getters,
+ *         DPRT_JNI_LATENCY_PROBE_GET_PROPERTY_C_FILE for the C property file getters, and
+ *         DPRT_JNI_LATENCY_PROBE_GET_PROPERTY_OTHER for any other getter.
  */
-void DpRt_JNI_Get_Error_String(char *error_string)
+static int DpRt_JNI_Latency_Property_Probe(void (*get_property_fp)(void))
 {
-	strcpy(error_string,DpRt_JNI_Error_String);
+	if((get_property_fp == (void (*)(void))DpRt_JNI_DpRtStatus_Get_Property)||
+	   (get_property_fp == (void (*)(void))DpRt_JNI_DpRtStatus_Get_Property_Integer)||
+	   (get_property_fp == (void (*)(void))DpRt_JNI_DpRtStatus_Get_Property_Double)||
+	   (get_property_fp == (void (*)(void))DpRt_JNI_DpRtStatus_Get_Property_Boolean)||
+	   (get_property_fp == (void (*)(void))DpRt_JNI_DpRtStatus_Get_Property_List))
+		return DPRT_JNI_LATENCY_PROBE_GET_PROPERTY_DPRTSTATUS;
+	if((get_property_fp == (void (*)(void))DpRt_JNI_Get_Property_From_C_File)||
+	   (get_property_fp == (void (*)(void))DpRt_JNI_Get_Property_Integer_From_C_File)||
+	   (get_property_fp == (void (*)(void))DpRt_JNI_Get_Property_Double_From_C_File)||
+	   (get_property_fp == (void (*)(void))DpRt_JNI_Get_Property_Boolean_From_C_File)||
+	   (get_property_fp == (void (*)(void))DpRt_JNI_Get_Property_List_From_C_File))
+		return DPRT_JNI_LATENCY_PROBE_GET_PROPERTY_C_FILE;
+	return DPRT_JNI_LATENCY_PROBE_GET_PROPERTY_OTHER;
 }
 
-/* ------------------------------------------------------- */
-/* internal functions */
-/* ------------------------------------------------------- */
 /**
- * Routine to get the value of the keyword from the property file.
- * This routine assumes keyword and value_string have been checked as being non-null.
- * @param keyword The keyword in the property file to look up.
- * @param value_string The address of a pointer to allocate and store the resulting value string in.
- * 	This pointer is dynamically allocated and must be freed using <b>free()</b>. 
- * @see #PROPERTY_FILE_NAME
+ * Routine to add one histogram into another. The source histogram may be being recorded into by it's owning
+ * thread, so it is read atomically.
+ * @param total The histogram to add to.
+ * @param histogram The histogram to add.
+ * @see #DpRt_JNI_Latency_Histogram_Get
  */
-static int DpRt_JNI_Get_Property_From_C_File(char *keyword,char **value_string)
+static void DpRt_JNI_Latency_Histogram_Add(struct DpRt_JNI_Latency_Histogram_Struct *total,
+					   struct DpRt_JNI_Latency_Histogram_Struct *histogram)
 {
-	char buff[256];
-	FILE *fp = NULL;
-	char *ch = NULL;
-	int done;
+	unsigned long long count,minimum,maximum;
+	int i;
+
+	count = __atomic_load_n(&(histogram->Count),__ATOMIC_ACQUIRE);
+	if(count == 0)
+		return;
+	minimum = __atomic_load_n(&(histogram->Minimum),__ATOMIC_RELAXED);
+	maximum = __atomic_load_n(&(histogram->Maximum),__ATOMIC_RELAXED);
+	if((total->Count == 0)||(minimum < total->Minimum))
+		total->Minimum = minimum;
+	if(maximum > total->Maximum)
+		total->Maximum = maximum;
+	total->Count += count;
+	total->Total += __atomic_load_n(&(histogram->Total),__ATOMIC_RELAXED);
+	for(i = 0; i < DPRT_JNI_LATENCY_BUCKET_COUNT; i++)
+		total->Bucket_List[i] += __atomic_load_n(&(histogram->Bucket_List[i]),__ATOMIC_RELAXED);
+}
+
+/**
+ * Routine to set or clear a context's abort flag. Setting it also cancels all the cancellation tokens 
+ * created in the context.
+ * @param context The context.
+ * @param value TRUE to abort, FALSE to reset the flag.
+ * @see #DpRt_JNI_Set_Abort
+ * @see #DpRt_JNI_Cancel_Token_Cancel
+ */
+static void DpRt_JNI_Context_Abort(struct DpRt_JNI_Context_Struct *context,int value)
+{
+	struct DpRt_JNI_Cancel_Token_Struct *token = NULL;
 
-	fp = fopen(PROPERTY_FILE_NAME,"r");
-	if(fp == NULL)
+	__atomic_store_n(&(context->DpRt_Data.DpRt_Abort),value,__ATOMIC_RELEASE);
+	if(value)
 	{
-		DpRt_JNI_Error_Number = 38;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_From_C_File failed: File open (%s) failed.\n",
-			PROPERTY_FILE_NAME);
-		return FALSE;
+		pthread_mutex_lock(&(context->Cancel_Token_Lock));
+		for(token = context->Cancel_Token_List; token != NULL; token = token->Next)
+			DpRt_JNI_Cancel_Token_Cancel(token);
+		pthread_mutex_unlock(&(context->Cancel_Token_Lock));
 	}
-	done = FALSE;
-	(*value_string) = NULL;
-	while((done == FALSE)&&(fgets(buff,255,fp) != NULL))
+}
+
+/**
+ * Routine to initialise Deadline_Watchdog, called once using Deadline_Watchdog_Once. 
+ * The condition variable uses CLOCK_MONOTONIC, so deadlines are not affected by changes to the system time.
+ * @see #Deadline_Watchdog
+ */
+static void DpRt_JNI_Deadline_Watchdog_Initialise(void)
+{
+	pthread_condattr_t condition_attributes;
+
+	pthread_mutex_init(&(Deadline_Watchdog.Lock),NULL);
+	pthread_condattr_init(&condition_attributes);
+	pthread_condattr_setclock(&condition_attributes,CLOCK_MONOTONIC);
+	pthread_cond_init(&(Deadline_Watchdog.Condition),&condition_attributes);
+	pthread_condattr_destroy(&condition_attributes);
+	Deadline_Watchdog.Running = FALSE;
+	Deadline_Watchdog.Deadline_List = NULL;
+	Deadline_Watchdog.Overrun_Count = 0;
+}
+
+/**
+ * The deadline watchdog thread. This sleeps until the earliest active deadline's budget elapses (or a deadline
+ * is added), then removes each expired deadline from the list, and calls DpRt_JNI_Deadline_Overrun 
+ * (without holding the lock) to abort the reduction and report it. The thread attaches itself to the JVM 
+ * as a daemon thread (using DpRt_JNI_Get_Env) the first time it reports an overrun.
+ * @param arg Unused.
+ * @return NULL.
+ * @see #Deadline_Watchdog
+ * @see #DpRt_JNI_Deadline_Overrun
+ */
+static void *DpRt_JNI_Deadline_Watchdog_Thread(void *arg)
+{
+	struct DpRt_JNI_Deadline_Struct **deadline_pointer = NULL;
+	struct DpRt_JNI_Deadline_Struct *deadline = NULL;
+	struct DpRt_JNI_Deadline_Struct *expired_deadline = NULL;
+	struct timespec current_time,wait_time;
+	JNIEnv *env = NULL;
+	int wait_forever;
+
+	pthread_mutex_lock(&(Deadline_Watchdog.Lock));
+	while(Deadline_Watchdog.Running)
 	{
-		if(strncmp(keyword,buff,strlen(keyword))==0)
+		clock_gettime(CLOCK_MONOTONIC,&current_time);
+		expired_deadline = NULL;
+		wait_forever = TRUE;
+		deadline_pointer = &(Deadline_Watchdog.Deadline_List);
+		while((*deadline_pointer) != NULL)
 		{
-			ch = strchr(buff,'=');
-			if(ch != NULL)
+			deadline = (*deadline_pointer);
+			if((deadline->Expiry_Time.tv_sec < current_time.tv_sec)||
+			   ((deadline->Expiry_Time.tv_sec == current_time.tv_sec)&&
+			    (deadline->Expiry_Time.tv_nsec <= current_time.tv_nsec)))
 			{
-				(*value_string) = (char*)malloc((strlen(ch)+1)*sizeof(char));
-				if((*value_string) == NULL)
-				{
-					fclose(fp);
-					DpRt_JNI_Error_Number = 39;
-					sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_From_C_File failed: "
-						"Memory Allocation error(%s,%s,%s,%d) failed.\n",
-						PROPERTY_FILE_NAME,keyword,ch,(strlen(ch)+1));
-					return FALSE;
-				}
-				strcpy((*value_string),ch+1);
-			/* if the string terminates in a new-line, remove it */
-				if((strlen((*value_string))>0) && ((*value_string)[strlen((*value_string))-1] == '\n'))
-					(*value_string)[strlen((*value_string))-1] = '\0';
-				done = TRUE;
+				(*deadline_pointer) = deadline->Next;
+				deadline->State = DEADLINE_STATE_EXPIRED;
+				expired_deadline = deadline;
+				break;
 			}
+			if(wait_forever||(deadline->Expiry_Time.tv_sec < wait_time.tv_sec)||
+			   ((deadline->Expiry_Time.tv_sec == wait_time.tv_sec)&&
+			    (deadline->Expiry_Time.tv_nsec < wait_time.tv_nsec)))
+				wait_time = deadline->Expiry_Time;
+			wait_forever = FALSE;
+			deadline_pointer = &(deadline->Next);
 		}
+		if(expired_deadline != NULL)
+		{
+			pthread_mutex_unlock(&(Deadline_Watchdog.Lock));
+			if((env == NULL)&&(expired_deadline->Done != NULL))
+				env = DpRt_JNI_Get_Env("DpRt deadline watchdog");
+			DpRt_JNI_Deadline_Overrun(env,expired_deadline,&current_time);
+			__atomic_add_fetch(&(Deadline_Watchdog.Overrun_Count),1,__ATOMIC_RELAXED);
+			pthread_mutex_lock(&(Deadline_Watchdog.Lock));
+			expired_deadline->State = DEADLINE_STATE_REPORTED;
+			pthread_cond_broadcast(&(Deadline_Watchdog.Condition));
+		}
+		else if(wait_forever)
+			pthread_cond_wait(&(Deadline_Watchdog.Condition),&(Deadline_Watchdog.Lock));
+		else
+			pthread_cond_timedwait(&(Deadline_Watchdog.Condition),&(Deadline_Watchdog.Lock),&wait_time);
 	}
-	fclose(fp);
-	if(done == FALSE)
-	{
-		DpRt_JNI_Error_Number = 40;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_From_C_File failed:Failed to find keyword (%s,%s).\n",
-			PROPERTY_FILE_NAME,keyword);
-	}
-	return done;
+	pthread_mutex_unlock(&(Deadline_Watchdog.Lock));
+	return NULL;
 }
 
 /**
- * Routine to get the integer value of the keyword from the property file.
- * This routine assumes keyword and value have been checked as being non-null.
- * DpRt_Get_Property_From_C_File is used to get the keyword's value, and sscanf used to convert it to
- * an integer.
- * @param keyword The keyword in the property file to look up.
- * @param value_string The address of an integer to store the resulting value string in.
- * @see #DpRt_JNI_Get_Property_From_C_File
+ * Routine called by the deadline watchdog thread when a deadline's budget has elapsed. The reduction is
+ * aborted, by cancelling the deadline's cancellation token.
+ * If the deadline has a done object, the overrun is then reported to it with DpRt_JNI_Set_Command_Done,
+ * with error number DPRT_JNI_DEADLINE_OVERRUN_ERROR_NUMBER and an error string naming the stage that overran.
+ * @param env The watchdog thread's JNI environment pointer, or NULL if it could not attach to the JVM.
+ * @param deadline The expired deadline.
+ * @param current_time The time (CLOCK_MONOTONIC) the deadline was found to have expired.
+ * @see #DpRt_JNI_Deadline_Watchdog_Thread
+ * @see #DpRt_JNI_Set_Command_Done
  */
-static int DpRt_JNI_Get_Property_Integer_From_C_File(char *keyword,int *value)
+static void DpRt_JNI_Deadline_Overrun(JNIEnv *env,struct DpRt_JNI_Deadline_Struct *deadline,
+				      struct timespec *current_time)
 {
-	char *value_string = NULL;
-	int retval;
+	char error_string[DPRT_ERROR_STRING_LENGTH];
+	char stage[DEADLINE_STAGE_LENGTH];
+	double elapsed_time;
 
-	if(!DpRt_JNI_Get_Property_From_C_File(keyword,&value_string))
-		return FALSE;
-	retval = sscanf(value_string,"%i",value);
-	if(retval != 1)
+	DpRt_JNI_Cancel_Token_Cancel(deadline->Cancel_Token);
+	if((env == NULL)||(deadline->Done == NULL))
+		return;
+	pthread_mutex_lock(&(Deadline_Watchdog.Lock));
+	strcpy(stage,deadline->Stage);
+	pthread_mutex_unlock(&(Deadline_Watchdog.Lock));
+	elapsed_time = (double)(current_time->tv_sec-deadline->Start_Time.tv_sec)+
+		((double)(current_time->tv_nsec-deadline->Start_Time.tv_nsec)/1000000000.0);
+	snprintf(error_string,DPRT_ERROR_STRING_LENGTH,"Deadline overrun:Stage %s overran it's %.3f second budget "
+		 "(%.3f seconds elapsed).",stage,deadline->Budget,elapsed_time);
+	if((*env)->PushLocalFrame(env,4) != 0)
 	{
-		DpRt_JNI_Error_Number = 41;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Integer_From_C_File failed:"
-			"Failed to convert (%s,%s,%s).\n",PROPERTY_FILE_NAME,keyword,value_string);
-		if(value_string != NULL)
-			free(value_string);
-		return FALSE;
+		(*env)->ExceptionClear(env);
+		return;
 	}
-	if(value_string != NULL)
-		free(value_string);
-	return TRUE;
+	DpRt_JNI_Set_Command_Done(env,deadline->Done_Class,deadline->Done,FALSE,
+				  DPRT_JNI_DEADLINE_OVERRUN_ERROR_NUMBER,error_string);
+	if((*env)->ExceptionCheck(env))
+		(*env)->ExceptionClear(env);
+	(*env)->PopLocalFrame(env,NULL);
 }
 
 /**
- * Routine to get the double value of the keyword from the property file.
- * This routine assumes keyword and value have been checked as being non-null.
- * DpRt_Get_Property_From_C_File is used to get the keyword's value, and sscanf used to convert it to
- * a double.
- * @param keyword The keyword in the property file to look up.
- * @param value_string The address of an double to store the resulting value string in.
- * @see #DpRt_JNI_Get_Property_From_C_File
+ * Routine to signal a cancellation token's eventfd, by adding one to it's counter. The eventfd is
+ * non-blocking and only ever written once per cancellation, so the write cannot fail in practice,
+ * and there is nothing more to be done if it does.
+ * @param fd The eventfd.
+ * @see #DpRt_JNI_Cancel_Token_Cancel
+ * @see #DpRt_JNI_Cancel_Token_Get_Event_Fd
  */
-static int DpRt_JNI_Get_Property_Double_From_C_File(char *keyword,double *value)
+static void DpRt_JNI_Cancel_Token_Event_Fd_Signal(int fd)
 {
-	char *value_string = NULL;
-	int retval;
+	uint64_t event_count = 1;
+	ssize_t write_count;
 
-	if(!DpRt_JNI_Get_Property_From_C_File(keyword,&value_string))
-		return FALSE;
-	retval = sscanf(value_string,"%lf",value);
-	if(retval != 1)
+	write_count = write(fd,&event_count,sizeof(event_count));
+	(void)write_count;
+}
+
+/**
+ * Routine to get the calling thread's error state.
+ * @return The thread's error state, or Fallback_Error if the thread's data could not be allocated.
+ * @see #Thread_Data_Struct
+ * @see #Fallback_Error
+ */
+static struct Error_Struct *DpRt_JNI_Error_Get(void)
+{
+	struct Thread_Data_Struct *thread_data = NULL;
+
+	thread_data = DpRt_JNI_Thread_Data_Get();
+	if(thread_data == NULL)
+		return &Fallback_Error;
+	return &(thread_data->Error);
+}
+
+/**
+ * Routine to format a stored error message into it's String. Each conversion specification in the format is
+ * formatted separately with snprintf, with the stored argument cast back to the type the 
+ * specification expects.
+ * @param error The error state, whose Format is not NULL.
+ * @see #DpRt_JNI_Error_Set
+ * @see #DpRt_JNI_Error_Format_Spec
+ */
+static void DpRt_JNI_Error_Format(struct Error_Struct *error)
+{
+	union Error_Argument_Union *argument = NULL;
+	char spec[ERROR_FORMAT_SPEC_LENGTH];
+	char *format = NULL;
+	char conversion,length_modifier;
+	size_t length,remaining;
+	int spec_length,argument_index,retval;
+
+	format = error->Format;
+	length = 0;
+	argument_index = 0;
+	while(((*format) != '\0')&&(length < (DPRT_ERROR_STRING_LENGTH-1)))
 	{
-		DpRt_JNI_Error_Number = 42;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Double_From_C_File failed:"
-			"Failed to convert (%s,%s,%s).\n",PROPERTY_FILE_NAME,keyword,value_string);
-		if(value_string != NULL)
-			free(value_string);
-		return FALSE;
+		if((*format) != '%')
+		{
+			error->String[length++] = (*format++);
+			continue;
+		}
+		spec_length = DpRt_JNI_Error_Format_Spec(format,&conversion,&length_modifier);
+		strncpy(spec,format,spec_length);
+		spec[spec_length] = '\0';
+		format += spec_length;
+		remaining = DPRT_ERROR_STRING_LENGTH-length;
+		if(conversion == '%')
+		{
+			error->String[length++] = '%';
+			continue;
+		}
+		argument = &(error->Argument_List[argument_index++]);
+		switch(conversion)
+		{
+			case 'd': case 'i': case 'c':
+				if(length_modifier == 'l')
+					retval = snprintf(error->String+length,remaining,spec,(long)argument->Integer_Value);
+				else if(length_modifier == 'q')
+					retval = snprintf(error->String+length,remaining,spec,argument->Integer_Value);
+				else if(length_modifier == 'z')
+					retval = snprintf(error->String+length,remaining,spec,(size_t)argument->Integer_Value);
+				else
+					retval = snprintf(error->String+length,remaining,spec,(int)argument->Integer_Value);
+				break;
+			case 'u': case 'x': case 'X': case 'o':
+				if(length_modifier == 'l')
+					retval = snprintf(error->String+length,remaining,spec,
+							  (unsigned long)argument->Unsigned_Value);
+				else if(length_modifier == 'q')
+					retval = snprintf(error->String+length,remaining,spec,argument->Unsigned_Value);
+				else if(length_modifier == 'z')
+					retval = snprintf(error->String+length,remaining,spec,(size_t)argument->Unsigned_Value);
+				else
+					retval = snprintf(error->String+length,remaining,spec,
+							  (unsigned int)argument->Unsigned_Value);
+				break;
+			case 'p':
+				retval = snprintf(error->String+length,remaining,spec,argument->Pointer_Value);
+				break;
+			case 's':
+				retval = snprintf(error->String+length,remaining,spec,
+						  error->String_Argument_Buffer+argument->String_Offset);
+				break;
+			default:
+				retval = snprintf(error->String+length,remaining,spec,argument->Double_Value);
+				break;
+		}
+		if(retval > 0)
+			length += (((size_t)retval) < remaining) ? ((size_t)retval) : (remaining-1);
 	}
-	if(value_string != NULL)
-		free(value_string);
-	return TRUE;
+	error->String[length] = '\0';
+	error->Format = NULL;
 }
 
 /**
- * Routine to get the boolean value of the keyword from the property file.
- * This routine assumes keyword and value have been checked as being non-null.
- * DpRt_Get_Property_From_C_File is used to get the keyword's value, and the string checked to see if it
- * contains <b>true</b> or <b>false</b>.
- * @param keyword The keyword in the property file to look up.
- * @param value_string The address of an integer to store the resulting value, either TRUE (1) or FALSE (0).
- * @see #DpRt_JNI_Get_Property_From_C_File
+ * Routine to parse one printf conversion specification (%[flags][width][.precision][length]conversion).
+ * @param format The format, pointing at the '%'.
+ * @param conversion The address of a character to store the conversion character in, or '\0' if the 
+ *        specification cannot be stored (it uses '*', is too long or is not terminated).
+ * @param length_modifier The address of a character to store the length modifier in: 'l' for long,
+ *        'q' for long long, 'z' for size_t, or '\0' for none (or 'h'/'hh', promoted to int anyway).
+ * @return The length of the specification, including the '%'.
+ * @see #ERROR_FORMAT_SPEC_LENGTH
  */
-static int DpRt_JNI_Get_Property_Boolean_From_C_File(char *keyword,int *value)
+static int DpRt_JNI_Error_Format_Spec(char *format,char *conversion,char *length_modifier)
 {
-	char *value_string = NULL;
+	int i;
 
-	if(!DpRt_JNI_Get_Property_From_C_File(keyword,&value_string))
-		return FALSE;
-	if((strcmp(value_string,"true")==0)||(strcmp(value_string,"TRUE")==0)||(strcmp(value_string,"True")==0))
-		(*value) = TRUE;
-	else if((strcmp(value_string,"false")==0)||(strcmp(value_string,"FALSE")==0)||
-		(strcmp(value_string,"False")==0))
-		(*value) = FALSE;
-	else
+	(*conversion) = '\0';
+	(*length_modifier) = '\0';
+	i = 1;
+	while((format[i] != '\0')&&(strchr("-+ #0123456789.",format[i]) != NULL))
+		i++;
+	while((format[i] != '\0')&&(strchr("hlzjt",format[i]) != NULL))
 	{
-		DpRt_JNI_Error_Number = 43;
-		sprintf(DpRt_JNI_Error_String,"DpRt_Get_Property_Boolean_From_C_File failed:"
-			"Failed to convert (%s,%s,%s).\n",PROPERTY_FILE_NAME,keyword,value_string);
-		if(value_string != NULL)
-			free(value_string);
-		return FALSE;
+		if(format[i] == 'l')
+			(*length_modifier) = ((*length_modifier) == 'l') ? 'q' : 'l';
+		else if(format[i] != 'h')
+			(*length_modifier) = 'z';
+		i++;
 	}
-	if(value_string != NULL)
-		free(value_string);
-	return TRUE;
+	if(format[i] == '\0')
+		return i;
+	if(i < (ERROR_FORMAT_SPEC_LENGTH-1))
+		(*conversion) = format[i];
+	return i+1;
 }
 
 /*
@@ -24,6 +24,7 @@
 #define DPRT_JNI_GENERAL_H
 
 /* needed for function prototypes */
+#include <stddef.h>
 #include <jni.h>
 
 /**
@@ -45,13 +46,351 @@
  */
 #define DPRT_ERROR_STRING_LENGTH	256
 
+/**
+ * Property value type: a string value.
+ * @see #DpRt_JNI_Property_Request_Struct
+ */
+#define DPRT_JNI_PROPERTY_TYPE_STRING	(0)
+/**
+ * Property value type: an integer value.
+ * @see #DpRt_JNI_Property_Request_Struct
+ */
+#define DPRT_JNI_PROPERTY_TYPE_INTEGER	(1)
+/**
+ * Property value type: a double value.
+ * @see #DpRt_JNI_Property_Request_Struct
+ */
+#define DPRT_JNI_PROPERTY_TYPE_DOUBLE	(2)
+/**
+ * Property value type: a boolean value.
+ * @see #DpRt_JNI_Property_Request_Struct
+ */
+#define DPRT_JNI_PROPERTY_TYPE_BOOLEAN	(3)
+/**
+ * The number of property value types.
+ */
+#define DPRT_JNI_PROPERTY_TYPE_COUNT	(4)
+
+/**
+ * Index of the mean counts in a reduce result list. 
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_MEAN_COUNTS	(0)
+/**
+ * Index of the peak counts in a reduce result list. 
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_PEAK_COUNTS	(1)
+/**
+ * Index of the seeing in a reduce result list. 
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_SEEING		(2)
+/**
+ * Index of the counts of the brightest object in a reduce result list. 
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_COUNTS		(3)
+/**
+ * Index of the X position (pixels) of the brightest object in a reduce result list. 
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_X_PIX		(4)
+/**
+ * Index of the Y position (pixels) of the brightest object in a reduce result list. 
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_Y_PIX		(5)
+/**
+ * Index of the photometricity in a reduce result list. 
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_PHOTOMETRICITY	(6)
+/**
+ * Index of the sky brightness in a reduce result list. 
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_SKY_BRIGHTNESS	(7)
+/**
+ * Index of the saturated flag (0.0 or 1.0) in a reduce result list. 
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_SATURATED	(8)
+/**
+ * The number of results in a reduce result list. New results should be added at the end.
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_COUNT		(9)
+/**
+ * Macro to get the bit for a reduce result index (one of the DPRT_JNI_REDUCE_RESULT_ defines), in a
+ * reduce result set mask.
+ * @see #DpRt_JNI_Set_Reduce_Results
+ */
+#define DPRT_JNI_REDUCE_RESULT_BIT(index)	(1U<<(index))
+
+/**
+ * Index of the X pixel position column in a source catalogue buffer.
+ * @see #DpRt_JNI_Set_Source_Catalogue
+ */
+#define DPRT_JNI_SOURCE_CATALOGUE_COLUMN_X_PIX		(0)
+/**
+ * Index of the Y pixel position column in a source catalogue buffer.
+ * @see #DpRt_JNI_Set_Source_Catalogue
+ */
+#define DPRT_JNI_SOURCE_CATALOGUE_COLUMN_Y_PIX		(1)
+/**
+ * Index of the flux column in a source catalogue buffer.
+ * @see #DpRt_JNI_Set_Source_Catalogue
+ */
+#define DPRT_JNI_SOURCE_CATALOGUE_COLUMN_FLUX		(2)
+/**
+ * Index of the FWHM column in a source catalogue buffer.
+ * @see #DpRt_JNI_Set_Source_Catalogue
+ */
+#define DPRT_JNI_SOURCE_CATALOGUE_COLUMN_FWHM		(3)
+/**
+ * Index of the ellipticity column in a source catalogue buffer.
+ * @see #DpRt_JNI_Set_Source_Catalogue
+ */
+#define DPRT_JNI_SOURCE_CATALOGUE_COLUMN_ELLIPTICITY	(4)
+/**
+ * The number of double columns in a source catalogue buffer. The int flags column follows them.
+ * @see #DpRt_JNI_Set_Source_Catalogue
+ */
+#define DPRT_JNI_SOURCE_CATALOGUE_DOUBLE_COLUMN_COUNT	(5)
+
+/**
+ * Asynchronous log queue overflow policy: when the queue is full, discard the oldest queued record.
+ * @see #DpRt_JNI_Log_Queue_Start
+ */
+#define DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_OLDEST	(0)
+/**
+ * Asynchronous log queue overflow policy: when the queue is full, discard the new record.
+ * @see #DpRt_JNI_Log_Queue_Start
+ */
+#define DPRT_JNI_LOG_QUEUE_OVERFLOW_DROP_NEWEST	(1)
+/**
+ * Asynchronous log queue overflow policy: when the queue is full, wait until there is room.
+ * @see #DpRt_JNI_Log_Queue_Start
+ */
+#define DPRT_JNI_LOG_QUEUE_OVERFLOW_BLOCK	(2)
+
+/**
+ * The error number the deadline watchdog reports to a COMMAND_DONE object when a reduction overruns it's budget.
+ * @see #DpRt_JNI_Deadline_Start
+ */
+#define DPRT_JNI_DEADLINE_OVERRUN_ERROR_NUMBER	(97)
+
+/**
+ * Latency probe: property getters of the Java DpRtStatus backend.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_GET_PROPERTY_DPRTSTATUS	(0)
+/**
+ * Latency probe: property getters of the C property file backend.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_GET_PROPERTY_C_FILE	(1)
+/**
+ * Latency probe: property getters of any other backend.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_GET_PROPERTY_OTHER	(2)
+/**
+ * Latency probe: DpRt_JNI_Log_Handler.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_LOG_HANDLER		(3)
+/**
+ * Latency probe: DpRt_JNI_Set_Command_Done.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_SET_COMMAND_DONE		(4)
+/**
+ * Latency probe: DpRt_JNI_Set_Reduce_Done.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_SET_REDUCE_DONE		(5)
+/**
+ * Latency probe: DpRt_JNI_Set_Calibrate_Reduce_Done.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_SET_CALIBRATE_REDUCE_DONE	(6)
+/**
+ * Latency probe: DpRt_JNI_Set_Expose_Reduce_Done.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_SET_EXPOSE_REDUCE_DONE	(7)
+/**
+ * Latency probe: DpRt_JNI_Throw_Exception_String.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_THROW_EXCEPTION_STRING	(8)
+/**
+ * The number of latency probes. New probes should be added at the end.
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+#define DPRT_JNI_LATENCY_PROBE_COUNT			(9)
+/**
+ * The number of bits of each latency (below it's most significant bit) used to pick it's histogram bucket. 
+ * Each power of two is split into 2^DPRT_JNI_LATENCY_SUB_BUCKET_BITS buckets, so latencies are counted to 
+ * within about 6%.
+ * @see #DpRt_JNI_Latency_Bucket_Value
+ */
+#define DPRT_JNI_LATENCY_SUB_BUCKET_BITS		(4)
+/**
+ * The number of buckets in a latency histogram, covering latencies up to 2^36 nanoseconds (about 68 seconds).
+ * @see #DpRt_JNI_Latency_Bucket_Value
+ */
+#define DPRT_JNI_LATENCY_BUCKET_COUNT			(33<<DPRT_JNI_LATENCY_SUB_BUCKET_BITS)
+/**
+ * Index of the call count in a latency statistics array.
+ * @see #DpRt_JNI_Latency_Statistics_Get
+ */
+#define DPRT_JNI_LATENCY_STATISTIC_CALL_COUNT		(0)
+/**
+ * Index of the total latency (nanoseconds) in a latency statistics array.
+ * @see #DpRt_JNI_Latency_Statistics_Get
+ */
+#define DPRT_JNI_LATENCY_STATISTIC_TOTAL		(1)
+/**
+ * Index of the minimum latency (nanoseconds) in a latency statistics array.
+ * @see #DpRt_JNI_Latency_Statistics_Get
+ */
+#define DPRT_JNI_LATENCY_STATISTIC_MINIMUM		(2)
+/**
+ * Index of the maximum latency (nanoseconds) in a latency statistics array.
+ * @see #DpRt_JNI_Latency_Statistics_Get
+ */
+#define DPRT_JNI_LATENCY_STATISTIC_MAXIMUM		(3)
+/**
+ * Index of the first histogram bucket count in a latency statistics array.
+ * @see #DpRt_JNI_Latency_Statistics_Get
+ */
+#define DPRT_JNI_LATENCY_STATISTIC_BUCKET		(4)
+/**
+ * The length of a latency statistics array.
+ * @see #DpRt_JNI_Latency_Statistics_Get
+ */
+#define DPRT_JNI_LATENCY_STATISTIC_COUNT		(DPRT_JNI_LATENCY_STATISTIC_BUCKET+DPRT_JNI_LATENCY_BUCKET_COUNT)
+
+/**
+ * Structure describing one keyword to retrieve with DpRt_JNI_Get_Property_List, and holding the result.
+ * <dl>
+ * <dt>Keyword</dt><dd>The keyword to look up. Filled in by the caller.</dd>
+ * <dt>Type</dt><dd>The type of value to retrieve, one of DPRT_JNI_PROPERTY_TYPE_STRING,
+ *     DPRT_JNI_PROPERTY_TYPE_INTEGER, DPRT_JNI_PROPERTY_TYPE_DOUBLE, DPRT_JNI_PROPERTY_TYPE_BOOLEAN. 
+ *     Filled in by the caller.</dd>
+ * <dt>String_Value</dt><dd>The string value, if Type is DPRT_JNI_PROPERTY_TYPE_STRING. This is dynamically 
+ *     allocated and must be freed using <b>free()</b>. NULL otherwise.</dd>
+ * <dt>Integer_Value</dt><dd>The integer value, if Type is DPRT_JNI_PROPERTY_TYPE_INTEGER.</dd>
+ * <dt>Double_Value</dt><dd>The double value, if Type is DPRT_JNI_PROPERTY_TYPE_DOUBLE.</dd>
+ * <dt>Boolean_Value</dt><dd>The boolean value (TRUE or FALSE), if Type is DPRT_JNI_PROPERTY_TYPE_BOOLEAN.</dd>
+ * <dt>Error_Number</dt><dd>Zero if the value was retrieved successfully, otherwise the number of the error
+ *     that stopped it being retrieved.</dd>
+ * </dl>
+ * @see #DpRt_JNI_Get_Property_List
+ */
+struct DpRt_JNI_Property_Request_Struct
+{
+	char *Keyword;
+	int Type;
+	char *String_Value;
+	int Integer_Value;
+	double Double_Value;
+	int Boolean_Value;
+	int Error_Number;
+};
+
+/**
+ * Structure holding a source catalogue, column-wise, for DpRt_JNI_Set_Source_Catalogue.
+ * <dl>
+ * <dt>Source_Count</dt><dd>The number of sources (the length of each column).</dd>
+ * <dt>X_Pix</dt><dd>The X pixel position of each source.</dd>
+ * <dt>Y_Pix</dt><dd>The Y pixel position of each source.</dd>
+ * <dt>Flux</dt><dd>The flux of each source.</dd>
+ * <dt>FWHM</dt><dd>The FWHM of each source, in pixels.</dd>
+ * <dt>Ellipticity</dt><dd>The ellipticity of each source.</dd>
+ * <dt>Flags</dt><dd>Extraction flags for each source.</dd>
+ * </dl>
+ * @see #DpRt_JNI_Set_Source_Catalogue
+ */
+struct DpRt_JNI_Source_Catalogue_Struct
+{
+	int Source_Count;
+	double *X_Pix;
+	double *Y_Pix;
+	double *Flux;
+	double *FWHM;
+	double *Ellipticity;
+	int *Flags;
+};
+
+/**
+ * Structure holding the latency histogram of one boundary function (probe).
+ * <dl>
+ * <dt>Count</dt><dd>The number of calls.</dd>
+ * <dt>Total</dt><dd>The total latency of the calls, in nanoseconds.</dd>
+ * <dt>Minimum</dt><dd>The shortest latency, in nanoseconds.</dd>
+ * <dt>Maximum</dt><dd>The longest latency, in nanoseconds.</dd>
+ * <dt>Bucket_List</dt><dd>The number of calls in each latency bucket. See DpRt_JNI_Latency_Bucket_Value.</dd>
+ * </dl>
+ * @see #DpRt_JNI_Latency_Histogram_Get
+ */
+struct DpRt_JNI_Latency_Histogram_Struct
+{
+	unsigned long long Count;
+	unsigned long long Total;
+	unsigned long long Minimum;
+	unsigned long long Maximum;
+	unsigned long long Bucket_List[DPRT_JNI_LATENCY_BUCKET_COUNT];
+};
+
+/**
+ * An independent pipeline context, holding it's own property backend, logger, status object and abort flag.
+ * The structure is private to dprt_jni_general.c.
+ */
+struct DpRt_JNI_Context_Struct;
+/**
+ * A reference counted, immutable snapshot of a context's properties, from which values can be borrowed.
+ * The structure is private to dprt_jni_general.c.
+ */
+struct DpRt_JNI_Property_Snapshot_Struct;
+/**
+ * A cancellation token for one reduction, cancelled individually or by DpRt_JNI_Set_Abort.
+ * The structure is private to dprt_jni_general.c.
+ */
+struct DpRt_JNI_Cancel_Token_Struct;
+/**
+ * The deadline of one reduction, watched by the deadline watchdog thread.
+ * The structure is private to dprt_jni_general.c.
+ */
+struct DpRt_JNI_Deadline_Struct;
+
 /* variable declarations */
-extern int DpRt_JNI_Error_Number;
-extern char DpRt_JNI_Error_String[];
+/**
+ * Error Number - set this to a unique value for each location an error occurs. 
+ * This is the calling thread's error number, so it can be used as an ordinary int variable.
+ * This is a macro, not an exported variable, since the library's ABI version 2 (see the README), 
+ * so modules built against an older header must be rebuilt.
+ */
+#define DpRt_JNI_Error_Number	(*DpRt_JNI_Error_Number_Location())
+/**
+ * Error String - set this to a descriptive string each place an error occurs.
+ * Ensure the string is not longer than DPRT_ERROR_STRING_LENGTH long.
+ * This is the calling thread's error string, so it can be used as an ordinary char array (including with
+ * sizeof, which gives DPRT_ERROR_STRING_LENGTH).
+ * DpRt_JNI_Error_Set is cheaper, as it only formats the message if it is retrieved.
+ * This is a macro, not an exported variable, since the library's ABI version 2 (see the README).
+ */
+#define DpRt_JNI_Error_String	(*DpRt_JNI_Error_String_Location())
 
 /* function declarations */
 /* initialisation/finalisation */
 extern void DpRt_JNI_Set_Java_VM(JavaVM *vm);
+extern void DpRt_JNI_Get_Thread_Attach_Statistics(unsigned long *attach_count,unsigned long *detach_count);
+extern void DpRt_JNI_Set_Local_Reference_Debug(int enable);
+extern int DpRt_JNI_Get_Local_Reference_Count(int *live_count,int *high_water_count);
 extern void DpRt_JNI_Set_Status(JNIEnv *env,jobject object,jobject status);
 extern void DpRt_JNI_Initialise_Logger_Reference(JNIEnv *env,jobject obj,jobject l);
 extern void DpRt_JNI_Finalise_Logger_Reference(JNIEnv *env);
@@ -60,16 +399,66 @@ extern int DpRt_JNI_Initialise(void);
 /* abort */
 extern void DpRt_JNI_Set_Abort(int value);
 extern int DpRt_JNI_Get_Abort(void);
+extern int DpRt_JNI_Cancel_Token_Create(struct DpRt_JNI_Cancel_Token_Struct **token);
+extern void DpRt_JNI_Cancel_Token_Destroy(struct DpRt_JNI_Cancel_Token_Struct *token);
+extern void DpRt_JNI_Cancel_Token_Cancel(struct DpRt_JNI_Cancel_Token_Struct *token);
+extern int DpRt_JNI_Cancel_Token_Is_Cancelled(struct DpRt_JNI_Cancel_Token_Struct *token);
+extern int DpRt_JNI_Cancel_Token_Wait(struct DpRt_JNI_Cancel_Token_Struct *token,int timeout_ms);
+extern int DpRt_JNI_Cancel_Token_Get_Event_Fd(struct DpRt_JNI_Cancel_Token_Struct *token,int *fd);
+extern int DpRt_JNI_Cancel_Token_Set_Current(struct DpRt_JNI_Cancel_Token_Struct *token);
+extern struct DpRt_JNI_Cancel_Token_Struct *DpRt_JNI_Cancel_Token_Get_Current(void);
+/* reduction deadlines */
+extern int DpRt_JNI_Deadline_Start(JNIEnv *env,jclass cls,jobject done,char *budget_keyword,
+				   struct DpRt_JNI_Deadline_Struct **deadline);
+extern void DpRt_JNI_Deadline_Stage_Set(struct DpRt_JNI_Deadline_Struct *deadline,char *stage);
+extern int DpRt_JNI_Deadline_Finish(JNIEnv *env,struct DpRt_JNI_Deadline_Struct *deadline);
+extern int DpRt_JNI_Deadline_Watchdog_Stop(void);
+extern unsigned long DpRt_JNI_Deadline_Get_Overrun_Count(void);
+/* work-stealing reduction scheduler */
+extern int DpRt_JNI_Scheduler_Start(char *property_prefix);
+extern int DpRt_JNI_Scheduler_Submit(JNIEnv *env,jclass cls,jobject done,
+				     int (*reduce_fp)(JNIEnv *env,jclass cls,jobject done,void *user_data),
+				     void *user_data);
+extern int DpRt_JNI_Scheduler_Stop(void);
+extern void DpRt_JNI_Scheduler_Get_Statistics(unsigned long *submitted_count,unsigned long *completed_count,
+					      unsigned long *stolen_count);
+/* asynchronous reductions */
+extern int DpRt_JNI_Completion_Queue_Start(JNIEnv *env);
+extern int DpRt_JNI_Completion_Queue_Stop(void);
+extern void DpRt_JNI_Completion_Queue_Get_Statistics(unsigned long *completion_count,unsigned long *batch_count);
+extern int DpRt_JNI_Reduce_Async_Submit(JNIEnv *env,jclass cls,jobject done,jobject future,
+					int (*reduce_fp)(JNIEnv *env,jclass cls,jobject done,void *user_data),
+					void *user_data);
+/* latency histograms */
+extern void DpRt_JNI_Latency_Set_Enabled(int enable);
+extern int DpRt_JNI_Latency_Histogram_Get(int probe,struct DpRt_JNI_Latency_Histogram_Struct *histogram);
+extern unsigned long long DpRt_JNI_Latency_Bucket_Value(int bucket_index);
+extern unsigned long long DpRt_JNI_Latency_Histogram_Get_Percentile(struct DpRt_JNI_Latency_Histogram_Struct *histogram,
+								    double percentile);
+extern jlongArray DpRt_JNI_Latency_Statistics_Get(JNIEnv *env,int probe);
 /* top level client API for getting property */
 extern int DpRt_JNI_Get_Property(char *keyword,char **value_string);
 extern int DpRt_JNI_Get_Property_Integer(char *keyword,int *value);
 extern int DpRt_JNI_Get_Property_Double(char *keyword,double *value);
 extern int DpRt_JNI_Get_Property_Boolean(char *keyword,int *value);
+extern int DpRt_JNI_Get_Property_List(struct DpRt_JNI_Property_Request_Struct *request_list,int request_count);
+/* optional properties, a default value is used if the keyword cannot be retrieved */
+extern int DpRt_JNI_Get_Property_Default(char *keyword,char *default_value,char **value_string);
+extern int DpRt_JNI_Get_Property_Integer_Default(char *keyword,int default_value,int *value);
+extern int DpRt_JNI_Get_Property_Double_Default(char *keyword,double default_value,double *value);
+extern int DpRt_JNI_Get_Property_Boolean_Default(char *keyword,int default_value,int *value);
+/* borrowed property values, valid until the snapshot is released */
+extern int DpRt_JNI_Property_Snapshot_Acquire(struct DpRt_JNI_Property_Snapshot_Struct **snapshot);
+extern int DpRt_JNI_Property_Snapshot_Get(struct DpRt_JNI_Property_Snapshot_Struct *snapshot,char *keyword,
+					  const char **value,size_t *length);
+extern void DpRt_JNI_Property_Snapshot_Release(struct DpRt_JNI_Property_Snapshot_Struct *snapshot);
 /* routines to set function pointer for property */
 extern void DpRt_JNI_Set_Property_Function_Pointer(int (*get_property_fp)(char *keyword,char **value_string));
 extern void DpRt_JNI_Set_Property_Integer_Function_Pointer(int (*get_property_integer_fp)(char *keyword,int *value));
 extern void DpRt_JNI_Set_Property_Double_Function_Pointer(int (*get_property_double_fp)(char *keyword,double *value));
 extern void DpRt_JNI_Set_Property_Boolean_Function_Pointer(int (*get_property_boolean_fp)(char *keyword,int *value));
+extern void DpRt_JNI_Set_Property_List_Function_Pointer(int (*get_property_list_fp)(
+				struct DpRt_JNI_Property_Request_Struct *request_list,int request_count));
 /* routines to get properties via the DpRtStatus object.
 ** Should not be used directly, should be parameters to DpRt_JNI_Set_Property_*_Function_Pointer
 ** and the top-level DpRt_JNI_Get_Property* should be used to actually get property values. */
@@ -77,22 +466,80 @@ extern int DpRt_JNI_DpRtStatus_Get_Property(char *keyword,char **value_string);
 extern int DpRt_JNI_DpRtStatus_Get_Property_Integer(char *keyword,int *value);
 extern int DpRt_JNI_DpRtStatus_Get_Property_Double(char *keyword,double *value);
 extern int DpRt_JNI_DpRtStatus_Get_Property_Boolean(char *keyword,int *value);
+extern int DpRt_JNI_DpRtStatus_Get_Property_List(struct DpRt_JNI_Property_Request_Struct *request_list,
+						 int request_count);
+/* invalidate values cached by the DpRtStatus property routines, when the Java layer re-loads it's properties */
+extern void DpRt_JNI_DpRtStatus_Property_Cache_Invalidate(void);
+/* snapshot DpRtStatus properties into native memory */
+extern int DpRt_JNI_Set_Status_Snapshot(int enable,char *prefix);
+extern int DpRt_JNI_Status_Snapshot_Refresh(JNIEnv *env);
 /* routines to set command dones */
 extern int DpRt_JNI_Set_Command_Done(JNIEnv *env,jclass cls,jobject done,
 					int successful,int error_number,char *error_string);
 extern int DpRt_JNI_Set_Reduce_Done(JNIEnv *env,jclass cls,jobject done,char *output_filename);
+extern int DpRt_JNI_Set_Reduce_Results(JNIEnv *env,jclass cls,jobject done,double *result_list,int result_count,
+				       unsigned int result_set_mask);
+extern int DpRt_JNI_Set_Source_Catalogue(JNIEnv *env,jclass cls,jobject done,
+					 struct DpRt_JNI_Source_Catalogue_Struct *catalogue);
 extern int DpRt_JNI_Set_Calibrate_Reduce_Done(JNIEnv *env,jclass cls,jobject done,
 					      double mean_counts,double peak_counts);
 extern int DpRt_JNI_Set_Expose_Reduce_Done(JNIEnv *env,jclass cls,jobject done,double seeing,double counts,
 					   double x_pix,double y_pix,double photometricity,
 					   double sky_brightness,int saturated);
+extern void DpRt_JNI_Finalise_Done_Class_References(JNIEnv *env);
+extern int DpRt_JNI_Set_Reduce_Frame(JNIEnv *env,jclass cls,jobject done,int frame_handle);
+/* zero-copy frame exchange */
+extern int DpRt_JNI_Frame_Create(size_t length,int *frame_handle);
+extern int DpRt_JNI_Frame_Wrap(void *data,size_t length,void (*free_fp)(void *data,void *user_data),void *user_data,
+			       int *frame_handle);
+extern int DpRt_JNI_Frame_From_Buffer(JNIEnv *env,jobject buffer,int *frame_handle);
+extern int DpRt_JNI_Frame_Get_Data(int frame_handle,void **data,size_t *length);
+extern int DpRt_JNI_Frame_Retain(int frame_handle);
+extern int DpRt_JNI_Frame_Release(int frame_handle);
+extern jobject DpRt_JNI_Frame_New_Buffer(JNIEnv *env,int frame_handle);
+/* frame buffer pool */
+extern int DpRt_JNI_Frame_Pool_Initialise(char *property_prefix);
+extern int DpRt_JNI_Frame_Pool_Finalise(void);
+extern int DpRt_JNI_Frame_Pool_Get(size_t length,int *frame_handle);
+extern void DpRt_JNI_Frame_Pool_Get_Statistics(unsigned long *get_count,unsigned long *miss_count);
 /* exception handling */
 extern void DpRt_JNI_Throw_Exception(JNIEnv *env,char *function_name);
 extern void DpRt_JNI_Throw_Exception_String(JNIEnv *env,char *function_name,int error_number,char *error_string);
 /* logging back to Java layer */
 extern void DpRt_JNI_Log_Handler(char* sub_system,char* source_filename,char* function,int level,char* category,
 				 char *string);
+extern void DpRt_JNI_Log_Format(char *sub_system,char *source_filename,char *function,int level,char *category,
+				char *format,...);
+extern void DpRt_JNI_Set_Log_Filter_Level(int level);
+extern void DpRt_JNI_Set_Log_Filter_Function(int (*filter_fp)(char *sub_system,char *source_filename,
+							      char *function,int level,char *category,char *string));
+extern int DpRt_JNI_Log_Filter_Level_Absolute(char *sub_system,char *source_filename,char *function,int level,
+					      char *category,char *string);
+extern int DpRt_JNI_Log_Filter_Level_Bitwise(char *sub_system,char *source_filename,char *function,int level,
+					     char *category,char *string);
+/* structured logging, sub-system/source filename/function/category sent to Java as interned integer IDs */
+extern int DpRt_JNI_Log_Intern(char *string);
+extern void DpRt_JNI_Initialise_Log_Record_Handler_Reference(JNIEnv *env,jobject obj,jobject handler);
+extern void DpRt_JNI_Finalise_Log_Record_Handler_Reference(JNIEnv *env);
+extern int DpRt_JNI_Log_Queue_Start(int capacity,int overflow_policy);
+extern int DpRt_JNI_Log_Queue_Stop(void);
+extern void DpRt_JNI_Log_Queue_Get_Statistics(unsigned long *record_count,unsigned long *dropped_count,
+					      unsigned long *blocked_count);
+/* contexts */
+extern int DpRt_JNI_Context_Create(struct DpRt_JNI_Context_Struct **context);
+extern int DpRt_JNI_Context_Destroy(JNIEnv *env,struct DpRt_JNI_Context_Struct *context);
+extern struct DpRt_JNI_Context_Struct *DpRt_JNI_Context_Get_Default(void);
+extern int DpRt_JNI_Context_Set_Current(struct DpRt_JNI_Context_Struct *context);
+extern struct DpRt_JNI_Context_Struct *DpRt_JNI_Context_Get_Current(void);
 /* error retrieval */
 extern int DpRt_JNI_Get_Error_Number(void);
 extern void DpRt_JNI_Get_Error_String(char *error_string);
+extern void DpRt_JNI_Error_Set(int error_number,char *format,...)
+#ifdef __GNUC__
+	__attribute__((format(printf,2,3)))
+#endif
+	;
+extern void DpRt_JNI_Error_Clear(void);
+extern int *DpRt_JNI_Error_Number_Location(void);
+extern char (*DpRt_JNI_Error_String_Location(void))[DPRT_ERROR_STRING_LENGTH];
 #endif